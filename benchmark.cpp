@@ -0,0 +1,144 @@
+#include "benchmark.h"
+#include "lib/cpu.h"
+#include "lib/intersection.h"
+#include "lib/kdtree.h"
+#include "lib/runtime.h"
+#include "lib/scene.h"
+#include "lib/scene_file.h"
+#include "lib/types.h"
+#include "lib/xorshift.h"
+
+#include <docopt/docopt.h>
+
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <vector>
+
+namespace {
+
+/**
+ * Generate one primary ray through the center of each pixel, and for each
+ * primary hit one secondary ray in a random direction on the side of the
+ * surface the primary ray came from.
+ */
+std::vector<Ray> generate_rays(const Camera& cam, const KDTree& tree,
+                               int width, int height) {
+    std::vector<Ray> rays;
+    rays.reserve(2 * width * height);
+
+    KDTreeIntersection tree_intersection(tree);
+    xorshift64star<float> uniform(42);
+
+    const Point3f cam_pos(cam.mPosition.x, cam.mPosition.y, cam.mPosition.z);
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            Ray ray(cam_pos,
+                    cam.raster2cam({x + 0.5f, y + 0.5f}, width, height));
+            rays.push_back(ray);
+
+            float r, s, t;
+            auto id = tree_intersection.intersect(ray, r, s, t);
+            if (!id) {
+                continue;
+            }
+
+            Vector3f normal(tree[id].normal);
+            if (dot(normal, ray.d) > 0) {
+                normal = -normal;
+            }
+
+            // rejection sampling of a direction in the unit ball
+            Vector3f dir;
+            do {
+                dir = {2 * uniform() - 1, 2 * uniform() - 1,
+                       2 * uniform() - 1};
+            } while (dir.length_squared() > 1 || dir.length_squared() == 0);
+            if (dot(dir, normal) < 0) {
+                dir = -dir;
+            }
+
+            rays.emplace_back(ray(r) + normal * EPS, normalize(dir));
+        }
+    }
+    return rays;
+}
+
+template <typename Intersector>
+void run(const char* name, const KDTree& tree, const std::vector<Ray>& rays,
+         size_t repeat) {
+    size_t precompute_ms = 0;
+    auto kernel_tree = ([&] {
+        Runtime runtime(precompute_ms);
+        return BasicKDTree<Intersector>(tree);
+    })();
+    BasicKDTreeIntersection<Intersector> tree_intersection(kernel_tree);
+
+    size_t num_hits = 0;
+    size_t runtime_ms = 0;
+    {
+        Runtime runtime(runtime_ms);
+        for (size_t i = 0; i < repeat; ++i) {
+            for (const auto& ray : rays) {
+                if (tree_intersection.intersect(ray)) {
+                    num_hits += 1;
+                }
+            }
+        }
+    }
+
+    std::cerr << name << std::endl;
+    std::cerr << "  Precompute     : " << precompute_ms << "ms" << std::endl;
+    std::cerr << "  Runtime        : " << runtime_ms << "ms" << std::endl;
+    std::cerr << "  Hits           : " << num_hits / repeat << std::endl;
+    std::cerr << "  Rays/sec       : " << std::fixed << std::setprecision(0)
+              << 1000. * rays.size() * repeat / std::max<size_t>(runtime_ms, 1)
+              << std::endl;
+}
+
+} // namespace
+
+int main(int argc, char const* argv[]) {
+    std::map<std::string, docopt::value> args =
+        docopt::docopt(USAGE, {argv + 1, argv + argc});
+    const std::string filename = args.at("<filename>").asString();
+    const int width = args.at("--width").asLong();
+    float aspect = std::stof(args.at("--aspect").asString());
+    const size_t repeat = args.at("--repeat").asLong();
+    assert(width > 0);
+    assert(repeat > 0);
+
+    std::cerr << "Loading scene..." << std::endl;
+    Scene scene;
+    std::string error;
+    if (!load_scene(filename, scene, error)) {
+        std::cerr << error << std::endl;
+        return 1;
+    }
+    if (!scene.chunks.empty()) {
+        std::cerr << "Out-of-core scenes are only supported by the tracers"
+                  << std::endl;
+        return 1;
+    }
+
+    const Camera cam = scene.make_camera(aspect);
+    const int height = width / aspect;
+
+    std::cerr << "Building kd-tree..." << std::endl;
+    KDTree tree(std::move(scene.mesh));
+
+    std::cerr << "Generating rays..." << std::endl;
+    const auto rays = generate_rays(cam, tree, width, height);
+
+    std::cerr << "Triangles      : " << tree.num_triangles() << std::endl;
+    std::cerr << "Kd-Tree Height : " << tree.height() << std::endl;
+    std::cerr << "Rays           : " << rays.size() << std::endl;
+    std::cerr << "Passes         : " << repeat << std::endl;
+    std::cerr << "CPU dispatch   : " << cpu::isa() << std::endl;
+    std::cerr << std::endl;
+
+    run<intersector::MoellerTrumbore>("Moeller-Trumbore", tree, rays, repeat);
+    run<intersector::WaldProjection>("Wald projection", tree, rays, repeat);
+    run<intersector::BaldwinWeber>("Baldwin-Weber", tree, rays, repeat);
+    return 0;
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+static const char* USAGE =
+    R"(Usage: turner-benchmark <filename> [options]
+
+Measures the throughput of the ray-triangle intersection kernels on a scene.
+All kernels traverse the same kd-tree with the same set of rays: one primary
+ray per pixel and one random secondary ray per primary hit.
+
+Options:
+  -w --width=<px>            Width of the ray raster [default: 640].
+  -a --aspect=<num>          Aspect ratio of the raster. If the model has
+                             specified the aspect ratio, it will be used
+                             [default: 1].
+  -r --repeat=<int>          Number of passes over all rays [default: 3].
+)";
@@ -0,0 +1,124 @@
+#include "client.h"
+#include "lib/daemon.h"
+#include "lib/progress_bar.h"
+
+#include <docopt/docopt.h>
+
+#include <csignal>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+
+namespace {
+
+// socket and cancel message for the signal handler
+int g_socket = -1;
+std::string g_cancel;
+
+void cancel(int) {
+    // send is async-signal-safe
+    ::send(g_socket, g_cancel.data(), g_cancel.size(), MSG_NOSIGNAL);
+}
+
+} // namespace
+
+int main(int argc, char const* argv[]) {
+    std::map<std::string, docopt::value> args =
+        docopt::docopt(USAGE, {argv + 1, argv + argc});
+    const std::string id = args.at("--id").asString();
+
+    std::string job = "{\"id\": " + json_string(id) + ", \"scene\": " +
+                      json_string(args.at("<scene>").asString());
+    if (args.at("--renderer")) {
+        job += ", \"renderer\": " +
+               json_string(args.at("--renderer").asString());
+    }
+    if (args.at("--camera")) {
+        job += ", \"camera\": " + json_string(args.at("--camera").asString());
+    }
+    job += ", \"args\": [";
+    const auto job_args = args.at("<arg>").asStringList();
+    for (size_t i = 0; i < job_args.size(); ++i) {
+        job += (i ? ", " : "") + json_string(job_args[i]);
+    }
+    job += "]}";
+
+    std::string error;
+    const int fd = connect_unix(args.at("<socket>").asString(), error);
+    if (fd < 0) {
+        std::cerr << error << std::endl;
+        return 1;
+    }
+    Connection connection(fd);
+    if (!connection.send_line(job)) {
+        std::cerr << "Cannot send the job" << std::endl;
+        return 1;
+    }
+    g_socket = fd;
+    g_cancel = "{\"cancel\": " + json_string(id) + "}\n";
+    std::signal(SIGINT, cancel);
+
+    std::unique_ptr<ProgressBar> progress_bar;
+    size_t pass = 0;
+    std::string line;
+    while (connection.read_line(line)) {
+        Json event;
+        if (!parse_json(line, event, error) || !event.is_object()) {
+            std::cerr << "Invalid event: " << line << std::endl;
+            return 1;
+        }
+        auto number = [&](const char* key) {
+            const Json* value = event.find(key);
+            return value ? value->number : 0;
+        };
+        auto string = [&](const char* key) {
+            const Json* value = event.find(key);
+            return value ? value->string : std::string();
+        };
+
+        const std::string type = string("event");
+        if (type == "progress") {
+            const size_t event_pass = number("pass");
+            if (event_pass != pass) {
+                if (progress_bar) {
+                    std::cerr << std::endl;
+                }
+                pass = event_pass;
+                progress_bar.reset(
+                    new ProgressBar(std::cerr, "Pass " + std::to_string(pass),
+                                    number("total")));
+            }
+            progress_bar->update(number("tiles"));
+        } else if (type == "image") {
+            std::string image;
+            if (!connection.read_bytes(image, number("bytes"))) {
+                break;
+            }
+            if (args.at("--output")) {
+                std::ofstream file(args.at("--output").asString(),
+                                   std::ios::binary);
+                file << image;
+            } else {
+                std::cout << image;
+            }
+        } else if (type == "done") {
+            const Json* cached = event.find("cached");
+            std::cerr << std::endl
+                      << "Rendered in " << number("runtime_ms") << " ms"
+                      << (cached && cached->boolean ? " with the loaded scene"
+                                                    : "")
+                      << std::endl;
+            return 0;
+        } else if (type == "cancelled") {
+            std::cerr << std::endl << "Cancelled" << std::endl;
+            return 1;
+        } else if (type == "error") {
+            std::cerr << std::endl << string("message") << std::endl;
+            return 1;
+        }
+    }
+    std::cerr << "Connection to the daemon lost" << std::endl;
+    return 1;
+}
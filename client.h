@@ -0,0 +1,18 @@
+#pragma once
+
+static const char* USAGE =
+    R"(Usage: turner-client <socket> <scene> [options] [--] [<arg>...]
+
+Sends a render job of <scene> to a tracer started with --serve=<socket> and
+writes the image in PPM format to stdout. The <arg>s are options of the tracer,
+e.g. -- -p 16 -w 320. Progress is printed to stderr, and Ctrl-C cancels the
+job.
+
+Options:
+  --id=<id>                  Id of the job [default: job].
+  --renderer=<name>          Fail unless the daemon is this renderer, e.g.
+                             pathtracer.
+  --camera=<camera>          Camera as a line of a camera file (cf. --cameras
+                             of the tracers) instead of the one of the scene.
+  -o --output=<file>         Write the image to <file> instead of stdout.
+)";
@@ -1,11 +1,15 @@
 #pragma once
 
+#include "lib/sampler.h"
+#include "lib/tile_scheduler.h"
 #include "lib/types.h"
 
 #include <docopt/docopt.h>
 
+#include <iostream>
 #include <map>
 #include <sstream>
+#include <stdexcept>
 
 /**
  * Common configuration
@@ -18,6 +22,8 @@ struct Config {
     // common options
     bool verbose = false;
     size_t num_threads = 1;
+    size_t tile_size = 16; // edge length of the tiles rendered by a thread
+    SamplerType sampler = SamplerType::SOBOL;
     float inverse_gamma = 0.454545;
     float exposure = 1;
     Color bg_color;
@@ -26,10 +32,58 @@ struct Config {
     // scene
     std::string filename;
 
+    // if not empty, file to which the stats are written as JSON
+    std::string stats_json;
+    // if not empty, file to which the telemetry is written every
+    // telemetry_interval seconds while rendering (cf. lib/telemetry.h)
+    std::string telemetry;
+    float telemetry_interval = 1;
+
+    /**
+     * Check the ranges of the options without asserting, e.g. for the options
+     * of a job of the render daemon.
+     *
+     * @return false with an error message naming the first invalid option.
+     */
+    bool validate(std::string& error) const {
+        // written as !(...) to reject NaN, too
+        if (!(0 < aspect)) {
+            error = "--aspect must be positive";
+        } else if (width < 1) {
+            error = "--width must be positive";
+        } else if (num_threads < 1) {
+            error = "--threads must be positive";
+        } else if (tile_size < 1) {
+            error = "--tile-size must be positive";
+        } else if (!(0 <= exposure)) {
+            error = "--exposure must not be negative";
+        } else if (!(0 < telemetry_interval)) {
+            error = "--telemetry-interval must be positive";
+        } else {
+            return true;
+        }
+        return false;
+    }
+
     void check() const {
-        assert(0 < aspect);
-        assert(1 <= num_threads);
-        assert(0 <= exposure);
+        std::string error;
+        const bool valid = validate(error);
+        if (!valid) {
+            std::cerr << error << std::endl;
+        }
+        assert(valid && "invalid options");
+        (void)valid;
+    }
+
+    /**
+     * Value of an option counting something, which must not be negative.
+     */
+    static size_t as_size(const docopt::value& value) {
+        const long n = value.asLong();
+        if (n < 0) {
+            throw std::invalid_argument("Negative count " + value.asString());
+        }
+        return n;
     }
 
     /**
@@ -38,11 +92,11 @@ struct Config {
      * @param  color_str contains either
      *         1. one numerical value in [0, 255], or
      *         2. three space-separated numerical values in [0, 255].
-     * @return if color_str is of type 1, then return Color with constant value
-     *         for all three channels, otherwise Color with channels containing
-     *         corresponding parsed values.
+     * @return false if color_str is neither, otherwise color with constant
+     *         value for all three channels if color_str is of type 1, or
+     *         with channels containing the corresponding parsed values.
      */
-    static Color parse_color(const std::string& color_str) {
+    static bool parse_color(const std::string& color_str, Color& color) {
         std::vector<float> result;
         std::stringstream ss(color_str);
         std::string item;
@@ -51,34 +105,76 @@ struct Config {
         }
 
         if (result.size() == 1) {
-            return Color{result[0], result[0], result[0], 1};
+            color = Color{result[0], result[0], result[0], 1};
         } else if (result.size() == 3) {
-            return Color{result[0], result[1], result[2], 1};
+            color = Color{result[0], result[1], result[2], 1};
+        } else {
+            return false;
         }
-        assert(false);
-        return {};
+        return true;
     }
 
-    static Config
-    from_docopt(const std::map<std::string, docopt::value>& args) {
-        Config conf;
-
+    /**
+     * Parse the common options into conf without asserting.
+     *
+     * @return false with an error message if an option is invalid. Malformed
+     *         numbers throw std::invalid_argument.
+     */
+    static bool parse(const std::map<std::string, docopt::value>& args,
+                      Config& conf, std::string& error) {
         conf.verbose = args.at("--verbose").asBool();
-        conf.width = args.at("--width").asLong();
+        conf.width = as_size(args.at("--width"));
         if (args.at("--aspect")) {
             conf.aspect = std::stof(args.at("--aspect").asString());
         }
 
-        conf.num_threads = args.at("--threads").asLong();
+        conf.num_threads = as_size(args.at("--threads"));
+        if (args.count("--tile-size")) {
+            conf.tile_size = as_size(args.at("--tile-size"));
+        }
+        if (args.count("--sampler") &&
+            !parse_sampler_type(args.at("--sampler").asString(),
+                                conf.sampler)) {
+            error = "Unknown sampler " + args.at("--sampler").asString();
+            return false;
+        }
         conf.inverse_gamma = std::stof(args.at("--inverse-gamma").asString());
         conf.exposure = std::stof(args.at("--exposure").asString());
-        conf.bg_color = parse_color(args.at("--background").asString());
+        if (!parse_color(args.at("--background").asString(), conf.bg_color)) {
+            error = "--background is neither one nor three numbers";
+            return false;
+        }
         conf.gamma_correction_enabled =
             !args.at("--no-gamma-correction").asBool();
 
-        conf.filename = args.at("<filename>").asString();
+        // the render daemon gets the scenes with the jobs
+        if (args.at("<filename>")) {
+            conf.filename = args.at("<filename>").asString();
+        }
+        if (args.count("--stats-json") && args.at("--stats-json")) {
+            conf.stats_json = args.at("--stats-json").asString();
+        }
+        if (args.count("--telemetry") && args.at("--telemetry")) {
+            conf.telemetry = args.at("--telemetry").asString();
+        }
+        if (args.count("--telemetry-interval")) {
+            conf.telemetry_interval =
+                std::stof(args.at("--telemetry-interval").asString());
+        }
+
+        return conf.validate(error);
+    }
 
-        conf.check();
+    static Config
+    from_docopt(const std::map<std::string, docopt::value>& args) {
+        Config conf;
+        std::string error;
+        const bool valid = parse(args, conf, error);
+        if (!valid) {
+            std::cerr << error << std::endl;
+        }
+        assert(valid && "invalid options");
+        (void)valid;
         return conf;
     }
 };
@@ -90,6 +186,17 @@ inline std::ostream& operator<<(std::ostream& os, const Config& conf) {
     os << std::endl;
     os << "Common parameters:" << std::endl;
     os << "  Number of threads: " << conf.num_threads << std::endl;
+    os << "  Tile size: " << conf.tile_size << std::endl;
+    os << "  Sampler: " << to_string(conf.sampler) << std::endl;
+    os << "  Stats JSON: " << (conf.stats_json.empty() ? "no" : conf.stats_json)
+       << std::endl;
+    os << "  Telemetry: ";
+    if (conf.telemetry.empty()) {
+        os << "no";
+    } else {
+        os << conf.telemetry << " every " << conf.telemetry_interval << " s";
+    }
+    os << std::endl;
     os << "  Inverse gamma: " << conf.inverse_gamma << std::endl;
     os << "  Exposure: " << conf.exposure << std::endl;
     os << "  Background color: " << conf.exposure << std::endl;
@@ -105,6 +212,37 @@ struct TracerConfig : public Config {
 
     // common tracer options
     int max_recursion_depth = 3;
+    // if not empty, output prefix of the traversal cost heatmap
+    std::string heatmap;
+    // directory of the kd-tree cache; if empty, the cache is disabled
+    std::string cache_dir = "kdtree-cache";
+    // memory for the chunks of an out-of-core scene in MB
+    size_t memory_limit_mb = 1024;
+    // if not empty, file of the checkpoints written every checkpoint_interval
+    // seconds, which is read first if resume is set
+    std::string checkpoint;
+    size_t checkpoint_interval = 600;
+    bool resume = false;
+    // progressive rendering: if > 0, passes of num_pixel_samples samples per
+    // pixel are rendered until time_limit seconds after the start
+    size_t time_limit = 0;
+    // distribution over processes: rectangle of the image to render (empty
+    // for the whole image), seed of the random streams, and if not empty, file
+    // of the samples of the rectangle (cf. lib/partial.h)
+    Tile region = {0, 0, 0, 0};
+    uint64_t seed = 0;
+    std::string partial;
+    // batch: if not empty, file of the cameras to render (cf. lib/cameras.h),
+    // whose images are written to <output>NNNN.ppm
+    std::string cameras;
+    std::string output = "frame";
+    // daemon: if not empty, Unix socket on which jobs are received (cf.
+    // lib/daemon.h), and the number of scenes kept loaded
+    std::string serve;
+    size_t max_scenes = 4;
+    // if not empty, file to which the preview levels and finally the image are
+    // written while rendering (cf. lib/preview.h)
+    std::string preview;
 
     // raycaster options
     float max_visibility = 2;
@@ -115,20 +253,147 @@ struct TracerConfig : public Config {
     // pathtracer options
     int num_pixel_samples = 1;
     int num_monte_carlo_samples = 1;
+    // adaptive sampling: relative standard error of the pixel mean at which
+    // a pixel is done (0 disables), and the cap of samples per pixel
+    float adaptive_threshold = 0;
+    int max_pixel_samples = 64;
+    // if not empty, output prefix of the number of samples per pixel
+    std::string samples_aov;
 
-    void check() const {
-        Config::check();
-        assert(0 < max_recursion_depth);
-        assert(0 <= max_visibility);
-        assert(0 <= shadow_intensity && shadow_intensity <= 1);
-        assert(1 <= num_pixel_samples);
-        assert(0 <= num_monte_carlo_samples);
+    /**
+     * Check the ranges of the options without asserting (cf.
+     * Config::validate).
+     */
+    bool validate(std::string& error) const {
+        if (!Config::validate(error)) {
+            return false;
+        }
+        if (max_recursion_depth < 1) {
+            error = "--max-depth must be positive";
+        } else if (memory_limit_mb < 1) {
+            error = "--memory-limit must be positive";
+        } else if (checkpoint_interval < 1) {
+            error = "--checkpoint-interval must be positive";
+        } else if (resume && checkpoint.empty()) {
+            error = "--resume needs a --checkpoint";
+        } else if (time_limit > 0 && !checkpoint.empty()) {
+            error = "--time-limit cannot be combined with --checkpoint";
+        } else if (region.x0 > region.x1 || region.y0 > region.y1) {
+            error = "--region must be x0,y0,x1,y1 with x0 <= x1 and y0 <= y1";
+        } else if (region.x1 > width) {
+            error = "--region is wider than --width";
+        } else if (!cameras.empty() &&
+                   (!checkpoint.empty() || !partial.empty())) {
+            error = "--cameras cannot be combined with --checkpoint or "
+                    "--partial";
+        } else if (max_scenes < 1) {
+            error = "--max-scenes must be positive";
+        } else if (!(0 <= max_visibility)) {
+            error = "--max-visibility must not be negative";
+        } else if (!(0 <= shadow_intensity && shadow_intensity <= 1)) {
+            error = "--shadow must be in [0, 1]";
+        } else if (num_pixel_samples < 1) {
+            error = "--pixel-samples must be positive";
+        } else if (num_monte_carlo_samples < 0) {
+            error = "--monte-carlo-samples must not be negative";
+        } else if (!(0 <= adaptive_threshold)) {
+            error = "--adaptive-threshold must not be negative";
+        } else if (adaptive_threshold > 0 &&
+                   num_pixel_samples > max_pixel_samples) {
+            error = "--max-pixel-samples must be at least --pixel-samples";
+        } else {
+            return true;
+        }
+        return false;
     }
 
-    static TracerConfig
-    from_docopt(const std::map<std::string, docopt::value>& args) {
-        TracerConfig conf(Config::from_docopt(args));
+    /**
+     * Parse a region of the image from a string "x0,y0,x1,y1" of pixel
+     * coordinates, where x1 and y1 are exclusive.
+     *
+     * @return false if region_str does not have four coordinates.
+     */
+    static bool parse_region(const std::string& region_str, Tile& region) {
+        std::vector<size_t> result;
+        std::stringstream ss(region_str);
+        std::string item;
+        while (std::getline(ss, item, ',')) {
+            result.push_back(std::stoul(item));
+        }
 
+        if (result.size() != 4) {
+            return false;
+        }
+        region = {result[0], result[1], result[2], result[3]};
+        return true;
+    }
+
+    /**
+     * Parse the tracer options into conf without asserting, e.g. the options
+     * of a job of the render daemon.
+     *
+     * @return false with an error message if an option is invalid. Malformed
+     *         numbers throw std::invalid_argument.
+     */
+    static bool parse(const std::map<std::string, docopt::value>& args,
+                      TracerConfig& conf, std::string& error) {
+        Config common;
+        if (!Config::parse(args, common, error)) {
+            return false;
+        }
+        conf = TracerConfig(common);
+
+        if (args.count("--heatmap") && args.at("--heatmap")) {
+            conf.heatmap = args.at("--heatmap").asString();
+        }
+        if (args.count("--cache-dir")) {
+            conf.cache_dir = args.at("--cache-dir").asString();
+        }
+        if (args.count("--no-cache") && args.at("--no-cache").asBool()) {
+            conf.cache_dir.clear();
+        }
+        if (args.count("--memory-limit")) {
+            conf.memory_limit_mb = as_size(args.at("--memory-limit"));
+        }
+        if (args.count("--checkpoint") && args.at("--checkpoint")) {
+            conf.checkpoint = args.at("--checkpoint").asString();
+        }
+        if (args.count("--checkpoint-interval")) {
+            conf.checkpoint_interval =
+                as_size(args.at("--checkpoint-interval"));
+        }
+        if (args.count("--resume")) {
+            conf.resume = args.at("--resume").asBool();
+        }
+        if (args.count("--time-limit")) {
+            conf.time_limit = as_size(args.at("--time-limit"));
+        }
+        if (args.count("--region") && args.at("--region") &&
+            !parse_region(args.at("--region").asString(), conf.region)) {
+            error = "--region is not x0,y0,x1,y1";
+            return false;
+        }
+        if (args.count("--seed")) {
+            conf.seed = args.at("--seed").asLong();
+        }
+        if (args.count("--partial") && args.at("--partial")) {
+            conf.partial = args.at("--partial").asString();
+        }
+        if (args.count("--cameras") && args.at("--cameras")) {
+            conf.cameras = args.at("--cameras").asString();
+        }
+        if (args.count("--output")) {
+            conf.output = args.at("--output").asString();
+        }
+        if (args.count("--serve") && args.at("--serve")) {
+            conf.serve = args.at("--serve").asString();
+        }
+        if (args.count("--max-scenes")) {
+            conf.max_scenes = as_size(args.at("--max-scenes"));
+        }
+        if (args.count("--preview") && args.at("--preview")) {
+            conf.preview = args.at("--preview").asString();
+        }
         if (args.count("--max-depth")) {
             conf.max_recursion_depth = args.at("--max-depth").asLong();
         }
@@ -146,8 +411,30 @@ struct TracerConfig : public Config {
             conf.num_monte_carlo_samples =
                 args.at("--monte-carlo-samples").asLong();
         }
+        if (args.count("--adaptive-threshold")) {
+            conf.adaptive_threshold =
+                std::stof(args.at("--adaptive-threshold").asString());
+        }
+        if (args.count("--max-pixel-samples")) {
+            conf.max_pixel_samples = args.at("--max-pixel-samples").asLong();
+        }
+        if (args.count("--samples-aov") && args.at("--samples-aov")) {
+            conf.samples_aov = args.at("--samples-aov").asString();
+        }
 
-        conf.check();
+        return conf.validate(error);
+    }
+
+    static TracerConfig
+    from_docopt(const std::map<std::string, docopt::value>& args) {
+        TracerConfig conf{Config()};
+        std::string error;
+        const bool valid = parse(args, conf, error);
+        if (!valid) {
+            std::cerr << error << std::endl;
+        }
+        assert(valid && "invalid options");
+        (void)valid;
         return conf;
     }
 };
@@ -157,10 +444,70 @@ inline std::ostream& operator<<(std::ostream& os, const TracerConfig& conf) {
     os << std::endl;
     os << "Tracer parameters (not all applicable):" << std::endl;
     os << "  Max recursion depth: " << conf.max_recursion_depth << std::endl;
+    os << "  Heatmap: " << (conf.heatmap.empty() ? "no" : conf.heatmap)
+       << std::endl;
+    os << "  Kd-tree cache: "
+       << (conf.cache_dir.empty() ? "no" : conf.cache_dir) << std::endl;
+    os << "  Memory limit of chunks: " << conf.memory_limit_mb << " MB"
+       << std::endl;
+    os << "  Checkpoint: ";
+    if (conf.checkpoint.empty()) {
+        os << "no";
+    } else {
+        os << conf.checkpoint << " every " << conf.checkpoint_interval
+           << " sec" << (conf.resume ? ", resumed" : "");
+    }
+    os << std::endl;
+    os << "  Time limit: ";
+    if (conf.time_limit > 0) {
+        os << conf.time_limit << " sec";
+    } else {
+        os << "no";
+    }
+    os << std::endl;
+    os << "  Region: ";
+    if (conf.region.size() > 0) {
+        os << conf.region.x0 << "," << conf.region.y0 << " to "
+           << conf.region.x1 << "," << conf.region.y1;
+    } else {
+        os << "whole image";
+    }
+    os << std::endl;
+    os << "  Seed: " << conf.seed << std::endl;
+    os << "  Partial: " << (conf.partial.empty() ? "no" : conf.partial)
+       << std::endl;
+    os << "  Cameras: ";
+    if (conf.cameras.empty()) {
+        os << "scene";
+    } else {
+        os << conf.cameras << " to " << conf.output << "NNNN.ppm";
+    }
+    os << std::endl;
+    os << "  Serve: ";
+    if (conf.serve.empty()) {
+        os << "no";
+    } else {
+        os << conf.serve << " with at most " << conf.max_scenes
+           << " scenes loaded";
+    }
+    os << std::endl;
+    os << "  Preview: " << (conf.preview.empty() ? "no" : conf.preview)
+       << std::endl;
     os << "  Max visibility: " << conf.max_visibility << std::endl;
     os << "  Shadow intensity: " << conf.shadow_intensity << std::endl;
     os << "  Number of pixel samples: " << conf.num_pixel_samples << std::endl;
-    os << "  Number of Monte-Carlo samples: " << conf.num_monte_carlo_samples;
+    os << "  Number of Monte-Carlo samples: " << conf.num_monte_carlo_samples
+       << std::endl;
+    os << "  Adaptive sampling: ";
+    if (conf.adaptive_threshold > 0) {
+        os << "threshold " << conf.adaptive_threshold << ", at most "
+           << conf.max_pixel_samples << " samples";
+    } else {
+        os << "no";
+    }
+    os << std::endl;
+    os << "  Samples AOV: "
+       << (conf.samples_aov.empty() ? "no" : conf.samples_aov);
     return os;
 }
 
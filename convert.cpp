@@ -0,0 +1,64 @@
+#include "convert.h"
+#include "lib/chunked_kdtree.h"
+#include "lib/scene.h"
+#include "lib/scene_file.h"
+
+#include <docopt/docopt.h>
+
+#include <fstream>
+#include <iostream>
+#include <map>
+
+int main(int argc, char const* argv[]) {
+    std::map<std::string, docopt::value> args =
+        docopt::docopt(USAGE, {argv + 1, argv + argc});
+    const std::string input = args.at("<input>").asString();
+    const std::string output = args.at("<output>").asString();
+    const long num_threads = args.at("--threads").asLong();
+    const long chunk_triangles = args.at("--chunk-triangles").asLong();
+    assert(num_threads > 0);
+    assert(chunk_triangles >= 0);
+
+    std::cerr << "Loading scene..." << std::endl;
+    SceneLoadTimes load_times;
+    Assimp::Importer importer;
+    const aiScene* raw_scene = import_scene(importer, input, &load_times);
+    if (!raw_scene) {
+        std::cerr << importer.GetErrorString() << std::endl;
+        return 1;
+    }
+    Scene scene = scene_from_assimp(raw_scene, num_threads, &load_times);
+    std::cerr << load_times << std::endl;
+
+    const size_t num_vertices = scene.mesh.vertices().size();
+    const size_t num_triangles = scene.mesh.size();
+    if (chunk_triangles > 0) {
+        const std::string dir = scene_chunk_dir(output);
+        std::cerr << "Building chunks in " << dir << "..." << std::endl;
+        std::string error;
+        if (!build_chunks(scene.mesh, chunk_triangles, dir, scene.chunks, error,
+                          num_threads)) {
+            std::cerr << error << std::endl;
+            return 1;
+        }
+        // the geometry lives in the chunks
+        scene.mesh = TriangleMesh(Triangles{}, scene.mesh.materials());
+    }
+
+    std::cerr << "Writing scene..." << std::endl;
+    std::ofstream file(output, std::ios::out | std::ios::binary);
+    write_scene_file(file, scene);
+    file.close();
+    if (!file) {
+        std::cerr << "Cannot write " << output << std::endl;
+        return 1;
+    }
+
+    std::cerr << "Vertices       : " << num_vertices << std::endl;
+    std::cerr << "Triangles      : " << num_triangles << std::endl;
+    std::cerr << "Materials      : " << scene.mesh.materials().size()
+              << std::endl;
+    std::cerr << "Lights         : " << scene.lights.size() << std::endl;
+    std::cerr << "Chunks         : " << scene.chunks.size() << std::endl;
+    return 0;
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+static const char* USAGE =
+    R"(Usage: turner-convert <input> <output> [options]
+
+Converts a scene in any format supported by Assimp into the native scene
+format (cf. lib/scene_file.h). All renderers load the native format without
+any parsing or post-processing.
+
+Options:
+  -t --threads=<int>         Number of threads used to convert the meshes
+                             and to build the kd-trees of the chunks
+                             [default: 1].
+  --chunk-triangles=<n>      Write an out-of-core scene: split the mesh into
+                             chunks of at most n triangles, whose kd-trees
+                             are stored in <output>.chunks. 0 disables the
+                             splitting [default: 0].
+)";
@@ -0,0 +1,220 @@
+/**
+ * Linear accumulation of the samples of every pixel.
+ *
+ * Besides the sum of the samples, the sum of their squared luminance is kept,
+ * from which we estimate the variance of the pixel mean. Adaptive sampling
+ * spends more samples only on pixels whose estimated error is still high.
+ */
+
+#pragma once
+
+#include "raster.h"
+#include "types.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <ostream>
+#include <vector>
+
+/**
+ * Relative luminance of a linear color (Rec. 709).
+ */
+inline float luminance(const Color& c) {
+    return 0.2126f * c.r + 0.7152f * c.g + 0.0722f * c.b;
+}
+
+class Accumulator {
+public:
+    struct Pixel {
+        Color sum;
+        float sum_sq = 0; // sum of the squared luminance of the samples
+        uint32_t num_samples = 0;
+
+        // merge the samples of another pixel
+        Pixel& operator+=(const Pixel& other) {
+            sum += other.sum;
+            sum_sq += other.sum_sq;
+            num_samples += other.num_samples;
+            return *this;
+        }
+    };
+
+    Accumulator(const size_t width, const size_t height)
+        : width_(width), height_(height), pixels_(width * height) {}
+
+    size_t width() const { return width_; }
+    size_t height() const { return height_; }
+    size_t memory_bytes() const { return pixels_.size() * sizeof(Pixel); }
+
+    Pixel& operator()(size_t x, size_t y) {
+        assert(x < width_ && "x out of accumulator bounds");
+        assert(y < height_ && "y out of accumulator bounds");
+        return pixels_[y * width_ + x];
+    }
+
+    const Pixel& operator()(size_t x, size_t y) const {
+        assert(x < width_ && "x out of accumulator bounds");
+        assert(y < height_ && "y out of accumulator bounds");
+        return pixels_[y * width_ + x];
+    }
+
+    void add(size_t x, size_t y, const Color& sample) {
+        auto& pixel = (*this)(x, y);
+        const float l = luminance(sample);
+        pixel.sum += sample;
+        pixel.sum_sq += l * l;
+        pixel.num_samples += 1;
+    }
+
+    size_t num_samples(size_t x, size_t y) const {
+        return (*this)(x, y).num_samples;
+    }
+
+    Color mean(size_t x, size_t y) const {
+        const auto& pixel = (*this)(x, y);
+        return pixel.num_samples
+                   ? pixel.sum / static_cast<float>(pixel.num_samples)
+                   : Color();
+    }
+
+    /**
+     * Estimated variance of the mean luminance of a pixel, i.e. the sample
+     * variance divided by the number of samples. Infinite for less than two
+     * samples.
+     */
+    float variance_of_mean(size_t x, size_t y) const {
+        const auto& pixel = (*this)(x, y);
+        const float n = pixel.num_samples;
+        if (n < 2) {
+            return std::numeric_limits<float>::infinity();
+        }
+        const float l = luminance(pixel.sum);
+        // clamped, since the difference is subject to cancellation
+        const float variance = std::max(0.f, (pixel.sum_sq - l * l / n)) /
+                               (n - 1);
+        return variance / n;
+    }
+
+    /**
+     * Standard error of the mean luminance relative to the mean. Dark pixels
+     * are compared to MIN_LUMINANCE instead, so that noise below one 8-bit
+     * step does not count.
+     */
+    float relative_error(size_t x, size_t y) const {
+        static constexpr float MIN_LUMINANCE = 1.f / 256;
+        return std::sqrt(variance_of_mean(x, y)) /
+               std::max(luminance(mean(x, y)), MIN_LUMINANCE);
+    }
+
+    auto end() { return pixels_.end(); }
+    auto begin() { return pixels_.begin(); }
+
+    auto end() const { return pixels_.end(); }
+    auto begin() const { return pixels_.begin(); }
+
+private:
+    size_t width_;
+    size_t height_;
+    std::vector<Pixel> pixels_;
+};
+
+/**
+ * Number of samples a render spends on a pixel.
+ */
+struct SampleBudget {
+    size_t batch_size = 1;  // samples added at once
+    size_t max_samples = 1; // cap of adaptive sampling in a single pass
+    // relative error at which a pixel is done (0 disables adaptive sampling)
+    float adaptive_threshold = 0;
+    // whether every pass adds a batch instead of a single pass adding all
+    bool progressive = false;
+};
+
+/**
+ * Sample pixel (x, y) of acc in the given pass (0 for a single pass), where
+ * sample() adds one sample to the pixel.
+ *
+ * A progressive pass tops the pixel up to pass + 1 batches, unless adaptive
+ * sampling found it converged. A single pass adds batches until the pixel
+ * converged or has budget.max_samples. Samples which the pixel already has,
+ * e.g. of a preview (cf. preview.h), count towards these batches, so that
+ * every pixel ends up with the same number of samples as without them.
+ *
+ * @return false if the pixel had converged and was skipped.
+ */
+template <typename Sample>
+bool sample_pixel(const Accumulator& acc, size_t x, size_t y,
+                  const SampleBudget& budget, size_t pass, Sample sample) {
+    assert(budget.batch_size > 0);
+    auto sample_to = [&](size_t target) {
+        while (acc.num_samples(x, y) < target) {
+            sample();
+        }
+    };
+    auto converged = [&]() {
+        return acc.num_samples(x, y) >= budget.max_samples ||
+               acc.relative_error(x, y) <= budget.adaptive_threshold;
+    };
+
+    if (budget.progressive) {
+        if (budget.adaptive_threshold > 0 && converged()) {
+            return false;
+        }
+        sample_to((pass + 1) * budget.batch_size);
+        return true;
+    }
+
+    for (size_t target = budget.batch_size;; target += budget.batch_size) {
+        sample_to(std::min(target, budget.max_samples));
+        if (converged()) {
+            return true;
+        }
+    }
+}
+
+/**
+ * Mean of the samples of every pixel.
+ */
+inline Image mean_image(const Accumulator& acc) {
+    Image image(acc.width(), acc.height());
+    for (size_t y = 0; y < acc.height(); ++y) {
+        for (size_t x = 0; x < acc.width(); ++x) {
+            image(x, y) = acc.mean(x, y);
+        }
+    }
+    return image;
+}
+
+/**
+ * Number of samples of every pixel in shades of gray, normalized by the
+ * maximum number.
+ */
+inline Image samples_image(const Accumulator& acc) {
+    uint32_t max_samples = 0;
+    for (const auto& pixel : acc) {
+        max_samples = std::max(max_samples, pixel.num_samples);
+    }
+
+    Image image(acc.width(), acc.height());
+    auto color = image.begin();
+    for (const auto& pixel : acc) {
+        const float value =
+            max_samples ? 1.f * pixel.num_samples / max_samples : 0.f;
+        *color++ = {value, value, value, 1};
+    }
+    return image;
+}
+
+/**
+ * Output the number of samples of every pixel in grayscale PFM format, cf.
+ * write_pfm in raster.h.
+ */
+inline void write_samples_pfm(std::ostream& os, const Accumulator& acc) {
+    write_pfm(os, acc.width(), acc.height(), 1,
+              [&acc](size_t x, size_t y, size_t) {
+                  return static_cast<float>(acc.num_samples(x, y));
+              });
+}
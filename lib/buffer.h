@@ -0,0 +1,83 @@
+/**
+ * Contiguous array which either owns its elements or is a view into memory
+ * owned by someone else, e.g. a memory-mapped file (cf. MappedFile).
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <memory>
+#include <vector>
+
+/**
+ * An owning buffer stores its elements in a std::vector, which can be
+ * modified through vector(). A view refers to size elements at data, and
+ * keeps their owner alive by a shared pointer; it is read-only.
+ *
+ * Copying a view is cheap: the copy refers to the same memory.
+ */
+template <typename T> class Buffer {
+public:
+    Buffer() = default;
+
+    // Owning buffer.
+    Buffer(std::vector<T> elements) : owned_(std::move(elements)) {}
+
+    // View of size elements at data owned by owner.
+    Buffer(const T* data, size_t size, std::shared_ptr<const void> owner)
+        : view_(data), view_size_(size), owner_(std::move(owner)) {
+        assert(owner_);
+    }
+
+    bool is_view() const { return owner_ != nullptr; }
+
+    // Elements of an owning buffer.
+    std::vector<T>& vector() {
+        assert(!is_view() && "views are read-only");
+        return owned_;
+    }
+
+    const T* data() const { return is_view() ? view_ : owned_.data(); }
+    size_t size() const { return is_view() ? view_size_ : owned_.size(); }
+    bool empty() const { return size() == 0; }
+
+    // Bytes allocated by an owning buffer resp. referred to by a view.
+    size_t memory_bytes() const {
+        return (is_view() ? view_size_ : owned_.capacity()) * sizeof(T);
+    }
+
+    const T& operator[](size_t i) const { return data()[i]; }
+
+    const T* begin() const { return data(); }
+    const T* end() const { return data() + size(); }
+
+    friend bool operator==(const Buffer& a, const Buffer& b) {
+        return a.size() == b.size() &&
+               std::equal(a.begin(), a.end(), b.begin());
+    }
+
+    friend bool operator!=(const Buffer& a, const Buffer& b) {
+        return !(a == b);
+    }
+
+    // A view is serialized as its elements and loaded as owning buffer.
+    template <class Archive> void save(Archive& archive) const {
+        if (is_view()) {
+            archive(std::vector<T>(begin(), end()));
+        } else {
+            archive(owned_);
+        }
+    }
+
+    template <class Archive> void load(Archive& archive) {
+        *this = Buffer();
+        archive(owned_);
+    }
+
+private:
+    std::vector<T> owned_;
+    const T* view_ = nullptr;
+    size_t view_size_ = 0;
+    std::shared_ptr<const void> owner_;
+};
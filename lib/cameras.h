@@ -0,0 +1,119 @@
+/**
+ * Cameras of a batch render (cf. --cameras).
+ *
+ * A batch renders one image per camera against a single loaded scene and
+ * kd-tree, so that loading the scene and building or loading the tree is paid
+ * once per batch instead of once per frame. A camera file has one camera per
+ * line, which is either
+ *
+ *   eye.x eye.y eye.z target.x target.y target.z up.x up.y up.z
+ *
+ * or the 16 numbers of the transformation of the camera node, row by row, as
+ * in a scene (cf. Camera). Empty lines and lines starting with # are ignored.
+ * Field of view and aspect ratio are the ones of the camera of the scene.
+ */
+
+#pragma once
+
+#include "types.h"
+
+#include <assimp/types.h>
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+/**
+ * Transformation of a camera node placing the camera at eye looking at target.
+ */
+inline aiMatrix4x4 look_at(const Point3f& eye, const Point3f& target,
+                           const Vector3f& up) {
+    // the camera looks along -z with y up in its node
+    const Vector3f back = normalize(eye - target);
+    const Vector3f right = normalize(cross(up, back));
+    const Vector3f true_up = cross(back, right);
+    return aiMatrix4x4(right.x, true_up.x, back.x, eye.x,
+                       right.y, true_up.y, back.y, eye.y,
+                       right.z, true_up.z, back.z, eye.z,
+                       0, 0, 0, 1);
+}
+
+/**
+ * Read the camera transformations of a camera file.
+ *
+ * @return false with an error message naming the line if a line is neither a
+ *         look-at camera nor a transformation.
+ */
+inline bool read_cameras(std::istream& is, std::vector<aiMatrix4x4>& trafos,
+                         std::string& error) {
+    trafos.clear();
+    std::string line;
+    for (size_t line_no = 1; std::getline(is, line); ++line_no) {
+        std::stringstream ss(line);
+        std::vector<float> values;
+        float value;
+        while (ss >> value) {
+            values.push_back(value);
+        }
+        ss.clear();
+        std::string rest;
+        ss >> rest;
+        if (values.empty() && (rest.empty() || rest[0] == '#')) {
+            continue;
+        }
+
+        if (rest.empty() && values.size() == 9) {
+            const Point3f eye(values[0], values[1], values[2]);
+            const Point3f target(values[3], values[4], values[5]);
+            const Vector3f up(values[6], values[7], values[8]);
+            const Vector3f dir = target - eye;
+            if (dir.length() == 0 || cross(dir, up).length() == 0) {
+                error = "Camera in line " + std::to_string(line_no) +
+                        " looks nowhere or along its up vector";
+                return false;
+            }
+            trafos.push_back(look_at(eye, target, up));
+        } else if (rest.empty() && values.size() == 16) {
+            const auto& v = values;
+            trafos.emplace_back(v[0], v[1], v[2], v[3], v[4], v[5], v[6], v[7],
+                                v[8], v[9], v[10], v[11], v[12], v[13], v[14],
+                                v[15]);
+        } else {
+            error = "Line " + std::to_string(line_no) +
+                    " is neither eye, target and up (9 numbers) nor a "
+                    "transformation (16 numbers)";
+            return false;
+        }
+    }
+    if (trafos.empty()) {
+        error = "No cameras";
+        return false;
+    }
+    return true;
+}
+
+inline bool read_cameras(const std::string& path,
+                         std::vector<aiMatrix4x4>& trafos, std::string& error) {
+    std::ifstream file(path);
+    if (!file) {
+        error = "Cannot open cameras " + path;
+        return false;
+    }
+    if (!read_cameras(file, trafos, error)) {
+        error += " in " + path;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Path of an output of the frame-th camera of a batch, e.g. frame0007.ppm.
+ */
+inline std::string frame_path(const std::string& prefix, size_t frame,
+                              const std::string& extension) {
+    char number[32];
+    std::snprintf(number, sizeof(number), "%04zu", frame);
+    return prefix + number + extension;
+}
@@ -0,0 +1,234 @@
+/**
+ * Checkpoints of long renders.
+ *
+ * A checkpoint contains the accumulated samples of all completed tiles and
+ * which tiles are complete. A resumed render only renders the remaining
+ * tiles. Since the random numbers of a sample depend only on its pixel and
+ * index (cf. CounterRng), the remaining tiles get the same samples as in an
+ * uninterrupted render, and so does the image.
+ *
+ * The checkpoint is keyed by a hash of everything which determines the
+ * samples (scene, camera, options), so that a render is never resumed from
+ * the checkpoint of another one. Files are written under a temporary name and
+ * renamed, so that a crash while writing keeps the previous checkpoint.
+ */
+
+#pragma once
+
+#include "accumulator.h"
+#include "tile_scheduler.h"
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+static constexpr char CHECKPOINT_MAGIC[8] = {'T', 'U', 'R', 'N',
+                                             'E', 'R', 'C', 'P'};
+static constexpr uint32_t CHECKPOINT_VERSION = 1;
+static constexpr uint32_t CHECKPOINT_BYTE_ORDER = 0x01020304;
+
+/**
+ * Header of a checkpoint file, followed by
+ *
+ *   tile flags  num_tiles x uint8_t (1 if complete) in the order of the grid
+ *   pixels      width * height x Accumulator::Pixel, row by row
+ *
+ * Pixels of incomplete tiles are zero.
+ */
+struct CheckpointHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint64_t key;
+    uint64_t width;
+    uint64_t height;
+    uint64_t tile_size;
+    uint64_t num_tiles;
+    uint64_t pixel_size;
+};
+
+/**
+ * Completed tiles of a render in the grid of tiles of make_tiles.
+ *
+ * Workers mark their tiles when they are done, while another thread writes
+ * checkpoints: a tile which is complete is also seen with all its pixels.
+ */
+class TileCompletion {
+public:
+    TileCompletion(size_t width, size_t height, size_t tile_size)
+        : tile_size_(tile_size), columns_((width + tile_size - 1) / tile_size),
+          num_tiles_(columns_ * ((height + tile_size - 1) / tile_size)),
+          done_(new std::atomic<bool>[num_tiles_]) {
+        assert(tile_size > 0);
+        for (size_t i = 0; i < num_tiles_; ++i) {
+            done_[i].store(false, std::memory_order_relaxed);
+        }
+    }
+
+    size_t tile_size() const { return tile_size_; }
+    size_t num_tiles() const { return num_tiles_; }
+
+    size_t num_done() const {
+        size_t num = 0;
+        for (size_t i = 0; i < num_tiles_; ++i) {
+            num += done_[i].load(std::memory_order_acquire);
+        }
+        return num;
+    }
+
+    // Index in the grid of the tile containing pixel (x, y).
+    size_t index(size_t x, size_t y) const {
+        return y / tile_size_ * columns_ + x / tile_size_;
+    }
+
+    bool done(size_t index) const {
+        return done_[index].load(std::memory_order_acquire);
+    }
+    bool done(const Tile& tile) const { return done(index(tile.x0, tile.y0)); }
+
+    void set_done(size_t index, bool done = true) {
+        done_[index].store(done, std::memory_order_release);
+    }
+    void set_done(const Tile& tile) { set_done(index(tile.x0, tile.y0)); }
+
+    /**
+     * Tiles which are not done, in their order.
+     */
+    std::vector<Tile> remaining(const std::vector<Tile>& tiles) const {
+        std::vector<Tile> result;
+        for (const auto& tile : tiles) {
+            if (!done(tile)) {
+                result.push_back(tile);
+            }
+        }
+        return result;
+    }
+
+private:
+    size_t tile_size_;
+    size_t columns_;
+    size_t num_tiles_;
+    std::unique_ptr<std::atomic<bool>[]> done_;
+};
+
+/**
+ * Write the completed tiles of the accumulator to path.
+ *
+ * Can be called while other threads render the remaining tiles.
+ *
+ * @return false with an error message if the file could not be written.
+ */
+inline bool write_checkpoint(const std::string& path, uint64_t key,
+                             const Accumulator& acc,
+                             const TileCompletion& completion,
+                             std::string& error) {
+    // snapshot of the flags, so that the pixels match them
+    std::vector<uint8_t> flags(completion.num_tiles());
+    for (size_t i = 0; i < flags.size(); ++i) {
+        flags[i] = completion.done(i);
+    }
+
+    CheckpointHeader header;
+    std::memcpy(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic));
+    header.version = CHECKPOINT_VERSION;
+    header.byte_order = CHECKPOINT_BYTE_ORDER;
+    header.key = key;
+    header.width = acc.width();
+    header.height = acc.height();
+    header.tile_size = completion.tile_size();
+    header.num_tiles = flags.size();
+    header.pixel_size = sizeof(Accumulator::Pixel);
+
+    const std::string tmp_path = path + ".tmp" + std::to_string(::getpid());
+    {
+        std::ofstream file(tmp_path, std::ios::out | std::ios::binary);
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char*>(flags.data()), flags.size());
+
+        std::vector<Accumulator::Pixel> row(acc.width());
+        for (size_t y = 0; y < acc.height(); ++y) {
+            for (size_t x = 0; x < acc.width(); ++x) {
+                row[x] = flags[completion.index(x, y)] ? acc(x, y)
+                                                       : Accumulator::Pixel();
+            }
+            file.write(reinterpret_cast<const char*>(row.data()),
+                       row.size() * sizeof(Accumulator::Pixel));
+        }
+        if (!file) {
+            std::remove(tmp_path.c_str());
+            error = "Cannot write checkpoint " + tmp_path;
+            return false;
+        }
+    }
+    if (std::rename(tmp_path.c_str(), path.c_str()) != 0) {
+        std::remove(tmp_path.c_str());
+        error = "Cannot rename checkpoint to " + path;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Read the checkpoint at path into the accumulator and the completion, which
+ * have to have the size, tile size and key of the checkpoint.
+ *
+ * @return false with an error message if the checkpoint cannot be read or
+ *         does not belong to this render; then, acc and completion are
+ *         unchanged.
+ */
+inline bool read_checkpoint(const std::string& path, uint64_t key,
+                            Accumulator& acc, TileCompletion& completion,
+                            std::string& error) {
+    std::ifstream file(path, std::ios::in | std::ios::binary);
+    if (!file) {
+        error = "Cannot open checkpoint " + path;
+        return false;
+    }
+
+    CheckpointHeader header;
+    if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+        std::memcmp(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic))) {
+        error = "Not a checkpoint: " + path;
+        return false;
+    }
+    if (header.version != CHECKPOINT_VERSION ||
+        header.byte_order != CHECKPOINT_BYTE_ORDER ||
+        header.pixel_size != sizeof(Accumulator::Pixel)) {
+        error = "Outdated checkpoint: " + path;
+        return false;
+    }
+    if (header.key != key || header.width != acc.width() ||
+        header.height != acc.height() ||
+        header.tile_size != completion.tile_size() ||
+        header.num_tiles != completion.num_tiles()) {
+        error = "Checkpoint " + path + " belongs to another render";
+        return false;
+    }
+
+    std::vector<uint8_t> flags(header.num_tiles);
+    std::vector<Accumulator::Pixel> pixels(acc.width() * acc.height());
+    if (!file.read(reinterpret_cast<char*>(flags.data()), flags.size()) ||
+        !file.read(reinterpret_cast<char*>(pixels.data()),
+                   pixels.size() * sizeof(Accumulator::Pixel))) {
+        error = "Truncated checkpoint: " + path;
+        return false;
+    }
+
+    auto pixel = pixels.begin();
+    for (size_t y = 0; y < acc.height(); ++y) {
+        for (size_t x = 0; x < acc.width(); ++x) {
+            acc(x, y) = *pixel++;
+        }
+    }
+    for (size_t i = 0; i < flags.size(); ++i) {
+        completion.set_done(i, flags[i]);
+    }
+    return true;
+}
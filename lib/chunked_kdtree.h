@@ -0,0 +1,633 @@
+/**
+ * Out-of-core kd-tree for scenes which do not fit into memory.
+ *
+ * turner-convert splits the mesh into spatially coherent chunks (cf.
+ * split_mesh), builds a kd-tree per chunk, and stores each tree as kd-tree
+ * cache file in the chunk directory of the scene (cf. kdtree_cache.h and
+ * scene_chunk_dir). Only the chunk table is stored in the scene file.
+ *
+ * At render time, a small BVH over the bounding boxes of the chunks yields
+ * the chunks along a ray. Their trees are mapped into memory on demand by an
+ * LRU cache with a memory limit (cf. ChunkCache); a ray visits the chunks
+ * front to back and stops at the first chunk behind its closest hit. Every
+ * render thread pins the few chunks it used last (cf.
+ * ChunkedKDTreeIntersection), so that rays and shading within them do not
+ * go through the shared cache.
+ *
+ * Rays which can be traced independently of each other, e.g. the primary
+ * rays of a tile, are queued at the chunk they enter first, and the longest
+ * queue is traced first (cf. ChunkedKDTreeIntersection::queue), so that every
+ * chunk paged in serves many rays in a row.
+ */
+
+#pragma once
+
+#include "kdtree.h"
+#include "kdtree_cache.h"
+#include "scene.h"
+#include "triangle.h"
+#include "types.h"
+
+#include <ThreadPool.h>
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <future>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <sys/stat.h>
+
+namespace detail {
+
+// Sort the triangles in [begin, end) by recursive median splits of their
+// centroids along the longest axis, until at most max_triangles are left.
+// The resulting ranges are appended to groups.
+inline void split_triangles(std::vector<uint32_t>::iterator begin,
+                            std::vector<uint32_t>::iterator end,
+                            const std::vector<Bbox3f>& boxes,
+                            size_t max_triangles,
+                            std::vector<std::vector<uint32_t>>& groups) {
+    const size_t size = end - begin;
+    if (size <= max_triangles) {
+        groups.emplace_back(begin, end);
+        return;
+    }
+
+    // twice the centroid; the factor does not matter for the order
+    auto centroid = [&boxes](uint32_t id, size_t ax) {
+        return boxes[id].p_min[ax] + boxes[id].p_max[ax];
+    };
+    Bbox3f centroids(Point3f(centroid(*begin, 0), centroid(*begin, 1),
+                             centroid(*begin, 2)));
+    for (auto it = begin + 1; it != end; ++it) {
+        centroids = bbox_union(centroids, Point3f(centroid(*it, 0),
+                                                  centroid(*it, 1),
+                                                  centroid(*it, 2)));
+    }
+    const auto d = centroids.diagonal();
+    const size_t ax = d.x >= d.y && d.x >= d.z ? 0 : (d.y >= d.z ? 1 : 2);
+
+    auto middle = begin + size / 2;
+    std::nth_element(begin, middle, end, [&](uint32_t a, uint32_t b) {
+        return centroid(a, ax) < centroid(b, ax);
+    });
+    split_triangles(begin, middle, boxes, max_triangles, groups);
+    split_triangles(middle, end, boxes, max_triangles, groups);
+}
+
+} // namespace detail
+
+/**
+ * Split the mesh into spatially coherent groups of at most max_triangles
+ * triangles (ids into mesh). Neighbouring groups are close to each other.
+ */
+inline std::vector<std::vector<uint32_t>>
+split_mesh(const TriangleMesh& mesh, size_t max_triangles) {
+    assert(max_triangles > 0);
+    std::vector<Bbox3f> boxes;
+    boxes.reserve(mesh.size());
+    for (size_t i = 0; i < mesh.size(); ++i) {
+        boxes.push_back(mesh.bbox(i));
+    }
+
+    std::vector<uint32_t> ids(mesh.size());
+    std::iota(ids.begin(), ids.end(), 0);
+    std::vector<std::vector<uint32_t>> groups;
+    if (!ids.empty()) {
+        detail::split_triangles(ids.begin(), ids.end(), boxes, max_triangles,
+                                groups);
+    }
+    return groups;
+}
+
+/**
+ * Mesh of the triangles ids of mesh. Only the vertices used by the triangles
+ * are copied; the material table is the one of mesh.
+ */
+inline TriangleMesh extract_mesh(const TriangleMesh& mesh,
+                                 const std::vector<uint32_t>& ids) {
+    std::unordered_map<uint32_t, uint32_t> vertex_ids;
+    std::vector<uint32_t> vertices;
+    auto vertex_id = [&](uint32_t v) {
+        auto res = vertex_ids.emplace(v, vertices.size());
+        if (res.second) {
+            vertices.push_back(v);
+        }
+        return res.first->second;
+    };
+
+    std::vector<TriangleMesh::Face> faces;
+    faces.reserve(ids.size());
+    for (auto id : ids) {
+        const auto& f = mesh.faces()[id];
+        faces.push_back({vertex_id(f[0]), vertex_id(f[1]), vertex_id(f[2])});
+    }
+
+    TriangleMesh result(Triangles{}, mesh.materials());
+    result.resize(vertices.size(), faces.size());
+    for (size_t i = 0; i < vertices.size(); ++i) {
+        result.set_vertex(i, mesh.vertices()[vertices[i]],
+                          mesh.normals()[vertices[i]]);
+    }
+    for (size_t i = 0; i < faces.size(); ++i) {
+        result.set_face(i, faces[i], mesh.material_ids()[ids[i]]);
+    }
+    return result;
+}
+
+/**
+ * Split the mesh into chunks of at most max_triangles triangles, build their
+ * kd-trees in parallel, and store them in dir.
+ *
+ * The triangles of the chunks are numbered consecutively in the order of the
+ * chunks, which differs from the order in mesh.
+ *
+ * @return false and an error message if a tree could not be stored.
+ */
+inline bool build_chunks(const TriangleMesh& mesh, size_t max_triangles,
+                         const std::string& dir,
+                         std::vector<SceneChunk>& chunks,
+                         std::string& error, size_t num_threads = 1) {
+    const auto groups = split_mesh(mesh, max_triangles);
+
+    chunks.assign(groups.size(), SceneChunk{});
+    uint32_t first_triangle = 0;
+    for (size_t i = 0; i < groups.size(); ++i) {
+        chunks[i].first_triangle = first_triangle;
+        chunks[i].num_triangles = groups[i].size();
+        first_triangle += groups[i].size();
+    }
+
+    std::vector<std::future<bool>> tasks;
+    {
+        ThreadPool pool(std::max<size_t>(num_threads, 1));
+        for (size_t i = 0; i < groups.size(); ++i) {
+            tasks.emplace_back(pool.enqueue([&, i]() {
+                const KDTree tree(extract_mesh(mesh, groups[i]));
+                const uint64_t key = kdtree_cache_key(tree.mesh());
+                chunks[i].key = key;
+                chunks[i].box = tree.box();
+                return store_cached_kdtree(dir, key, tree);
+            }));
+        }
+    }
+    for (size_t i = 0; i < tasks.size(); ++i) {
+        if (!tasks[i].get() && error.empty()) {
+            error = "Cannot write chunk " + std::to_string(i) + " to " + dir;
+        }
+    }
+    return error.empty();
+}
+
+/**
+ * Counters of a ChunkCache.
+ */
+struct ChunkCacheStats {
+    size_t hits = 0;          // requests of a resident chunk
+    size_t loads = 0;         // chunks mapped into memory
+    size_t evictions = 0;     // chunks dropped to stay below the limit
+    size_t resident_bytes = 0;
+    size_t peak_bytes = 0;
+};
+
+inline std::ostream& operator<<(std::ostream& os, const ChunkCacheStats& s) {
+    return os << "Chunk hits     : " << s.hits << std::endl
+              << "Chunk loads    : " << s.loads << std::endl
+              << "Chunk evictions: " << s.evictions << std::endl
+              << "Chunk peak     : " << s.peak_bytes / (1 << 20) << " MB";
+}
+
+/**
+ * Thread-safe LRU cache of the kd-trees of chunks.
+ *
+ * The size of a chunk is the size of its mapped file. When the resident
+ * chunks exceed the memory limit, the least recently used ones are dropped.
+ * The limit is soft: a dropped tree stays mapped as long as a thread still
+ * uses it, and the most recent chunk is never dropped. A chunk is loaded
+ * without holding the lock of the cache, so only the threads requesting the
+ * same chunk wait for it.
+ */
+class ChunkCache {
+public:
+    ChunkCache(std::string dir, std::vector<uint64_t> keys,
+               size_t memory_limit)
+        : dir_(std::move(dir))
+        , keys_(std::move(keys))
+        , memory_limit_(memory_limit)
+        , entries_(keys_.size()) {}
+
+    /**
+     * Tree of chunk, mapped into memory if it is not resident.
+     *
+     * Throws std::runtime_error if the tree cannot be loaded.
+     */
+    std::shared_ptr<const KDTree> get(size_t chunk) {
+        assert(chunk < entries_.size());
+        std::unique_lock<std::mutex> lock(mutex_);
+        auto& entry = entries_[chunk];
+        // the chunk is loaded by another thread
+        loaded_.wait(lock, [&entry]() { return !entry.loading; });
+        if (entry.tree) {
+            stats_.hits += 1;
+            lru_.splice(lru_.begin(), lru_, entry.lru);
+            return entry.tree;
+        }
+
+        // Loading reads the indices of the tree (cf. load_cached_kdtree), so
+        // we load without the lock; other threads only wait for this chunk.
+        entry.loading = true;
+        lock.unlock();
+        KDTree tree;
+        std::string error;
+        bool loaded = false;
+        try {
+            loaded = load_cached_kdtree(dir_, keys_[chunk], tree, error);
+        } catch (...) {
+            lock.lock();
+            entry.loading = false;
+            loaded_.notify_all();
+            throw;
+        }
+        const auto path = kdtree_cache_path(dir_, keys_[chunk]);
+        struct stat st;
+        const size_t bytes = ::stat(path.c_str(), &st) == 0 ? st.st_size : 0;
+        lock.lock();
+        entry.loading = false;
+        loaded_.notify_all();
+        if (!loaded) {
+            throw std::runtime_error(error.empty() ? "Missing chunk " + path
+                                                   : error);
+        }
+
+        entry.bytes = bytes;
+        entry.tree = std::make_shared<const KDTree>(std::move(tree));
+        lru_.push_front(chunk);
+        entry.lru = lru_.begin();
+        stats_.loads += 1;
+        stats_.resident_bytes += entry.bytes;
+        stats_.peak_bytes =
+            std::max(stats_.peak_bytes, stats_.resident_bytes);
+
+        while (stats_.resident_bytes > memory_limit_ && lru_.size() > 1) {
+            auto& victim = entries_[lru_.back()];
+            lru_.pop_back();
+            victim.tree.reset();
+            stats_.resident_bytes -= victim.bytes;
+            stats_.evictions += 1;
+        }
+        return entry.tree;
+    }
+
+    size_t size() const { return entries_.size(); }
+    size_t memory_limit() const { return memory_limit_; }
+
+    ChunkCacheStats stats() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return stats_;
+    }
+
+private:
+    struct Entry {
+        std::shared_ptr<const KDTree> tree; // null if not resident
+        bool loading = false;               // by a thread without the lock
+        size_t bytes = 0;
+        std::list<size_t>::iterator lru;
+    };
+
+    const std::string dir_;
+    const std::vector<uint64_t> keys_;
+    const size_t memory_limit_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable loaded_; // a chunk is done loading
+    std::vector<Entry> entries_;
+    std::list<size_t> lru_; // resident chunks, most recently used first
+    ChunkCacheStats stats_;
+};
+
+class ChunkedKDTreeIntersection;
+
+/**
+ * Geometry of an out-of-core scene: the chunks, a BVH over their bounding
+ * boxes, and the cache of their kd-trees.
+ *
+ * Triangle ids are global, i.e. the triangles of chunk i have the ids
+ * chunks[i].first_triangle + local id.
+ */
+class ChunkedKDTree {
+    friend ChunkedKDTreeIntersection;
+
+public:
+    using TriangleId = detail::TriangleId;
+
+    ChunkedKDTree(const std::string& dir, std::vector<SceneChunk> chunks,
+                  Materials materials, size_t memory_limit)
+        : chunks_(std::move(chunks))
+        , materials_(std::move(materials))
+        , cache_(dir, keys(chunks_), memory_limit) {
+        assert(!chunks_.empty());
+        assert(num_triangles() <= detail::FlatNode::MAX_TRIANGLE_ID);
+        std::vector<uint32_t> ids(chunks_.size());
+        std::iota(ids.begin(), ids.end(), 0);
+        build_bvh(ids.begin(), ids.end());
+    }
+
+    size_t num_chunks() const { return chunks_.size(); }
+    size_t num_triangles() const {
+        return chunks_.back().first_triangle + chunks_.back().num_triangles;
+    }
+    const Bbox3f& box() const { return bvh_.front().box; }
+    const std::vector<SceneChunk>& chunks() const { return chunks_; }
+
+    // Note: The material table is shared by all chunks, so the reference
+    // stays valid when the chunk of the triangle is evicted.
+    const Material& material(const TriangleId id) const {
+        const size_t chunk = chunk_of(id);
+        const auto local_id = id - chunks_[chunk].first_triangle;
+        return materials_[tree(chunk)->mesh().material_ids()[local_id]];
+    }
+
+    // Chunk containing the triangle with global id.
+    size_t chunk_of(const TriangleId id) const {
+        auto it = std::upper_bound(
+            chunks_.begin(), chunks_.end(), id,
+            [](uint32_t id, const SceneChunk& c) {
+                return id < c.first_triangle;
+            });
+        assert(it != chunks_.begin());
+        return it - chunks_.begin() - 1;
+    }
+
+    std::shared_ptr<const KDTree> tree(size_t chunk) const {
+        return cache_.get(chunk);
+    }
+
+    ChunkCacheStats cache_stats() const { return cache_.stats(); }
+
+private:
+    // Node of the BVH in DFS order: the left child of an inner node is the
+    // next node, the right child is at right.
+    struct BVHNode {
+        Bbox3f box;
+        uint32_t right;
+        int32_t chunk; // -1 for inner nodes
+    };
+
+    static std::vector<uint64_t> keys(const std::vector<SceneChunk>& chunks) {
+        std::vector<uint64_t> res;
+        res.reserve(chunks.size());
+        for (const auto& c : chunks) {
+            res.push_back(c.key);
+        }
+        return res;
+    }
+
+    void build_bvh(std::vector<uint32_t>::iterator begin,
+                   std::vector<uint32_t>::iterator end) {
+        const size_t index = bvh_.size();
+        Bbox3f box = chunks_[*begin].box;
+        for (auto it = begin + 1; it != end; ++it) {
+            box = bbox_union(box, chunks_[*it].box);
+        }
+        if (end - begin == 1) {
+            bvh_.push_back({box, 0, static_cast<int32_t>(*begin)});
+            return;
+        }
+        bvh_.push_back({box, 0, -1});
+
+        const auto d = box.diagonal();
+        const size_t ax = d.x >= d.y && d.x >= d.z ? 0 : (d.y >= d.z ? 1 : 2);
+        auto middle = begin + (end - begin) / 2;
+        std::nth_element(begin, middle, end, [&](uint32_t a, uint32_t b) {
+            const auto& ba = chunks_[a].box;
+            const auto& bb = chunks_[b].box;
+            return ba.p_min[ax] + ba.p_max[ax] < bb.p_min[ax] + bb.p_max[ax];
+        });
+        build_bvh(begin, middle);
+        bvh_[index].right = bvh_.size();
+        build_bvh(middle, end);
+    }
+
+private:
+    std::vector<SceneChunk> chunks_;
+    Materials materials_;
+    std::vector<BVHNode> bvh_;
+    mutable ChunkCache cache_;
+};
+
+/**
+ * Wraps a ChunkedKDTree and provides the interface of KDTreeIntersection.
+ *
+ * Not thread-safe; use one object per thread. The object pins the trees of
+ * the MAX_PINNED chunks it intersected last together with their
+ * intersections, since consecutive rays mostly hit the same chunks. Triangles
+ * and materials of pinned chunks, i.e. of the hits being shaded, are looked
+ * up without locking the cache.
+ */
+class ChunkedKDTreeIntersection {
+public:
+    using Tree = ChunkedKDTree;
+    using TriangleId = Tree::TriangleId;
+    using OptionalId = detail::OptionalId;
+
+    static constexpr size_t MAX_PINNED = 4;
+
+    explicit ChunkedKDTreeIntersection(const Tree& tree) : tree_(&tree) {}
+
+    Triangle operator[](const TriangleId id) const {
+        const size_t chunk = tree_->chunk_of(id);
+        const auto local_id = id - tree_->chunks_[chunk].first_triangle;
+        if (const KDTree* tree = pinned_tree(chunk)) {
+            return (*tree)[local_id];
+        }
+        return (*tree_->tree(chunk))[local_id];
+    }
+
+    Triangle at(const TriangleId id) const {
+        if (id >= tree_->num_triangles()) {
+            throw std::out_of_range("ChunkedKDTreeIntersection::at");
+        }
+        return (*this)[id];
+    }
+
+    const Material& material(const TriangleId id) const {
+        const size_t chunk = tree_->chunk_of(id);
+        if (const KDTree* tree = pinned_tree(chunk)) {
+            const auto local_id = id - tree_->chunks_[chunk].first_triangle;
+            return tree_->materials_[tree->mesh().material_ids()[local_id]];
+        }
+        return tree_->material(id);
+    }
+
+    /**
+     * Intersect the chunks along the ray front to back. Cf.
+     * KDTreeIntersection::intersect.
+     */
+    const OptionalId intersect(const Ray& ray, float& r, float& a, float& b) {
+        chunks_along(ray, candidates_);
+        OptionalId res;
+        r = ray.t_max;
+        for (const auto& candidate : candidates_) {
+            if (r <= candidate.first) {
+                break; // all remaining chunks start behind the closest hit
+            }
+            const size_t chunk = candidate.second;
+            float next_r, next_a, next_b;
+            auto next = intersection(chunk).intersect(
+                Ray(ray.o, ray.d, r), next_r, next_a, next_b);
+            if (next) {
+                res = global_id(chunk, next);
+                r = next_r;
+                a = next_a;
+                b = next_b;
+            }
+        }
+        return res;
+    }
+
+    const OptionalId intersect(const Ray& ray) {
+        float unused;
+        return intersect(ray, unused, unused, unused);
+    }
+
+    /**
+     * Queue independent rays at the chunk each of them enters first.
+     *
+     * @return the indices of the rays queue by queue, the longest queue
+     *         first; the rays missing all chunks come last.
+     */
+    std::vector<uint32_t> queue(const std::vector<Ray>& rays) {
+        const size_t num_chunks = tree_->num_chunks();
+        std::vector<uint32_t> first_chunk(rays.size());
+        // one more queue for the rays missing all chunks
+        std::vector<uint32_t> sizes(num_chunks + 1, 0);
+        for (size_t i = 0; i < rays.size(); ++i) {
+            chunks_along(rays[i], candidates_);
+            first_chunk[i] =
+                candidates_.empty() ? num_chunks : candidates_.front().second;
+            sizes[first_chunk[i]] += 1;
+        }
+
+        std::vector<uint32_t> chunks(num_chunks);
+        std::iota(chunks.begin(), chunks.end(), 0);
+        std::stable_sort(chunks.begin(), chunks.end(),
+                         [&sizes](uint32_t a, uint32_t b) {
+                             return sizes[a] > sizes[b];
+                         });
+        chunks.push_back(num_chunks);
+
+        // start of the queue of each chunk in the result
+        std::vector<uint32_t> next(num_chunks + 1);
+        uint32_t start = 0;
+        for (const auto chunk : chunks) {
+            next[chunk] = start;
+            start += sizes[chunk];
+        }
+        std::vector<uint32_t> order(rays.size());
+        for (size_t i = 0; i < rays.size(); ++i) {
+            order[next[first_chunk[i]]++] = i;
+        }
+        return order;
+    }
+
+    /**
+     * Instrumentation: add the traversal cost of all subsequent intersections
+     * to cost. Pass nullptr to stop counting (default).
+     */
+    void count_cost(TraversalCost* cost) {
+        cost_ = cost;
+        for (auto& pinned : pinned_) {
+            pinned.isect->count_cost(cost);
+        }
+    }
+
+private:
+    // Chunks hit by ray with their entry distances, sorted front to back.
+    void chunks_along(const Ray& ray,
+                      std::vector<std::pair<float, uint32_t>>& res) {
+        res.clear();
+        const Ray fixed_ray(ray.o, detail::fix_direction(ray));
+        const auto& bvh = tree_->bvh_;
+        stack_.push_back(0);
+        while (!stack_.empty()) {
+            const auto& node = bvh[stack_.back()];
+            const uint32_t index = stack_.back();
+            stack_.pop_back();
+
+            float tenter, texit;
+            if (!intersect_ray_box(fixed_ray, node.box, tenter, texit) ||
+                texit < 0 || ray.t_max <= tenter) {
+                continue;
+            }
+            if (node.chunk < 0) {
+                stack_.push_back(node.right);
+                stack_.push_back(index + 1);
+            } else {
+                res.emplace_back(std::max(tenter, 0.f), node.chunk);
+            }
+        }
+        std::sort(res.begin(), res.end());
+    }
+
+    OptionalId global_id(size_t chunk, OptionalId local_id) const {
+        return OptionalId{tree_->chunks_[chunk].first_triangle +
+                          static_cast<TriangleId>(local_id)};
+    }
+
+    // Tree of chunk if it is pinned, otherwise nullptr.
+    const KDTree* pinned_tree(size_t chunk) const {
+        for (const auto& pinned : pinned_) {
+            if (pinned.chunk == chunk) {
+                return pinned.tree.get();
+            }
+        }
+        return nullptr;
+    }
+
+    // Intersection of the tree of chunk, which is pinned as most recently
+    // used chunk.
+    KDTreeIntersection& intersection(size_t chunk) {
+        auto it = std::find_if(
+            pinned_.begin(), pinned_.end(),
+            [chunk](const Pinned& pinned) { return pinned.chunk == chunk; });
+        if (it == pinned_.end()) {
+            Pinned pinned;
+            pinned.chunk = chunk;
+            pinned.tree = tree_->tree(chunk);
+            pinned.isect.reset(new KDTreeIntersection(*pinned.tree));
+            pinned.isect->count_cost(cost_);
+            if (pinned_.size() == MAX_PINNED) {
+                pinned_.pop_back();
+            }
+            pinned_.insert(pinned_.begin(), std::move(pinned));
+        } else if (it != pinned_.begin()) {
+            std::rotate(pinned_.begin(), it, it + 1);
+        }
+        return *pinned_.front().isect;
+    }
+
+private:
+    struct Pinned {
+        size_t chunk;
+        std::shared_ptr<const KDTree> tree;
+        // destroyed before the tree it refers to
+        std::unique_ptr<KDTreeIntersection> isect;
+    };
+
+    const Tree* tree_;
+    std::vector<uint32_t> stack_;
+    std::vector<std::pair<float, uint32_t>> candidates_;
+    TraversalCost* cost_ = nullptr;
+
+    std::vector<Pinned> pinned_; // most recently used first
+};
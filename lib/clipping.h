@@ -187,7 +187,7 @@ clip_polygon_at_plane(const std::vector<Point3f>& poly, const Normal3f& n,
 }
 
 /**
- * Clip triangle `tri` at AABB `box`.
+ * Clip the triangle with vertices `vs` at AABB `box`.
  *
  * Requirement: triangle and box intersect.
  *
@@ -196,8 +196,9 @@ clip_polygon_at_plane(const std::vector<Point3f>& poly, const Normal3f& n,
  *
  * TODO: Do not allocate std::vector inside of this function.
  */
-inline Bbox3f clip_triangle_at_aabb(const Triangle& tri, const Bbox3f& box) {
-    std::vector<Point3f> points(tri.vertices.begin(), tri.vertices.end());
+inline Bbox3f clip_triangle_at_aabb(const std::array<Point3f, 3>& vs,
+                                    const Bbox3f& box) {
+    std::vector<Point3f> points(vs.begin(), vs.end());
 
     // clip at 6 planes defined by box
     for (auto ax : AXES3) {
@@ -233,3 +234,12 @@ inline Bbox3f clip_triangle_at_aabb(const Triangle& tri, const Bbox3f& box) {
 
     return {p_min, p_max};
 }
+
+/**
+ * Clip triangle `tri` at AABB `box`.
+ *
+ * Cf. above.
+ */
+inline Bbox3f clip_triangle_at_aabb(const Triangle& tri, const Bbox3f& box) {
+    return clip_triangle_at_aabb(tri.vertices, box);
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cmath>
+#include <stdint.h>
+
+namespace detail {
+
+// Finalizer of splitmix64, a bijective hash with full avalanche.
+inline constexpr uint64_t mix64(uint64_t z) {
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
+
+} // namespace detail
+
+/**
+ * Counter-based random numbers in [0, 1) of a single sample of a pixel.
+ *
+ * The i-th number is a hash of (seed, pixel, sample, i), where i is the
+ * dimension of the sample, e.g. 0 and 1 for the position on the pixel and
+ * two more for every bounce. There is no state besides the counter, so the
+ * numbers do not depend on which thread, process or pass renders the sample.
+ *
+ * Cf. [SMDS11] for counter-based generators, and splitmix64 in [SLF14],
+ * whose hash we use.
+ */
+class CounterRng {
+public:
+    constexpr CounterRng(uint64_t seed, uint64_t pixel, uint64_t sample)
+        : key_(detail::mix64(detail::mix64(detail::mix64(seed + GOLDEN) ^
+                                           pixel) ^
+                             sample)) {}
+
+    /**
+     * Number of the given dimension, independent of the counter.
+     */
+    float at(uint32_t dimension) const {
+        // the top 24 bits fill the mantissa of a float
+        return std::ldexp(
+            static_cast<float>(
+                detail::mix64(key_ + (dimension + uint64_t(1)) * GOLDEN) >>
+                40),
+            -24);
+    }
+
+    /**
+     * Number of the next dimension.
+     */
+    float operator()() { return at(dimension_++); }
+
+    uint32_t dimension() const { return dimension_; }
+
+private:
+    static constexpr uint64_t GOLDEN = 0x9e3779b97f4a7c15ull;
+
+    uint64_t key_;
+    uint32_t dimension_ = 0;
+};
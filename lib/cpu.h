@@ -0,0 +1,182 @@
+/**
+ * Runtime CPU feature dispatch.
+ *
+ * Hot kernels are compiled in several ISA variants inside the same binary,
+ * and the best variant supported by the host is selected at startup via
+ * cpuid. A kernel is a default constructible function object; it is called
+ * through `cpu::dispatch<Kernel>(args...)`.
+ *
+ * Each variant is compiled with the corresponding target attribute and the
+ * whole call tree of the kernel is inlined into it (flatten). Therefore, also
+ * the inline helpers used by the kernel (geometry, intersection, ...) are
+ * compiled for the target ISA.
+ *
+ * The variants do not enable FMA, and we compile with -ffp-contract=off (note
+ * that AVX-512F includes FMA instructions), so that all variants produce
+ * bitwise identical results. Images rendered on different machines can be
+ * merged.
+ *
+ * The environment variable TURNER_ISA (baseline, sse4.2, avx2, avx512) caps
+ * the selected ISA, e.g. for benchmarking or debugging.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <ostream>
+#include <utility>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define TURNER_X86 1
+#include <cpuid.h>
+#endif
+
+namespace cpu {
+
+enum class Isa : int { BASELINE = 0, SSE42 = 1, AVX2 = 2, AVX512 = 3 };
+
+inline const char* to_string(Isa isa) {
+    switch (isa) {
+    case Isa::SSE42:
+        return "sse4.2";
+    case Isa::AVX2:
+        return "avx2";
+    case Isa::AVX512:
+        return "avx512";
+    default:
+        return "baseline";
+    }
+}
+
+inline std::ostream& operator<<(std::ostream& os, Isa isa) {
+    return os << to_string(isa);
+}
+
+/**
+ * Detect the best ISA supported by the cpu and the operating system.
+ */
+inline Isa detect() {
+#ifdef TURNER_X86
+    unsigned int eax, ebx, ecx, edx;
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+        return Isa::BASELINE;
+    }
+    if (!(ecx & (1u << 20) /* SSE4.2 */)) {
+        return Isa::BASELINE;
+    }
+
+    // AVX registers have to be enabled by the OS (XCR0).
+    bool osxsave = ecx & (1u << 27);
+    bool avx = ecx & (1u << 28);
+    if (!osxsave || !avx) {
+        return Isa::SSE42;
+    }
+    uint32_t xcr0_lo, xcr0_hi;
+    __asm__("xgetbv" : "=a"(xcr0_lo), "=d"(xcr0_hi) : "c"(0));
+    bool ymm_enabled = (xcr0_lo & 0x6) == 0x6;
+    bool zmm_enabled = (xcr0_lo & 0xe6) == 0xe6;
+
+    if (!ymm_enabled || __get_cpuid_max(0, nullptr) < 7) {
+        return Isa::SSE42;
+    }
+    __cpuid_count(7, 0, eax, ebx, ecx, edx);
+    bool avx2 = ebx & (1u << 5);
+    bool avx512f = ebx & (1u << 16);
+    bool avx512vl = ebx & (1u << 31);
+
+    if (avx2 && avx512f && avx512vl && zmm_enabled) {
+        return Isa::AVX512;
+    }
+    if (avx2) {
+        return Isa::AVX2;
+    }
+    return Isa::SSE42;
+#else
+    return Isa::BASELINE;
+#endif
+}
+
+/**
+ * ISA used for dispatching: the detected ISA capped by TURNER_ISA.
+ */
+inline Isa isa() {
+    static const Isa selected = [] {
+        Isa isa = detect();
+        const char* cap = std::getenv("TURNER_ISA");
+        if (cap) {
+            for (Isa other : {Isa::BASELINE, Isa::SSE42, Isa::AVX2}) {
+                if (std::strcmp(cap, to_string(other)) == 0 && other < isa) {
+                    isa = other;
+                }
+            }
+        }
+        return isa;
+    }();
+    return selected;
+}
+
+} // namespace cpu
+
+#ifdef TURNER_X86
+#define TURNER_TARGET_BASELINE __attribute__((flatten))
+#define TURNER_TARGET_SSE42 __attribute__((target("sse4.2"), flatten))
+#define TURNER_TARGET_AVX2 __attribute__((target("avx2"), flatten))
+#define TURNER_TARGET_AVX512                                                   \
+    __attribute__((target("avx512f,avx512vl"), flatten))
+#else
+#define TURNER_TARGET_BASELINE
+#define TURNER_TARGET_SSE42
+#define TURNER_TARGET_AVX2
+#define TURNER_TARGET_AVX512
+#endif
+
+namespace cpu {
+namespace detail {
+
+template <typename Kernel, typename... Args>
+TURNER_TARGET_BASELINE auto run_baseline(Args... args) {
+    return Kernel{}(std::forward<Args>(args)...);
+}
+
+template <typename Kernel, typename... Args>
+TURNER_TARGET_SSE42 auto run_sse42(Args... args) {
+    return Kernel{}(std::forward<Args>(args)...);
+}
+
+template <typename Kernel, typename... Args>
+TURNER_TARGET_AVX2 auto run_avx2(Args... args) {
+    return Kernel{}(std::forward<Args>(args)...);
+}
+
+template <typename Kernel, typename... Args>
+TURNER_TARGET_AVX512 auto run_avx512(Args... args) {
+    return Kernel{}(std::forward<Args>(args)...);
+}
+
+} // namespace detail
+
+/**
+ * Call the variant of Kernel compiled for the ISA of the host.
+ *
+ * The variant is selected once per kernel and signature.
+ */
+template <typename Kernel, typename... Args> auto dispatch(Args&&... args) {
+    using Fn = decltype(&detail::run_baseline<Kernel, Args&&...>);
+    static const Fn fn = [] {
+        switch (isa()) {
+        case Isa::SSE42:
+            return &detail::run_sse42<Kernel, Args&&...>;
+        case Isa::AVX2:
+            return &detail::run_avx2<Kernel, Args&&...>;
+        case Isa::AVX512:
+            return &detail::run_avx512<Kernel, Args&&...>;
+        default:
+            return &detail::run_baseline<Kernel, Args&&...>;
+        }
+    }();
+    return fn(std::forward<Args>(args)...);
+}
+
+} // namespace cpu
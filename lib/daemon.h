@@ -0,0 +1,437 @@
+/**
+ * Render daemon: a tracer started with --serve keeps scenes and their
+ * kd-trees loaded and renders jobs sent over a Unix domain socket.
+ *
+ * Every message is a JSON object on one line. A client sends
+ *
+ *   {"id": "a", "scene": "scene.turner", "args": ["-p", "16"],
+ *    "camera": "0 0 5  0 0 0  0 1 0", "renderer": "pathtracer"}
+ *
+ * to render a job, where args are options of the renderer as on its command
+ * line, camera (optional) is a line of a camera file (cf. cameras.h), and
+ * renderer (optional) has to be the one of the daemon, and
+ *
+ *   {"cancel": "a"}
+ *
+ * to cancel a queued or running job. The daemon answers with the events of
+ * the job:
+ *
+ *   {"id": "a", "event": "progress", "pass": 1, "tiles": 12, "total": 100}
+ *   {"id": "a", "event": "image", "width": 640, "height": 480, "bytes": n}
+ *       followed by the n bytes of the image in PPM format
+ *   {"id": "a", "event": "done", "runtime_ms": 1234, "cached": true}
+ *   {"id": "a", "event": "cancelled"}
+ *   {"id": "a", "event": "error", "message": "..."}
+ *
+ * The jobs of all clients are rendered one after the other in the order in
+ * which they arrive, each with the threads of the daemon (--threads).
+ */
+
+#pragma once
+
+#include "json.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <errno.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+/**
+ * Render job of a client.
+ */
+struct Job {
+    std::string id;
+    std::string renderer; // empty for any
+    std::string scene;
+    std::string camera; // empty for the camera of the scene
+    std::vector<std::string> args;
+};
+
+/**
+ * Message of a client: a job to render, or the id of a job to cancel.
+ */
+struct Request {
+    bool cancel = false;
+    Job job;
+};
+
+/**
+ * Parse a message of a client.
+ *
+ * @return false with an error message if line is not a valid request.
+ */
+inline bool parse_request(const std::string& line, Request& request,
+                          std::string& error) {
+    Json json;
+    if (!parse_json(line, json, error)) {
+        return false;
+    }
+    if (!json.is_object()) {
+        error = "Request is not an object";
+        return false;
+    }
+
+    request = Request();
+    if (const Json* cancel = json.find("cancel")) {
+        if (!cancel->is_string()) {
+            error = "cancel is not a job id";
+            return false;
+        }
+        request.cancel = true;
+        request.job.id = cancel->string;
+        return true;
+    }
+
+    Job& job = request.job;
+    const Json* id = json.find("id");
+    const Json* scene = json.find("scene");
+    if (!id || !id->is_string() || !scene || !scene->is_string()) {
+        error = "Job without id or scene";
+        return false;
+    }
+    job.id = id->string;
+    job.scene = scene->string;
+    for (const auto& key : {"renderer", "camera"}) {
+        const Json* value = json.find(key);
+        if (value && !value->is_string()) {
+            error = std::string(key) + " of job " + job.id +
+                    " is not a string";
+            return false;
+        }
+    }
+    if (const Json* renderer = json.find("renderer")) {
+        job.renderer = renderer->string;
+    }
+    if (const Json* camera = json.find("camera")) {
+        job.camera = camera->string;
+    }
+    if (const Json* args = json.find("args")) {
+        if (!args->is_array()) {
+            error = "args of job " + job.id + " is not an array";
+            return false;
+        }
+        for (const auto& arg : args->array) {
+            if (!arg.is_string()) {
+                error = "args of job " + job.id + " are not strings";
+                return false;
+            }
+            job.args.push_back(arg.string);
+        }
+    }
+    return true;
+}
+
+inline std::string progress_event(const std::string& id, size_t pass,
+                                  size_t tiles, size_t total) {
+    return "{\"id\": " + json_string(id) +
+           ", \"event\": \"progress\", \"pass\": " + std::to_string(pass) +
+           ", \"tiles\": " + std::to_string(tiles) +
+           ", \"total\": " + std::to_string(total) + "}";
+}
+
+inline std::string image_event(const std::string& id, size_t width,
+                               size_t height, size_t bytes) {
+    return "{\"id\": " + json_string(id) +
+           ", \"event\": \"image\", \"width\": " + std::to_string(width) +
+           ", \"height\": " + std::to_string(height) +
+           ", \"bytes\": " + std::to_string(bytes) + "}";
+}
+
+inline std::string done_event(const std::string& id, size_t runtime_ms,
+                              bool cached) {
+    return "{\"id\": " + json_string(id) +
+           ", \"event\": \"done\", \"runtime_ms\": " +
+           std::to_string(runtime_ms) +
+           ", \"cached\": " + (cached ? "true" : "false") + "}";
+}
+
+inline std::string cancelled_event(const std::string& id) {
+    return "{\"id\": " + json_string(id) + ", \"event\": \"cancelled\"}";
+}
+
+inline std::string error_event(const std::string& id,
+                               const std::string& message) {
+    return "{\"id\": " + json_string(id) +
+           ", \"event\": \"error\", \"message\": " + json_string(message) +
+           "}";
+}
+
+/**
+ * Stream socket of a client, which is closed on destruction.
+ *
+ * One thread reads, while any thread may send: messages are sent as a whole.
+ */
+class Connection {
+public:
+    // longest message which is read
+    static constexpr size_t MAX_LINE = 1 << 20;
+
+    explicit Connection(int fd) : fd_(fd) { assert(fd >= 0); }
+    ~Connection() { ::close(fd_); }
+
+    Connection(const Connection&) = delete;
+    Connection& operator=(const Connection&) = delete;
+
+    int fd() const { return fd_; }
+
+    /**
+     * Read the next line without the newline.
+     *
+     * @return false at the end of the stream, on error, or if the line is
+     *         longer than MAX_LINE.
+     */
+    bool read_line(std::string& line) {
+        while (true) {
+            const size_t newline = buffer_.find('\n');
+            if (newline != std::string::npos) {
+                line = buffer_.substr(0, newline);
+                buffer_.erase(0, newline + 1);
+                return true;
+            }
+            if (buffer_.size() > MAX_LINE) {
+                return false;
+            }
+            char chunk[4096];
+            const ssize_t n = ::read(fd_, chunk, sizeof(chunk));
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                return false;
+            }
+            buffer_.append(chunk, n);
+        }
+    }
+
+    /**
+     * Read exactly size bytes, e.g. an image following its event.
+     */
+    bool read_bytes(std::string& data, size_t size) {
+        data = buffer_.substr(0, size);
+        buffer_.erase(0, data.size());
+        while (data.size() < size) {
+            char chunk[4096];
+            const ssize_t n = ::read(
+                fd_, chunk, std::min(sizeof(chunk), size - data.size()));
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                return false;
+            }
+            data.append(chunk, n);
+        }
+        return true;
+    }
+
+    /**
+     * Send data as a whole, or nothing if the client has gone.
+     */
+    bool send(const std::string& data) {
+        std::lock_guard<std::mutex> lock(send_mutex_);
+        for (size_t sent = 0; sent < data.size();) {
+            const ssize_t n = ::send(fd_, data.data() + sent,
+                                     data.size() - sent, MSG_NOSIGNAL);
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                return false;
+            }
+            sent += n;
+        }
+        return true;
+    }
+
+    bool send_line(const std::string& line) { return send(line + "\n"); }
+
+private:
+    int fd_;
+    std::string buffer_;
+    std::mutex send_mutex_;
+};
+
+namespace detail {
+
+inline bool unix_address(const std::string& path, sockaddr_un& address,
+                         std::string& error) {
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path)) {
+        error = "Socket path too long: " + path;
+        return false;
+    }
+    std::strcpy(address.sun_path, path.c_str());
+    return true;
+}
+
+} // namespace detail
+
+/**
+ * Listen on a Unix domain socket at path, replacing a stale socket file.
+ *
+ * @return the socket, or -1 with an error message.
+ */
+inline int listen_unix(const std::string& path, std::string& error) {
+    sockaddr_un address;
+    if (!detail::unix_address(path, address, error)) {
+        return -1;
+    }
+    struct stat st;
+    if (::stat(path.c_str(), &st) == 0 && S_ISSOCK(st.st_mode)) {
+        ::unlink(path.c_str());
+    }
+
+    const int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || ::bind(fd, reinterpret_cast<const sockaddr*>(&address),
+                         sizeof(address)) != 0 ||
+        ::listen(fd, 16) != 0) {
+        error = "Cannot listen on " + path + ": " + std::strerror(errno);
+        if (fd >= 0) {
+            ::close(fd);
+        }
+        return -1;
+    }
+    return fd;
+}
+
+/**
+ * Connect to the Unix domain socket at path.
+ *
+ * @return the socket, or -1 with an error message.
+ */
+inline int connect_unix(const std::string& path, std::string& error) {
+    sockaddr_un address;
+    if (!detail::unix_address(path, address, error)) {
+        return -1;
+    }
+    const int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || ::connect(fd, reinterpret_cast<const sockaddr*>(&address),
+                            sizeof(address)) != 0) {
+        error = "Cannot connect to " + path + ": " + std::strerror(errno);
+        if (fd >= 0) {
+            ::close(fd);
+        }
+        return -1;
+    }
+    return fd;
+}
+
+/**
+ * Jobs of all clients in the order of arrival, and the job being rendered.
+ */
+class JobQueue {
+public:
+    struct Entry {
+        std::shared_ptr<Connection> connection;
+        Job job;
+    };
+
+    enum class Cancelled { QUEUED, RUNNING, UNKNOWN };
+
+    void push(std::shared_ptr<Connection> connection, Job job) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            queue_.push_back({std::move(connection), std::move(job)});
+        }
+        cv_.notify_one();
+    }
+
+    /**
+     * Wait for the next job, which becomes the running one.
+     *
+     * @return false if the queue was stopped.
+     */
+    bool pop(Entry& entry) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        cv_.wait(lock, [this] { return stopped_ || !queue_.empty(); });
+        if (stopped_) {
+            return false;
+        }
+        entry = std::move(queue_.front());
+        queue_.pop_front();
+        running_ = entry.connection;
+        running_id_ = entry.job.id;
+        cancelled_ = false;
+        return true;
+    }
+
+    /**
+     * Mark the running job as finished.
+     */
+    void finish() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        running_.reset();
+        running_id_.clear();
+    }
+
+    /**
+     * Cancel the job id of the connection: a queued job is removed; the
+     * renderer of a running one has to check cancelled().
+     */
+    Cancelled cancel(const std::shared_ptr<Connection>& connection,
+                     const std::string& id) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (running_ == connection && running_id_ == id) {
+            cancelled_ = true;
+            return Cancelled::RUNNING;
+        }
+        for (auto it = queue_.begin(); it != queue_.end(); ++it) {
+            if (it->connection == connection && it->job.id == id) {
+                queue_.erase(it);
+                return Cancelled::QUEUED;
+            }
+        }
+        return Cancelled::UNKNOWN;
+    }
+
+    /**
+     * Cancel all jobs of a connection which was closed.
+     */
+    void drop(const std::shared_ptr<Connection>& connection) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (running_ == connection) {
+            cancelled_ = true;
+        }
+        for (auto it = queue_.begin(); it != queue_.end();) {
+            it = it->connection == connection ? queue_.erase(it) : ++it;
+        }
+    }
+
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopped_ = true;
+        }
+        cv_.notify_all();
+    }
+
+    size_t size() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return queue_.size();
+    }
+
+    // whether the running job was cancelled
+    const std::atomic<bool>& cancelled() const { return cancelled_; }
+
+private:
+    mutable std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<Entry> queue_;
+    std::shared_ptr<Connection> running_;
+    std::string running_id_;
+    std::atomic<bool> cancelled_{false};
+    bool stopped_ = false;
+};
@@ -1,6 +1,9 @@
 #pragma once
 
+#include "cpu.h"
+#include "raster.h"
 #include "types.h"
+
 #include <math.h>
 
 /**
@@ -47,3 +50,34 @@ inline Color gamma(Color c, float inverse_gamma = 1 / 2.2f) {
     return {gamma(c.r, inverse_gamma), gamma(c.g, inverse_gamma),
             gamma(c.b, inverse_gamma), c.a};
 }
+
+namespace detail {
+
+// Post-processing kernel compiled for several ISAs, cf. cpu.h
+struct PostProcess {
+    void operator()(Image& image, float exposure_value,
+                    bool gamma_correction_enabled, float inverse_gamma) const {
+        for (auto& c : image) {
+            c = exposure(c, exposure_value);
+            if (gamma_correction_enabled) {
+                c = gamma(c, inverse_gamma);
+            }
+        }
+    }
+};
+
+} // namespace detail
+
+/**
+ * Apply exposure and optionally gamma correction to all pixels of the image.
+ *
+ * @param image                    image to post-process in place
+ * @param exposure_value           explosure (cf. exposure function)
+ * @param gamma_correction_enabled whether to apply gamma correction
+ * @param inverse_gamma            1.f/gamma factor (cf. gamma function)
+ */
+inline void post_process(Image& image, float exposure_value,
+                         bool gamma_correction_enabled, float inverse_gamma) {
+    cpu::dispatch<detail::PostProcess>(image, exposure_value,
+                                       gamma_correction_enabled, inverse_gamma);
+}
@@ -0,0 +1,114 @@
+/**
+ * Per-pixel traversal cost of the kd-tree.
+ *
+ * Counts the work done by all rays spawned by a pixel (cf. TraversalCost) and
+ * outputs it as a false-color image and as a raw float buffer. Badly built
+ * regions of the tree and pathological geometry stand out immediately.
+ */
+
+#pragma once
+
+#include "kdtree.h"
+#include "raster.h"
+#include "types.h"
+
+#include <algorithm>
+#include <cmath>
+#include <ostream>
+#include <vector>
+
+/**
+ * Raster of traversal costs.
+ */
+class Heatmap {
+public:
+    Heatmap(const size_t width, const size_t height)
+        : width_(width), height_(height), data_(width * height) {}
+
+    size_t width() const { return width_; }
+    size_t height() const { return height_; }
+    size_t memory_bytes() const {
+        return data_.size() * sizeof(TraversalCost);
+    }
+
+    TraversalCost& operator()(size_t x, size_t y) {
+        assert(x < width_ && "x out of heatmap bounds");
+        assert(y < height_ && "y out of heatmap bounds");
+        return data_[y * width_ + x];
+    }
+
+    const TraversalCost& operator()(size_t x, size_t y) const {
+        assert(x < width_ && "x out of heatmap bounds");
+        assert(y < height_ && "y out of heatmap bounds");
+        return data_[y * width_ + x];
+    }
+
+    auto end() { return data_.end(); }
+    auto begin() { return data_.begin(); }
+
+    auto end() const { return data_.end(); }
+    auto begin() const { return data_.begin(); }
+
+private:
+    size_t width_;
+    size_t height_;
+    std::vector<TraversalCost> data_;
+};
+
+/**
+ * Total cost of the traversal: every visited node and every triangle test
+ * counts as one.
+ */
+inline size_t total(const TraversalCost& cost) {
+    return cost.nodes + cost.leaves + cost.triangle_tests;
+}
+
+/**
+ * Map a value in [0, 1] to the color scale blue - cyan - green - yellow - red.
+ */
+inline Color false_color(float value) {
+    assert(0 <= value && value <= 1);
+    float x = 4 * value;
+    float r = clamp(x - 2, 0.f, 1.f);
+    float g = x < 2 ? clamp(x, 0.f, 1.f) : clamp(4 - x, 0.f, 1.f);
+    float b = clamp(2 - x, 0.f, 1.f);
+    return {r, g, b, 1};
+}
+
+/**
+ * False-color image of the total cost per pixel.
+ *
+ * The costs are heavy-tailed, so we use a logarithmic scale normalized by
+ * the most expensive pixel.
+ */
+inline Image false_color_image(const Heatmap& heatmap) {
+    size_t max_cost = 0;
+    for (const auto& cost : heatmap) {
+        max_cost = std::max(max_cost, total(cost));
+    }
+    const float log_max = std::log1p(static_cast<float>(max_cost));
+
+    Image image(heatmap.width(), heatmap.height());
+    auto pixel = image.begin();
+    for (const auto& cost : heatmap) {
+        float value = max_cost
+                          ? std::log1p(static_cast<float>(total(cost))) / log_max
+                          : 0.f;
+        *pixel++ = false_color(std::min(value, 1.f));
+    }
+    return image;
+}
+
+/**
+ * Output raw costs in PFM format with the channels (nodes, leaves, triangle
+ * tests), cf. write_pfm in raster.h.
+ */
+inline void write_pfm(std::ostream& os, const Heatmap& heatmap) {
+    write_pfm(os, heatmap.width(), heatmap.height(), 3,
+              [&heatmap](size_t x, size_t y, size_t channel) {
+                  const auto& cost = heatmap(x, y);
+                  const size_t counts[] = {cost.nodes, cost.leaves,
+                                           cost.triangle_tests};
+                  return static_cast<float>(counts[channel]);
+              });
+}
@@ -2,11 +2,13 @@
 
 #include "algorithm.h"
 #include "kdtree.h"
+#include "memory.h"
 #include "mesh.h"
 #include "output.h"
 #include "progress_bar.h"
 #include "radiosity.h"
 #include "raster.h"
+#include "telemetry.h"
 #include "types.h"
 
 #include <iostream>
@@ -55,17 +57,31 @@ class HierarchicalRadiosity {
     };
 
 public:
+    // The phases of compute() are reported to telemetry, if any.
     HierarchicalRadiosity(const KDTree& tree, float F_eps, float A_eps,
-                          float BF_eps, size_t max_iterations)
+                          float BF_eps, size_t max_iterations,
+                          Telemetry* telemetry = nullptr)
         : tree_(&tree)
         , tree_intersection_(tree)
         , F_eps_(F_eps)
         , A_eps_(A_eps)
         , BF_eps_(BF_eps)
-        , max_iterations_(max_iterations){};
+        , max_iterations_(max_iterations)
+        , telemetry_(telemetry){};
 
     const RadiosityMesh& mesh() const { return mesh_; }
 
+    // Bytes of the Quadnode hierarchy resp. of the links between its nodes.
+    size_t hierarchy_bytes() const {
+        return count_bytes([](const Quadnode&) { return sizeof(Quadnode); });
+    }
+
+    size_t links_bytes() const {
+        return count_bytes([](const Quadnode& p) {
+            return memory_bytes(p.gathering_from);
+        });
+    }
+
     Image visualize_links(const Camera& cam, Image&& image) const {
         auto draw_pixel = [&image](int x, int y) {
             if (0 <= x && static_cast<size_t>(x) < image.width() && 0 <= y &&
@@ -127,17 +143,20 @@ public:
             nodes_.back().vs =
                 triangle_vertices(mesh_, RadiosityMesh::FaceHandle(i));
             const auto& tri = (*tree_)[i];
+            const auto& material = tree_->material(i);
             nodes_.back().area = tri.area();
             nodes_.back().rad_gather = Color(); // black
-            nodes_.back().rad_shoot = tri.emissive;
-            nodes_.back().emission = tri.emissive;
-            nodes_.back().rho = tri.diffuse;
+            nodes_.back().rad_shoot = material.emissive;
+            nodes_.back().emission = material.emissive;
+            nodes_.back().rho = material.diffuse;
         }
 
         // Refine nodes
         auto progress_bar =
             ProgressBar(std::cerr, "Refine Nodes", nodes_.size());
+        start_phase("Form factors", nodes_.size());
         for (size_t n = 0; n < nodes_.size(); ++n) {
+            Telemetry::Busy busy(telemetry_, 0);
             auto& p = nodes_[n];
             for (auto& q : nodes_) {
                 if (p.root_tri_id == q.root_tri_id) {
@@ -147,6 +166,7 @@ public:
             }
 
             progress_bar.update(n + 1);
+            set_completed(n + 1);
         }
         std::cerr << std::endl;
 
@@ -246,6 +266,18 @@ public:
     }
 
 private:
+    void start_phase(const std::string& phase, size_t num_steps) {
+        if (telemetry_) {
+            telemetry_->start_phase(phase, num_steps);
+        }
+    }
+
+    void set_completed(size_t steps) {
+        if (telemetry_) {
+            telemetry_->set_completed(steps);
+        }
+    }
+
     float estimate_form_factor(const Quadnode& p, const Quadnode& q) const {
         const auto p_midpoint = triangle_midpoint(mesh_, p.vs);
         const auto p_normal = triangle_normal(mesh_, p.vs);
@@ -373,8 +405,10 @@ private:
         size_t iteration = max_iterations_;
         auto progress_bar =
             ProgressBar(std::cerr, "Solving System", max_iterations_);
+        start_phase("Solve", max_iterations_);
         while (iteration--) // TODO: need a better convergence criteria
         {
+            Telemetry::Busy busy(telemetry_, 0);
             for (auto& p : nodes_) {
                 gather_radiosity(p);
             }
@@ -383,6 +417,7 @@ private:
             }
 
             progress_bar.update(max_iterations_ - iteration);
+            set_completed(max_iterations_ - iteration);
         }
         std::cerr << std::endl;
     }
@@ -395,10 +430,13 @@ private:
         bool refined = false;
         auto progress_bar =
             ProgressBar(std::cerr, "Refining Links", nodes_.size());
+        start_phase("Refine links", nodes_.size());
         for (size_t n = 0; n < nodes_.size(); ++n) {
+            Telemetry::Busy busy(telemetry_, 0);
             refined |= refine_links(nodes_[n]);
 
             progress_bar.update(n + 1);
+            set_completed(n + 1);
         }
         std::cerr << std::endl;
 
@@ -533,6 +571,26 @@ private:
         return Normal3f{pt[0], pt[1], pt[2]};
     };
 
+    // Sum of bytes(node) over all nodes of the hierarchy.
+    template <typename Bytes> size_t count_bytes(Bytes bytes) const {
+        size_t sum = 0;
+        std::stack<const Quadnode*> stack;
+        for (const auto& root : nodes_) {
+            stack.push(&root);
+            while (!stack.empty()) {
+                const auto& p = *stack.top();
+                stack.pop();
+                sum += bytes(p);
+                if (!p.is_leaf()) {
+                    for (const auto& child : p.children) {
+                        stack.push(child.get());
+                    }
+                }
+            }
+        }
+        return sum;
+    }
+
 private:
     std::vector<Quadnode> nodes_;
     Triangles subdivided_tris_; // TODO: Remove
@@ -544,4 +602,5 @@ private:
     float A_eps_;
     float BF_eps_;
     int max_iterations_;
+    Telemetry* telemetry_;
 };
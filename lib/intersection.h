@@ -3,6 +3,9 @@
 #include "triangle.h"
 #include "types.h"
 
+#include <array>
+#include <cstdint>
+
 /**
  * Test segment and plane intersection
  *
@@ -88,6 +91,220 @@ inline bool intersect_ray_triangle(const Ray& ray, const Triangle& tri,
     return true;
 }
 
+/**
+ * Ray-triangle intersection kernels
+ *
+ * Each kernel precomputes its own per-triangle data once (cf. Data and
+ * precompute), and provides an intersection test against this data. The
+ * kd-tree traversal is parametrized by the kernel, cf. BasicKDTree and
+ * BasicKDTreeIntersection in kdtree.h. The kernel used by the renderers is
+ * selected at build time, cf. TriangleIntersector below. The unique ID of a
+ * kernel identifies its Data, e.g. in kd-tree cache files.
+ *
+ * All kernels follow the conventions of intersect_ray_triangle: s and t are
+ * the barycentric coordinates w.r.t. vertices[1] resp. vertices[2], and edges
+ * are inclusive. Additionally, only intersections with `0 <= r < t_max` are
+ * reported, which allows to reject triangles behind the closest hit so far
+ * early.
+ */
+namespace intersector {
+
+/**
+ * "Fast, Minimum Storage Ray/Triangle Intersection"
+ * by Tomas Moeller and Ben Trumbore
+ * [MT97]
+ */
+struct MoellerTrumbore {
+    static constexpr uint32_t ID = 1;
+
+    struct Data {
+        Point3f v0;
+        Vector3f e1, e2;
+    };
+
+    static Data precompute(const Triangle& tri) {
+        return {tri.vertices[0], tri.u, tri.v};
+    }
+
+    static bool intersect(const Ray& ray, const Data& tri, float t_max,
+                          float& r, float& s, float& t) {
+        Vector3f p = cross(ray.d, tri.e2);
+        float det = dot(tri.e1, p);
+        if (det == 0.f) {
+            return false;
+        }
+        float inv_det = 1.f / det;
+
+        Vector3f q = ray.o - tri.v0;
+        s = dot(q, p) * inv_det;
+        if (s < 0 || 1 < s) {
+            return false;
+        }
+
+        Vector3f qe1 = cross(q, tri.e1);
+        t = dot(ray.d, qe1) * inv_det;
+        if (t < 0 || 1 < s + t) {
+            return false;
+        }
+
+        r = dot(tri.e2, qe1) * inv_det;
+        return 0 <= r && r < t_max;
+    }
+};
+
+/**
+ * Projection method from "Realtime Ray Tracing and Interactive Global
+ * Illumination" by Ingo Wald, Section 7.1
+ * [Wal04]
+ *
+ * The triangle is projected onto the axis-aligned plane in which it has the
+ * largest area. The distance is computed first, so that the barycentric
+ * coordinates are only computed if the hit is in front of t_max.
+ */
+struct WaldProjection {
+    static constexpr uint32_t ID = 2;
+
+    struct Data {
+        // projection axis k, and remaining axes u = k + 1, v = k + 2 (mod 3)
+        uint32_t k;
+        // plane: n_u * p_u + n_v * p_v + p_k = n_d
+        float n_u, n_v, n_d;
+        // edge equations for the barycentric coordinates in the (u, v) plane
+        float b_nu, b_nv, b_d;
+        float c_nu, c_nv, c_d;
+    };
+
+    static Data precompute(const Triangle& tri) {
+        const Point3f& a = tri.vertices[0];
+        const Vector3f& e1 = tri.u;
+        const Vector3f& e2 = tri.v;
+        Vector3f n = cross(e1, e2);
+
+        Data data;
+        data.k = max_dimension(abs(n));
+        size_t k = data.k;
+        size_t u = (k + 1) % 3;
+        size_t v = (k + 2) % 3;
+
+        float n_k = n[k];
+        data.n_u = n[u] / n_k;
+        data.n_v = n[v] / n_k;
+        data.n_d = dot(n, Vector3f(a)) / n_k;
+
+        data.b_nu = e2[v] / n_k;
+        data.b_nv = -e2[u] / n_k;
+        data.b_d = -(data.b_nu * a[u] + data.b_nv * a[v]);
+
+        data.c_nu = -e1[v] / n_k;
+        data.c_nv = e1[u] / n_k;
+        data.c_d = -(data.c_nu * a[u] + data.c_nv * a[v]);
+        return data;
+    }
+
+    static bool intersect(const Ray& ray, const Data& tri, float t_max,
+                          float& r, float& s, float& t) {
+        size_t k = tri.k;
+        size_t u = (k + 1) % 3;
+        size_t v = (k + 2) % 3;
+
+        float denom = ray.d[k] + tri.n_u * ray.d[u] + tri.n_v * ray.d[v];
+        r = (tri.n_d - ray.o[k] - tri.n_u * ray.o[u] - tri.n_v * ray.o[v]) /
+            denom;
+        // also rejects NaN, i.e. rays parallel to the triangle
+        if (!(0 <= r && r < t_max)) {
+            return false;
+        }
+
+        float h_u = ray.o[u] + r * ray.d[u];
+        float h_v = ray.o[v] + r * ray.d[v];
+
+        s = tri.b_nu * h_u + tri.b_nv * h_v + tri.b_d;
+        if (s < 0) {
+            return false;
+        }
+
+        t = tri.c_nu * h_u + tri.c_nv * h_v + tri.c_d;
+        return 0 <= t && s + t <= 1;
+    }
+};
+
+/**
+ * "Fast Ray-Triangle Intersections by Coordinate Transformation"
+ * by Doug Baldwin and Michael Weber
+ * [BW16]
+ *
+ * We precompute the affine transformation mapping the triangle onto the unit
+ * triangle in the xy-plane and its normal onto the z-axis. Then, the
+ * intersection reduces to intersecting the transformed ray with the plane
+ * z = 0. The paper describes a variant storing only 9 floats by exploiting
+ * the choice of a free row; we store the full 3x4 matrix.
+ */
+struct BaldwinWeber {
+    static constexpr uint32_t ID = 3;
+
+    struct Data {
+        // row-major 3x4 matrix: rows map to s, t and z
+        std::array<float, 12> m;
+    };
+
+    static Data precompute(const Triangle& tri) {
+        const Point3f& a = tri.vertices[0];
+        const Vector3f& e1 = tri.u;
+        const Vector3f& e2 = tri.v;
+        Vector3f n = cross(e1, e2);
+        float inv_nn = 1.f / dot(n, n);
+
+        Vector3f row_s = cross(e2, n);
+        Vector3f row_t = cross(n, e1);
+
+        Data data;
+        for (size_t i = 0; i < 3; ++i) {
+            data.m[i] = row_s[i] * inv_nn;
+            data.m[4 + i] = row_t[i] * inv_nn;
+            data.m[8 + i] = n[i] * inv_nn;
+        }
+        for (size_t row = 0; row < 3; ++row) {
+            float* m = &data.m[4 * row];
+            m[3] = -(m[0] * a.x + m[1] * a.y + m[2] * a.z);
+        }
+        return data;
+    }
+
+    static bool intersect(const Ray& ray, const Data& tri, float t_max,
+                          float& r, float& s, float& t) {
+        const auto& m = tri.m;
+
+        float o_z = m[8] * ray.o.x + m[9] * ray.o.y + m[10] * ray.o.z + m[11];
+        float d_z = m[8] * ray.d.x + m[9] * ray.d.y + m[10] * ray.d.z;
+        r = -o_z / d_z;
+        // also rejects NaN, i.e. rays parallel to the triangle
+        if (!(0 <= r && r < t_max)) {
+            return false;
+        }
+
+        Point3f p = ray.o + r * ray.d;
+        s = m[0] * p.x + m[1] * p.y + m[2] * p.z + m[3];
+        if (s < 0) {
+            return false;
+        }
+
+        t = m[4] * p.x + m[5] * p.y + m[6] * p.z + m[7];
+        return 0 <= t && s + t <= 1;
+    }
+};
+
+} // namespace intersector
+
+// Kernel used by KDTree resp. KDTreeIntersection. Select a different kernel at
+// build time by passing -DINTERSECTOR=<name> to cmake.
+#if defined(TURNER_INTERSECTOR_MOELLER_TRUMBORE)
+using TriangleIntersector = intersector::MoellerTrumbore;
+#elif defined(TURNER_INTERSECTOR_BALDWIN_WEBER)
+using TriangleIntersector = intersector::BaldwinWeber;
+#else
+using TriangleIntersector = intersector::WaldProjection;
+#endif
+
 /**
  * Test ray AABB (axis-aligned bounding box) intersection
  *
@@ -0,0 +1,313 @@
+/**
+ * Minimal JSON reader for the messages of the render daemon (cf. daemon.h).
+ *
+ * Numbers are doubles, and strings are UTF-8; \u escapes are decoded to
+ * UTF-8, but surrogate pairs are not combined. Output is written directly
+ * (cf. write_json in output.h) with json_string for strings.
+ */
+
+#pragma once
+
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <string>
+#include <vector>
+
+struct Json {
+    enum Type { NUL, BOOL, NUMBER, STRING, ARRAY, OBJECT };
+
+    Type type = NUL;
+    bool boolean = false;
+    double number = 0;
+    std::string string;
+    std::vector<Json> array;
+    std::map<std::string, Json> object;
+
+    bool is_string() const { return type == STRING; }
+    bool is_array() const { return type == ARRAY; }
+    bool is_object() const { return type == OBJECT; }
+
+    /**
+     * Member of an object, or nullptr if there is none.
+     */
+    const Json* find(const std::string& key) const {
+        const auto it = object.find(key);
+        return it == object.end() ? nullptr : &it->second;
+    }
+};
+
+namespace detail {
+
+class JsonParser {
+public:
+    explicit JsonParser(const std::string& text) : text_(text) {}
+
+    bool parse(Json& value, std::string& error) {
+        if (!parse_value(value, 0)) {
+            error = error_ + " at offset " + std::to_string(pos_);
+            return false;
+        }
+        skip_space();
+        if (pos_ != text_.size()) {
+            error = "Trailing characters at offset " + std::to_string(pos_);
+            return false;
+        }
+        return true;
+    }
+
+private:
+    static constexpr size_t MAX_DEPTH = 64;
+
+    void skip_space() {
+        while (pos_ < text_.size() &&
+               (text_[pos_] == ' ' || text_[pos_] == '\t' ||
+                text_[pos_] == '\n' || text_[pos_] == '\r')) {
+            ++pos_;
+        }
+    }
+
+    bool fail(const char* message) {
+        error_ = message;
+        return false;
+    }
+
+    bool consume(const char* word) {
+        const std::string w(word);
+        if (text_.compare(pos_, w.size(), w) != 0) {
+            return fail("Invalid literal");
+        }
+        pos_ += w.size();
+        return true;
+    }
+
+    bool parse_value(Json& value, size_t depth) {
+        if (depth > MAX_DEPTH) {
+            return fail("Nesting too deep");
+        }
+        skip_space();
+        if (pos_ == text_.size()) {
+            return fail("Unexpected end");
+        }
+        switch (text_[pos_]) {
+        case 'n':
+            value.type = Json::NUL;
+            return consume("null");
+        case 't':
+            value.type = Json::BOOL;
+            value.boolean = true;
+            return consume("true");
+        case 'f':
+            value.type = Json::BOOL;
+            value.boolean = false;
+            return consume("false");
+        case '"':
+            value.type = Json::STRING;
+            return parse_string(value.string);
+        case '[':
+            value.type = Json::ARRAY;
+            return parse_array(value.array, depth);
+        case '{':
+            value.type = Json::OBJECT;
+            return parse_object(value.object, depth);
+        default:
+            value.type = Json::NUMBER;
+            return parse_number(value.number);
+        }
+    }
+
+    bool parse_number(double& number) {
+        const char* begin = text_.c_str() + pos_;
+        if (*begin != '-' && (*begin < '0' || *begin > '9')) {
+            return fail("Unexpected character");
+        }
+        char* end;
+        number = std::strtod(begin, &end);
+        pos_ += end - begin;
+        return true;
+    }
+
+    static void append_utf8(std::string& s, unsigned code) {
+        if (code < 0x80) {
+            s += static_cast<char>(code);
+        } else if (code < 0x800) {
+            s += static_cast<char>(0xc0 | (code >> 6));
+            s += static_cast<char>(0x80 | (code & 0x3f));
+        } else {
+            s += static_cast<char>(0xe0 | (code >> 12));
+            s += static_cast<char>(0x80 | ((code >> 6) & 0x3f));
+            s += static_cast<char>(0x80 | (code & 0x3f));
+        }
+    }
+
+    bool parse_string(std::string& s) {
+        ++pos_; // "
+        s.clear();
+        while (pos_ < text_.size()) {
+            const char c = text_[pos_++];
+            if (c == '"') {
+                return true;
+            }
+            if (c != '\\') {
+                s += c;
+                continue;
+            }
+            if (pos_ == text_.size()) {
+                break;
+            }
+            const char escaped = text_[pos_++];
+            switch (escaped) {
+            case '"':
+            case '\\':
+            case '/':
+                s += escaped;
+                break;
+            case 'b':
+                s += '\b';
+                break;
+            case 'f':
+                s += '\f';
+                break;
+            case 'n':
+                s += '\n';
+                break;
+            case 'r':
+                s += '\r';
+                break;
+            case 't':
+                s += '\t';
+                break;
+            case 'u': {
+                if (pos_ + 4 > text_.size()) {
+                    return fail("Invalid escape");
+                }
+                char* end;
+                const std::string hex = text_.substr(pos_, 4);
+                const unsigned code = std::strtoul(hex.c_str(), &end, 16);
+                if (end != hex.c_str() + 4) {
+                    return fail("Invalid escape");
+                }
+                append_utf8(s, code);
+                pos_ += 4;
+                break;
+            }
+            default:
+                return fail("Invalid escape");
+            }
+        }
+        return fail("Unterminated string");
+    }
+
+    bool parse_array(std::vector<Json>& array, size_t depth) {
+        ++pos_; // [
+        array.clear();
+        skip_space();
+        if (pos_ < text_.size() && text_[pos_] == ']') {
+            ++pos_;
+            return true;
+        }
+        while (true) {
+            array.emplace_back();
+            if (!parse_value(array.back(), depth + 1)) {
+                return false;
+            }
+            skip_space();
+            if (pos_ < text_.size() && text_[pos_] == ',') {
+                ++pos_;
+            } else if (pos_ < text_.size() && text_[pos_] == ']') {
+                ++pos_;
+                return true;
+            } else {
+                return fail("Expected , or ]");
+            }
+        }
+    }
+
+    bool parse_object(std::map<std::string, Json>& object, size_t depth) {
+        ++pos_; // {
+        object.clear();
+        skip_space();
+        if (pos_ < text_.size() && text_[pos_] == '}') {
+            ++pos_;
+            return true;
+        }
+        while (true) {
+            skip_space();
+            std::string key;
+            if (pos_ == text_.size() || text_[pos_] != '"') {
+                return fail("Expected key");
+            }
+            if (!parse_string(key)) {
+                return false;
+            }
+            skip_space();
+            if (pos_ == text_.size() || text_[pos_] != ':') {
+                return fail("Expected :");
+            }
+            ++pos_;
+            if (!parse_value(object[key], depth + 1)) {
+                return false;
+            }
+            skip_space();
+            if (pos_ < text_.size() && text_[pos_] == ',') {
+                ++pos_;
+            } else if (pos_ < text_.size() && text_[pos_] == '}') {
+                ++pos_;
+                return true;
+            } else {
+                return fail("Expected , or }");
+            }
+        }
+    }
+
+    const std::string& text_;
+    size_t pos_ = 0;
+    std::string error_;
+};
+
+} // namespace detail
+
+/**
+ * Parse a JSON document.
+ *
+ * @return false with an error message if text is not valid JSON.
+ */
+inline bool parse_json(const std::string& text, Json& value,
+                       std::string& error) {
+    return detail::JsonParser(text).parse(value, error);
+}
+
+/**
+ * Quoted and escaped JSON string of s.
+ */
+inline std::string json_string(const std::string& s) {
+    std::string result = "\"";
+    for (const char c : s) {
+        switch (c) {
+        case '"':
+            result += "\\\"";
+            break;
+        case '\\':
+            result += "\\\\";
+            break;
+        case '\n':
+            result += "\\n";
+            break;
+        case '\r':
+            result += "\\r";
+            break;
+        case '\t':
+            result += "\\t";
+            break;
+        default:
+            if (static_cast<unsigned char>(c) < 0x20) {
+                char escaped[8];
+                std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+                result += escaped;
+            } else {
+                result += c;
+            }
+        }
+    }
+    return result + "\"";
+}
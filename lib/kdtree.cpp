@@ -123,7 +123,7 @@ private:
  */
 class KDTreeBuildAlgorithm {
 public:
-    KDTreeBuildAlgorithm(const Triangles& triangles) : triangles_(&triangles) {}
+    KDTreeBuildAlgorithm(const TriangleMesh& mesh) : mesh_(&mesh) {}
 
     TreeNode* build(TriangleIds tris, const Bbox3f& box) {
         using Node = TreeNode;
@@ -174,14 +174,13 @@ public:
     }
 
 private:
-    // Cf. [WH06], 5.2, Table 1
-    static constexpr int COST_TRAVERSAL = 15;
-    static constexpr int COST_INTERSECTION = 20;
+    static constexpr int COST_TRAVERSAL = detail::SAH_COST_TRAVERSAL;
+    static constexpr int COST_INTERSECTION = detail::SAH_COST_INTERSECTION;
 
     // Cost function bias
     float lambda(size_t num_ltris, size_t num_rtris) const {
         if (num_ltris == 0 || num_rtris == 0) {
-            return 0.8f;
+            return detail::SAH_EMPTY_SPACE_BIAS;
         }
         return 1;
     }
@@ -270,7 +269,7 @@ private:
         // generate events
         size_t num_tris = 0;
         for (const auto& id : tris) {
-            auto clipped_box = clip_triangle_at_aabb((*triangles_)[id], box);
+            auto clipped_box = clip_triangle_at_aabb(mesh_->vertices(id), box);
             if (clipped_box.empty()) {
                 continue;
             }
@@ -408,7 +407,7 @@ private:
     }
 
 private:
-    const Triangles* triangles_;
+    const TriangleMesh* mesh_;
 };
 
 /**
@@ -471,137 +470,20 @@ std::vector<detail::FlatNode> flatten(std::unique_ptr<TreeNode> root) {
 // KDTree implementation
 //
 
-KDTree::KDTree(Triangles tris) : tris_(std::move(tris)) {
-    assert(tris_.size() > 0);
-    assert(tris_.size() < detail::FlatNode::MAX_TRIANGLE_ID);
+namespace detail {
 
-    std::vector<TriangleId> ids(tris_.size(), 0);
+std::vector<FlatNode> build_kdtree(const TriangleMesh& mesh,
+                                   const Bbox3f& box) {
+    assert(mesh.size() > 0);
+    assert(mesh.size() < FlatNode::MAX_TRIANGLE_ID);
 
-    // Compute the bounding box of all triangles and fill in vector of all ids.
-    box_ = tris_.front().bbox();
-    for (size_t i = 1; i < tris_.size(); ++i) {
-        box_ = bbox_union(box_, tris_[i].bbox());
+    std::vector<TriangleId> ids(mesh.size(), 0);
+    for (size_t i = 1; i < mesh.size(); ++i) {
         ids[i] = i;
     }
 
-    KDTreeBuildAlgorithm algo(tris_);
-    nodes_ =
-        flatten(std::unique_ptr<TreeNode>(algo.build(std::move(ids), box_)));
+    KDTreeBuildAlgorithm algo(mesh);
+    return flatten(std::unique_ptr<TreeNode>(algo.build(std::move(ids), box)));
 }
 
-//
-// KDTreeIntersection implementation
-//
-
-namespace {
-
-/**
- * Replace all zero coordinates of ray.dir by EPS.
- * @param  ray with direction to fix.
- * @return     new direction.
- */
-Vector3f fix_direction(const Ray& ray) {
-    Vector3f d = ray.d;
-    for (auto ax : AXES3) {
-        if (d[ax] == 0) {
-            d[ax] = EPS;
-        }
-    }
-    return d;
-}
-
-} // namespace anonymous
-
-const KDTreeIntersection::OptionalId
-KDTreeIntersection::intersect(const Ray& ray, float& r, float& a, float& b) {
-    // A trick to make the traversal robust.
-    // Cf. [HH11], p. 5, comment about dir classification and robustness.
-    const Ray fixed_ray(ray.o, fix_direction(ray));
-
-    float tenter, texit;
-    if (!intersect_ray_box(fixed_ray, tree_->box(), tenter, texit)) {
-        return OptionalId{};
-    }
-
-    // Note: No need to clear, since when we leave this function, the stack is
-    // always empty.
-    assert(stack_.empty());
-    const auto* root = tree_->nodes_.data();
-    stack_.emplace(root, tenter, texit);
-
-    Vector3f d_inv(1 / fixed_ray.d.x, 1 / fixed_ray.d.y, 1 / fixed_ray.d.z);
-    const detail::FlatNode* node;
-    OptionalId res;
-    r = std::numeric_limits<float>::max();
-    while (!stack_.empty()) {
-        std::tie(node, tenter, texit) = stack_.top();
-        stack_.pop();
-
-        while (node->is_inner()) {
-            int ax = static_cast<int>(node->split_axis());
-            float split_pos = node->split_pos();
-
-            // t at split
-            float t = (split_pos - fixed_ray.o[ax]) * d_inv[ax];
-
-            // classify near/far with respect to t:
-            // left is near if ray.dir[ax] <= 0, else otherwise
-            const auto* near = node + 1;
-            const auto* far = root + node->right();
-            if (fixed_ray.d[ax] <= 0) {
-                std::swap(near, far);
-            }
-
-            if (texit < t) {
-                node = near;
-            } else if (t < tenter) {
-                node = far;
-            } else {
-                stack_.emplace(far, t, texit);
-                node = near;
-                texit = t;
-            }
-        }
-
-        assert(node->is_leaf());
-        float next_r, next_a, next_b;
-        auto next = intersect(node, ray, next_r, next_a, next_b);
-        if (next && next_r < r) {
-            res = next;
-            r = next_r;
-            a = next_a;
-            b = next_b;
-        }
-    }
-
-    return res;
-}
-
-const KDTreeIntersection::OptionalId
-KDTreeIntersection::intersect(const detail::FlatNode* node, const Ray& ray,
-                              float& min_r, float& min_s, float& min_t) {
-    min_r = std::numeric_limits<float>::max();
-    OptionalId res;
-
-    const Triangles& triangles = tree_->tris_;
-    auto intersect = [&](uint32_t triangle_id) {
-        const auto& tri = triangles[triangle_id];
-        float r, s, t;
-        bool intersects = intersect_ray_triangle(ray, tri, r, s, t);
-        if (intersects && r < min_r) {
-            min_r = r;
-            min_s = s;
-            min_t = t;
-            res = OptionalId{triangle_id};
-        }
-    };
-
-    for (; node->is_leaf(); ++node) {
-        intersect(node->first_triangle_id());
-        if (!node->has_second_triangle_id()) {
-            break;
-        }
-        intersect(node->second_triangle_id());
-    }
-    return res;
-}
+} // namespace detail
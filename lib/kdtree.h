@@ -20,6 +20,9 @@
 
 #pragma once
 
+#include "buffer.h"
+#include "cpu.h"
+#include "intersection.h"
 #include "triangle.h"
 
 #include <cereal/types/vector.hpp>
@@ -27,6 +30,7 @@
 #include <functional>
 #include <memory>
 #include <stack>
+#include <tuple>
 #include <vector>
 
 namespace detail {
@@ -34,6 +38,15 @@ namespace detail {
 using TriangleId = uint32_t;
 using TriangleIds = std::vector<TriangleId>;
 
+// Parameters of the SAH build (cf. [WH06], 5.2, Table 1, and kdtree.cpp).
+// Cached trees are keyed by them (cf. kdtree_cache.h); bump
+// KDTREE_BUILD_VERSION on any other change of the build which changes the
+// resulting tree.
+static constexpr int SAH_COST_TRAVERSAL = 15;
+static constexpr int SAH_COST_INTERSECTION = 20;
+static constexpr float SAH_EMPTY_SPACE_BIAS = 0.8f;
+static constexpr uint32_t KDTREE_BUILD_VERSION = 1;
+
 inline uint32_t float_to_uint32(float val) {
     uint32_t result;
     std::memcpy(&result, &val, sizeof(val));
@@ -180,19 +193,93 @@ private:
     TriangleId id_;
 };
 
+/**
+ * Build a flattened kd-tree over the triangles of mesh contained in box.
+ *
+ * Cf. kdtree.cpp for the implementation.
+ */
+std::vector<FlatNode> build_kdtree(const TriangleMesh& mesh, const Bbox3f& box);
+
+/**
+ * Replace all zero coordinates of ray.dir by EPS.
+ * @param  ray with direction to fix.
+ * @return     new direction.
+ */
+inline Vector3f fix_direction(const Ray& ray) {
+    Vector3f d = ray.d;
+    for (auto ax : AXES3) {
+        if (d[ax] == 0) {
+            d[ax] = EPS;
+        }
+    }
+    return d;
+}
+
 } // namespace detail
 
-class KDTreeIntersection;
+template <typename Intersector> class BasicKDTreeIntersection;
 
-class KDTree {
-    friend KDTreeIntersection;
+/**
+ * KDTree parametrized by the ray-triangle intersection kernel (cf.
+ * intersection.h). The tree stores the precomputed data of the kernel for
+ * each triangle next to the triangle mesh.
+ *
+ * Triangles are stored in an indexed mesh (cf. TriangleMesh), and are
+ * materialized on access.
+ *
+ * All arrays of the tree may be views into a memory-mapped cache file (cf.
+ * Buffer and kdtree_cache.h); such a tree is read-only and cheap to copy.
+ */
+template <typename Intersector> class BasicKDTree {
+    template <typename> friend class BasicKDTree;
+    friend BasicKDTreeIntersection<Intersector>;
 
 public:
     using TriangleId = detail::TriangleId;
+    using IntersectorData = typename Intersector::Data;
 
-    KDTree() = default;
+    BasicKDTree() = default;
+
+    explicit BasicKDTree(TriangleMesh mesh) : mesh_(std::move(mesh)) {
+        assert(mesh_.size() > 0);
+
+        // Compute the bounding box of all triangles.
+        box_ = mesh_.bbox(0);
+        for (size_t i = 1; i < mesh_.size(); ++i) {
+            box_ = bbox_union(box_, mesh_.bbox(i));
+        }
+
+        nodes_ = detail::build_kdtree(mesh_, box_);
+        precompute();
+    }
 
-    explicit KDTree(Triangles tris);
+    explicit BasicKDTree(const Triangles& tris,
+                         Materials materials = {Material{}})
+        : BasicKDTree(TriangleMesh(tris, std::move(materials))) {}
+
+    /**
+     * Tree from its parts, e.g. views into a memory-mapped cache file. If
+     * isect is empty, the data of the intersection kernel is precomputed.
+     */
+    BasicKDTree(TriangleMesh mesh, const Bbox3f& box,
+                Buffer<detail::FlatNode> nodes,
+                Buffer<IntersectorData> isect = {})
+        : mesh_(std::move(mesh))
+        , box_(box)
+        , nodes_(std::move(nodes))
+        , isect_(std::move(isect)) {
+        if (isect_.empty()) {
+            precompute();
+        }
+        assert(isect_.size() == mesh_.size());
+    }
+
+    // Reuse the tree built for another intersection kernel.
+    template <typename OtherIntersector>
+    explicit BasicKDTree(const BasicKDTree<OtherIntersector>& other)
+        : mesh_(other.mesh_), box_(other.box_), nodes_(other.nodes_) {
+        precompute();
+    }
 
     size_t height() const {
         using Node = detail::FlatNode;
@@ -217,20 +304,50 @@ public:
         return height;
     }
     size_t num_nodes() const { return nodes_.size(); }
-    size_t num_triangles() const { return tris_.size(); }
-    const Triangles& triangles() const { return tris_; }
+    size_t num_triangles() const { return mesh_.size(); }
+    const TriangleMesh& mesh() const { return mesh_; }
+    // Note: Materializes all triangles.
+    Triangles triangles() const { return mesh_.triangles(); }
     const Bbox3f& box() const { return box_; }
-    const Triangle& operator[](const TriangleId id) const { return tris_[id]; }
-    const Triangle& at(const TriangleId id) const { return tris_.at(id); }
+    Triangle operator[](const TriangleId id) const { return mesh_[id]; }
+    Triangle at(const TriangleId id) const { return mesh_.at(id); }
+    const Material& material(const TriangleId id) const {
+        return mesh_.material(id);
+    }
+
+    // Bytes of the nodes and the intersector data; cf. mesh().memory_bytes().
+    size_t memory_bytes() const {
+        return nodes_.memory_bytes() + isect_.memory_bytes();
+    }
+
+    const Buffer<detail::FlatNode>& nodes() const { return nodes_; }
+    const Buffer<IntersectorData>& intersector_data() const { return isect_; }
 
     static constexpr size_t node_size() { return sizeof(detail::FlatNode); }
 
-    template <class Archive> void serialize(Archive& archive) {
-        archive(tris_, box_, nodes_);
+    // Note: The precomputed intersection data is not serialized. Therefore,
+    // the archive does not depend on the intersection kernel.
+    template <class Archive> void save(Archive& archive) const {
+        archive(mesh_, box_, nodes_);
+    }
+
+    template <class Archive> void load(Archive& archive) {
+        archive(mesh_, box_, nodes_);
+        precompute();
     }
 
 private:
-    Triangles tris_;
+    void precompute() {
+        std::vector<IntersectorData> isect;
+        isect.reserve(mesh_.size());
+        for (size_t i = 0; i < mesh_.size(); ++i) {
+            isect.push_back(Intersector::precompute(mesh_[i]));
+        }
+        isect_ = std::move(isect);
+    }
+
+private:
+    TriangleMesh mesh_;
     Bbox3f box_;
 
     /**
@@ -260,59 +377,211 @@ private:
      *    /   \
      * [2 3]  [4 5 6]
      */
-    std::vector<detail::FlatNode> nodes_;
+    Buffer<detail::FlatNode> nodes_;
+
+    // Precomputed data of the intersection kernel indexed by triangle id.
+    Buffer<IntersectorData> isect_;
+};
+
+/**
+ * Work done by the kd-tree traversal, summed up over a number of rays.
+ */
+struct TraversalCost {
+    size_t nodes = 0;          // inner nodes visited
+    size_t leaves = 0;         // leaves visited
+    size_t triangle_tests = 0; // ray-triangle intersection tests
 };
 
 /**
  * Wraps a KDTree and provides an interface for computing Ray-Triangle
  * intersection.
  */
-class KDTreeIntersection {
+template <typename Intersector> class BasicKDTreeIntersection {
 public:
-    using TriangleId = KDTree::TriangleId;
+    using Tree = BasicKDTree<Intersector>;
+    using TriangleId = typename Tree::TriangleId;
     using OptionalId = detail::OptionalId;
 
-    explicit KDTreeIntersection(const KDTree& tree) : tree_(&tree) {}
+    explicit BasicKDTreeIntersection(const Tree& tree) : tree_(&tree) {}
 
-    const Triangle& operator[](const TriangleId id) const {
-        return (*tree_)[id];
+    Triangle operator[](const TriangleId id) const { return (*tree_)[id]; }
+    Triangle at(const TriangleId id) const { return tree_->at(id); }
+    const Material& material(const TriangleId id) const {
+        return tree_->material(id);
     }
-    const Triangle& at(const TriangleId id) const { return tree_->at(id); }
 
     /**
      * Cf. [HH11], Algorithm 2
      *
+     * Only intersections closer than ray.t_max are reported.
+     *
      * @param  ray   Ray for which the intersection will be computed
      * @param  r     distance from ray to triangle (if intersection
      *               exists)
      * @param  a, b  barycentric coordinates of the intersection point
      * @return       optional id of the triangle hit by the ray
      */
-    const OptionalId intersect(const Ray& ray, float& r, float& a, float& b);
+    const OptionalId intersect(const Ray& ray, float& r, float& a, float& b) {
+        return cpu::dispatch<Traverse>(*this, ray, r, a, b);
+    }
 
     const OptionalId intersect(const Ray& ray) {
         float unused;
         return intersect(ray, unused, unused, unused);
     }
 
+    /**
+     * Instrumentation: add the traversal cost of all subsequent intersections
+     * to cost. Pass nullptr to stop counting (default).
+     */
+    void count_cost(TraversalCost* cost) { cost_ = cost; }
+
 private:
+    // Traversal kernel compiled for several ISAs, cf. cpu.h
+    struct Traverse {
+        OptionalId operator()(BasicKDTreeIntersection& self, const Ray& ray,
+                              float& r, float& a, float& b) const {
+            return self.traverse(ray, r, a, b);
+        }
+    };
+
+    const OptionalId traverse(const Ray& ray, float& r, float& a, float& b);
+
     // Helper method which intersects triangles from consecutive nodes (starting
-    // at node) until we reach an inner node.
+    // at node) until we reach an inner node. Only intersections closer than
+    // t_max are considered.
     const OptionalId intersect(const detail::FlatNode* node, const Ray& ray,
-                               float& min_r, float& min_s, float& min_t);
+                               float t_max, float& min_r, float& min_s,
+                               float& min_t);
 
 private:
-    const KDTree* tree_;
+    const Tree* tree_;
     std::stack<
         std::tuple<const detail::FlatNode*, float /*tenter*/, float /*texit*/>>
         stack_;
+    TraversalCost* cost_ = nullptr;
 };
 
+template <typename Intersector>
+const detail::OptionalId BasicKDTreeIntersection<Intersector>::traverse(
+    const Ray& ray, float& r, float& a, float& b) {
+    // A trick to make the traversal robust.
+    // Cf. [HH11], p. 5, comment about dir classification and robustness.
+    const Ray fixed_ray(ray.o, detail::fix_direction(ray));
+
+    float tenter, texit;
+    if (!intersect_ray_box(fixed_ray, tree_->box(), tenter, texit)) {
+        return OptionalId{};
+    }
+
+    // Note: No need to clear, since when we leave this function, the stack is
+    // always empty.
+    assert(stack_.empty());
+    const auto* root = tree_->nodes_.data();
+    stack_.emplace(root, tenter, texit);
+
+    Vector3f d_inv(1 / fixed_ray.d.x, 1 / fixed_ray.d.y, 1 / fixed_ray.d.z);
+    const detail::FlatNode* node;
+    OptionalId res;
+    r = ray.t_max;
+    while (!stack_.empty()) {
+        std::tie(node, tenter, texit) = stack_.top();
+        stack_.pop();
+
+        while (node->is_inner()) {
+            if (cost_) {
+                cost_->nodes += 1;
+            }
+            int ax = static_cast<int>(node->split_axis());
+            float split_pos = node->split_pos();
+
+            // t at split
+            float t = (split_pos - fixed_ray.o[ax]) * d_inv[ax];
+
+            // classify near/far with respect to t:
+            // left is near if ray.dir[ax] <= 0, else otherwise
+            const auto* near = node + 1;
+            const auto* far = root + node->right();
+            if (fixed_ray.d[ax] <= 0) {
+                std::swap(near, far);
+            }
+
+            if (texit < t) {
+                node = near;
+            } else if (t < tenter) {
+                node = far;
+            } else {
+                stack_.emplace(far, t, texit);
+                node = near;
+                texit = t;
+            }
+        }
+
+        assert(node->is_leaf());
+        if (cost_) {
+            cost_->leaves += 1;
+        }
+        float next_r, next_a, next_b;
+        auto next = intersect(node, ray, r, next_r, next_a, next_b);
+        if (next) {
+            res = next;
+            r = next_r;
+            a = next_a;
+            b = next_b;
+        }
+
+        // Early termination: all remaining nodes on the stack start behind
+        // texit, so they cannot contain a closer intersection.
+        if (res && r <= texit) {
+            while (!stack_.empty()) {
+                stack_.pop();
+            }
+        }
+    }
+
+    return res;
+}
+
+template <typename Intersector>
+const detail::OptionalId BasicKDTreeIntersection<Intersector>::intersect(
+    const detail::FlatNode* node, const Ray& ray, float t_max, float& min_r,
+    float& min_s, float& min_t) {
+    min_r = t_max;
+    OptionalId res;
+
+    const auto* isect = tree_->isect_.data();
+    auto intersect = [&](uint32_t triangle_id) {
+        if (cost_) {
+            cost_->triangle_tests += 1;
+        }
+        float r, s, t;
+        // reports only intersections closer than min_r
+        if (Intersector::intersect(ray, isect[triangle_id], min_r, r, s, t)) {
+            min_r = r;
+            min_s = s;
+            min_t = t;
+            res = OptionalId{triangle_id};
+        }
+    };
+
+    for (; node->is_leaf(); ++node) {
+        intersect(node->first_triangle_id());
+        if (!node->has_second_triangle_id()) {
+            break;
+        }
+        intersect(node->second_triangle_id());
+    }
+    return res;
+}
+
+using KDTree = BasicKDTree<TriangleIntersector>;
+using KDTreeIntersection = BasicKDTreeIntersection<TriangleIntersector>;
+
 // custom hash for OptionalId
 namespace std {
 
-template <> struct hash<KDTreeIntersection::OptionalId> {
-    size_t operator()(const KDTreeIntersection::OptionalId& id) const {
+template <> struct hash<detail::OptionalId> {
+    size_t operator()(const detail::OptionalId& id) const {
         return std::hash<detail::TriangleId>()(id.id_);
     }
 };
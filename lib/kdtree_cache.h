@@ -0,0 +1,473 @@
+/**
+ * Content-addressed cache of built kd-trees.
+ *
+ * Building the kd-tree of a big scene takes long, so the renderers cache it.
+ * A tree is stored in <cache dir>/<key>.kdtree, where the key is a hash of
+ * the triangle mesh (vertices, normals, faces and materials) and of the build
+ * parameters. Hence, trees of different scenes live side by side, and a tree
+ * is never used for a scene it was not built for.
+ *
+ * A cache file contains the arrays of the tree in their in-memory layout
+ * (cf. KDTreeCacheHeader), so a cached tree is a view into the mapped file
+ * (cf. Buffer): nothing is copied or parsed, and all processes rendering
+ * the same scene on a host share the pages of the file.
+ *
+ * A file is only used if its header matches: version, byte order, key, the
+ * layout of the stored types, and all arrays inside of the file. Before the
+ * tree is handed out, one linear pass checks every index of the arrays (cf.
+ * detail::valid_kdtree_arrays), so that a corrupt file is rejected instead of
+ * crashing a renderer. Hence, loading reads the faces, material ids and nodes
+ * once; the vertices and normals are only read when they are used. Files are
+ * written under a temporary name and renamed, so that renderers never see a
+ * partially written file.
+ */
+
+#pragma once
+
+#include "buffer.h"
+#include "kdtree.h"
+#include "mapped_file.h"
+#include "triangle.h"
+#include "types.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <string>
+
+#include <errno.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static constexpr char KDTREE_CACHE_MAGIC[8] = {'T', 'U', 'R', 'N',
+                                               'E', 'R', 'K', 'D'};
+static constexpr uint32_t KDTREE_CACHE_VERSION = 2;
+static constexpr uint32_t KDTREE_CACHE_BYTE_ORDER = 0x01020304;
+
+/**
+ * Header of a cache file, followed by the arrays at their offsets aligned to
+ * MAPPED_ARRAY_ALIGNMENT bytes:
+ *
+ *   vertices         num_vertices  x Point3f
+ *   normals          num_vertices  x Normal3f
+ *   faces            num_faces     x TriangleMesh::Face
+ *   material ids     num_faces     x MaterialId
+ *   materials        num_materials x Material
+ *   nodes            num_nodes     x FlatNode
+ *   intersector data num_faces     x Intersector::Data
+ *
+ * The sizes of the types are stored in the header, since they depend on the
+ * build (e.g. -DSIMD=OFF). The intersector data is only used by a tree with
+ * the same intersection kernel; otherwise, it is precomputed again.
+ */
+struct KDTreeCacheHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint64_t key;
+
+    uint32_t point_size;
+    uint32_t normal_size;
+    uint32_t face_size;
+    uint32_t material_size;
+    uint32_t node_size;
+    uint32_t intersector_id;
+    uint32_t intersector_data_size;
+    uint32_t padding;
+
+    uint64_t num_vertices;
+    uint64_t num_faces;
+    uint64_t num_materials;
+    uint64_t num_nodes;
+
+    uint64_t vertices_offset;
+    uint64_t normals_offset;
+    uint64_t faces_offset;
+    uint64_t material_ids_offset;
+    uint64_t materials_offset;
+    uint64_t nodes_offset;
+    uint64_t intersector_data_offset;
+    uint64_t file_size;
+
+    float box_min[3];
+    float box_max[3];
+};
+
+namespace detail {
+
+/**
+ * 64 bit FNV-1a over words followed by the finalizer of splitmix64.
+ *
+ * Not meant to withstand adversarial input, only to tell scenes apart.
+ */
+class Hash64 {
+public:
+    void add(uint64_t word) {
+        hash_ ^= word;
+        hash_ *= 0x100000001b3ull;
+    }
+
+    void add(float value) {
+        add(static_cast<uint64_t>(float_to_uint32(value)));
+    }
+
+    void add(const Color& c) {
+        add(c.r);
+        add(c.g);
+        add(c.b);
+        add(c.a);
+    }
+
+    void add(const char* data, size_t size) {
+        uint64_t word;
+        for (; size >= sizeof(word);
+             data += sizeof(word), size -= sizeof(word)) {
+            std::memcpy(&word, data, sizeof(word));
+            add(word);
+        }
+        word = 0;
+        std::memcpy(&word, data, size);
+        add(word);
+    }
+
+    uint64_t value() const {
+        uint64_t z = hash_;
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+        return z ^ (z >> 31);
+    }
+
+private:
+    uint64_t hash_ = 0xcbf29ce484222325ull;
+};
+
+} // namespace detail
+
+/**
+ * Key of the kd-tree built over the mesh.
+ */
+inline uint64_t kdtree_cache_key(const TriangleMesh& mesh) {
+    detail::Hash64 hash;
+
+    hash.add(static_cast<uint64_t>(detail::KDTREE_BUILD_VERSION));
+    hash.add(static_cast<uint64_t>(detail::SAH_COST_TRAVERSAL));
+    hash.add(static_cast<uint64_t>(detail::SAH_COST_INTERSECTION));
+    hash.add(detail::SAH_EMPTY_SPACE_BIAS);
+
+    hash.add(static_cast<uint64_t>(mesh.vertices().size()));
+    for (const auto& v : mesh.vertices()) {
+        hash.add(v.x);
+        hash.add(v.y);
+        hash.add(v.z);
+    }
+    for (const auto& n : mesh.normals()) {
+        hash.add(n.x);
+        hash.add(n.y);
+        hash.add(n.z);
+    }
+
+    hash.add(static_cast<uint64_t>(mesh.size()));
+    for (size_t i = 0; i < mesh.size(); ++i) {
+        const auto& f = mesh.faces()[i];
+        hash.add(static_cast<uint64_t>(f[0]) << 32 | f[1]);
+        hash.add(static_cast<uint64_t>(f[2]) << 32 | mesh.material_ids()[i]);
+    }
+
+    hash.add(static_cast<uint64_t>(mesh.materials().size()));
+    for (const auto& m : mesh.materials()) {
+        hash.add(m.ambient);
+        hash.add(m.diffuse);
+        hash.add(m.emissive);
+        hash.add(m.reflective);
+        hash.add(m.reflectivity);
+    }
+
+    return hash.value();
+}
+
+/**
+ * Path of the cache file of key in cache_dir.
+ */
+inline std::string kdtree_cache_path(const std::string& cache_dir,
+                                     uint64_t key) {
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.kdtree",
+                  static_cast<unsigned long long>(key));
+    return cache_dir + "/" + name;
+}
+
+namespace detail {
+
+template <typename Intersector>
+KDTreeCacheHeader kdtree_cache_header(uint64_t key,
+                                      const BasicKDTree<Intersector>& tree) {
+    const auto& mesh = tree.mesh();
+
+    KDTreeCacheHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, KDTREE_CACHE_MAGIC, sizeof(header.magic));
+    header.version = KDTREE_CACHE_VERSION;
+    header.byte_order = KDTREE_CACHE_BYTE_ORDER;
+    header.key = key;
+
+    header.point_size = sizeof(Point3f);
+    header.normal_size = sizeof(Normal3f);
+    header.face_size = sizeof(TriangleMesh::Face);
+    header.material_size = sizeof(Material);
+    header.node_size = sizeof(FlatNode);
+    header.intersector_id = Intersector::ID;
+    header.intersector_data_size = sizeof(typename Intersector::Data);
+
+    header.num_vertices = mesh.vertices().size();
+    header.num_faces = mesh.size();
+    header.num_materials = mesh.materials().size();
+    header.num_nodes = tree.num_nodes();
+
+    header.vertices_offset = align_offset(sizeof(header));
+    header.normals_offset = align_offset(
+        header.vertices_offset + header.num_vertices * header.point_size);
+    header.faces_offset = align_offset(
+        header.normals_offset + header.num_vertices * header.normal_size);
+    header.material_ids_offset = align_offset(
+        header.faces_offset + header.num_faces * header.face_size);
+    header.materials_offset = align_offset(
+        header.material_ids_offset + header.num_faces * sizeof(MaterialId));
+    header.nodes_offset = align_offset(
+        header.materials_offset + header.num_materials * header.material_size);
+    header.intersector_data_offset = align_offset(
+        header.nodes_offset + header.num_nodes * header.node_size);
+    header.file_size = header.intersector_data_offset +
+                       header.num_faces * header.intersector_data_size;
+
+    const auto& box = tree.box();
+    const float box_min[3] = {box.p_min.x, box.p_min.y, box.p_min.z};
+    const float box_max[3] = {box.p_max.x, box.p_max.y, box.p_max.z};
+    std::memcpy(header.box_min, box_min, sizeof(box_min));
+    std::memcpy(header.box_max, box_max, sizeof(box_max));
+    return header;
+}
+
+// View of count elements of type T at offset in file.
+template <typename T>
+Buffer<T> mapped_view(const std::shared_ptr<const MappedFile>& file,
+                      uint64_t offset, uint64_t count) {
+    return Buffer<T>(reinterpret_cast<const T*>(file->data() + offset), count,
+                     file);
+}
+
+/**
+ * Check the indices of the arrays of a cache file: vertices of faces,
+ * material ids, triangles of leaves, and children of inner nodes.
+ *
+ * An inner node with right child 0 is a sentinel ending the triangles of a
+ * leaf (cf. BasicKDTree::nodes_). Every other inner node comes before its
+ * children, which are no sentinels, so that the traversal only moves
+ * forward and stays inside of the nodes.
+ */
+inline bool valid_kdtree_arrays(const KDTreeCacheHeader& header,
+                                const TriangleMesh::Face* faces,
+                                const MaterialId* material_ids,
+                                const FlatNode* nodes) {
+    for (size_t i = 0; i < header.num_faces; ++i) {
+        const auto& f = faces[i];
+        if (f[0] >= header.num_vertices || f[1] >= header.num_vertices ||
+            f[2] >= header.num_vertices ||
+            material_ids[i] >= header.num_materials) {
+            return false;
+        }
+    }
+
+    const uint64_t n = header.num_nodes;
+    auto is_sentinel = [](const FlatNode& node) {
+        return node.is_inner() && node.right() == 0;
+    };
+    if (is_sentinel(nodes[0])) {
+        return false;
+    }
+    for (uint64_t i = 0; i < n; ++i) {
+        const FlatNode& node = nodes[i];
+        if (node.is_leaf()) {
+            if (node.first_triangle_id() >= header.num_faces) {
+                return false;
+            }
+            // the triangles continue in the next node
+            if (node.has_second_triangle_id() &&
+                (node.second_triangle_id() >= header.num_faces ||
+                 i + 1 >= n)) {
+                return false;
+            }
+        } else if (!is_sentinel(node)) {
+            if (i + 1 >= n || node.right() <= i || node.right() >= n ||
+                is_sentinel(nodes[i + 1]) || is_sentinel(nodes[node.right()])) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+} // namespace detail
+
+/**
+ * Load the tree with key from cache_dir. The tree refers to the mapped file,
+ * which stays mapped as long as the tree or any copy of it exists.
+ *
+ * @return true if the tree was loaded. Otherwise false, and error is empty if
+ *         there is no cached tree, or describes why the cached tree was
+ *         rejected.
+ */
+template <typename Intersector>
+bool load_cached_kdtree(const std::string& cache_dir, uint64_t key,
+                        BasicKDTree<Intersector>& tree, std::string& error) {
+    using IntersectorData = typename Intersector::Data;
+
+    error.clear();
+    const std::string path = kdtree_cache_path(cache_dir, key);
+    if (::access(path.c_str(), F_OK) != 0) {
+        return false;
+    }
+
+    auto file = std::make_shared<const MappedFile>(path);
+    if (!*file) {
+        error = "Cannot map kd-tree cache file " + path;
+        return false;
+    }
+
+    KDTreeCacheHeader header;
+    if (file->size() < sizeof(header)) {
+        error = "Not a kd-tree cache file: " + path;
+        return false;
+    }
+    std::memcpy(&header, file->data(), sizeof(header));
+    if (std::memcmp(header.magic, KDTREE_CACHE_MAGIC, sizeof(header.magic))) {
+        error = "Not a kd-tree cache file: " + path;
+        return false;
+    }
+    if (header.version != KDTREE_CACHE_VERSION ||
+        header.byte_order != KDTREE_CACHE_BYTE_ORDER || header.key != key ||
+        header.point_size != sizeof(Point3f) ||
+        header.normal_size != sizeof(Normal3f) ||
+        header.face_size != sizeof(TriangleMesh::Face) ||
+        header.material_size != sizeof(Material) ||
+        header.node_size != sizeof(detail::FlatNode)) {
+        error = "Outdated kd-tree cache file: " + path;
+        return false;
+    }
+
+    // every array has to be aligned and inside of the file
+    auto fits = [&file](uint64_t offset, uint64_t count, uint64_t item_size) {
+        return detail::is_aligned(offset) && offset <= file->size() &&
+               count <= (file->size() - offset) / item_size;
+    };
+    const bool same_intersector =
+        header.intersector_id == Intersector::ID &&
+        header.intersector_data_size == sizeof(IntersectorData);
+    if (header.file_size != file->size() || header.num_faces == 0 ||
+        header.num_nodes == 0 ||
+        !fits(header.vertices_offset, header.num_vertices, sizeof(Point3f)) ||
+        !fits(header.normals_offset, header.num_vertices, sizeof(Normal3f)) ||
+        !fits(header.faces_offset, header.num_faces,
+              sizeof(TriangleMesh::Face)) ||
+        !fits(header.material_ids_offset, header.num_faces,
+              sizeof(MaterialId)) ||
+        !fits(header.materials_offset, header.num_materials,
+              sizeof(Material)) ||
+        !fits(header.nodes_offset, header.num_nodes,
+              sizeof(detail::FlatNode)) ||
+        (same_intersector &&
+         !fits(header.intersector_data_offset, header.num_faces,
+               sizeof(IntersectorData)))) {
+        error = "Truncated kd-tree cache file: " + path;
+        return false;
+    }
+
+    const auto* faces = reinterpret_cast<const TriangleMesh::Face*>(
+        file->data() + header.faces_offset);
+    const auto* material_ids = reinterpret_cast<const MaterialId*>(
+        file->data() + header.material_ids_offset);
+    const auto* flat_nodes = reinterpret_cast<const detail::FlatNode*>(
+        file->data() + header.nodes_offset);
+    if (!detail::valid_kdtree_arrays(header, faces, material_ids,
+                                     flat_nodes)) {
+        error = "Corrupt kd-tree cache file: " + path;
+        return false;
+    }
+
+    // views into the mapped file
+    using detail::mapped_view;
+    const auto* materials = reinterpret_cast<const Material*>(
+        file->data() + header.materials_offset);
+    TriangleMesh mesh(
+        mapped_view<Point3f>(file, header.vertices_offset,
+                             header.num_vertices),
+        mapped_view<Normal3f>(file, header.normals_offset,
+                              header.num_vertices),
+        mapped_view<TriangleMesh::Face>(file, header.faces_offset,
+                                        header.num_faces),
+        mapped_view<MaterialId>(file, header.material_ids_offset,
+                                header.num_faces),
+        Materials(materials, materials + header.num_materials));
+    const Bbox3f box(
+        {header.box_min[0], header.box_min[1], header.box_min[2]},
+        {header.box_max[0], header.box_max[1], header.box_max[2]});
+    auto nodes = mapped_view<detail::FlatNode>(file, header.nodes_offset,
+                                               header.num_nodes);
+    auto isect = same_intersector
+                     ? mapped_view<IntersectorData>(
+                           file, header.intersector_data_offset,
+                           header.num_faces)
+                     : Buffer<IntersectorData>();
+
+    tree = BasicKDTree<Intersector>(std::move(mesh), box, std::move(nodes),
+                                    std::move(isect));
+    return true;
+}
+
+/**
+ * Store the tree with key in cache_dir. The directory is created if needed.
+ *
+ * The file is written under a temporary name and renamed afterwards, so that
+ * concurrent renderers never see a partially written file.
+ *
+ * @return false if the tree could not be stored.
+ */
+template <typename Intersector>
+bool store_cached_kdtree(const std::string& cache_dir, uint64_t key,
+                         const BasicKDTree<Intersector>& tree) {
+    if (::mkdir(cache_dir.c_str(), 0755) != 0 && errno != EEXIST) {
+        return false;
+    }
+
+    const auto header = detail::kdtree_cache_header(key, tree);
+    const auto& mesh = tree.mesh();
+
+    const std::string path = kdtree_cache_path(cache_dir, key);
+    const std::string tmp_path = path + ".tmp" + std::to_string(::getpid());
+    {
+        std::ofstream file(tmp_path, std::ios::out | std::ios::binary);
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        uint64_t pos = sizeof(header);
+        detail::write_array(file, pos, header.vertices_offset, mesh.vertices());
+        detail::write_array(file, pos, header.normals_offset, mesh.normals());
+        detail::write_array(file, pos, header.faces_offset, mesh.faces());
+        detail::write_array(file, pos, header.material_ids_offset,
+                            mesh.material_ids());
+        detail::write_array(file, pos, header.materials_offset,
+                            mesh.materials());
+        detail::write_array(file, pos, header.nodes_offset, tree.nodes());
+        detail::write_array(file, pos, header.intersector_data_offset,
+                            tree.intersector_data());
+        assert(pos == header.file_size);
+        if (!file) {
+            std::remove(tmp_path.c_str());
+            return false;
+        }
+    }
+    if (std::rename(tmp_path.c_str(), path.c_str()) != 0) {
+        std::remove(tmp_path.c_str());
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <list>
+#include <map>
+#include <utility>
+
+/**
+ * Map of at most capacity entries, which evicts the least recently used entry
+ * when a new one is added.
+ */
+template <typename Key, typename Value> class LruCache {
+public:
+    explicit LruCache(size_t capacity) : capacity_(capacity) {
+        assert(capacity > 0);
+    }
+
+    size_t size() const { return index_.size(); }
+    size_t capacity() const { return capacity_; }
+
+    /**
+     * Value of key, which becomes the most recently used entry, or nullptr if
+     * there is none.
+     */
+    Value* get(const Key& key) {
+        const auto it = index_.find(key);
+        if (it == index_.end()) {
+            return nullptr;
+        }
+        entries_.splice(entries_.begin(), entries_, it->second);
+        return &it->second->second;
+    }
+
+    /**
+     * Add or replace the value of key as the most recently used entry.
+     */
+    Value& put(const Key& key, Value value) {
+        erase(key);
+        if (index_.size() == capacity_) {
+            index_.erase(entries_.back().first);
+            entries_.pop_back();
+        }
+        entries_.emplace_front(key, std::move(value));
+        index_[key] = entries_.begin();
+        return entries_.front().second;
+    }
+
+    void erase(const Key& key) {
+        const auto it = index_.find(key);
+        if (it != index_.end()) {
+            entries_.erase(it->second);
+            index_.erase(it);
+        }
+    }
+
+    /**
+     * Keys from the most to the least recently used.
+     */
+    template <typename OutputIt> void keys(OutputIt out) const {
+        for (const auto& entry : entries_) {
+            *out++ = entry.first;
+        }
+    }
+
+private:
+    using Entries = std::list<std::pair<Key, Value>>;
+
+    size_t capacity_;
+    Entries entries_;
+    std::map<Key, typename Entries::iterator> index_;
+};
@@ -0,0 +1,111 @@
+/**
+ * Read-only memory mapping of a whole file, and helpers to write files of
+ * aligned arrays, which can be used in place after mapping.
+ */
+
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/**
+ * Maps a file read-only into memory for the lifetime of the object (RAII).
+ *
+ * If the file cannot be opened or mapped, the object is invalid (cf.
+ * operator bool). An empty file is mapped as valid with size 0.
+ */
+class MappedFile {
+public:
+    MappedFile() = default;
+
+    explicit MappedFile(const std::string& filename) {
+        int fd = ::open(filename.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return;
+        }
+        struct stat st;
+        if (::fstat(fd, &st) == 0) {
+            size_ = st.st_size;
+            if (size_ == 0) {
+                valid_ = true;
+            } else {
+                void* data =
+                    ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (data != MAP_FAILED) {
+                    data_ = static_cast<const char*>(data);
+                    valid_ = true;
+                }
+            }
+        }
+        // the mapping stays valid after closing the file descriptor
+        ::close(fd);
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    MappedFile(MappedFile&& other) { *this = std::move(other); }
+
+    MappedFile& operator=(MappedFile&& other) {
+        std::swap(data_, other.data_);
+        std::swap(size_, other.size_);
+        std::swap(valid_, other.valid_);
+        return *this;
+    }
+
+    ~MappedFile() {
+        if (data_) {
+            ::munmap(const_cast<char*>(data_), size_);
+        }
+    }
+
+    explicit operator bool() const { return valid_; }
+
+    const char* data() const { return data_; }
+    size_t size() const { return size_; }
+
+private:
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+    bool valid_ = false;
+};
+
+// Alignment of the arrays in mapped files (cache line).
+static constexpr size_t MAPPED_ARRAY_ALIGNMENT = 64;
+
+namespace detail {
+
+inline uint64_t align_offset(uint64_t offset) {
+    return (offset + MAPPED_ARRAY_ALIGNMENT - 1) / MAPPED_ARRAY_ALIGNMENT *
+           MAPPED_ARRAY_ALIGNMENT;
+}
+
+inline bool is_aligned(uint64_t offset) {
+    return offset % MAPPED_ARRAY_ALIGNMENT == 0;
+}
+
+/**
+ * Write the elements of array (anything with data() and size()) at offset.
+ * The gap between the current position pos and offset is zero-padded.
+ */
+template <typename Array>
+void write_array(std::ostream& os, uint64_t& pos, uint64_t offset,
+                 const Array& array) {
+    static const char zeros[MAPPED_ARRAY_ALIGNMENT] = {};
+    assert(pos <= offset && offset - pos <= sizeof(zeros));
+    os.write(zeros, offset - pos);
+    const auto size = array.size() * sizeof(*array.data());
+    os.write(reinterpret_cast<const char*>(array.data()), size);
+    pos = offset + size;
+}
+
+} // namespace detail
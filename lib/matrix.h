@@ -20,6 +20,8 @@ public:
 
     size_t rows() const { return rows_; }
 
+    size_t memory_bytes() const { return data_.capacity() * sizeof(Number); }
+
     Number& operator()(size_t row, size_t col) {
         assert(0 <= row && row < rows_ && "Row index out of range.");
         assert(0 <= col && col < cols_ && "Column index out of range.");
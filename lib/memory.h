@@ -0,0 +1,70 @@
+/**
+ * Memory accounting: bytes held by containers, and the resident set size
+ * (RSS) of the process.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <sys/resource.h>
+
+/**
+ * Bytes allocated by a vector (capacity, not size).
+ */
+template <typename T> size_t memory_bytes(const std::vector<T>& v) {
+    return v.capacity() * sizeof(T);
+}
+
+namespace detail {
+
+// Value of a field in kB of /proc/self/status, e.g. "VmHWM:", or 0 if it is
+// not available.
+inline size_t proc_status_kb(const std::string& field) {
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line)) {
+        if (line.compare(0, field.size(), field) == 0) {
+            return std::stoull(line.substr(field.size()));
+        }
+    }
+    return 0;
+}
+
+} // namespace detail
+
+/**
+ * Current resident set size in bytes, or 0 if it is not available.
+ */
+inline size_t current_rss_bytes() {
+    return detail::proc_status_kb("VmRSS:") * 1024;
+}
+
+/**
+ * Peak resident set size in bytes since the start of the process or since
+ * the last reset_peak_rss().
+ */
+inline size_t peak_rss_bytes() {
+    size_t kb = detail::proc_status_kb("VmHWM:");
+    if (kb == 0) {
+        struct rusage usage;
+        if (::getrusage(RUSAGE_SELF, &usage) == 0) {
+            kb = usage.ru_maxrss; // in kB on Linux, never reset
+        }
+    }
+    return kb * 1024;
+}
+
+/**
+ * Reset the peak RSS to the current RSS (Linux 4.0 and later).
+ *
+ * @return false if the peak cannot be reset; then, peak_rss_bytes() keeps
+ *         the peak since the start of the process.
+ */
+inline bool reset_peak_rss() {
+    std::ofstream clear_refs("/proc/self/clear_refs");
+    return static_cast<bool>(clear_refs << "5" << std::flush);
+}
@@ -44,6 +44,28 @@ using VertexRadiosityHandle = OpenMesh::VPropHandleT<Color>;
 using VertexRadiosityHandleProperty =
     OpenMesh::PropertyManager<VertexRadiosityHandle, RadiosityMesh>;
 
+/**
+ * Bytes of the connectivity and of all properties (points, radiosity, ...)
+ * of the mesh.
+ */
+inline size_t memory_bytes(const RadiosityMesh& mesh) {
+    size_t bytes = mesh.n_vertices() * sizeof(RadiosityMesh::Vertex) +
+                   mesh.n_edges() * sizeof(RadiosityMesh::Edge) +
+                   mesh.n_faces() * sizeof(RadiosityMesh::Face);
+    auto add = [&bytes](auto begin, auto end) {
+        for (auto it = begin; it != end; ++it) {
+            if (*it) {
+                bytes += (*it)->size_of();
+            }
+        }
+    };
+    add(mesh.vprops_begin(), mesh.vprops_end());
+    add(mesh.hprops_begin(), mesh.hprops_end());
+    add(mesh.eprops_begin(), mesh.eprops_end());
+    add(mesh.fprops_begin(), mesh.fprops_end());
+    return bytes;
+}
+
 namespace detail {
 /**
  * Get halfedge of a face by index.
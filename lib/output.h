@@ -8,6 +8,7 @@
 
 #include <iomanip>
 #include <ostream>
+#include <string>
 #include <unordered_map>
 #include <unordered_set>
 #include <vector>
@@ -98,18 +99,107 @@ inline std::ostream& operator<<(std::ostream& os, const aiCamera& cam) {
               << "mUp=" << cam.mUp << ")";
 }
 
+namespace detail {
+
+// Number of depth buckets up to the last non-empty one.
+inline size_t num_depths(const RayStats& rays) {
+    size_t n = RayStats::MAX_DEPTH;
+    while (n > 0 && rays.by_depth[n - 1] == 0) {
+        n -= 1;
+    }
+    return n;
+}
+
+} // namespace detail
+
 inline std::ostream& operator<<(std::ostream& os, const Stats& stats) {
-    return os << "Triangles      : " << stats.num_triangles << std::endl
-              << "Kd-Tree Height : " << stats.kdtree_height << std::endl
-              << "Rays           : " << stats.num_rays << std::endl
-              << "Rays (primary) : " << stats.num_prim_rays << std::endl
-              << "Rays/sec       : "
-              << (stats.runtime_ms ? 1000 * stats.num_rays / stats.runtime_ms
-                                   : 0)
-              << std::endl
-              << "Loading time   : " << 1.0 * stats.loading_time_ms / 1000
-              << " sec" << std::endl
-              << "Rendering time : " << 1.0 * stats.runtime_ms / 1000 << " sec";
+    auto mb = [](size_t bytes) { return 1.0 * bytes / (1 << 20); };
+    const auto& m = stats.memory;
+    const auto rays = stats.rays();
+    os << "Triangles      : " << stats.num_triangles << std::endl
+       << "Kd-Tree Height : " << stats.kdtree_height << std::endl
+       << "Rays           : " << rays.num_rays() << std::endl
+       << "Rays/sec       : "
+       << (stats.runtime_ms ? 1000 * rays.num_rays() / stats.runtime_ms : 0)
+       << std::endl;
+    for (size_t i = 0; i < NUM_RAY_TYPES; ++i) {
+        const auto type = static_cast<RayType>(i);
+        if (rays.num_rays(type) == 0) {
+            continue;
+        }
+        const std::string name = to_string(type);
+        const size_t padding = name.size() < 8 ? 8 - name.size() : 0;
+        os << "Rays (" << name << ")" << std::string(padding, ' ') << ": "
+           << rays.num_rays(type) << ", "
+           << (type == RayType::SHADOW || type == RayType::FORM_FACTOR
+                   ? "occluded "
+                   : "hit ")
+           << 100 * rays.hit_rate(type) << "%" << std::endl;
+    }
+    if (detail::num_depths(rays) > 0) {
+        os << "Rays by depth  :";
+        for (size_t d = 0; d < detail::num_depths(rays); ++d) {
+            os << " " << rays.by_depth[d];
+        }
+        os << std::endl;
+    }
+    os << "Loading time   : " << 1.0 * stats.loading_time_ms / 1000 << " sec"
+       << std::endl
+       << "Rendering time : " << 1.0 * stats.runtime_ms / 1000 << " sec"
+       << std::endl
+       << "Memory (MB)    : triangles " << mb(m.triangles) << ", kd-tree "
+       << mb(m.kdtree) << ", framebuffer " << mb(m.framebuffer);
+    if (m.radiosity_mesh || m.hierarchy || m.links || m.matrix) {
+        os << std::endl
+           << "Memory (MB)    : radiosity mesh " << mb(m.radiosity_mesh)
+           << ", hierarchy " << mb(m.hierarchy) << ", links " << mb(m.links)
+           << ", matrix " << mb(m.matrix);
+    }
+    for (const auto& phase : stats.peak_rss) {
+        os << std::endl
+           << "Peak RSS (MB)  : " << mb(phase.second) << " (" << phase.first
+           << ")";
+    }
+    return os;
+}
+
+/**
+ * Write the stats as JSON object. Memory is in bytes, times are in ms.
+ *
+ * Note: Phase names are written as they are, so they must not contain
+ * characters which need escaping.
+ */
+inline void write_json(std::ostream& os, const Stats& stats) {
+    const auto& m = stats.memory;
+    const auto rays = stats.rays();
+    os << "{\"triangles\": " << stats.num_triangles
+       << ", \"kdtree_height\": " << stats.kdtree_height
+       << ", \"rays\": " << rays.num_rays()
+       << ", \"primary_rays\": " << rays.num_rays(RayType::PRIMARY)
+       << ", \"ray_types\": {";
+    for (size_t i = 0; i < NUM_RAY_TYPES; ++i) {
+        const auto type = static_cast<RayType>(i);
+        os << (i ? ", " : "") << "\"" << to_string(type)
+           << "\": {\"rays\": " << rays.num_rays(type)
+           << ", \"hits\": " << rays.num_hits(type) << "}";
+    }
+    os << "}, \"rays_by_depth\": [";
+    for (size_t d = 0; d < detail::num_depths(rays); ++d) {
+        os << (d ? ", " : "") << rays.by_depth[d];
+    }
+    os << "], \"runtime_ms\": " << stats.runtime_ms
+       << ", \"loading_time_ms\": " << stats.loading_time_ms
+       << ", \"memory\": {\"triangles\": " << m.triangles
+       << ", \"kdtree\": " << m.kdtree
+       << ", \"framebuffer\": " << m.framebuffer
+       << ", \"radiosity_mesh\": " << m.radiosity_mesh
+       << ", \"hierarchy\": " << m.hierarchy << ", \"links\": " << m.links
+       << ", \"matrix\": " << m.matrix << "}, \"peak_rss\": [";
+    for (size_t i = 0; i < stats.peak_rss.size(); ++i) {
+        os << (i ? ", " : "") << "{\"phase\": \"" << stats.peak_rss[i].first
+           << "\", \"bytes\": " << stats.peak_rss[i].second << "}";
+    }
+    os << "]}";
 }
 
 template <typename X, typename Y>
@@ -0,0 +1,195 @@
+/**
+ * Partial renders of an image, to distribute an image over processes.
+ *
+ * A tracer with --region renders only a rectangle of the image and writes
+ * the accumulated samples of the rectangle to a partial file (--partial).
+ * turner-merge adds the samples of the partials to one accumulator. Partials
+ * of the same region rendered with different seeds are thus merged weighted
+ * by their numbers of samples.
+ *
+ * A partial stores the key of the render (cf. render_key in main.cpp), so
+ * that partials of different scenes, cameras, renderers or options are not
+ * merged, and its seed: partials of the same pixels with the same seed have
+ * the same samples, which would be counted twice.
+ */
+
+#pragma once
+
+#include "accumulator.h"
+#include "tile_scheduler.h"
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+static constexpr char PARTIAL_MAGIC[8] = {'T', 'U', 'R', 'N',
+                                          'E', 'R', 'P', 'T'};
+static constexpr uint32_t PARTIAL_VERSION = 2;
+static constexpr uint32_t PARTIAL_BYTE_ORDER = 0x01020304;
+
+/**
+ * Header of a partial file, followed by region.size() x Accumulator::Pixel,
+ * row by row.
+ */
+struct PartialHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint64_t width; // of the whole image
+    uint64_t height;
+    uint64_t x0, y0, x1, y1; // region
+    uint64_t pixel_size;
+    uint64_t key;
+    uint64_t seed;
+};
+
+/**
+ * Accumulated samples of a region of an image.
+ */
+struct Partial {
+    size_t width = 0; // of the whole image
+    size_t height = 0;
+    Tile region = {0, 0, 0, 0};
+    uint64_t key = 0; // of the render
+    uint64_t seed = 0;
+    std::vector<Accumulator::Pixel> pixels; // of the region, row by row
+};
+
+/**
+ * Key, regions and seeds of the partials merged into an accumulator.
+ */
+struct MergedPartials {
+    uint64_t key = 0;
+    std::vector<std::pair<Tile, uint64_t>> regions; // with their seeds
+};
+
+/**
+ * Write the region of the accumulator rendered with key and seed to path.
+ *
+ * @return false with an error message if the file could not be written.
+ */
+inline bool write_partial(const std::string& path, const Accumulator& acc,
+                          const Tile& region, uint64_t key, uint64_t seed,
+                          std::string& error) {
+    assert(region.x1 <= acc.width() && region.y1 <= acc.height());
+
+    PartialHeader header;
+    std::memcpy(header.magic, PARTIAL_MAGIC, sizeof(header.magic));
+    header.version = PARTIAL_VERSION;
+    header.byte_order = PARTIAL_BYTE_ORDER;
+    header.width = acc.width();
+    header.height = acc.height();
+    header.x0 = region.x0;
+    header.y0 = region.y0;
+    header.x1 = region.x1;
+    header.y1 = region.y1;
+    header.pixel_size = sizeof(Accumulator::Pixel);
+    header.key = key;
+    header.seed = seed;
+
+    std::ofstream file(path, std::ios::out | std::ios::binary);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    for (size_t y = region.y0; y < region.y1 && region.width() > 0; ++y) {
+        file.write(reinterpret_cast<const char*>(&acc(region.x0, y)),
+                   region.width() * sizeof(Accumulator::Pixel));
+    }
+    if (!file) {
+        error = "Cannot write partial " + path;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Read the partial at path.
+ *
+ * @return false with an error message if the file is not a valid partial.
+ */
+inline bool read_partial(const std::string& path, Partial& partial,
+                         std::string& error) {
+    std::ifstream file(path, std::ios::in | std::ios::binary);
+    if (!file) {
+        error = "Cannot open partial " + path;
+        return false;
+    }
+
+    PartialHeader header;
+    if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+        std::memcmp(header.magic, PARTIAL_MAGIC, sizeof(header.magic))) {
+        error = "Not a partial: " + path;
+        return false;
+    }
+    if (header.version != PARTIAL_VERSION ||
+        header.byte_order != PARTIAL_BYTE_ORDER ||
+        header.pixel_size != sizeof(Accumulator::Pixel)) {
+        error = "Outdated partial: " + path;
+        return false;
+    }
+    if (header.x0 > header.x1 || header.y0 > header.y1 ||
+        header.x1 > header.width || header.y1 > header.height) {
+        error = "Invalid region in partial " + path;
+        return false;
+    }
+
+    partial.width = header.width;
+    partial.height = header.height;
+    partial.region = {header.x0, header.y0, header.x1, header.y1};
+    partial.key = header.key;
+    partial.seed = header.seed;
+    partial.pixels.resize(partial.region.size());
+    if (!file.read(reinterpret_cast<char*>(partial.pixels.data()),
+                   partial.pixels.size() * sizeof(Accumulator::Pixel))) {
+        error = "Truncated partial: " + path;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Add the samples of the partial to the accumulator, which has to have the
+ * size of the image of the partial, and record it in merged. All partials
+ * merged into an accumulator have to have the same key.
+ *
+ * @return false with an error message if the sizes or keys differ. Otherwise
+ *         true, and warning is set if the partial overlaps a merged partial
+ *         with the same seed, whose samples are thus counted twice.
+ */
+inline bool merge_partial(const Partial& partial, Accumulator& acc,
+                          MergedPartials& merged, std::string& error,
+                          std::string& warning) {
+    warning.clear();
+    if (partial.width != acc.width() || partial.height != acc.height()) {
+        error = "Partial of a " + std::to_string(partial.width) + "x" +
+                std::to_string(partial.height) + " image cannot be merged " +
+                "into a " + std::to_string(acc.width()) + "x" +
+                std::to_string(acc.height()) + " image";
+        return false;
+    }
+    if (merged.regions.empty()) {
+        merged.key = partial.key;
+    } else if (partial.key != merged.key) {
+        error = "Partial of another scene, camera, renderer or options";
+        return false;
+    }
+    for (const auto& region : merged.regions) {
+        if (region.second == partial.seed &&
+            intersect(region.first, partial.region).size() > 0) {
+            warning = "Partial overlaps another partial with seed " +
+                      std::to_string(partial.seed) +
+                      ", whose samples are counted twice";
+            break;
+        }
+    }
+    merged.regions.emplace_back(partial.region, partial.seed);
+
+    auto pixel = partial.pixels.begin();
+    for (size_t y = partial.region.y0; y < partial.region.y1; ++y) {
+        for (size_t x = partial.region.x0; x < partial.region.x1; ++x) {
+            acc(x, y) += *pixel++;
+        }
+    }
+    return true;
+}
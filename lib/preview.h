@@ -0,0 +1,77 @@
+/**
+ * Multi-resolution preview of a render (cf. --preview).
+ *
+ * Before the full render, the image is rendered in levels of decreasing
+ * block size: one sample per 8x8 block, then per 4x4 and 2x2 block. The
+ * sample of a block is the one of its top left pixel, so that a level only
+ * renders the pixels which no coarser level has rendered, and the full
+ * render only adds the remaining samples to every pixel. Since the samples
+ * of a pixel are determined by their index (cf. CounterRng), the final image
+ * is the same as without a preview.
+ */
+
+#pragma once
+
+#include "accumulator.h"
+#include "raster.h"
+
+#include <cassert>
+#include <cstddef>
+#include <cstdio>
+#include <fstream>
+#include <string>
+
+// block sizes of the preview levels, from coarse to fine
+static constexpr size_t PREVIEW_BLOCKS[] = {8, 4, 2};
+
+/**
+ * Whether the pixel (x, y) is rendered at the level of block size block:
+ * it is the top left pixel of a block, but not of a block of the coarser
+ * level of twice the size, unless this is the coarsest level.
+ */
+inline bool preview_pixel(size_t x, size_t y, size_t block) {
+    assert(block > 0);
+    if (x % block != 0 || y % block != 0) {
+        return false;
+    }
+    const size_t coarser = 2 * block;
+    return block == PREVIEW_BLOCKS[0] || x % coarser != 0 || y % coarser != 0;
+}
+
+/**
+ * Image in which every pixel has the mean of the top left pixel of its block.
+ */
+inline Image preview_image(const Accumulator& acc, size_t block) {
+    assert(block > 0);
+    Image image(acc.width(), acc.height());
+    for (size_t y = 0; y < acc.height(); ++y) {
+        for (size_t x = 0; x < acc.width(); ++x) {
+            image(x, y) = acc.mean(x - x % block, y - y % block);
+        }
+    }
+    return image;
+}
+
+/**
+ * Replace the file at path by image, so that a viewer never reads a partly
+ * written image.
+ *
+ * @return false with an error message if the image cannot be written.
+ */
+inline bool write_preview(const std::string& path, const Image& image,
+                          std::string& error) {
+    const std::string tmp = path + ".tmp";
+    {
+        std::ofstream ppm(tmp);
+        ppm << image << std::endl;
+        if (!ppm) {
+            error = "Cannot write preview " + tmp;
+            return false;
+        }
+    }
+    if (std::rename(tmp.c_str(), path.c_str()) != 0) {
+        error = "Cannot replace preview " + path;
+        return false;
+    }
+    return true;
+}
@@ -17,9 +17,82 @@
  * 3. Use Poisson disk sampling.
  */
 
+#include "cpu.h"
 #include "kdtree.h"
 #include "mesh.h"
 #include "sampling.h"
+#include "stats.h"
+
+#include <cstring>
+
+namespace detail {
+
+// Key of the samples between two triangles given by a corner each, so that
+// every pair gets its own points.
+inline uint64_t form_factor_key(const Point3f& from_pos,
+                                const Point3f& to_pos) {
+    uint64_t key = 0;
+    for (const float c :
+         {from_pos.x, from_pos.y, from_pos.z, to_pos.x, to_pos.y, to_pos.z}) {
+        uint32_t bits;
+        std::memcpy(&bits, &c, sizeof(bits));
+        key = mix64(key ^ bits);
+    }
+    return key;
+}
+
+// Sampling kernel of form_factor compiled for several ISAs, cf. cpu.h. Adds
+// the number of occluded samples to num_occluded. The point pairs are the
+// samples of the sampler of sampling::sampler_type().
+struct FormFactor {
+    float operator()(KDTreeIntersection& tree, const Point3f& from_pos,
+                     const Vector3f& from_u, const Vector3f& from_v,
+                     const Normal3f& from_normal, const Point3f& to_pos,
+                     const Vector3f& to_u, const Vector3f& to_v,
+                     const Normal3f& to_normal, const float to_area,
+                     const KDTree::TriangleId to_id, const size_t num_samples,
+                     size_t& num_occluded) const {
+        const uint64_t key = form_factor_key(from_pos, to_pos);
+        float result = 0;
+        for (size_t i = 0; i < num_samples; ++i) {
+            sampling::start_sample(0, key, i, num_samples);
+            auto p1 = Point3f(sampling::triangle(from_pos, from_u, from_v));
+            auto p2 = Point3f(sampling::triangle(to_pos, to_u, to_v));
+
+            Vector3f v = p2 - p1;
+            if (tree.intersect({p1 + Vector3f(EPS * from_normal), v}) !=
+                to_id) {
+                num_occluded += 1;
+                continue;
+            }
+
+            float length_squared = v.length_squared();
+            if (length_squared == 0) {
+                continue;
+            }
+
+            float length = sqrt(length_squared);
+
+            float cos_theta1 = dot(v, from_normal) / length;
+            if (cos_theta1 <= 0) {
+                continue;
+            }
+
+            float cos_theta2 = dot(-v, to_normal) / length;
+            if (cos_theta2 <= 0) {
+                continue;
+            }
+
+            float G = cos_theta1 * cos_theta2 /
+                      (PI * length_squared + to_area / num_samples);
+            result += G;
+        }
+
+        return result * to_area / num_samples;
+    }
+};
+
+} // namespace detail
 
 /**
  * Numerical integration of form factor from infinitesimal area to finite area.
@@ -60,39 +133,13 @@ inline float form_factor(KDTreeIntersection& tree, const Point3f& from_pos,
                          const Normal3f& to_normal, const float to_area,
                          const KDTree::TriangleId to_id,
                          const size_t num_samples = 128) {
-    float result = 0;
-    for (size_t i = 0; i < num_samples; ++i) {
-        auto p1 = Point3f(sampling::triangle(from_pos, from_u, from_v));
-        auto p2 = Point3f(sampling::triangle(to_pos, to_u, to_v));
-
-        Vector3f v = p2 - p1;
-        if (tree.intersect({p1 + Vector3f(EPS * from_normal), v}) != to_id) {
-            continue;
-        }
-
-        float length_squared = v.length_squared();
-        if (length_squared == 0) {
-            continue;
-        }
-
-        float length = sqrt(length_squared);
-
-        float cos_theta1 = dot(v, from_normal) / length;
-        if (cos_theta1 <= 0) {
-            continue;
-        }
-
-        float cos_theta2 = dot(-v, to_normal) / length;
-        if (cos_theta2 <= 0) {
-            continue;
-        }
-
-        float G = cos_theta1 * cos_theta2 /
-                  (PI * length_squared + to_area / num_samples);
-        result += G;
-    }
-
-    return result * to_area / num_samples;
+    size_t num_occluded = 0;
+    const float result = cpu::dispatch<detail::FormFactor>(
+        tree, from_pos, from_u, from_v, from_normal, to_pos, to_u, to_v,
+        to_normal, to_area, to_id, num_samples, num_occluded);
+    Stats::local().count_rays(RayType::FORM_FACTOR, num_samples,
+                              num_occluded);
+    return result;
 }
 
 /*
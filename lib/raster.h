@@ -3,6 +3,8 @@
 
 #include <assert.h>
 #include <cmath>
+#include <cstdint>
+#include <cstring>
 #include <iomanip>
 #include <ostream>
 #include <vector>
@@ -46,6 +48,7 @@ public:
 
     size_t width() const { return width_; }
     size_t height() const { return height_; }
+    size_t memory_bytes() const { return image_data_.size() * sizeof(Color); }
 
     Color& operator()(size_t x, size_t y) {
         assert(x < width_ && "x out of image bounds");
@@ -98,3 +101,41 @@ inline std::ostream& operator<<(std::ostream& os, const Image& img) {
 
     return os;
 }
+
+/**
+ * Output raw floats in PFM format, either grayscale ("Pf") or with three
+ * channels ("PF").
+ *
+ * The floats are written in host byte order, rows from bottom to top.
+ * Cf. http://www.pauldebevec.com/Research/HDR/PFM/.
+ *
+ * @param num_channels  1 or 3
+ * @param value         callback function: (size_t x, size_t y, size_t channel)
+ *                      -> float, which returns the value of a channel of the
+ *                      pixel at the given position
+ */
+template <typename ValueFun>
+void write_pfm(std::ostream& os, size_t width, size_t height,
+               size_t num_channels, ValueFun&& value) {
+    assert((num_channels == 1 || num_channels == 3) &&
+           "PFM is grayscale or RGB");
+    const uint16_t one = 1;
+    uint8_t first_byte;
+    std::memcpy(&first_byte, &one, 1);
+    const bool little_endian = first_byte == 1;
+
+    os << (num_channels == 3 ? "PF" : "Pf") << "\n"
+       << width << " " << height << "\n"
+       << (little_endian ? "-1.0" : "1.0") << "\n";
+
+    std::vector<float> row(num_channels * width);
+    for (size_t y = height; y-- > 0;) {
+        for (size_t x = 0; x < width; ++x) {
+            for (size_t c = 0; c < num_channels; ++c) {
+                row[num_channels * x + c] = value(x, y, c);
+            }
+        }
+        os.write(reinterpret_cast<const char*>(row.data()),
+                 row.size() * sizeof(float));
+    }
+}
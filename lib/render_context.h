@@ -0,0 +1,46 @@
+/**
+ * State of a render worker thread, which is kept across all tiles the
+ * thread renders.
+ */
+
+#pragma once
+
+#include <memory>
+#include <vector>
+
+/**
+ * Per-thread render context.
+ *
+ * TreeIntersection is the traversal state of the thread, e.g.
+ * KDTreeIntersection or ChunkedKDTreeIntersection. Since it is created once
+ * per thread instead of once per tile, a ChunkedKDTreeIntersection keeps its
+ * current chunk between tiles.
+ *
+ * Ray counters are kept in the thread-local Stats::local() shard of the
+ * worker, since they are also counted outside of render loops. Random numbers
+ * are drawn per sample (cf. sampling::start_sample), so they are no state of
+ * the thread.
+ */
+template <typename TreeIntersection> struct RenderContext {
+    explicit RenderContext(const typename TreeIntersection::Tree& tree)
+        : tree_intersection(tree) {}
+
+    RenderContext(const RenderContext&) = delete;
+    RenderContext& operator=(const RenderContext&) = delete;
+
+    TreeIntersection tree_intersection;
+};
+
+/**
+ * One context per worker.
+ */
+template <typename TreeIntersection>
+std::vector<std::unique_ptr<RenderContext<TreeIntersection>>>
+make_render_contexts(const typename TreeIntersection::Tree& tree,
+                     size_t num_workers) {
+    std::vector<std::unique_ptr<RenderContext<TreeIntersection>>> contexts;
+    for (size_t i = 0; i < num_workers; ++i) {
+        contexts.emplace_back(new RenderContext<TreeIntersection>(tree));
+    }
+    return contexts;
+}
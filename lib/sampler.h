@@ -0,0 +1,248 @@
+/**
+ * Samplers of the random numbers of a sample.
+ *
+ * A sample (e.g. a path through a pixel, or a pair of points of a form
+ * factor) consumes a sequence of dimensions in [0, 1): two for the position
+ * on the pixel, two for every direction on a hemisphere, and so on. The
+ * samplers differ in how the numbers of the samples of a pixel are spread:
+ *
+ *   random      independent numbers (cf. CounterRng)
+ *   stratified  every dimension is stratified over each batch of
+ *               num_samples samples of a pixel, with strata permuted
+ *               independently per dimension (Latin hypercube, [Ken13])
+ *   halton      Halton sequence with a random rotation per pixel; dimensions
+ *               beyond the table of primes are random
+ *   sobol       2d Sobol sequence per pair of dimensions with hash-based
+ *               Owen scrambling and shuffled indices [Bur20]
+ *
+ * Like CounterRng, a number depends only on (seed, pixel, sample, dimension),
+ * so it does not matter which thread or process renders a sample.
+ */
+
+#pragma once
+
+#include "counter_rng.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <limits>
+#include <stdint.h>
+#include <string>
+
+enum class SamplerType { RANDOM, STRATIFIED, HALTON, SOBOL };
+
+inline const char* to_string(SamplerType type) {
+    switch (type) {
+    case SamplerType::RANDOM:
+        return "random";
+    case SamplerType::STRATIFIED:
+        return "stratified";
+    case SamplerType::HALTON:
+        return "halton";
+    default:
+        return "sobol";
+    }
+}
+
+/**
+ * Parse a sampler type from its name.
+ *
+ * @return false if name is not a sampler type
+ */
+inline bool parse_sampler_type(const std::string& name, SamplerType& type) {
+    for (const auto t : {SamplerType::RANDOM, SamplerType::STRATIFIED,
+                         SamplerType::HALTON, SamplerType::SOBOL}) {
+        if (name == to_string(t)) {
+            type = t;
+            return true;
+        }
+    }
+    return false;
+}
+
+namespace detail {
+
+inline uint32_t reverse_bits(uint32_t x) {
+    x = (x << 16) | (x >> 16);
+    x = ((x & 0x00ff00ffu) << 8) | ((x & 0xff00ff00u) >> 8);
+    x = ((x & 0x0f0f0f0fu) << 4) | ((x & 0xf0f0f0f0u) >> 4);
+    x = ((x & 0x33333333u) << 2) | ((x & 0xccccccccu) >> 2);
+    x = ((x & 0x55555555u) << 1) | ((x & 0xaaaaaaaau) >> 1);
+    return x;
+}
+
+// Random permutation of the bit-reversed x, which only mixes bits towards
+// the higher ones. Cf. [Bur20].
+inline uint32_t laine_karras_permutation(uint32_t x, uint32_t seed) {
+    x += seed;
+    x ^= x * 0x6c50b47cu;
+    x ^= x * 0xb82f1e52u;
+    x ^= x * 0xc7afe638u;
+    x ^= x * 0x8d22f6e6u;
+    return x;
+}
+
+// Owen scrambling of the binary digits of x in [0, 2^32). Cf. [Bur20].
+inline uint32_t nested_uniform_scramble(uint32_t x, uint32_t seed) {
+    return reverse_bits(laine_karras_permutation(reverse_bits(x), seed));
+}
+
+// First (van der Corput) and second dimension of the Sobol sequence.
+inline uint32_t sobol(uint32_t index, uint32_t dimension) {
+    assert(dimension < 2);
+    if (dimension == 0) {
+        return reverse_bits(index);
+    }
+    uint32_t result = 0;
+    for (uint32_t v = 1u << 31; index; index >>= 1, v ^= v >> 1) {
+        if (index & 1) {
+            result ^= v;
+        }
+    }
+    return result;
+}
+
+// Random permutation of [0, n) indexed by seed. Cf. permute in [Ken13].
+inline uint32_t permute(uint32_t i, uint32_t n, uint32_t seed) {
+    uint32_t w = n - 1;
+    w |= w >> 1;
+    w |= w >> 2;
+    w |= w >> 4;
+    w |= w >> 8;
+    w |= w >> 16;
+    do {
+        i ^= seed;
+        i *= 0xe170893du;
+        i ^= seed >> 16;
+        i ^= (i & w) >> 4;
+        i ^= seed >> 8;
+        i *= 0x0929eb3fu;
+        i ^= seed >> 23;
+        i ^= (i & w) >> 1;
+        i *= 1 | (seed >> 27);
+        i *= 0x6935fa69u;
+        i ^= (i & w) >> 11;
+        i *= 0x74dcb303u;
+        i ^= (i & w) >> 2;
+        i *= 0x9e501cc3u;
+        i ^= (i & w) >> 2;
+        i *= 0xc860a3dfu;
+        i &= w;
+        i ^= i >> 5;
+    } while (i >= n);
+    return (i + seed) % n;
+}
+
+inline double radical_inverse(uint32_t index, uint32_t base) {
+    const double inv_base = 1.0 / base;
+    double inv = inv_base;
+    double result = 0;
+    for (; index; index /= base, inv *= inv_base) {
+        result += (index % base) * inv;
+    }
+    return result;
+}
+
+static constexpr uint32_t HALTON_PRIMES[] = {
+    2,  3,  5,  7,  11, 13, 17, 19, 23,  29,  31,  37,  41,  43,  47,  53,
+    59, 61, 67, 71, 73, 79, 83, 89, 97, 101, 103, 107, 109, 113, 127, 131};
+static constexpr uint32_t NUM_HALTON_PRIMES =
+    sizeof(HALTON_PRIMES) / sizeof(HALTON_PRIMES[0]);
+
+// Largest float below 1.
+static constexpr float ONE_MINUS_EPSILON =
+    1.f - std::numeric_limits<float>::epsilon() / 2;
+
+// Float in [0, 1) of the upper 24 bits of x.
+inline float to_unit_float(uint32_t x) {
+    return std::ldexp(static_cast<float>(x >> 8), -24);
+}
+
+} // namespace detail
+
+/**
+ * Numbers of one sample of a pixel, drawn dimension by dimension.
+ */
+class Sampler {
+public:
+    /**
+     * @param sample      index of the sample in the pixel
+     * @param num_samples samples per pixel in a batch, which the stratified
+     *                    sampler stratifies
+     */
+    Sampler(SamplerType type, uint64_t seed, uint64_t pixel, uint32_t sample,
+            uint32_t num_samples)
+        : type_(type), rng_(seed, pixel, sample),
+          key_(detail::mix64(detail::mix64(seed ^ 0x5eed) ^ pixel)),
+          sample_(sample), num_samples_(std::max(num_samples, 1u)) {}
+
+    /**
+     * Number of the given dimension, independent of the counter.
+     */
+    float at(uint32_t dimension) const {
+        switch (type_) {
+        case SamplerType::STRATIFIED:
+            return stratified(dimension);
+        case SamplerType::HALTON:
+            return halton(dimension);
+        case SamplerType::SOBOL:
+            return sobol(dimension);
+        default:
+            return rng_.at(dimension);
+        }
+    }
+
+    /**
+     * Number of the next dimension.
+     */
+    float operator()() { return at(dimension_++); }
+
+    uint32_t dimension() const { return dimension_; }
+    SamplerType type() const { return type_; }
+
+private:
+    // hash of the pixel and something else, e.g. a dimension
+    uint32_t hash(uint64_t value) const {
+        return static_cast<uint32_t>(
+            detail::mix64(key_ ^ detail::mix64(value)));
+    }
+
+    float stratified(uint32_t dimension) const {
+        const uint32_t batch = sample_ / num_samples_;
+        const uint32_t stratum = detail::permute(
+            sample_ % num_samples_, num_samples_,
+            hash((uint64_t(batch) << 32) | dimension));
+        return std::min((stratum + rng_.at(dimension)) / num_samples_,
+                        detail::ONE_MINUS_EPSILON);
+    }
+
+    float halton(uint32_t dimension) const {
+        if (dimension >= detail::NUM_HALTON_PRIMES) {
+            return rng_.at(dimension);
+        }
+        // Cranley-Patterson rotation
+        double value =
+            detail::radical_inverse(sample_, detail::HALTON_PRIMES[dimension]) +
+            detail::to_unit_float(hash(dimension));
+        value -= std::floor(value);
+        return std::min(static_cast<float>(value), detail::ONE_MINUS_EPSILON);
+    }
+
+    float sobol(uint32_t dimension) const {
+        const uint32_t pair_seed = hash(dimension / 2);
+        const uint32_t index =
+            detail::nested_uniform_scramble(sample_, pair_seed);
+        const uint32_t value = detail::nested_uniform_scramble(
+            detail::sobol(index, dimension % 2),
+            static_cast<uint32_t>(detail::mix64(pair_seed + dimension % 2)));
+        return detail::to_unit_float(value);
+    }
+
+    SamplerType type_;
+    CounterRng rng_;
+    uint64_t key_;
+    uint32_t sample_;
+    uint32_t num_samples_;
+    uint32_t dimension_ = 0;
+};
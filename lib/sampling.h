@@ -1,17 +1,49 @@
 #pragma once
 
+#include "sampler.h"
 #include "triangle.h"
 #include "types.h"
-#include "xorshift.h"
 
 #include <cmath>
 #include <tuple>
 
 namespace sampling {
 namespace detail {
-static __thread xorshift64star<float> uniform{4};
+// Numbers of the current sample of the calling thread, shared by all
+// translation units.
+inline Sampler& sampler() {
+    static thread_local Sampler sampler{SamplerType::RANDOM, 0, 0, 0, 1};
+    return sampler;
+}
 } // namespace detail
 
+/**
+ * Sampler of all samples started by start_sample. Set once at startup, e.g.
+ * from the options.
+ */
+inline SamplerType& sampler_type() {
+    static SamplerType type = SamplerType::SOBOL;
+    return type;
+}
+
+/**
+ * Start a sample of a pixel on the calling thread. The following numbers of
+ * uniform() and of the sampling functions depend only on seed, pixel and
+ * sample, i.e. not on the thread or on the order of the samples.
+ *
+ * num_samples is the number of samples of the pixel in a batch, cf. Sampler.
+ */
+inline void start_sample(uint64_t seed, uint64_t pixel, uint32_t sample,
+                         uint32_t num_samples) {
+    detail::sampler() =
+        Sampler(sampler_type(), seed, pixel, sample, num_samples);
+}
+
+/**
+ * Next number in [0, 1) of the current sample.
+ */
+inline float uniform() { return detail::sampler()(); }
+
 static constexpr float M_2PI = 2.f * M_PI;
 
 /**
@@ -19,8 +51,8 @@ static constexpr float M_2PI = 2.f * M_PI;
  */
 inline std::pair<Vector3f, float> hemisphere() {
     // draw coordinates
-    float u1 = detail::uniform();
-    float u2 = detail::uniform();
+    float u1 = uniform();
+    float u2 = uniform();
 
     // u1 is cos(theta)
     auto z = u1;
@@ -41,14 +73,16 @@ inline std::pair<Vector3f, float> hemisphere() {
  */
 inline Point3f triangle(const Point3f& pos, const Vector3f& u,
                         const Vector3f& v) {
-    while (true) {
-        float r1 = detail::uniform();
-        float r2 = detail::uniform();
+    float r1 = uniform();
+    float r2 = uniform();
 
-        if ((r1 + r2) <= 1.f) {
-            return pos + r1 * u + r2 * v;
-        }
+    // fold the other half of the parallelogram onto the triangle, so that a
+    // point takes exactly two dimensions of a sample
+    if (r1 + r2 > 1.f) {
+        r1 = 1.f - r1;
+        r2 = 1.f - r2;
     }
+    return pos + r1 * u + r2 * v;
 }
 
 /**
@@ -0,0 +1,293 @@
+/**
+ * Scene loading shared by all renderers.
+ *
+ * The scene is imported by Assimp and converted into our internal types:
+ * a triangle mesh with a material table, the camera and the lights. Cf.
+ * scene_file.h for the native format, which skips Assimp altogether.
+ */
+
+#pragma once
+
+#include "range.h"
+#include "runtime.h"
+#include "triangle.h"
+#include "types.h"
+
+#include <ThreadPool.h>
+#include <assimp/Importer.hpp>
+#include <assimp/postprocess.h>
+#include <assimp/scene.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <future>
+#include <limits>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/**
+ * Runtime of the phases of the scene loading in ms.
+ */
+struct SceneLoadTimes {
+    size_t import_ms = 0;  // Assimp import resp. reading the native file
+    size_t count_ms = 0;   // counting of vertices and faces
+    size_t convert_ms = 0; // conversion of meshes into TriangleMesh
+};
+
+inline std::ostream& operator<<(std::ostream& os, const SceneLoadTimes& t) {
+    return os << "Scene import   : " << 1.0 * t.import_ms / 1000 << " sec"
+              << std::endl
+              << "Scene count    : " << 1.0 * t.count_ms / 1000 << " sec"
+              << std::endl
+              << "Scene convert  : " << 1.0 * t.convert_ms / 1000 << " sec";
+}
+
+/**
+ * Import the scene with the post-processing needed by the renderers.
+ *
+ * @return scene owned by importer, or nullptr on error (cf.
+ *         importer.GetErrorString()).
+ */
+inline const aiScene* import_scene(Assimp::Importer& importer,
+                                   const std::string& filename,
+                                   SceneLoadTimes* times = nullptr) {
+    Runtime runtime;
+    const aiScene* scene = importer.ReadFile(
+        filename, aiProcess_CalcTangentSpace | aiProcess_Triangulate |
+                      aiProcess_JoinIdenticalVertices | aiProcess_GenNormals |
+                      aiProcess_SortByPType);
+    if (times) {
+        times->import_ms = runtime();
+    }
+    return scene;
+}
+
+/**
+ * Camera from its raw description and the transformation of its node.
+ *
+ * If the camera does not specify the aspect ratio, aspect is used; otherwise
+ * aspect is set to the one of the camera.
+ */
+inline Camera make_camera(const aiMatrix4x4& trafo, aiCamera cam,
+                          float& aspect) {
+    if (cam.mAspect > 0) {
+        aspect = cam.mAspect;
+    } else if (cam.mAspect == 0) {
+        cam.mAspect = aspect;
+    }
+    return Camera(trafo, cam);
+}
+
+/**
+ * Camera of the scene.
+ *
+ * We can deal only with a single camera. If the camera does not specify the
+ * aspect ratio, aspect is used; otherwise aspect is set to the one of the
+ * camera.
+ */
+inline Camera camera_from_scene(const aiScene* scene, float& aspect) {
+    assert(scene->mNumCameras == 1);
+    const auto& scene_cam = *scene->mCameras[0];
+    auto* cam_node = scene->mRootNode->FindNode(scene_cam.mName);
+    assert(cam_node != nullptr);
+    return make_camera(cam_node->mTransformation, scene_cam, aspect);
+}
+
+/**
+ * Lights of the scene in world coordinates.
+ *
+ * We can deal only with one single or no light at all.
+ */
+inline std::vector<Light> lights_from_scene(const aiScene* scene) {
+    assert(scene->mNumLights == 0 || scene->mNumLights == 1);
+    std::vector<Light> lights;
+    if (scene->mNumLights == 1) {
+        auto& raw_light = *scene->mLights[0];
+
+        auto* light_node = scene->mRootNode->FindNode(raw_light.mName);
+        assert(light_node != nullptr);
+        const auto& LT = light_node->mTransformation;
+        const auto& v = LT * aiVector3D();
+        lights.push_back(
+            {{v.x, v.y, v.z},
+             aiColor4D{raw_light.mColorDiffuse.r, raw_light.mColorDiffuse.g,
+                       raw_light.mColorDiffuse.b, 1}});
+    }
+    return lights;
+}
+
+/**
+ * Material table of the scene indexed by aiMesh::mMaterialIndex.
+ */
+inline Materials materials_from_scene(const aiScene* scene) {
+    assert(scene->mNumMaterials <=
+           static_cast<size_t>(std::numeric_limits<MaterialId>::max()) + 1);
+    Materials materials;
+    materials.reserve(scene->mNumMaterials);
+    for (auto material : make_range(scene->mMaterials, scene->mNumMaterials)) {
+        Material m;
+        material->Get(AI_MATKEY_COLOR_AMBIENT, m.ambient);
+        material->Get(AI_MATKEY_COLOR_DIFFUSE, m.diffuse);
+        material->Get(AI_MATKEY_COLOR_EMISSIVE, m.emissive);
+        material->Get(AI_MATKEY_COLOR_REFLECTIVE, m.reflective);
+        material->Get(AI_MATKEY_REFLECTIVITY, m.reflectivity);
+        materials.push_back(m);
+    }
+    return materials;
+}
+
+/**
+ * Convert all meshes attached to the children of the root node of the scene
+ * into a triangle mesh in world coordinates.
+ *
+ * The vertices and normals of an aiMesh are transformed once and shared by
+ * its faces. The material table of the mesh is the one of the scene, i.e. a
+ * face's material id is the material index of its aiMesh.
+ *
+ * First, we count all vertices and faces to compute the offset of each mesh
+ * in the buffers. Then, the meshes are converted in parallel in chunks of at
+ * most CHUNK_SIZE vertices resp. faces.
+ */
+inline TriangleMesh mesh_from_scene(const aiScene* scene,
+                                    size_t num_threads = 1,
+                                    SceneLoadTimes* times = nullptr) {
+    static constexpr size_t CHUNK_SIZE = 1 << 16;
+
+    // mesh attached to a node
+    struct Part {
+        const aiMesh* mesh;
+        const aiMatrix4x4* trafo;
+        size_t vertex_offset;
+        size_t face_offset;
+    };
+
+    TriangleMesh result(Triangles{}, materials_from_scene(scene));
+
+    // count
+    Runtime count_runtime;
+    std::vector<Part> parts;
+    size_t num_vertices = 0;
+    size_t num_faces = 0;
+    for (auto node : make_range(scene->mRootNode->mChildren,
+                                scene->mRootNode->mNumChildren)) {
+        for (auto mesh_index : make_range(node->mMeshes, node->mNumMeshes)) {
+            const auto* mesh = scene->mMeshes[mesh_index];
+            parts.push_back(
+                {mesh, &node->mTransformation, num_vertices, num_faces});
+            num_vertices += mesh->mNumVertices;
+            num_faces += mesh->mNumFaces;
+        }
+    }
+    assert(num_vertices <= std::numeric_limits<uint32_t>::max());
+    result.resize(num_vertices, num_faces);
+    if (times) {
+        times->count_ms = count_runtime();
+    }
+
+    // convert
+    Runtime convert_runtime;
+    {
+        ThreadPool pool(std::max<size_t>(num_threads, 1));
+        std::vector<std::future<void>> tasks;
+
+        for (const auto& part : parts) {
+            const auto& mesh = *part.mesh;
+
+            for (size_t begin = 0; begin < mesh.mNumVertices;
+                 begin += CHUNK_SIZE) {
+                size_t end =
+                    std::min<size_t>(begin + CHUNK_SIZE, mesh.mNumVertices);
+                tasks.emplace_back(pool.enqueue([&result, &part, begin, end]() {
+                    const auto& T = *part.trafo;
+                    const aiMatrix3x3 Tp(T); // trafo without translation
+                    for (size_t i = begin; i < end; ++i) {
+                        aiVector3D v = T * part.mesh->mVertices[i];
+                        aiVector3D n = Tp * part.mesh->mNormals[i];
+                        result.set_vertex(part.vertex_offset + i,
+                                          {v.x, v.y, v.z}, {n.x, n.y, n.z});
+                    }
+                }));
+            }
+
+            for (size_t begin = 0; begin < mesh.mNumFaces;
+                 begin += CHUNK_SIZE) {
+                size_t end =
+                    std::min<size_t>(begin + CHUNK_SIZE, mesh.mNumFaces);
+                tasks.emplace_back(pool.enqueue([&result, &part, begin, end]() {
+                    const uint32_t offset = part.vertex_offset;
+                    const MaterialId material_id = part.mesh->mMaterialIndex;
+                    for (size_t i = begin; i < end; ++i) {
+                        const aiFace& face = part.mesh->mFaces[i];
+                        assert(face.mNumIndices == 3);
+                        result.set_face(part.face_offset + i,
+                                        {offset + face.mIndices[0],
+                                         offset + face.mIndices[1],
+                                         offset + face.mIndices[2]},
+                                        material_id);
+                    }
+                }));
+            }
+        }
+
+        for (auto& task : tasks) {
+            task.get();
+        }
+    }
+    if (times) {
+        times->convert_ms = convert_runtime();
+    }
+
+    return result;
+}
+
+/**
+ * Spatially coherent part of the geometry of an out-of-core scene. Its
+ * triangles are stored in a kd-tree cache file with key (cf. kdtree_cache.h
+ * and chunked_kdtree.h); their global ids start at first_triangle.
+ */
+struct SceneChunk {
+    uint64_t key;
+    Bbox3f box;
+    uint32_t first_triangle;
+    uint32_t num_triangles;
+};
+
+/**
+ * Scene in our internal types.
+ *
+ * The camera is kept in its raw form, since the final camera depends on the
+ * aspect ratio configured by the user (cf. make_camera).
+ *
+ * The geometry of an out-of-core scene lives in chunks; then, the mesh only
+ * holds the material table.
+ */
+struct Scene {
+    TriangleMesh mesh;
+    aiMatrix4x4 camera_trafo;
+    aiCamera camera;
+    std::vector<Light> lights;
+    std::vector<SceneChunk> chunks;
+
+    Camera make_camera(float& aspect) const {
+        return ::make_camera(camera_trafo, camera, aspect);
+    }
+};
+
+/**
+ * Convert an imported scene into our internal types.
+ */
+inline Scene scene_from_assimp(const aiScene* scene, size_t num_threads = 1,
+                               SceneLoadTimes* times = nullptr) {
+    assert(scene->mNumCameras == 1);
+    const auto& scene_cam = *scene->mCameras[0];
+    auto* cam_node = scene->mRootNode->FindNode(scene_cam.mName);
+    assert(cam_node != nullptr);
+
+    Scene result;
+    result.mesh = mesh_from_scene(scene, num_threads, times);
+    result.camera_trafo = cam_node->mTransformation;
+    result.camera = scene_cam;
+    result.lights = lights_from_scene(scene);
+    return result;
+}
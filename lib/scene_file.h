@@ -0,0 +1,394 @@
+/**
+ * Native scene format.
+ *
+ * Importing a scene with Assimp (parsing, triangulation, joining of identical
+ * vertices, generation of normals) dominates the startup of the renderers for
+ * big scenes. turner-convert does this once and writes the result as flat
+ * binary arrays, which are mapped into memory and copied into the mesh
+ * without any parsing or post-processing.
+ *
+ * Layout:
+ *
+ *   SceneFileHeader
+ *   vertices      num_vertices  x float[3]
+ *   normals       num_vertices  x float[3]
+ *   faces         num_faces     x uint32_t[3]
+ *   material ids  num_faces     x uint16_t
+ *   materials     num_materials x float[17] (ambient, diffuse, emissive,
+ *                                            reflective, reflectivity)
+ *   lights        num_lights    x float[7]  (position, color)
+ *   chunks        num_chunks    x SceneFileChunk
+ *
+ * An out-of-core scene (cf. chunked_kdtree.h) has no vertices and faces;
+ * its geometry is stored in the kd-trees of its chunks in the directory
+ * scene_chunk_dir(filename).
+ *
+ * Each array starts at its offset stored in the header, aligned to
+ * MAPPED_ARRAY_ALIGNMENT bytes. All values are in the byte order of the host
+ * which wrote the file; files of the other byte order are rejected.
+ */
+
+#pragma once
+
+#include "mapped_file.h"
+#include "runtime.h"
+#include "scene.h"
+#include "triangle.h"
+#include "types.h"
+
+#include <assimp/Importer.hpp>
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <ostream>
+#include <string>
+#include <vector>
+
+static constexpr char SCENE_FILE_MAGIC[8] = {'T', 'U', 'R', 'N',
+                                             'E', 'R', 'S', 'C'};
+static constexpr uint32_t SCENE_FILE_VERSION = 2;
+static constexpr uint32_t SCENE_FILE_BYTE_ORDER = 0x01020304;
+
+struct SceneFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+
+    uint64_t num_vertices;
+    uint64_t num_faces;
+    uint64_t num_materials;
+    uint64_t num_lights;
+    uint64_t num_chunks;
+
+    uint64_t vertices_offset;
+    uint64_t normals_offset;
+    uint64_t faces_offset;
+    uint64_t material_ids_offset;
+    uint64_t materials_offset;
+    uint64_t lights_offset;
+    uint64_t chunks_offset;
+    uint64_t file_size;
+
+    // camera node transformation (row-major) and parameters of the trivial
+    // camera (cf. Camera)
+    float camera_trafo[16];
+    float camera_fov;
+    float camera_near;
+    float camera_far;
+    float camera_aspect;
+};
+
+struct SceneFileChunk {
+    uint64_t key;
+    float box_min[3];
+    float box_max[3];
+    uint32_t first_triangle;
+    uint32_t num_triangles;
+};
+
+static_assert(sizeof(SceneFileChunk) == 40, "chunks are stored packed");
+static_assert(sizeof(TriangleMesh::Face) == 3 * sizeof(uint32_t),
+              "faces are stored as packed uint32_t[3]");
+
+namespace detail {
+
+inline void push_color(std::vector<float>& out, const aiColor4D& c) {
+    out.insert(out.end(), {c.r, c.g, c.b, c.a});
+}
+
+inline aiColor4D read_color(const float* in) {
+    return {in[0], in[1], in[2], in[3]};
+}
+
+} // namespace detail
+
+/**
+ * Directory of the chunks of the out-of-core scene stored in filename.
+ */
+inline std::string scene_chunk_dir(const std::string& filename) {
+    return filename + ".chunks";
+}
+
+/**
+ * Check the magic number at the beginning of the file.
+ */
+inline bool is_scene_file(const std::string& filename) {
+    std::ifstream file(filename, std::ios::binary);
+    char magic[sizeof(SCENE_FILE_MAGIC)];
+    return file.read(magic, sizeof(magic)) &&
+           std::memcmp(magic, SCENE_FILE_MAGIC, sizeof(magic)) == 0;
+}
+
+/**
+ * Write the scene in the native format.
+ */
+inline void write_scene_file(std::ostream& os, const Scene& scene) {
+    const auto& mesh = scene.mesh;
+
+    SceneFileHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, SCENE_FILE_MAGIC, sizeof(header.magic));
+    header.version = SCENE_FILE_VERSION;
+    header.byte_order = SCENE_FILE_BYTE_ORDER;
+    header.num_vertices = mesh.vertices().size();
+    header.num_faces = mesh.size();
+    header.num_materials = mesh.materials().size();
+    header.num_lights = scene.lights.size();
+    header.num_chunks = scene.chunks.size();
+
+    using detail::align_offset;
+    header.vertices_offset = align_offset(sizeof(header));
+    header.normals_offset = align_offset(header.vertices_offset +
+                                         header.num_vertices * 3 * 4);
+    header.faces_offset =
+        align_offset(header.normals_offset + header.num_vertices * 3 * 4);
+    header.material_ids_offset =
+        align_offset(header.faces_offset + header.num_faces * 3 * 4);
+    header.materials_offset =
+        align_offset(header.material_ids_offset + header.num_faces * 2);
+    header.lights_offset =
+        align_offset(header.materials_offset + header.num_materials * 17 * 4);
+    header.chunks_offset =
+        align_offset(header.lights_offset + header.num_lights * 7 * 4);
+    header.file_size =
+        header.chunks_offset + header.num_chunks * sizeof(SceneFileChunk);
+
+    const auto& T = scene.camera_trafo;
+    const float trafo[16] = {T.a1, T.a2, T.a3, T.a4, T.b1, T.b2, T.b3, T.b4,
+                             T.c1, T.c2, T.c3, T.c4, T.d1, T.d2, T.d3, T.d4};
+    std::memcpy(header.camera_trafo, trafo, sizeof(trafo));
+    header.camera_fov = scene.camera.mHorizontalFOV;
+    header.camera_near = scene.camera.mClipPlaneNear;
+    header.camera_far = scene.camera.mClipPlaneFar;
+    header.camera_aspect = scene.camera.mAspect;
+
+    // Point3f and Normal3f may be padded (cf. TURNER_SIMD), so we pack them.
+    std::vector<float> vertices, normals;
+    vertices.reserve(3 * header.num_vertices);
+    normals.reserve(3 * header.num_vertices);
+    for (const auto& v : mesh.vertices()) {
+        vertices.insert(vertices.end(), {v.x, v.y, v.z});
+    }
+    for (const auto& n : mesh.normals()) {
+        normals.insert(normals.end(), {n.x, n.y, n.z});
+    }
+
+    std::vector<float> materials;
+    materials.reserve(17 * header.num_materials);
+    for (const auto& m : mesh.materials()) {
+        detail::push_color(materials, m.ambient);
+        detail::push_color(materials, m.diffuse);
+        detail::push_color(materials, m.emissive);
+        detail::push_color(materials, m.reflective);
+        materials.push_back(m.reflectivity);
+    }
+
+    std::vector<float> lights;
+    lights.reserve(7 * header.num_lights);
+    for (const auto& light : scene.lights) {
+        const auto& p = light.position;
+        lights.insert(lights.end(), {p.x, p.y, p.z});
+        detail::push_color(lights, light.color);
+    }
+
+    std::vector<SceneFileChunk> chunks;
+    chunks.reserve(header.num_chunks);
+    for (const auto& chunk : scene.chunks) {
+        const auto& b = chunk.box;
+        chunks.push_back({chunk.key,
+                          {b.p_min.x, b.p_min.y, b.p_min.z},
+                          {b.p_max.x, b.p_max.y, b.p_max.z},
+                          chunk.first_triangle,
+                          chunk.num_triangles});
+    }
+
+    os.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    uint64_t pos = sizeof(header);
+    detail::write_array(os, pos, header.vertices_offset, vertices);
+    detail::write_array(os, pos, header.normals_offset, normals);
+    detail::write_array(os, pos, header.faces_offset, mesh.faces());
+    detail::write_array(os, pos, header.material_ids_offset,
+                        mesh.material_ids());
+    detail::write_array(os, pos, header.materials_offset, materials);
+    detail::write_array(os, pos, header.lights_offset, lights);
+    detail::write_array(os, pos, header.chunks_offset, chunks);
+    assert(pos == header.file_size);
+}
+
+/**
+ * Read a scene in the native format by mapping it into memory.
+ *
+ * @return false and an error message if the file cannot be read or is not a
+ *         valid scene file of this version.
+ */
+inline bool read_scene_file(const std::string& filename, Scene& scene,
+                            std::string& error) {
+    MappedFile file(filename);
+    if (!file) {
+        error = "Cannot map scene file " + filename;
+        return false;
+    }
+
+    SceneFileHeader header;
+    if (file.size() < sizeof(header)) {
+        error = "Scene file too small: " + filename;
+        return false;
+    }
+    std::memcpy(&header, file.data(), sizeof(header));
+    if (std::memcmp(header.magic, SCENE_FILE_MAGIC, sizeof(header.magic))) {
+        error = "Not a scene file: " + filename;
+        return false;
+    }
+    if (header.byte_order != SCENE_FILE_BYTE_ORDER) {
+        error = "Scene file has wrong byte order: " + filename;
+        return false;
+    }
+    if (header.version != SCENE_FILE_VERSION) {
+        error = "Unsupported scene file version " +
+                std::to_string(header.version) + ": " + filename;
+        return false;
+    }
+    // every array has to be aligned and inside of the file
+    auto fits = [&file](uint64_t offset, uint64_t count, uint64_t item_size) {
+        return detail::is_aligned(offset) && offset <= file.size() &&
+               count <= (file.size() - offset) / item_size;
+    };
+    if (header.file_size != file.size() ||
+        !fits(header.vertices_offset, header.num_vertices, 3 * 4) ||
+        !fits(header.normals_offset, header.num_vertices, 3 * 4) ||
+        !fits(header.faces_offset, header.num_faces, 3 * 4) ||
+        !fits(header.material_ids_offset, header.num_faces, 2) ||
+        !fits(header.materials_offset, header.num_materials, 17 * 4) ||
+        !fits(header.lights_offset, header.num_lights, 7 * 4) ||
+        !fits(header.chunks_offset, header.num_chunks,
+              sizeof(SceneFileChunk)) ||
+        (header.num_chunks > 0 && header.num_faces > 0) ||
+        header.num_vertices > std::numeric_limits<uint32_t>::max() ||
+        header.num_materials >
+            static_cast<size_t>(std::numeric_limits<MaterialId>::max()) + 1) {
+        error = "Scene file is corrupt: " + filename;
+        return false;
+    }
+
+    const char* data = file.data();
+    const auto* vertices =
+        reinterpret_cast<const float*>(data + header.vertices_offset);
+    const auto* normals =
+        reinterpret_cast<const float*>(data + header.normals_offset);
+    const auto* faces = reinterpret_cast<const TriangleMesh::Face*>(
+        data + header.faces_offset);
+    const auto* material_ids =
+        reinterpret_cast<const MaterialId*>(data + header.material_ids_offset);
+    const auto* materials =
+        reinterpret_cast<const float*>(data + header.materials_offset);
+    const auto* lights =
+        reinterpret_cast<const float*>(data + header.lights_offset);
+    const auto* chunks =
+        reinterpret_cast<const SceneFileChunk*>(data + header.chunks_offset);
+
+    Materials table;
+    table.reserve(header.num_materials);
+    for (size_t i = 0; i < header.num_materials; ++i) {
+        const float* m = materials + 17 * i;
+        table.push_back({detail::read_color(m), detail::read_color(m + 4),
+                         detail::read_color(m + 8), detail::read_color(m + 12),
+                         m[16]});
+    }
+
+    TriangleMesh mesh(Triangles{}, std::move(table));
+    mesh.resize(header.num_vertices, header.num_faces);
+    for (size_t i = 0; i < header.num_vertices; ++i) {
+        const float* v = vertices + 3 * i;
+        const float* n = normals + 3 * i;
+        mesh.set_vertex(i, {v[0], v[1], v[2]}, {n[0], n[1], n[2]});
+    }
+    for (size_t i = 0; i < header.num_faces; ++i) {
+        const auto& f = faces[i];
+        if (f[0] >= header.num_vertices || f[1] >= header.num_vertices ||
+            f[2] >= header.num_vertices ||
+            material_ids[i] >= header.num_materials) {
+            error = "Scene file is corrupt: " + filename;
+            return false;
+        }
+        mesh.set_face(i, f, material_ids[i]);
+    }
+
+    std::vector<Light> scene_lights;
+    scene_lights.reserve(header.num_lights);
+    for (size_t i = 0; i < header.num_lights; ++i) {
+        const float* l = lights + 7 * i;
+        scene_lights.push_back(
+            {{l[0], l[1], l[2]}, detail::read_color(l + 3)});
+    }
+
+    // chunks have to number the triangles consecutively
+    std::vector<SceneChunk> scene_chunks;
+    scene_chunks.reserve(header.num_chunks);
+    uint64_t num_triangles = 0;
+    for (size_t i = 0; i < header.num_chunks; ++i) {
+        const auto& c = chunks[i];
+        if (c.first_triangle != num_triangles || c.num_triangles == 0) {
+            error = "Scene file is corrupt: " + filename;
+            return false;
+        }
+        num_triangles += c.num_triangles;
+        scene_chunks.push_back(
+            {c.key,
+             Bbox3f({c.box_min[0], c.box_min[1], c.box_min[2]},
+                    {c.box_max[0], c.box_max[1], c.box_max[2]}),
+             c.first_triangle, c.num_triangles});
+    }
+    if (num_triangles > std::numeric_limits<uint32_t>::max()) {
+        error = "Scene file is corrupt: " + filename;
+        return false;
+    }
+
+    const float* t = header.camera_trafo;
+    scene.mesh = std::move(mesh);
+    scene.camera_trafo =
+        aiMatrix4x4(t[0], t[1], t[2], t[3], t[4], t[5], t[6], t[7], t[8], t[9],
+                    t[10], t[11], t[12], t[13], t[14], t[15]);
+    // Only trivial cameras are stored (cf. Camera), while the default of
+    // aiCamera looks along +z.
+    scene.camera = aiCamera();
+    scene.camera.mPosition = aiVector3D(0, 0, 0);
+    scene.camera.mUp = aiVector3D(0, 1, 0);
+    scene.camera.mLookAt = aiVector3D(0, 0, -1);
+    scene.camera.mHorizontalFOV = header.camera_fov;
+    scene.camera.mClipPlaneNear = header.camera_near;
+    scene.camera.mClipPlaneFar = header.camera_far;
+    scene.camera.mAspect = header.camera_aspect;
+    scene.lights = std::move(scene_lights);
+    scene.chunks = std::move(scene_chunks);
+    return true;
+}
+
+/**
+ * Load a scene either in the native format or in any format supported by
+ * Assimp.
+ *
+ * @return false and an error message if the scene cannot be loaded.
+ */
+inline bool load_scene(const std::string& filename, Scene& scene,
+                       std::string& error, size_t num_threads = 1,
+                       SceneLoadTimes* times = nullptr) {
+    if (is_scene_file(filename)) {
+        Runtime runtime;
+        bool ok = read_scene_file(filename, scene, error);
+        if (times) {
+            times->import_ms = runtime();
+        }
+        return ok;
+    }
+
+    Assimp::Importer importer;
+    const aiScene* raw_scene = import_scene(importer, filename, times);
+    if (!raw_scene) {
+        error = importer.GetErrorString();
+        return false;
+    }
+    scene = scene_from_assimp(raw_scene, num_threads, times);
+    return true;
+}
@@ -1,6 +1,152 @@
 #pragma once
 
+#include "memory.h"
+
+#include <algorithm>
+#include <array>
 #include <atomic>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+enum class RayType : size_t {
+    PRIMARY = 0, // from the camera
+    SHADOW,      // towards a light
+    INDIRECT,    // reflected or sampled at a hit point
+    FORM_FACTOR, // visibility between two patches in radiosity
+};
+
+static constexpr size_t NUM_RAY_TYPES = 4;
+
+inline const char* to_string(RayType type) {
+    switch (type) {
+    case RayType::PRIMARY:
+        return "primary";
+    case RayType::SHADOW:
+        return "shadow";
+    case RayType::INDIRECT:
+        return "indirect";
+    default:
+        return "form_factor";
+    }
+}
+
+/**
+ * Ray counters by type and by path depth.
+ *
+ * A primary or indirect ray hits if it hits a triangle. A visibility ray
+ * (shadow, form factor) hits if it is occluded.
+ */
+struct RayStats {
+    // rays starting at a deeper path vertex are counted in the last bucket
+    static constexpr size_t MAX_DEPTH = 16;
+
+    std::array<size_t, NUM_RAY_TYPES> rays{};
+    std::array<size_t, NUM_RAY_TYPES> hits{};
+    // rays of the tracers by depth of the path vertex they start at
+    std::array<size_t, MAX_DEPTH> by_depth{};
+
+    size_t num_rays() const {
+        size_t num = 0;
+        for (size_t n : rays) {
+            num += n;
+        }
+        return num;
+    }
+    size_t num_rays(RayType type) const {
+        return rays[static_cast<size_t>(type)];
+    }
+    size_t num_hits(RayType type) const {
+        return hits[static_cast<size_t>(type)];
+    }
+    // fraction of hits in [0, 1], or 0 if no ray of the type was cast
+    double hit_rate(RayType type) const {
+        return num_rays(type) ? 1.0 * num_hits(type) / num_rays(type) : 0;
+    }
+
+    RayStats& operator+=(const RayStats& other) {
+        for (size_t i = 0; i < NUM_RAY_TYPES; ++i) {
+            rays[i] += other.rays[i];
+            hits[i] += other.hits[i];
+        }
+        for (size_t i = 0; i < MAX_DEPTH; ++i) {
+            by_depth[i] += other.by_depth[i];
+        }
+        return *this;
+    }
+};
+
+/**
+ * Ray counters of a single thread, cf. Stats::local().
+ *
+ * Only the owning thread writes the counters, so an increment is a plain
+ * load and store instead of an atomic read-modify-write on a cache line
+ * shared by all threads. The counters are still atomics, such that Stats can
+ * read them at any time.
+ */
+class alignas(64) StatsShard {
+public:
+    StatsShard() {
+        for (auto& counter : rays_) {
+            counter.store(0, std::memory_order_relaxed);
+        }
+        for (auto& counter : hits_) {
+            counter.store(0, std::memory_order_relaxed);
+        }
+        for (auto& counter : by_depth_) {
+            counter.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    StatsShard(const StatsShard&) = delete;
+    StatsShard& operator=(const StatsShard&) = delete;
+
+    /**
+     * Count a ray of a tracer starting at a path vertex of the given depth
+     * (0 for the camera).
+     */
+    void count_ray(RayType type, int depth, bool hit) {
+        const auto i = static_cast<size_t>(type);
+        add(rays_[i], 1);
+        add(hits_[i], hit);
+        add(by_depth_[std::min(static_cast<size_t>(depth),
+                               RayStats::MAX_DEPTH - 1)],
+            1);
+    }
+
+    /**
+     * Count rays without a path depth, e.g. form factor rays.
+     */
+    void count_rays(RayType type, size_t num_rays, size_t num_hits) {
+        const auto i = static_cast<size_t>(type);
+        add(rays_[i], num_rays);
+        add(hits_[i], num_hits);
+    }
+
+    RayStats snapshot() const {
+        RayStats stats;
+        for (size_t i = 0; i < NUM_RAY_TYPES; ++i) {
+            stats.rays[i] = rays_[i].load(std::memory_order_relaxed);
+            stats.hits[i] = hits_[i].load(std::memory_order_relaxed);
+        }
+        for (size_t i = 0; i < RayStats::MAX_DEPTH; ++i) {
+            stats.by_depth[i] = by_depth_[i].load(std::memory_order_relaxed);
+        }
+        return stats;
+    }
+
+private:
+    static void add(std::atomic<size_t>& counter, size_t n) {
+        counter.store(counter.load(std::memory_order_relaxed) + n,
+                      std::memory_order_relaxed);
+    }
+
+private:
+    std::array<std::atomic<size_t>, NUM_RAY_TYPES> rays_;
+    std::array<std::atomic<size_t>, NUM_RAY_TYPES> hits_;
+    std::array<std::atomic<size_t>, RayStats::MAX_DEPTH> by_depth_;
+};
 
 class Stats {
 public:
@@ -9,15 +155,85 @@ public:
         return instance;
     }
 
+    /**
+     * Ray counters of the calling thread.
+     */
+    static StatsShard& local() {
+        thread_local Registration registration;
+        return registration.shard;
+    }
+
+    /**
+     * Bytes held by the subsystems of the renderers (0 if not used).
+     */
+    struct Memory {
+        size_t triangles = 0;      // triangle meshes
+        size_t kdtree = 0;         // kd-tree nodes and intersector data
+        size_t framebuffer = 0;    // image and heatmap
+        size_t radiosity_mesh = 0; // OpenMesh mesh of hierarchical radiosity
+        size_t hierarchy = 0;      // Quadnode hierarchy
+        size_t links = 0;          // links between Quadnodes
+        size_t matrix = 0;         // dense matrices of exact radiosity
+    };
+
+    /**
+     * Record the peak RSS of the phase which ends now, and reset the peak, so
+     * that the next phase gets its own.
+     */
+    void end_phase(const std::string& name) {
+        peak_rss.emplace_back(name, peak_rss_bytes());
+        reset_peak_rss();
+    }
+
+    /**
+     * Ray counters summed over the shards of all threads, including the
+     * threads which already exited.
+     */
+    RayStats rays() const {
+        std::lock_guard<std::mutex> lock(shards_mutex_);
+        RayStats stats = retired_;
+        for (const auto* shard : shards_) {
+            stats += shard->snapshot();
+        }
+        return stats;
+    }
+
+    size_t num_rays() const { return rays().num_rays(); }
+    size_t num_prim_rays() const { return rays().num_rays(RayType::PRIMARY); }
+
     size_t num_triangles;
     size_t kdtree_height;
-    std::atomic<size_t> num_rays;      // all rays
-    std::atomic<size_t> num_prim_rays; // primary rays
     size_t runtime_ms;
     size_t loading_time_ms;
+    Memory memory;
+    // peak RSS in bytes per phase in the order of the phases
+    std::vector<std::pair<std::string, size_t>> peak_rss;
 
 private:
+    // Registers the shard of a thread for the lifetime of the thread, and
+    // keeps its counts when the thread exits.
+    struct Registration {
+        Registration() {
+            auto& stats = Stats::instance();
+            std::lock_guard<std::mutex> lock(stats.shards_mutex_);
+            stats.shards_.push_back(&shard);
+        }
+        ~Registration() {
+            auto& stats = Stats::instance();
+            std::lock_guard<std::mutex> lock(stats.shards_mutex_);
+            stats.retired_ += shard.snapshot();
+            stats.shards_.erase(
+                std::find(stats.shards_.begin(), stats.shards_.end(), &shard));
+        }
+
+        StatsShard shard;
+    };
+
     Stats() {}
     Stats(const Stats&) = delete;
     Stats operator=(const Stats&) = delete;
+
+    mutable std::mutex shards_mutex_;
+    std::vector<const StatsShard*> shards_;
+    RayStats retired_;
 };
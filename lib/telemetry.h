@@ -0,0 +1,288 @@
+/**
+ * Live telemetry of a render (cf. --telemetry).
+ *
+ * A thread of the telemetry writes a JSON line every interval, so that a
+ * dashboard can follow the throughput of a render and spot stragglers without
+ * parsing the progress bars on stderr:
+ *
+ *   {"event": "progress", "time_s": 12.000, "label": "frame0003",
+ *    "phase": "Pass 2", "tiles": 40, "total": 100, "eta_s": 18.000,
+ *    "rays_per_s": {"primary": 1200000, "shadow": 800000, "indirect": 0,
+ *                   "form_factor": 0},
+ *    "rss_bytes": 123456789,
+ *    "threads": [{"busy_s": 11.500, "idle_s": 0.500, "tiles": 20}, ...]}
+ *
+ * The last line, written on destruction, is the same with "event": "done".
+ * Rays per second are measured since the previous line, busy and idle time of
+ * a render thread since the start of the telemetry. The ETA is the one of the
+ * current phase (a preview level or a pass), extrapolated from its completed
+ * tiles, or the time until the deadline of a progressive render; it is null
+ * before the first tile of a phase is done. Phases of radiosity which do not
+ * render tiles count their steps instead, e.g. the patches whose form factors
+ * are computed or the iterations of the solver.
+ */
+
+#pragma once
+
+#include "json.h"
+#include "memory.h"
+#include "stats.h"
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+
+class Telemetry {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    /**
+     * Busy time of a render thread from construction to destruction, e.g.
+     * while it renders a tile. Nothing is measured without a telemetry.
+     */
+    class Busy {
+    public:
+        Busy(Telemetry* telemetry, size_t worker)
+            : telemetry_(telemetry), worker_(worker) {
+            if (telemetry_) {
+                telemetry_->begin_busy(worker_);
+            }
+        }
+        ~Busy() {
+            if (telemetry_) {
+                telemetry_->end_busy(worker_);
+            }
+        }
+
+        Busy(const Busy&) = delete;
+        Busy& operator=(const Busy&) = delete;
+
+    private:
+        Telemetry* telemetry_;
+        size_t worker_;
+    };
+
+    Telemetry(std::ostream& out, size_t num_workers,
+              std::chrono::milliseconds interval)
+        : out_(out), num_workers_(num_workers), interval_(interval),
+          workers_(new Worker[num_workers]), start_(Clock::now()),
+          phase_start_(start_), deadline_(Clock::time_point::max()),
+          last_time_(start_), last_rays_(Stats::instance().rays()) {
+        assert(num_workers > 0);
+        assert(interval.count() > 0);
+        thread_ = std::thread([this]() {
+            std::unique_lock<std::mutex> lock(mutex_);
+            while (!cv_.wait_for(lock, interval_,
+                                 [this]() { return stopped_; })) {
+                write("progress");
+            }
+        });
+    }
+
+    ~Telemetry() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopped_ = true;
+        }
+        cv_.notify_one();
+        thread_.join();
+        std::lock_guard<std::mutex> lock(mutex_);
+        write("done");
+    }
+
+    Telemetry(const Telemetry&) = delete;
+    Telemetry& operator=(const Telemetry&) = delete;
+
+    /**
+     * Label of the following lines, e.g. the frame of a batch or the job of
+     * the daemon.
+     */
+    void set_label(const std::string& label) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        label_ = label;
+    }
+
+    /**
+     * Start a phase of num_tiles tiles, which lasts until deadline if the
+     * render is progressive.
+     */
+    void start_phase(const std::string& phase, size_t num_tiles,
+                     Clock::time_point deadline = Clock::time_point::max()) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        phase_ = phase;
+        tiles_ = 0;
+        total_ = num_tiles;
+        phase_start_ = Clock::now();
+        deadline_ = deadline;
+    }
+
+    void set_completed(size_t tiles) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        tiles_ = tiles;
+    }
+
+private:
+    // Busy time of a render thread. Guarded by its own mutex, which is only
+    // contended once per line, so that a line never sees a busy period both
+    // completed and current.
+    struct Worker {
+        std::mutex mutex;
+        // busy time of the completed busy periods
+        int64_t busy_ns = 0;
+        // start of the current busy period since start_, or -1 if idle
+        int64_t busy_since_ns = -1;
+        size_t tiles = 0;
+    };
+
+    int64_t elapsed_ns(Clock::time_point time) const {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(time -
+                                                                    start_)
+            .count();
+    }
+
+    void begin_busy(size_t worker) {
+        assert(worker < num_workers_);
+        Worker& w = workers_[worker];
+        const int64_t now_ns = elapsed_ns(Clock::now());
+        std::lock_guard<std::mutex> lock(w.mutex);
+        w.busy_since_ns = now_ns;
+    }
+
+    void end_busy(size_t worker) {
+        assert(worker < num_workers_);
+        Worker& w = workers_[worker];
+        const int64_t now_ns = elapsed_ns(Clock::now());
+        std::lock_guard<std::mutex> lock(w.mutex);
+        w.busy_ns += now_ns - w.busy_since_ns;
+        w.busy_since_ns = -1;
+        w.tiles += 1;
+    }
+
+    static std::string seconds(int64_t ns) {
+        char s[32];
+        std::snprintf(s, sizeof(s), "%.3f", ns * 1e-9);
+        return s;
+    }
+
+    // Write a line. Called with mutex_ locked.
+    void write(const char* event) {
+        const auto now = Clock::now();
+        const int64_t time_ns = elapsed_ns(now);
+
+        const bool has_deadline = deadline_ != Clock::time_point::max();
+        std::string eta = "null";
+        if (tiles_ > 0 || has_deadline) {
+            int64_t eta_ns = 0;
+            if (tiles_ > 0) {
+                const int64_t phase_ns = time_ns - elapsed_ns(phase_start_);
+                const size_t remaining = total_ - std::min(tiles_, total_);
+                eta_ns = phase_ns * static_cast<int64_t>(remaining) /
+                         static_cast<int64_t>(tiles_);
+            }
+            if (has_deadline) {
+                eta_ns = std::max(eta_ns, elapsed_ns(deadline_) - time_ns);
+            }
+            eta = seconds(eta_ns);
+        }
+
+        const RayStats rays = Stats::instance().rays();
+        const double interval_s =
+            std::chrono::duration<double>(now - last_time_).count();
+        std::string rays_per_s;
+        for (size_t i = 0; i < NUM_RAY_TYPES; ++i) {
+            const double rate =
+                interval_s > 0
+                    ? (rays.rays[i] - last_rays_.rays[i]) / interval_s
+                    : 0;
+            char value[32];
+            std::snprintf(value, sizeof(value), "%.0f", rate);
+            rays_per_s += std::string(i > 0 ? ", " : "") +
+                          json_string(to_string(static_cast<RayType>(i))) +
+                          ": " + value;
+        }
+        last_time_ = now;
+        last_rays_ = rays;
+
+        std::string threads;
+        for (size_t i = 0; i < num_workers_; ++i) {
+            Worker& w = workers_[i];
+            int64_t busy_ns;
+            size_t tiles;
+            {
+                std::lock_guard<std::mutex> lock(w.mutex);
+                const int64_t since = w.busy_since_ns;
+                busy_ns = w.busy_ns +
+                          (since >= 0 ? std::max<int64_t>(time_ns - since, 0)
+                                      : 0);
+                tiles = w.tiles;
+            }
+            threads += std::string(i > 0 ? ", " : "") + "{\"busy_s\": " +
+                       seconds(busy_ns) + ", \"idle_s\": " +
+                       seconds(std::max<int64_t>(time_ns - busy_ns, 0)) +
+                       ", \"tiles\": " + std::to_string(tiles) + "}";
+        }
+
+        out_ << "{\"event\": " << json_string(event)
+             << ", \"time_s\": " << seconds(time_ns)
+             << ", \"label\": " << json_string(label_)
+             << ", \"phase\": " << json_string(phase_)
+             << ", \"tiles\": " << tiles_ << ", \"total\": " << total_
+             << ", \"eta_s\": " << eta << ", \"rays_per_s\": {" << rays_per_s
+             << "}, \"rss_bytes\": " << current_rss_bytes()
+             << ", \"threads\": [" << threads << "]}" << std::endl;
+    }
+
+private:
+    std::ostream& out_;
+    const size_t num_workers_;
+    const std::chrono::milliseconds interval_;
+    std::unique_ptr<Worker[]> workers_;
+    const Clock::time_point start_;
+
+    // guards the state of the phase and the output
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    bool stopped_ = false;
+    std::string label_;
+    std::string phase_;
+    size_t tiles_ = 0;
+    size_t total_ = 0;
+    Clock::time_point phase_start_;
+    Clock::time_point deadline_;
+    Clock::time_point last_time_;
+    RayStats last_rays_;
+
+    std::thread thread_;
+};
+
+/**
+ * Telemetry of num_workers render threads written to file at path every
+ * interval_s seconds, or nullptr if path is empty or cannot be opened.
+ */
+inline std::unique_ptr<Telemetry> open_telemetry(const std::string& path,
+                                                 float interval_s,
+                                                 size_t num_workers,
+                                                 std::ofstream& file) {
+    if (path.empty()) {
+        return nullptr;
+    }
+    file.open(path);
+    if (!file) {
+        std::cerr << "Cannot write telemetry to " << path << std::endl;
+        return nullptr;
+    }
+    const auto interval_ms = static_cast<int64_t>(interval_s * 1000);
+    return std::unique_ptr<Telemetry>(
+        new Telemetry(file, num_workers,
+                      std::chrono::milliseconds(std::max<int64_t>(
+                          interval_ms, 1))));
+}
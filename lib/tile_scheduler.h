@@ -0,0 +1,225 @@
+/**
+ * Tile-based render scheduler with work stealing.
+ *
+ * The image is split into square tiles, which are ordered along a Morton
+ * (Z-order) curve, so that consecutive tiles are close on screen and hence
+ * traverse similar parts of the scene. Every worker thread gets a contiguous
+ * range of the ordered tiles in its own deque and renders them front to
+ * back. A worker running out of tiles steals from the back of the deque of
+ * another worker, i.e. the tiles farthest from where that worker currently
+ * renders.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * Rectangle [x0, x1) x [y0, y1) of pixels.
+ */
+struct Tile {
+    size_t x0, y0, x1, y1;
+
+    size_t width() const { return x1 - x0; }
+    size_t height() const { return y1 - y0; }
+    size_t size() const { return width() * height(); }
+};
+
+/**
+ * Pixels in both a and b. Empty if they do not overlap.
+ */
+inline Tile intersect(const Tile& a, const Tile& b) {
+    const size_t x0 = std::max(a.x0, b.x0);
+    const size_t y0 = std::max(a.y0, b.y0);
+    return {x0, y0, std::max(x0, std::min(a.x1, b.x1)),
+            std::max(y0, std::min(a.y1, b.y1))};
+}
+
+namespace detail {
+
+// Spread the lower 32 bits of x to the even bits.
+inline uint64_t spread_bits(uint64_t x) {
+    x &= 0xffffffffull;
+    x = (x | (x << 16)) & 0x0000ffff0000ffffull;
+    x = (x | (x << 8)) & 0x00ff00ff00ff00ffull;
+    x = (x | (x << 4)) & 0x0f0f0f0f0f0f0f0full;
+    x = (x | (x << 2)) & 0x3333333333333333ull;
+    x = (x | (x << 1)) & 0x5555555555555555ull;
+    return x;
+}
+
+} // namespace detail
+
+/**
+ * Position of (x, y) on the Morton curve.
+ */
+inline uint64_t morton_code(uint32_t x, uint32_t y) {
+    return detail::spread_bits(x) | (detail::spread_bits(y) << 1);
+}
+
+/**
+ * Tiles of at most tile_size x tile_size pixels covering the image, in
+ * Morton order.
+ */
+inline std::vector<Tile> make_tiles(size_t width, size_t height,
+                                    size_t tile_size) {
+    assert(tile_size > 0);
+    std::vector<std::pair<uint64_t, Tile>> ordered;
+    for (size_t y = 0; y < height; y += tile_size) {
+        for (size_t x = 0; x < width; x += tile_size) {
+            ordered.push_back(
+                {morton_code(x / tile_size, y / tile_size),
+                 {x, y, std::min(x + tile_size, width),
+                  std::min(y + tile_size, height)}});
+        }
+    }
+    std::sort(ordered.begin(), ordered.end(),
+              [](const std::pair<uint64_t, Tile>& a,
+                 const std::pair<uint64_t, Tile>& b) {
+                  return a.first < b.first;
+              });
+
+    std::vector<Tile> tiles;
+    tiles.reserve(ordered.size());
+    for (const auto& tile : ordered) {
+        tiles.push_back(tile.second);
+    }
+    return tiles;
+}
+
+/**
+ * Renders tiles on a fixed number of worker threads with work stealing.
+ *
+ * A scheduler renders its tiles once; create a new one for every image.
+ */
+class TileScheduler {
+public:
+    TileScheduler(std::vector<Tile> tiles, size_t num_workers)
+        : num_tiles_(tiles.size()) {
+        assert(num_workers > 0);
+        for (size_t i = 0; i < num_workers; ++i) {
+            queues_.emplace_back(new Queue);
+        }
+        // contiguous ranges of the Morton order, so that each worker starts
+        // in its own region of the image
+        for (size_t i = 0; i < tiles.size(); ++i) {
+            queues_[i * num_workers / tiles.size()]->tiles.push_back(tiles[i]);
+        }
+    }
+
+    size_t num_tiles() const { return num_tiles_; }
+    size_t num_workers() const { return queues_.size(); }
+    size_t num_steals() const { return num_steals_; }
+
+    /**
+     * Render all tiles by render_tile(tile, worker) on the worker threads,
+     * where worker is the index of the thread in [0, num_workers()). The
+     * calling thread reports progress(number of completed tiles) after every
+     * tile, and returns when all tiles are done.
+     *
+     * If render_tile throws, the remaining tiles are skipped and the first
+     * exception is rethrown.
+     */
+    template <typename RenderTile, typename Progress>
+    void run(RenderTile render_tile, Progress progress) {
+        size_t completed = 0;
+        std::exception_ptr error;
+        std::mutex mutex;
+        std::condition_variable done;
+
+        std::vector<std::thread> workers;
+        for (size_t worker = 0; worker < num_workers(); ++worker) {
+            workers.emplace_back([&, worker]() {
+                Tile tile;
+                while (next(worker, tile)) {
+                    try {
+                        render_tile(tile, worker);
+                    } catch (...) {
+                        std::lock_guard<std::mutex> lock(mutex);
+                        if (!error) {
+                            error = std::current_exception();
+                        }
+                        clear();
+                    }
+                    std::lock_guard<std::mutex> lock(mutex);
+                    completed += 1;
+                    done.notify_one();
+                }
+            });
+        }
+
+        size_t reported = 0;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            while (reported < num_tiles_ && !error) {
+                done.wait(lock,
+                          [&]() { return completed > reported || error; });
+                reported = completed;
+                lock.unlock();
+                progress(reported);
+                lock.lock();
+            }
+        }
+
+        for (auto& worker : workers) {
+            worker.join();
+        }
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+
+private:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Tile> tiles;
+    };
+
+    // Next tile of worker: the front of its own queue, or the back of the
+    // queue of another worker.
+    bool next(size_t worker, Tile& tile) {
+        {
+            auto& own = *queues_[worker];
+            std::lock_guard<std::mutex> lock(own.mutex);
+            if (!own.tiles.empty()) {
+                tile = own.tiles.front();
+                own.tiles.pop_front();
+                return true;
+            }
+        }
+        for (size_t i = 1; i < queues_.size(); ++i) {
+            auto& victim = *queues_[(worker + i) % queues_.size()];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (!victim.tiles.empty()) {
+                tile = victim.tiles.back();
+                victim.tiles.pop_back();
+                num_steals_ += 1;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Drop all remaining tiles.
+    void clear() {
+        for (auto& queue : queues_) {
+            std::lock_guard<std::mutex> lock(queue->mutex);
+            queue->tiles.clear();
+        }
+    }
+
+private:
+    const size_t num_tiles_;
+    std::vector<std::unique_ptr<Queue>> queues_;
+    std::atomic<size_t> num_steals_{0};
+};
@@ -1,14 +1,39 @@
 #pragma once
 
 #include "../src/serialize.h"
+#include "buffer.h"
 #include "types.h"
 
 #include <cereal/types/array.hpp>
 #include <cereal/types/vector.hpp>
 
 #include <array>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
 #include <vector>
 
+/**
+ * Surface material of a triangle.
+ *
+ * Materials are stored once per scene in a table (cf. TriangleMesh), and
+ * triangles refer to them by MaterialId.
+ */
+struct Material {
+    aiColor4D ambient;
+    aiColor4D diffuse;
+    aiColor4D emissive;
+    aiColor4D reflective;
+    float reflectivity = 0;
+
+    template <class Archive> void serialize(Archive& archive) {
+        archive(ambient, diffuse, emissive, reflective, reflectivity);
+    }
+};
+
+using MaterialId = uint16_t;
+using Materials = std::vector<Material>;
+
 //
 // Do NOT modify data in the triangle after its construction! The precomputed
 // values won't be updated.
@@ -20,16 +45,10 @@ public:
     Triangle() = default;
 
     Triangle(std::array<Point3f, 3> vs, std::array<Normal3f, 3> ns,
-             const aiColor4D& ambient, const aiColor4D& diffuse,
-             const aiColor4D& emissive, const aiColor4D& reflective,
-             const float reflectivity)
+             const MaterialId material_id)
         : vertices(vs)
         , normals(ns)
-        , ambient(ambient)
-        , diffuse(diffuse)
-        , emissive(emissive)
-        , reflective(reflective)     // reflective color
-        , reflectivity(reflectivity) // reflectivity factor
+        , material_id(material_id)
         , u(vertices[1] - vertices[0])
         , v(vertices[2] - vertices[0])
         , normal(normalize(cross(u, v)))
@@ -40,8 +59,7 @@ public:
 
     // minimal constructor
     explicit Triangle(std::array<Point3f, 3> vs)
-        : Triangle(vs, {Normal3f{}, Normal3f{}, Normal3f{}}, {}, {}, {}, {},
-                   0) {}
+        : Triangle(vs, {Normal3f{}, Normal3f{}, Normal3f{}}, 0) {}
 
     friend bool intersect_ray_triangle(const Ray& ray, const Triangle& tri,
                                        float& r, float& s, float& t);
@@ -87,18 +105,14 @@ public:
     }
 
     template <class Archive> void serialize(Archive& archive) {
-        archive(vertices, normals, ambient, diffuse, emissive, reflective,
-                reflectivity, u, v, normal, uv, vv, uu, denom);
+        archive(vertices, normals, material_id, u, v, normal, uv, vv, uu,
+                denom);
     }
 
     // members
     std::array<Point3f, 3> vertices;
     std::array<Normal3f, 3> normals;
-    aiColor4D ambient;
-    aiColor4D diffuse;
-    aiColor4D emissive;
-    aiColor4D reflective;
-    float reflectivity;
+    MaterialId material_id;
 
     // precomputed
     // Edges of the triangle from point 0 to points 1 resp. 2
@@ -119,3 +133,195 @@ private:
 };
 
 using Triangles = std::vector<Triangle>;
+
+/**
+ * Triangles with shared vertex and normal buffers.
+ *
+ * Scenes imported with aiProcess_JoinIdenticalVertices are indexed meshes, in
+ * which a vertex is shared by about six triangles. Instead of copying the
+ * vertices into each triangle, we store them once and a triangle (face)
+ * refers to them by three indices. The vertex i has the normal normals()[i].
+ *
+ * A Triangle with all precomputed values is materialized on access, cf.
+ * operator[].
+ *
+ * The mesh also owns the material table of the scene; faces refer to it by
+ * MaterialId.
+ *
+ * The buffers may be views into a memory-mapped file (cf. Buffer).
+ */
+class TriangleMesh {
+public:
+    using Face = std::array<uint32_t, 3>;
+
+    TriangleMesh() = default;
+
+    /**
+     * Mesh from a list of triangles and their material table. Vertices are not
+     * shared.
+     *
+     * By default, all triangles have the default material.
+     */
+    explicit TriangleMesh(const Triangles& triangles,
+                          Materials materials = {Material{}})
+        : materials_(std::move(materials)) {
+        reserve(3 * triangles.size(), triangles.size());
+        for (const auto& tri : triangles) {
+            Face face;
+            for (size_t k = 0; k < 3; ++k) {
+                face[k] = add_vertex(tri.vertices[k], tri.normals[k]);
+            }
+            add_face(face, tri.material_id);
+        }
+    }
+
+    /**
+     * Mesh from its buffers, e.g. views into a memory-mapped file (cf.
+     * kdtree_cache.h). Such a mesh cannot be modified except for its
+     * material table.
+     */
+    TriangleMesh(Buffer<Point3f> vertices, Buffer<Normal3f> normals,
+                 Buffer<Face> faces, Buffer<MaterialId> material_ids,
+                 Materials materials)
+        : vertices_(std::move(vertices))
+        , normals_(std::move(normals))
+        , faces_(std::move(faces))
+        , material_ids_(std::move(material_ids))
+        , materials_(std::move(materials)) {
+        assert(vertices_.size() == normals_.size());
+        assert(faces_.size() == material_ids_.size());
+    }
+
+    void reserve(size_t num_vertices, size_t num_faces) {
+        vertices_.vector().reserve(num_vertices);
+        normals_.vector().reserve(num_vertices);
+        faces_.vector().reserve(num_faces);
+        material_ids_.vector().reserve(num_faces);
+    }
+
+    MaterialId add_material(const Material& material) {
+        assert(materials_.size() <= std::numeric_limits<MaterialId>::max());
+        materials_.push_back(material);
+        return materials_.size() - 1;
+    }
+
+    /**
+     * Resize the vertex and face buffers, e.g. to fill them in parallel by
+     * set_vertex and set_face.
+     */
+    void resize(size_t num_vertices, size_t num_faces) {
+        vertices_.vector().resize(num_vertices);
+        normals_.vector().resize(num_vertices);
+        faces_.vector().resize(num_faces);
+        material_ids_.vector().resize(num_faces);
+    }
+
+    void set_vertex(size_t i, const Point3f& p, const Normal3f& n) {
+        vertices_.vector()[i] = p;
+        normals_.vector()[i] = n;
+    }
+
+    void set_face(size_t i, const Face& face, const MaterialId material_id) {
+        assert(face[0] < vertices_.size());
+        assert(face[1] < vertices_.size());
+        assert(face[2] < vertices_.size());
+        assert(material_id < materials_.size());
+        faces_.vector()[i] = face;
+        material_ids_.vector()[i] = material_id;
+    }
+
+    uint32_t add_vertex(const Point3f& p, const Normal3f& n) {
+        vertices_.vector().push_back(p);
+        normals_.vector().push_back(n);
+        return vertices_.size() - 1;
+    }
+
+    void add_face(const Face& face, const MaterialId material_id) {
+        assert(face[0] < vertices_.size());
+        assert(face[1] < vertices_.size());
+        assert(face[2] < vertices_.size());
+        assert(material_id < materials_.size());
+        faces_.vector().push_back(face);
+        material_ids_.vector().push_back(material_id);
+    }
+
+    size_t size() const { return faces_.size(); }
+    bool empty() const { return faces_.empty(); }
+
+    Triangle operator[](size_t id) const {
+        const auto& f = faces_[id];
+        return {{vertices_[f[0]], vertices_[f[1]], vertices_[f[2]]},
+                {normals_[f[0]], normals_[f[1]], normals_[f[2]]},
+                material_ids_[id]};
+    }
+
+    Triangle at(size_t id) const {
+        if (id >= size()) {
+            throw std::out_of_range("TriangleMesh::at");
+        }
+        return (*this)[id];
+    }
+
+    /**
+     * Material of the triangle id.
+     */
+    const Material& material(size_t id) const {
+        return materials_[material_ids_[id]];
+    }
+
+    /**
+     * Vertices of the triangle id.
+     */
+    std::array<Point3f, 3> vertices(size_t id) const {
+        const auto& f = faces_[id];
+        return {vertices_[f[0]], vertices_[f[1]], vertices_[f[2]]};
+    }
+
+    /**
+     * Bounding box of the triangle id. Same as (*this)[id].bbox().
+     */
+    Bbox3f bbox(size_t id) const {
+        const auto& f = faces_[id];
+        const auto& a = vertices_[f[0]];
+        const auto& b = vertices_[f[1]];
+        const auto& c = vertices_[f[2]];
+        return {{fmin(a.x, b.x, c.x), fmin(a.y, b.y, c.y), fmin(a.z, b.z, c.z)},
+                {fmax(a.x, b.x, c.x), fmax(a.y, b.y, c.y),
+                 fmax(a.z, b.z, c.z)}};
+    }
+
+    /**
+     * Materialize all triangles.
+     */
+    Triangles triangles() const {
+        Triangles result;
+        result.reserve(size());
+        for (size_t i = 0; i < size(); ++i) {
+            result.push_back((*this)[i]);
+        }
+        return result;
+    }
+
+    const Buffer<Point3f>& vertices() const { return vertices_; }
+    const Buffer<Normal3f>& normals() const { return normals_; }
+    const Buffer<Face>& faces() const { return faces_; }
+    const Buffer<MaterialId>& material_ids() const { return material_ids_; }
+    const Materials& materials() const { return materials_; }
+
+    size_t memory_bytes() const {
+        return vertices_.memory_bytes() + normals_.memory_bytes() +
+               faces_.memory_bytes() + material_ids_.memory_bytes() +
+               materials_.capacity() * sizeof(Material);
+    }
+
+    template <class Archive> void serialize(Archive& archive) {
+        archive(vertices_, normals_, faces_, material_ids_, materials_);
+    }
+
+private:
+    Buffer<Point3f> vertices_;
+    Buffer<Normal3f> normals_;
+    Buffer<Face> faces_;
+    Buffer<MaterialId> material_ids_; // per face
+    Materials materials_;
+};
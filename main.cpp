@@ -1,138 +1,353 @@
+#include "lib/accumulator.h"
+#include "lib/cameras.h"
+#include "lib/checkpoint.h"
+#include "lib/chunked_kdtree.h"
+#include "lib/daemon.h"
 #include "lib/effects.h"
+#include "lib/heatmap.h"
+#include "lib/kdtree_cache.h"
+#include "lib/lru_cache.h"
 #include "lib/output.h"
+#include "lib/partial.h"
+#include "lib/preview.h"
 #include "lib/progress_bar.h"
 #include "lib/range.h"
 #include "lib/raster.h"
+#include "lib/render_context.h"
 #include "lib/runtime.h"
+#include "lib/sampling.h"
+#include "lib/scene.h"
+#include "lib/scene_file.h"
 #include "lib/stats.h"
+#include "lib/telemetry.h"
+#include "lib/tile_scheduler.h"
 #include "lib/triangle.h"
-#include "lib/xorshift.h"
 #include "trace.h"
 
-#include <ThreadPool.h>
-#include <assimp/Importer.hpp>  // C++ importer interface
-#include <assimp/postprocess.h> // Post processing flags
-#include <assimp/scene.h>       // Output data structure
-#include <cereal/archives/portable_binary.hpp>
 #include <docopt/docopt.h>
 
+#include <atomic>
+#include <chrono>
+#include <cstring>
 #include <fstream>
+#include <functional>
 #include <iostream>
+#include <limits>
 #include <map>
 #include <math.h>
+#include <memory>
+#include <numeric>
+#include <sstream>
+#include <string>
+#include <thread>
 #include <vector>
 
-Triangles triangles_from_scene(const aiScene* scene) {
-    Triangles triangles;
-    for (auto node : make_range(scene->mRootNode->mChildren,
-                                scene->mRootNode->mNumChildren)) {
-        if (node->mNumMeshes == 0) {
-            continue;
-        }
-
-        const auto& T = node->mTransformation;
-        const aiMatrix3x3 Tp(T); // trafo without translation
-
-        for (auto mesh_index : make_range(node->mMeshes, node->mNumMeshes)) {
-            const auto& mesh = *scene->mMeshes[mesh_index];
-            const auto& material = scene->mMaterials[mesh.mMaterialIndex];
-
-            aiColor4D ambient, diffuse, emissive, reflective;
-            material->Get(AI_MATKEY_COLOR_AMBIENT, ambient);
-            material->Get(AI_MATKEY_COLOR_DIFFUSE, diffuse);
-            material->Get(AI_MATKEY_COLOR_DIFFUSE, emissive);
-            material->Get(AI_MATKEY_COLOR_REFLECTIVE, reflective);
-
-            float reflectivity = 0.f;
-            material->Get(AI_MATKEY_REFLECTIVITY, reflectivity);
-
-            for (aiFace face : make_range(mesh.mFaces, mesh.mNumFaces)) {
-                assert(face.mNumIndices == 3);
-
-                // convert to our internal Vec = Vector3f type
-                aiVector3D aiv0 = T * mesh.mVertices[face.mIndices[0]];
-                aiVector3D aiv1 = T * mesh.mVertices[face.mIndices[1]];
-                aiVector3D aiv2 = T * mesh.mVertices[face.mIndices[2]];
-
-                aiVector3D ain0 = Tp * mesh.mNormals[face.mIndices[0]];
-                aiVector3D ain1 = Tp * mesh.mNormals[face.mIndices[1]];
-                aiVector3D ain2 = Tp * mesh.mNormals[face.mIndices[2]];
-
-                Point3f v0(aiv0.x, aiv0.y, aiv0.z);
-                Point3f v1(aiv1.x, aiv1.y, aiv1.z);
-                Point3f v2(aiv2.x, aiv2.y, aiv2.z);
-
-                Normal3f n0(ain0.x, ain0.y, ain0.z);
-                Normal3f n1(ain1.x, ain1.y, ain1.z);
-                Normal3f n2(ain2.x, ain2.y, ain2.z);
-
-                triangles.push_back(Triangle{// vertices
-                                             {v0, v1, v2},
-                                             // normals
-                                             {n0, n1, n2},
-                                             ambient,
-                                             diffuse,
-                                             emissive,
-                                             reflective,
-                                             reflectivity});
-            }
-        }
-    }
-    return triangles;
-}
+#include <errno.h>
+#include <sys/stat.h>
 
 // Defined in the file with the trace implementation for the corresponding
 // renderer.
 extern const char* USAGE;
 
-int main(int argc, char const* argv[]) {
-    std::map<std::string, docopt::value> args =
-        docopt::docopt(USAGE, {argv + 1, argv + argc});
-    TracerConfig conf = TracerConfig::from_docopt(args);
-    if (conf.verbose) {
-        std::cerr << conf << std::endl;
+/**
+ * Callbacks of render, which are all optional.
+ */
+struct RenderHooks {
+    // called every conf.checkpoint_interval seconds if conf.checkpoint is set
+    std::function<void()> checkpoint;
+    // called with the pass, and the completed and all tiles of the pass,
+    // whenever a tile is completed
+    std::function<void(size_t, size_t, size_t)> progress;
+    // if set, the remaining tiles are skipped
+    const std::atomic<bool>* cancelled = nullptr;
+    // if set, the preview levels are rendered first, and called with the
+    // block size of every level (cf. lib/preview.h)
+    std::function<void(size_t)> preview;
+    // if set, the phases, completed tiles and busy time of the threads are
+    // reported to it
+    Telemetry* telemetry = nullptr;
+};
+
+/**
+ * Order in which the pixels rendered together are sampled, as indices in
+ * row-major order. ray(i) is the primary ray through the center of pixel i.
+ */
+template <typename RayOf>
+std::vector<uint32_t> pixel_order(KDTreeIntersection&, size_t num_pixels,
+                                  RayOf) {
+    std::vector<uint32_t> order(num_pixels);
+    std::iota(order.begin(), order.end(), 0);
+    return order;
+}
+
+/**
+ * Pixels of an out-of-core scene are queued at the chunk their primary ray
+ * enters first, so that each chunk serves the pixels of its queue in a row
+ * while it is pinned (cf. ChunkedKDTreeIntersection::queue).
+ */
+template <typename RayOf>
+std::vector<uint32_t> pixel_order(ChunkedKDTreeIntersection& isect,
+                                  size_t num_pixels, RayOf ray) {
+    std::vector<Ray> rays;
+    rays.reserve(num_pixels);
+    for (size_t i = 0; i < num_pixels; ++i) {
+        rays.push_back(ray(i));
     }
+    return isect.queue(rays);
+}
 
-    // import scene
-    std::cerr << "Loading scene..." << std::endl;
-    Assimp::Importer importer;
-    const aiScene* scene = importer.ReadFile(
-        conf.filename, aiProcess_CalcTangentSpace | aiProcess_Triangulate |
-                           aiProcess_JoinIdenticalVertices |
-                           aiProcess_GenNormals | aiProcess_SortByPType);
-
-    if (!scene) {
-        std::cout << importer.GetErrorString() << std::endl;
-        return 1;
+/**
+ * Render the image with the trace function of the renderer (cf. trace.h)
+ * into the accumulator.
+ *
+ * TreeIntersection is KDTreeIntersection or, for out-of-core scenes,
+ * ChunkedKDTreeIntersection. If heatmap is not empty, the traversal cost per
+ * pixel is added to it.
+ *
+ * Every pixel gets conf.num_pixel_samples samples. With adaptive sampling,
+ * further batches of that size are added until the relative error of the
+ * pixel is at most conf.adaptive_threshold or it has
+ * conf.max_pixel_samples samples. The pixels of a tile are sampled in
+ * pixel_order.
+ *
+ * Only the tiles which are not done in completion are rendered, and marked
+ * as done. If conf.checkpoint is set, hooks.checkpoint() is called every
+ * conf.checkpoint_interval seconds. Once hooks.cancelled is set, the
+ * remaining tiles are skipped and not marked.
+ *
+ * With a conf.time_limit, the image is rendered progressively: every pass
+ * adds conf.num_pixel_samples samples to each pixel which has not converged
+ * yet, until the deadline. The first pass is always complete; the tiles of a
+ * later pass which would start after the deadline are skipped.
+ *
+ * With hooks.preview, the levels of the preview are rendered first. Their
+ * samples count towards the batches of the pixels (cf. sample_pixel), so
+ * that the image does not change.
+ *
+ * Only the pixels in region are rendered.
+ */
+template <typename TreeIntersection>
+void render(const typename TreeIntersection::Tree& tree, const Camera& cam,
+            const std::vector<Light>& lights, const TracerConfig& conf,
+            Accumulator& accumulator, TileCompletion& completion,
+            Heatmap& heatmap, const RenderHooks& hooks,
+            std::chrono::steady_clock::time_point deadline,
+            const Tile& region) {
+    Runtime rt(Stats::instance().runtime_ms);
+
+    std::cerr << "Rendering ";
+
+    const int width = accumulator.width();
+    const int height = accumulator.height();
+    const bool heatmap_enabled = heatmap.width() > 0;
+    const bool progressive = conf.time_limit > 0;
+    const size_t batch_size = conf.num_pixel_samples;
+    SampleBudget budget;
+    budget.batch_size = batch_size;
+    budget.max_samples = conf.adaptive_threshold > 0 ? conf.max_pixel_samples
+                                                     : batch_size;
+    budget.adaptive_threshold = conf.adaptive_threshold;
+    budget.progressive = progressive;
+
+    std::vector<Tile> tiles;
+    for (const auto& tile : make_tiles(width, height, conf.tile_size)) {
+        if (intersect(tile, region).size() > 0) {
+            tiles.push_back(tile);
+        }
+    }
+    auto contexts =
+        make_render_contexts<TreeIntersection>(tree, conf.num_threads);
+    auto last_checkpoint = std::chrono::steady_clock::now();
+
+    const Point3f cam_pos(cam.mPosition.x, cam.mPosition.y, cam.mPosition.z);
+
+    // pixels of a tile in the order they are sampled
+    auto tile_order = [&](TreeIntersection& tree_intersection,
+                          const Tile& pixels) {
+        return pixel_order(
+            tree_intersection, pixels.size(), [&](size_t i) {
+                const size_t x = pixels.x0 + i % pixels.width();
+                const size_t y = pixels.y0 + i / pixels.width();
+                return Ray(cam_pos, cam.raster2cam({x + 0.5f, y + 0.5f},
+                                                   width, height));
+            });
+    };
+
+    auto sample = [&](auto& ctx, size_t x, size_t y) {
+        // the i-th sample of a pixel is the same in any thread, pass, region
+        // and process
+        sampling::start_sample(conf.seed, y * width + x,
+                               accumulator.num_samples(x, y), batch_size);
+        const float dx = sampling::uniform();
+        const float dy = sampling::uniform();
+        auto cam_dir = cam.raster2cam({x + dx, y + dy}, width, height);
+        accumulator.add(x, y,
+                        trace({cam_pos, cam_dir}, ctx.tree_intersection,
+                              lights, 0, conf));
+    };
+
+    for (const size_t block : PREVIEW_BLOCKS) {
+        if (!hooks.preview) {
+            break;
+        }
+        TileScheduler scheduler(completion.remaining(tiles), conf.num_threads);
+        const std::string label =
+            "Preview " + std::to_string(block) + "x" + std::to_string(block);
+        auto progress_bar =
+            ProgressBar(std::cerr, label, scheduler.num_tiles());
+        if (hooks.telemetry) {
+            hooks.telemetry->start_phase(label, scheduler.num_tiles());
+        }
+        scheduler.run(
+            [&](const Tile& tile, size_t worker) {
+                if (hooks.cancelled && *hooks.cancelled) {
+                    return;
+                }
+                Telemetry::Busy busy(hooks.telemetry, worker);
+                auto& ctx = *contexts[worker];
+                const Tile pixels = intersect(tile, region);
+                for (const uint32_t i :
+                     tile_order(ctx.tree_intersection, pixels)) {
+                    const size_t x = pixels.x0 + i % pixels.width();
+                    const size_t y = pixels.y0 + i / pixels.width();
+                    if (!preview_pixel(x, y, block) ||
+                        accumulator.num_samples(x, y) > 0) {
+                        continue;
+                    }
+                    if (heatmap_enabled) {
+                        ctx.tree_intersection.count_cost(&heatmap(x, y));
+                    }
+                    sample(ctx, x, y);
+                }
+            },
+            [&](size_t completed) {
+                progress_bar.update(completed);
+                if (hooks.telemetry) {
+                    hooks.telemetry->set_completed(completed);
+                }
+            });
+        std::cerr << std::endl;
+        hooks.preview(block);
     }
 
-    // setup camera
-    assert(scene->mNumCameras == 1); // we can deal only with a single camera
-    auto& sceneCam = *scene->mCameras[0];
-    if (sceneCam.mAspect > 0) {
-        conf.aspect = sceneCam.mAspect;
-    } else if (sceneCam.mAspect == 0) {
-        sceneCam.mAspect = conf.aspect;
+    for (size_t pass = 0;; ++pass) {
+        TileScheduler scheduler(pass == 0 ? completion.remaining(tiles)
+                                          : tiles,
+                                conf.num_threads);
+        // whether any pixel got samples in this pass
+        std::atomic<bool> sampled(false);
+
+        const std::string label =
+            progressive ? "Pass " + std::to_string(pass + 1) : "Rendering";
+        auto progress_bar =
+            ProgressBar(std::cerr, label, scheduler.num_tiles());
+        if (hooks.telemetry) {
+            hooks.telemetry->start_phase(
+                label, scheduler.num_tiles(),
+                progressive ? deadline
+                            : std::chrono::steady_clock::time_point::max());
+        }
+        scheduler.run(
+            [&](const Tile& tile, size_t worker) {
+                if ((pass > 0 &&
+                     std::chrono::steady_clock::now() >= deadline) ||
+                    (hooks.cancelled && *hooks.cancelled)) {
+                    return;
+                }
+                Telemetry::Busy busy(hooks.telemetry, worker);
+                auto& ctx = *contexts[worker];
+                const Tile pixels = intersect(tile, region);
+
+                for (const uint32_t i :
+                     tile_order(ctx.tree_intersection, pixels)) {
+                    const size_t x = pixels.x0 + i % pixels.width();
+                    const size_t y = pixels.y0 + i / pixels.width();
+                    if (heatmap_enabled) {
+                        ctx.tree_intersection.count_cost(&heatmap(x, y));
+                    }
+
+                    if (sample_pixel(accumulator, x, y, budget, pass,
+                                     [&]() { sample(ctx, x, y); })) {
+                        sampled.store(true, std::memory_order_relaxed);
+                    }
+                }
+                completion.set_done(tile);
+            },
+            [&](size_t completed) {
+                progress_bar.update(completed);
+                if (hooks.telemetry) {
+                    hooks.telemetry->set_completed(completed);
+                }
+                if (hooks.progress) {
+                    hooks.progress(pass + 1, completed, scheduler.num_tiles());
+                }
+                const auto now = std::chrono::steady_clock::now();
+                if (!conf.checkpoint.empty() &&
+                    now - last_checkpoint >=
+                        std::chrono::seconds(conf.checkpoint_interval)) {
+                    hooks.checkpoint();
+                    last_checkpoint = now;
+                }
+            });
+        std::cerr << std::endl;
+
+        if (!progressive || !sampled ||
+            std::chrono::steady_clock::now() >= deadline ||
+            (hooks.cancelled && *hooks.cancelled)) {
+            break;
+        }
     }
-    auto* camNode = scene->mRootNode->FindNode(sceneCam.mName);
-    assert(camNode != nullptr);
-    const Camera cam(camNode->mTransformation, sceneCam);
+}
 
-    // setup light
-    // we can deal only with one single or no light at all
-    assert(scene->mNumLights == 0 || scene->mNumLights == 1);
-    std::vector<Light> lights;
-    if (scene->mNumLights == 1) {
-        auto& rawLight = *scene->mLights[0];
+/**
+ * Scene with its kd-tree, or for an out-of-core scene, its chunked kd-tree.
+ * The mesh and the chunks of the scene are moved into the tree.
+ */
+struct LoadedScene {
+    Scene scene;
+    std::unique_ptr<ChunkedKDTree> chunked_tree;
+    KDTree tree;
+    // hash of the geometry, i.e. the kd-tree cache key of the mesh or the
+    // keys of the chunks; 0 unless a cache, a checkpoint or a partial needs it
+    uint64_t geometry_key = 0;
+    // modification time of the scene file, for the daemon
+    int64_t mtime = 0;
+    // time to build, load or open the tree(s)
+    size_t loading_time_ms = 0;
+};
+
+/**
+ * Load the scene at filename and its kd-tree (cf. --cache-dir), or open the
+ * chunks of an out-of-core scene.
+ *
+ * @return false with an error message if the scene cannot be loaded.
+ */
+bool load(const TracerConfig& conf, const std::string& filename,
+          LoadedScene& loaded, std::string& error) {
+    std::cerr << "Loading scene..." << std::endl;
+    SceneLoadTimes load_times;
+    Scene& scene = loaded.scene;
+    if (!load_scene(filename, scene, error, conf.num_threads, &load_times)) {
+        return false;
+    }
 
-        auto* lightNode = scene->mRootNode->FindNode(rawLight.mName);
-        assert(lightNode != nullptr);
-        const auto& LT = lightNode->mTransformation;
-        const auto& v = LT * aiVector3D();
-        lights.push_back(
-            {{v.x, v.y, v.z},
-             aiColor4D{rawLight.mColorDiffuse.r, rawLight.mColorDiffuse.g,
-                       rawLight.mColorDiffuse.b, 1}});
+    if (!scene.chunks.empty()) {
+        detail::Hash64 hash;
+        for (const auto& chunk : scene.chunks) {
+            hash.add(chunk.key);
+        }
+        loaded.geometry_key = hash.value();
+
+        // Out-of-core scene: the kd-trees of the chunks are mapped on demand.
+        std::cerr << "Opening " << scene.chunks.size() << " chunks..."
+                  << std::endl;
+        Runtime loading_time;
+        loaded.chunked_tree.reset(new ChunkedKDTree(
+            scene_chunk_dir(filename), std::move(scene.chunks),
+            scene.mesh.materials(), conf.memory_limit_mb << 20));
+        std::cerr << load_times << std::endl;
+        loaded.loading_time_ms = loading_time();
+        return true;
     }
 
     // load triangles from the scene into a kd-tree
@@ -141,104 +356,587 @@ int main(int argc, char const* argv[]) {
 
     // Load KDTree from cache if it exists or build it.
     size_t kdtree_runtime_ms = 0;
-    KDTree tree;
+    KDTree& tree = loaded.tree;
     {
         Runtime runtime(kdtree_runtime_ms);
-        std::ifstream kdtree_cache("kdtree.cache");
-        if (kdtree_cache.is_open()) {
-            {
-                cereal::PortableBinaryInputArchive iarchive(kdtree_cache);
-                iarchive(tree);
-            }
+        const bool cache_enabled = !conf.cache_dir.empty();
+        if (cache_enabled || !conf.checkpoint.empty() ||
+            !conf.partial.empty()) {
+            loaded.geometry_key = kdtree_cache_key(scene.mesh);
+        }
+        const uint64_t key = loaded.geometry_key;
+
+        std::string cache_error;
+        if (cache_enabled &&
+            load_cached_kdtree(conf.cache_dir, key, tree, cache_error)) {
+            std::cerr << "Loaded kd-tree from "
+                      << kdtree_cache_path(conf.cache_dir, key) << std::endl;
         } else {
+            if (!cache_error.empty()) {
+                std::cerr << cache_error << std::endl;
+            }
+
             // Build tree
-            auto triangles = triangles_from_scene(scene);
-            tree = KDTree(std::move(triangles));
+            tree = KDTree(std::move(scene.mesh));
 
             // Cache KDTree
-            {
-                std::ofstream output_file;
-                output_file.open("kdtree.cache",
-                                 std::ios::out | std::ios::binary);
-                cereal::PortableBinaryOutputArchive oarchive(output_file);
-                oarchive(tree);
+            if (cache_enabled &&
+                !store_cached_kdtree(conf.cache_dir, key, tree)) {
+                std::cerr << "Cannot write kd-tree cache to "
+                          << conf.cache_dir << std::endl;
             }
         }
     }
+    std::cerr << load_times << std::endl;
     std::cerr << "KDTree runtime: " << kdtree_runtime_ms << std::endl;
+    loaded.loading_time_ms = loading_time();
+    return true;
+}
 
-    Stats::instance().num_triangles = tree.num_triangles();
-    Stats::instance().loading_time_ms = loading_time();
-    Stats::instance().kdtree_height = tree.height();
+/**
+ * Record the loaded scene in the stats and end their load phase. Only for a
+ * single render: the daemon loads many scenes, and a phase resets the peak
+ * memory (cf. Stats::end_phase).
+ */
+void record_load(const LoadedScene& loaded) {
+    Stats& stats = Stats::instance();
+    stats.loading_time_ms = loaded.loading_time_ms;
+    if (loaded.chunked_tree) {
+        stats.num_triangles = loaded.chunked_tree->num_triangles();
+    } else {
+        stats.num_triangles = loaded.tree.num_triangles();
+        stats.kdtree_height = loaded.tree.height();
+        stats.memory.triangles = loaded.tree.mesh().memory_bytes();
+        stats.memory.kdtree = loaded.tree.memory_bytes();
+    }
+    stats.end_phase("load");
+}
 
-    //
-    // Raytracer
-    //
+/**
+ * Render the image of cam with the tree of the loaded scene, cf. render.
+ */
+void render(const LoadedScene& loaded, const Camera& cam,
+            const TracerConfig& conf, Accumulator& accumulator,
+            TileCompletion& completion, Heatmap& heatmap,
+            const RenderHooks& hooks,
+            std::chrono::steady_clock::time_point deadline,
+            const Tile& region) {
+    if (loaded.chunked_tree) {
+        render<ChunkedKDTreeIntersection>(
+            *loaded.chunked_tree, cam, loaded.scene.lights, conf, accumulator,
+            completion, heatmap, hooks, deadline, region);
+    } else {
+        render<KDTreeIntersection>(loaded.tree, cam, loaded.scene.lights, conf,
+                                   accumulator, completion, heatmap, hooks,
+                                   deadline, region);
+    }
+}
 
-    int width = conf.width;
-    int height = width / cam.mAspect;
+/**
+ * Key of a render: a hash of everything the mean of the samples of a pixel
+ * depends on, i.e. the renderer, the scene, the camera and the options but
+ * the seed and the numbers of samples. Partials are merged only if their keys
+ * match (cf. merge_partial).
+ */
+uint64_t render_key(const TracerConfig& conf, const LoadedScene& loaded,
+                    const Camera& cam) {
+    detail::Hash64 hash;
+    hash.add(USAGE, std::strlen(USAGE)); // the renderer
+    hash.add(loaded.geometry_key);
+    for (const auto& light : loaded.scene.lights) {
+        hash.add(light.position.x);
+        hash.add(light.position.y);
+        hash.add(light.position.z);
+        hash.add(light.color);
+    }
+    for (const auto& v : {cam.mPosition, cam.mLookAt, cam.mUp}) {
+        hash.add(v.x);
+        hash.add(v.y);
+        hash.add(v.z);
+    }
+    hash.add(cam.mHorizontalFOV);
+    hash.add(cam.mAspect);
+
+    hash.add(static_cast<uint64_t>(conf.width));
+    hash.add(conf.bg_color);
+    hash.add(static_cast<uint64_t>(conf.max_recursion_depth));
+    hash.add(conf.max_visibility);
+    hash.add(conf.shadow_intensity);
+    hash.add(static_cast<uint64_t>(conf.num_monte_carlo_samples));
+    hash.add(static_cast<uint64_t>(conf.sampler));
+    return hash.value();
+}
 
-    Image image(width, height);
-    {
-        Runtime rt(Stats::instance().runtime_ms);
+/**
+ * Key of the checkpoints of a render: the render key plus everything else the
+ * samples depend on, i.e. the tiles, the region, the seed and the numbers of
+ * samples.
+ */
+uint64_t checkpoint_key(const TracerConfig& conf, const LoadedScene& loaded,
+                        const Camera& cam) {
+    detail::Hash64 hash;
+    hash.add(render_key(conf, loaded, cam));
+    hash.add(static_cast<uint64_t>(conf.tile_size));
+    hash.add(static_cast<uint64_t>(conf.num_pixel_samples));
+    hash.add(conf.adaptive_threshold);
+    hash.add(static_cast<uint64_t>(conf.max_pixel_samples));
+    for (const size_t bound : {conf.region.x0, conf.region.y0,
+                               conf.region.x1, conf.region.y1}) {
+        hash.add(static_cast<uint64_t>(bound));
+    }
+    hash.add(conf.seed);
+    return hash.value();
+}
+
+/**
+ * Name of the renderer, i.e. the first word after "Usage:" in USAGE.
+ */
+std::string renderer_name() {
+    std::stringstream ss(USAGE);
+    std::string usage, name;
+    ss >> usage >> name;
+    return name;
+}
 
-        std::cerr << "Rendering ";
+/**
+ * Modification time of a file in ns, or 0 if it does not exist.
+ */
+int64_t modification_time(const std::string& path) {
+    struct stat st;
+    if (::stat(path.c_str(), &st) != 0) {
+        return 0;
+    }
+    return static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 +
+           st.st_mtim.tv_nsec;
+}
 
-        ThreadPool pool(conf.num_threads);
-        std::vector<std::future<void>> tasks;
+/**
+ * Render a job of the daemon and send its events (cf. lib/daemon.h).
+ *
+ * The job is rendered with the threads of the daemon, and the scene is
+ * loaded with its options (e.g. --cache-dir). Loaded scenes are kept in
+ * scenes until they are modified or evicted. The job is reported to the
+ * telemetry of the daemon, if any.
+ */
+void render_job(const TracerConfig& daemon_conf, const Job& job,
+                Connection& connection, const JobQueue& queue,
+                LruCache<std::string, std::unique_ptr<LoadedScene>>& scenes,
+                Telemetry* telemetry) {
+    const auto start = std::chrono::steady_clock::now();
+    auto fail = [&](const std::string& message) {
+        std::cerr << "Job " << job.id << ": " << message << std::endl;
+        connection.send_line(error_event(job.id, message));
+    };
+
+    if (!job.renderer.empty() && job.renderer != renderer_name()) {
+        return fail("This daemon is a " + renderer_name() + ", not a " +
+                    job.renderer);
+    }
 
-        Point3f cam_pos =
-            Point3f(cam.mPosition.x, cam.mPosition.y, cam.mPosition.z);
+    std::vector<std::string> argv = {job.scene};
+    argv.insert(argv.end(), job.args.begin(), job.args.end());
+    // the options of a client must not abort the daemon
+    TracerConfig conf{Config()};
+    try {
+        std::string error;
+        if (!TracerConfig::parse(
+                docopt::docopt_parse(USAGE, argv, false, false), conf,
+                error)) {
+            return fail("Invalid args: " + error);
+        }
+    } catch (const std::exception& e) {
+        return fail(std::string("Invalid args: ") + e.what());
+    }
+    if (!conf.serve.empty() || !conf.cameras.empty() ||
+        !conf.checkpoint.empty() || !conf.partial.empty() ||
+        !conf.heatmap.empty() || !conf.samples_aov.empty() ||
+        !conf.preview.empty() || !conf.telemetry.empty()) {
+        return fail("--serve, --cameras, --checkpoint, --partial, --heatmap, "
+                    "--samples-aov, --preview and --telemetry are not "
+                    "supported in jobs");
+    }
+    conf.num_threads = daemon_conf.num_threads;
+    sampling::sampler_type() = conf.sampler;
+
+    // the resident scene, unless the file was modified since it was loaded
+    const int64_t mtime = modification_time(job.scene);
+    std::unique_ptr<LoadedScene>* resident = scenes.get(job.scene);
+    const bool cached = resident && (*resident)->mtime == mtime;
+    LoadedScene* loaded = cached ? resident->get() : nullptr;
+    if (!cached) {
+        // free the memory of the outdated scene first
+        scenes.erase(job.scene);
+        std::unique_ptr<LoadedScene> scene(new LoadedScene);
+        std::string error;
+        if (!load(daemon_conf, job.scene, *scene, error)) {
+            return fail(error);
+        }
+        scene->mtime = mtime;
+        loaded = scenes.put(job.scene, std::move(scene)).get();
+    }
 
-        for (int y = 0; y < height; ++y) {
-            tasks.emplace_back(pool.enqueue([&image, &cam, &tree, &lights,
-                                             width, height, y, &conf,
-                                             &cam_pos]() {
-                // TODO: we need only one tree intersection per thread, not task
-                KDTreeIntersection tree_intersection(tree);
+    std::vector<Camera> cams;
+    if (job.camera.empty()) {
+        cams.push_back(loaded->scene.make_camera(conf.aspect));
+    } else {
+        std::stringstream ss(job.camera);
+        std::vector<aiMatrix4x4> trafos;
+        std::string error;
+        if (!read_cameras(ss, trafos, error) || trafos.size() != 1) {
+            return fail("Invalid camera: " + error);
+        }
+        cams.push_back(
+            make_camera(trafos[0], loaded->scene.camera, conf.aspect));
+    }
+    const Camera& cam = cams[0];
+
+    const int width = conf.width;
+    const int height = width / cam.mAspect;
+    Tile region = {0, 0, static_cast<size_t>(width),
+                   static_cast<size_t>(height)};
+    if (conf.region.size() > 0) {
+        region = intersect(conf.region, region);
+    }
+    if (region.size() == 0) {
+        return fail("The region or the " + std::to_string(width) + "x" +
+                    std::to_string(height) + " image is empty");
+    }
 
-                float dx, dy;
-                xorshift64star<float> gen(42);
+    Accumulator accumulator(width, height);
+    TileCompletion completion(width, height, conf.tile_size);
+    Heatmap heatmap(0, 0);
+
+    RenderHooks hooks;
+    size_t last_percent = 0;
+    hooks.progress = [&](size_t pass, size_t completed, size_t total) {
+        // at most one event per percent
+        const size_t percent = 100 * completed / std::max<size_t>(total, 1);
+        if (percent != last_percent || completed == total) {
+            connection.send_line(
+                progress_event(job.id, pass, completed, total));
+            last_percent = percent;
+        }
+    };
+    hooks.cancelled = &queue.cancelled();
+    hooks.telemetry = telemetry;
+    if (telemetry) {
+        telemetry->set_label(job.id);
+    }
 
-                for (int x = 0; x < width; ++x) {
-                    for (int i = 0; i < conf.num_pixel_samples; ++i) {
-                        dx = gen();
-                        dy = gen();
+    std::cerr << "Job " << job.id << ": " << job.scene
+              << (cached ? " (loaded)" : "") << std::endl;
+    render(*loaded, cam, conf, accumulator, completion, heatmap, hooks,
+           start + std::chrono::seconds(conf.time_limit), region);
+    if (queue.cancelled()) {
+        std::cerr << "Job " << job.id << " cancelled" << std::endl;
+        connection.send_line(cancelled_event(job.id));
+        return;
+    }
 
-                        auto cam_dir =
-                            cam.raster2cam({x + dx, y + dy}, width, height);
+    Image image = mean_image(accumulator);
+    post_process(image, conf.exposure, conf.gamma_correction_enabled,
+                 conf.inverse_gamma);
+    std::stringstream ppm;
+    ppm << image << std::endl;
+    const std::string data = ppm.str();
+    connection.send(image_event(job.id, width, height, data.size()) + "\n" +
+                    data);
+    const size_t runtime_ms =
+        std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - start)
+            .count();
+    connection.send_line(done_event(job.id, runtime_ms, cached));
+}
 
-                        Stats::instance().num_prim_rays += 1;
-                        image(x, y) +=
-                            trace({cam_pos, cam_dir}, tree_intersection, lights,
-                                  0, conf);
+/**
+ * Render the jobs sent to the socket conf.serve until the process is killed
+ * (cf. lib/daemon.h).
+ *
+ * Every client is read by its own thread, which queues its jobs and cancels
+ * them; the jobs are rendered by the calling thread.
+ */
+int serve(const TracerConfig& conf) {
+    std::string error;
+    const int listener = listen_unix(conf.serve, error);
+    if (listener < 0) {
+        std::cout << error << std::endl;
+        return 1;
+    }
+    std::cerr << "Serving " << renderer_name() << " jobs on " << conf.serve
+              << std::endl;
+
+    auto queue = std::make_shared<JobQueue>();
+    std::thread([queue, listener]() {
+        while (true) {
+            const int fd = ::accept(listener, nullptr, nullptr);
+            if (fd < 0 && errno == EINTR) {
+                continue;
+            }
+            if (fd < 0) {
+                break;
+            }
+            auto connection = std::make_shared<Connection>(fd);
+            std::thread([queue, connection]() {
+                std::string line;
+                while (connection->read_line(line)) {
+                    if (line.empty()) {
+                        continue;
                     }
-                    image(x, y) /= static_cast<float>(conf.num_pixel_samples);
+                    Request request;
+                    std::string error;
+                    if (!parse_request(line, request, error)) {
+                        connection->send_line(error_event("", error));
+                    } else if (!request.cancel) {
+                        queue->push(connection, request.job);
+                    } else {
+                        const std::string& id = request.job.id;
+                        switch (queue->cancel(connection, id)) {
+                        case JobQueue::Cancelled::QUEUED:
+                            connection->send_line(cancelled_event(id));
+                            break;
+                        case JobQueue::Cancelled::RUNNING:
+                            break; // the renderer sends the event
+                        default:
+                            connection->send_line(
+                                error_event(id, "Unknown job"));
+                        }
+                    }
+                }
+                queue->drop(connection);
+            }).detach();
+        }
+        queue->stop();
+    }).detach();
+
+    LruCache<std::string, std::unique_ptr<LoadedScene>> scenes(
+        conf.max_scenes);
+    std::ofstream telemetry_file;
+    const auto telemetry = open_telemetry(
+        conf.telemetry, conf.telemetry_interval, conf.num_threads,
+        telemetry_file);
+    JobQueue::Entry entry;
+    while (queue->pop(entry)) {
+        try {
+            render_job(conf, entry.job, *entry.connection, *queue, scenes,
+                       telemetry.get());
+        } catch (const std::exception& e) {
+            entry.connection->send_line(error_event(entry.job.id, e.what()));
+        }
+        queue->finish();
+        // the connection is closed once its reader is done, too
+        entry = JobQueue::Entry();
+    }
+    return 0;
+}
 
-                    image(x, y) = exposure(image(x, y), conf.exposure);
+int main(int argc, char const* argv[]) {
+    // the time limit includes loading the scene
+    const auto start = std::chrono::steady_clock::now();
+    std::map<std::string, docopt::value> args =
+        docopt::docopt(USAGE, {argv + 1, argv + argc});
+    TracerConfig conf = TracerConfig::from_docopt(args);
+    const auto deadline = start + std::chrono::seconds(conf.time_limit);
+    sampling::sampler_type() = conf.sampler;
+    if (conf.verbose) {
+        std::cerr << conf << std::endl;
+        std::cerr << "CPU dispatch: " << cpu::isa() << std::endl;
+    }
 
-                    // gamma correction
-                    if (conf.gamma_correction_enabled) {
-                        image(x, y) = gamma(image(x, y), conf.inverse_gamma);
-                    }
+    if (!conf.serve.empty()) {
+        return serve(conf);
+    }
+
+    std::string error;
+    std::vector<aiMatrix4x4> trafos;
+    if (!conf.cameras.empty() && !read_cameras(conf.cameras, trafos, error)) {
+        std::cout << error << std::endl;
+        return 1;
+    }
+
+    // import scene and load the tree once for all cameras
+    LoadedScene loaded;
+    if (!load(conf, conf.filename, loaded, error)) {
+        std::cout << error << std::endl;
+        return 1;
+    }
+    record_load(loaded);
+    const Scene& scene = loaded.scene;
+
+    // the camera of the scene, or the ones of a batch
+    std::vector<Camera> cams;
+    if (conf.cameras.empty()) {
+        cams.push_back(scene.make_camera(conf.aspect));
+    } else {
+        for (const auto& trafo : trafos) {
+            cams.push_back(make_camera(trafo, scene.camera, conf.aspect));
+        }
+        std::cerr << "Rendering " << cams.size() << " cameras of "
+                  << conf.cameras << std::endl;
+    }
+
+    int width = conf.width;
+    int height = width / cams.front().mAspect;
+
+    Tile region = {0, 0, static_cast<size_t>(width),
+                   static_cast<size_t>(height)};
+    if (conf.region.size() > 0) {
+        region = intersect(conf.region, region);
+        if (region.size() == 0) {
+            std::cout << "Region is outside of the " << width << "x" << height
+                      << " image" << std::endl;
+            return 1;
+        }
+    }
+
+    const bool heatmap_enabled = !conf.heatmap.empty();
+    const uint64_t key =
+        conf.checkpoint.empty() ? 0 : checkpoint_key(conf, loaded, cams[0]);
+    std::ofstream telemetry_file;
+    const auto telemetry = open_telemetry(
+        conf.telemetry, conf.telemetry_interval, conf.num_threads,
+        telemetry_file);
+
+    size_t runtime_ms = 0;
+    for (size_t frame = 0; frame < cams.size(); ++frame) {
+        const Camera& cam = cams[frame];
+        // in a batch, every camera gets the time limit
+        const auto frame_deadline =
+            frame == 0 ? deadline
+                       : std::chrono::steady_clock::now() +
+                             std::chrono::seconds(conf.time_limit);
+
+        Accumulator accumulator(width, height);
+        TileCompletion completion(width, height, conf.tile_size);
+        Heatmap heatmap(heatmap_enabled ? width : 0,
+                        heatmap_enabled ? height : 0);
+        // including the image of the means, which is created after rendering
+        Stats::instance().memory.framebuffer = accumulator.memory_bytes() +
+                                               width * height * sizeof(Color) +
+                                               heatmap.memory_bytes();
+
+        // checkpoints
+        if (conf.resume) {
+            if (std::ifstream(conf.checkpoint)) {
+                if (!read_checkpoint(conf.checkpoint, key, accumulator,
+                                     completion, error)) {
+                    std::cout << error << std::endl;
+                    return 1;
+                }
+                std::cerr << "Resuming from " << conf.checkpoint << " with "
+                          << completion.num_done() << " of "
+                          << completion.num_tiles() << " tiles done"
+                          << std::endl;
+            } else {
+                std::cerr << "No checkpoint " << conf.checkpoint
+                          << " yet, starting from scratch" << std::endl;
+            }
+        }
+        RenderHooks hooks;
+        hooks.checkpoint = [&]() {
+            std::string checkpoint_error;
+            if (!write_checkpoint(conf.checkpoint, key, accumulator,
+                                  completion, checkpoint_error)) {
+                std::cerr << checkpoint_error << std::endl;
+            }
+        };
+        if (!conf.preview.empty()) {
+            hooks.preview = [&](size_t block) {
+                Image image = preview_image(accumulator, block);
+                post_process(image, conf.exposure,
+                             conf.gamma_correction_enabled, conf.inverse_gamma);
+                std::string preview_error;
+                if (!write_preview(conf.preview, image, preview_error)) {
+                    std::cerr << preview_error << std::endl;
                 }
-            }));
+            };
         }
 
-        long completed = 0;
-        auto progress_bar = ProgressBar(std::cerr, "Rendering", tasks.size());
-        for (auto& task : tasks) {
-            task.get();
-            completed += 1;
-            progress_bar.update(completed);
+        hooks.telemetry = telemetry.get();
+        if (telemetry && !conf.cameras.empty()) {
+            telemetry->set_label(frame_path(conf.output, frame, ""));
         }
-        std::cerr << std::endl;
+
+        if (cams.size() > 1) {
+            std::cerr << "Camera " << frame + 1 << " of " << cams.size()
+                      << std::endl;
+        }
+        render(loaded, cam, conf, accumulator, completion, heatmap, hooks,
+               frame_deadline, region);
+        runtime_ms += Stats::instance().runtime_ms;
+
+        if (!conf.checkpoint.empty()) {
+            hooks.checkpoint();
+        }
+        if (!conf.partial.empty()) {
+            if (!write_partial(conf.partial, accumulator, region,
+                               render_key(conf, loaded, cam), conf.seed,
+                               error)) {
+                std::cerr << error << std::endl;
+                return 1;
+            }
+            std::cerr << "Partial written to " << conf.partial << std::endl;
+        }
+
+        // outputs of a batch are numbered by camera
+        const std::string suffix =
+            conf.cameras.empty() ? "" : frame_path("", frame, "");
+
+        if (heatmap_enabled) {
+            const std::string prefix = conf.heatmap + suffix;
+            std::ofstream ppm(prefix + ".ppm");
+            ppm << false_color_image(heatmap) << std::endl;
+            std::ofstream pfm(prefix + ".pfm", std::ios::binary);
+            write_pfm(pfm, heatmap);
+            std::cerr << "Heatmap written to " << prefix << ".{ppm,pfm}"
+                      << std::endl;
+        }
+
+        if (!conf.samples_aov.empty()) {
+            const std::string prefix = conf.samples_aov + suffix;
+            std::ofstream ppm(prefix + ".ppm");
+            ppm << samples_image(accumulator) << std::endl;
+            std::ofstream pfm(prefix + ".pfm", std::ios::binary);
+            write_samples_pfm(pfm, accumulator);
+            std::cerr << "Samples per pixel written to " << prefix
+                      << ".{ppm,pfm}" << std::endl;
+        }
+
+        // output image
+        Image image = mean_image(accumulator);
+        post_process(image, conf.exposure, conf.gamma_correction_enabled,
+                     conf.inverse_gamma);
+        if (!conf.preview.empty() &&
+            !write_preview(conf.preview, image, error)) {
+            std::cerr << error << std::endl;
+        }
+        if (conf.cameras.empty()) {
+            std::cout << image << std::endl;
+        } else {
+            const std::string path = frame_path(conf.output, frame, ".ppm");
+            std::ofstream ppm(path);
+            ppm << image << std::endl;
+            if (!ppm) {
+                std::cerr << "Cannot write " << path << std::endl;
+                return 1;
+            }
+            std::cerr << "Image written to " << path << std::endl;
+        }
+    }
+    Stats::instance().runtime_ms = runtime_ms;
+    if (loaded.chunked_tree) {
+        const auto cache_stats = loaded.chunked_tree->cache_stats();
+        std::cerr << cache_stats << std::endl;
+        // the chunks contain both the meshes and the trees
+        Stats::instance().memory.kdtree = cache_stats.peak_bytes;
     }
+    Stats::instance().end_phase("render");
 
     // output stats
     std::cerr << Stats::instance() << std::endl;
-
-    // output image
-    std::cout << image << std::endl;
+    if (!conf.stats_json.empty()) {
+        std::ofstream json(conf.stats_json);
+        write_json(json, Stats::instance());
+        json << std::endl;
+    }
     return 0;
 }
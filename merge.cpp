@@ -0,0 +1,84 @@
+#include "merge.h"
+#include "lib/accumulator.h"
+#include "lib/effects.h"
+#include "lib/partial.h"
+
+#include <docopt/docopt.h>
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+
+int main(int argc, char const* argv[]) {
+    std::map<std::string, docopt::value> args =
+        docopt::docopt(USAGE, {argv + 1, argv + argc});
+    const auto paths = args.at("<partial>").asStringList();
+    const float inverse_gamma =
+        std::stof(args.at("--inverse-gamma").asString());
+    const float exposure = std::stof(args.at("--exposure").asString());
+    const bool gamma_correction_enabled =
+        !args.at("--no-gamma-correction").asBool();
+
+    std::unique_ptr<Accumulator> accumulator;
+    Tile region = {0, 0, 0, 0}; // bounding box of the regions of the partials
+    MergedPartials merged;
+    std::string error, warning;
+    for (const auto& path : paths) {
+        Partial partial;
+        if (!read_partial(path, partial, error)) {
+            std::cerr << error << std::endl;
+            return 1;
+        }
+        if (!accumulator) {
+            accumulator.reset(new Accumulator(partial.width, partial.height));
+            region = partial.region;
+        }
+        if (!merge_partial(partial, *accumulator, merged, error, warning)) {
+            std::cerr << path << ": " << error << std::endl;
+            return 1;
+        }
+        if (!warning.empty()) {
+            std::cerr << "Warning: " << path << ": " << warning << std::endl;
+        }
+        region = {std::min(region.x0, partial.region.x0),
+                  std::min(region.y0, partial.region.y0),
+                  std::max(region.x1, partial.region.x1),
+                  std::max(region.y1, partial.region.y1)};
+        std::cerr << "Merged " << path << " (" << partial.region.x0 << ","
+                  << partial.region.y0 << " to " << partial.region.x1 << ","
+                  << partial.region.y1 << ")" << std::endl;
+    }
+
+    const size_t num_empty = std::count_if(
+        accumulator->begin(), accumulator->end(),
+        [](const Accumulator::Pixel& pixel) { return !pixel.num_samples; });
+    if (num_empty > 0) {
+        std::cerr << "Warning: " << num_empty
+                  << " pixels are not covered by any partial" << std::endl;
+    }
+
+    if (args.at("--partial")) {
+        const std::string path = args.at("--partial").asString();
+        // keyed like the partials, with the seed of the first one
+        if (!write_partial(path, *accumulator, region, merged.key,
+                           merged.regions.front().second, error)) {
+            std::cerr << error << std::endl;
+            return 1;
+        }
+    }
+
+    if (args.at("--samples-aov")) {
+        const std::string prefix = args.at("--samples-aov").asString();
+        std::ofstream ppm(prefix + ".ppm");
+        ppm << samples_image(*accumulator) << std::endl;
+        std::ofstream pfm(prefix + ".pfm", std::ios::binary);
+        write_samples_pfm(pfm, *accumulator);
+    }
+
+    Image image = mean_image(*accumulator);
+    post_process(image, exposure, gamma_correction_enabled, inverse_gamma);
+    std::cout << image << std::endl;
+    return 0;
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+static const char* USAGE =
+    R"(Usage: turner-merge <partial>... [options]
+
+Merges partial files of renders of regions of an image (cf. --region and
+--partial of the tracers) and writes the image in PPM format to stdout.
+Partials of the same pixels, e.g. rendered with different --seed, are merged
+weighted by their numbers of samples.
+
+Options:
+  --partial=<file>           Also write the merged samples to <file>, e.g.
+                             to merge them with further partials later.
+  --inverse-gamma=<float>    Inverse of gamma for gamma correction
+                             [default: 0.454545].
+  --no-gamma-correction      Disables gamma correction.
+  --exposure=<float>         Exposure [default: 1].
+  --samples-aov=<prefix>     Write the number of samples per pixel to
+                             <prefix>.ppm (gray) and <prefix>.pfm.
+)";
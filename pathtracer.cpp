@@ -11,18 +11,19 @@
  * equation, thefore it is not guaranteed that the calculated color values are
  * less than 1. E.g. an approximation of value 1 may be greater than 1.
  */
-Color trace(const Ray& ray, KDTreeIntersection& tree_intersection,
+template <typename TreeIntersection>
+Color trace(const Ray& ray, TreeIntersection& tree_intersection,
             const std::vector<Light>& lights, int depth,
             const TracerConfig& conf) {
     if (depth > conf.max_recursion_depth) {
         return {};
     }
 
-    Stats::instance().num_rays += 1;
-
     // intersection
     float dist_to_triangle, s, t;
     auto triangle_id = tree_intersection.intersect(ray, dist_to_triangle, s, t);
+    Stats::local().count_ray(depth ? RayType::INDIRECT : RayType::PRIMARY,
+                             depth, triangle_id);
     if (!triangle_id) {
         return conf.bg_color;
     }
@@ -32,6 +33,7 @@ Color trace(const Ray& ray, KDTreeIntersection& tree_intersection,
     // interpolate normal
     const auto& triangle = tree_intersection[triangle_id];
     Normal3f normal = triangle.interpolate_normal(1.f - s - t, s, t);
+    const auto& material = tree_intersection.material(triangle_id);
 
     Point3f p2 = p + Vector3f(normal * 0.0001f);
 
@@ -50,7 +52,10 @@ Color trace(const Ray& ray, KDTreeIntersection& tree_intersection,
             {p2, light_dir}, dist_to_next_triangle, s, t);
 
         // Do we get direct light?
-        if (!has_shadow || dist_to_next_triangle > dist_to_light) {
+        const bool occluded =
+            has_shadow && dist_to_next_triangle <= dist_to_light;
+        Stats::local().count_ray(RayType::SHADOW, depth, occluded);
+        if (!occluded) {
             // lambertian
             direct_lightning =
                 std::max(0.f, dot(light_dir, normal)) * light.color;
@@ -97,6 +102,11 @@ Color trace(const Ray& ray, KDTreeIntersection& tree_intersection,
     // N - number of samples
     // ρ - material color
     //
-    return triangle.diffuse * (direct_lightning * static_cast<float>(M_1_PI) +
+    return material.diffuse * (direct_lightning * static_cast<float>(M_1_PI) +
                                indirect_lightning * 2.f);
 }
+
+template Color trace(const Ray&, KDTreeIntersection&,
+                     const std::vector<Light>&, int, const TracerConfig&);
+template Color trace(const Ray&, ChunkedKDTreeIntersection&,
+                     const std::vector<Light>&, int, const TracerConfig&);
@@ -3,6 +3,7 @@
 extern const char* USAGE;
 const char* USAGE =
     R"(Usage: pathtracer <filename> [options]
+       pathtracer --serve=<socket> [options]
 
 Options:
   -w --width=<px>                   Width of the image [default: 640].
@@ -11,15 +12,66 @@ Options:
                                     [default: 1].
   --background=<3x float>           Background color [default: 0 0 0].
   -t --threads=<int>                Number of threads [default: 1].
+  --tile-size=<px>                  Edge length of the image tiles rendered by
+                                    a thread [default: 16].
+  --sampler=<name>                  Sampler of the pixels and bounces:
+                                    random, stratified, halton or sobol
+                                    [default: sobol].
   --inverse-gamma=<float>           Inverse of gamma for gamma correction
                                     [default: 0.454545].
   --no-gamma-correction             Disables gamma correction.
   --exposure=<float>                Exposure [default: 1].
   -v --verbose                      Verbose output.
+  --stats-json=<file>               Write the stats (incl. memory) as JSON to
+                                    <file>.
+  --heatmap=<prefix>                Write kd-tree traversal cost per pixel to
+                                    <prefix>.ppm (false color) and <prefix>.pfm.
+  --cache-dir=<dir>                 Directory of the kd-tree cache
+                                    [default: kdtree-cache].
+  --no-cache                        Neither read nor write the kd-tree cache.
+  --memory-limit=<MB>               Memory for the chunks of an out-of-core scene
+                                    (cf. turner-convert) [default: 1024].
+  --checkpoint=<file>               Write the accumulated samples to <file>
+                                    periodically.
+  --checkpoint-interval=<sec>       Seconds between checkpoints [default: 600].
+  --resume                          Continue from the checkpoint, if it exists.
+  --time-limit=<sec>                Render passes of --pixel-samples over the
+                                    whole image until <sec> seconds after the
+                                    start; 0 renders a single pass
+                                    [default: 0].
+  --region=<x0,y0,x1,y1>            Render only the pixels in [x0, x1) x
+                                    [y0, y1).
+  --seed=<int>                      Seed of the random numbers, e.g. to render
+                                    a region in several processes [default: 0].
+  --partial=<file>                  Write the samples of the region to <file>
+                                    for turner-merge.
+  --cameras=<file>                  Render one image per camera in <file> (cf.
+                                    README) against the same scene and kd-tree.
+  --output=<prefix>                 Write the image of the i-th camera to
+                                    <prefix>NNNN.ppm [default: frame].
+  --serve=<socket>                  Keep scenes loaded and render the jobs sent
+                                    to the Unix socket <socket> (cf.
+                                    turner-client).
+  --max-scenes=<int>                Scenes kept loaded by --serve [default: 4].
+  --preview=<file>                  Write coarse previews and then the image to
+                                    <file> while rendering.
+  --telemetry=<file>                Write progress, rays per second, ETA, memory
+                                    and busy time per thread as JSON lines to
+                                    <file>, e.g. /dev/fd/3.
+  --telemetry-interval=<sec>        Seconds between telemetry lines
+                                    [default: 1].
 
 Pathtracer options:
   -d --max-depth=<int>              Maximum recursion depth for raytracing
                                     [default: 3].
   -p --pixel-samples=<int>          Number of samples per pixel [default: 1].
   -m --monte-carlo-samples=<int>    Monto Carlo samples per ray [default: 8].
+  --adaptive-threshold=<float>      Add batches of --pixel-samples to a pixel
+                                    until the standard error of its mean is
+                                    below this fraction of the mean; 0
+                                    disables adaptive sampling [default: 0].
+  --max-pixel-samples=<int>         Maximum number of samples per pixel with
+                                    adaptive sampling [default: 64].
+  --samples-aov=<prefix>            Write the number of samples per pixel to
+                                    <prefix>.ppm (gray) and <prefix>.pfm.
 )";
@@ -9,19 +9,24 @@
 #include "lib/radiosity.h"
 #include "lib/range.h"
 #include "lib/raster.h"
+#include "lib/render_context.h"
 #include "lib/runtime.h"
+#include "lib/scene.h"
+#include "lib/scene_file.h"
 #include "lib/stats.h"
+#include "lib/telemetry.h"
+#include "lib/tile_scheduler.h"
 #include "lib/triangle.h"
 #include "lib/xorshift.h"
 #include "trace.h"
 
-#include <ThreadPool.h>
 #include <assimp/Importer.hpp>  // C++ importer interface
 #include <assimp/postprocess.h> // Post processing flags
 #include <assimp/scene.h>       // Output data structure
 #include <docopt/docopt.h>
 
 #include <array>
+#include <fstream>
 #include <iostream>
 #include <map>
 #include <math.h>
@@ -32,11 +37,10 @@ using Point2f = turner::Point2f;
 
 Color trace(const Ray& ray, KDTreeIntersection& tree_intersection,
             const std::vector<Color>& radiosity, const RadiosityConfig& conf) {
-    Stats::instance().num_rays += 1;
-
     // intersection
     float dist_to_triangle, s, t;
     auto triangle_id = tree_intersection.intersect(ray, dist_to_triangle, s, t);
+    Stats::local().count_ray(RayType::PRIMARY, 0, triangle_id);
     if (!triangle_id) {
         return conf.bg_color;
     }
@@ -47,11 +51,10 @@ Color trace(const Ray& ray, KDTreeIntersection& tree_intersection,
 Color trace(const Ray& ray, KDTreeIntersection& tree_intersection,
             const RadiosityMesh& mesh, const FaceRadiosityHandle& rad,
             const RadiosityConfig& conf) {
-    Stats::instance().num_rays += 1;
-
     // intersection
     float dist_to_triangle, s, t;
     auto triangle_id = tree_intersection.intersect(ray, dist_to_triangle, s, t);
+    Stats::local().count_ray(RayType::PRIMARY, 0, triangle_id);
     if (!triangle_id) {
         return conf.bg_color;
     }
@@ -64,11 +67,10 @@ Color trace_gouraud(const Ray& ray, KDTreeIntersection& tree_intersection,
                     const RadiosityMesh& mesh,
                     const VertexRadiosityHandle& vrad,
                     const RadiosityConfig& conf) {
-    Stats::instance().num_rays += 1;
-
     // intersection
     float dist_to_triangle, s, t;
     auto triangle_id = tree_intersection.intersect(ray, dist_to_triangle, s, t);
+    Stats::local().count_ray(RayType::PRIMARY, 0, triangle_id);
     if (!triangle_id) {
         return conf.bg_color;
     }
@@ -91,7 +93,8 @@ Color trace_gouraud(const Ray& ray, KDTreeIntersection& tree_intersection,
     return rad;
 }
 
-std::vector<Color> compute_radiosity(KDTree& tree) {
+// The form factors and the solver are reported to telemetry, if any.
+std::vector<Color> compute_radiosity(KDTree& tree, Telemetry* telemetry) {
     using MatrixF = math::Matrix<float>;
     using VectorF = math::Vector<float>;
     size_t num_triangles = tree.num_triangles();
@@ -106,7 +109,11 @@ std::vector<Color> compute_radiosity(KDTree& tree) {
     VectorF E_b(num_triangles);
 
     KDTreeIntersection tree_intersection(tree);
+    if (telemetry) {
+        telemetry->start_phase("Form factors", num_triangles);
+    }
     for (size_t i = 0; i < num_triangles; ++i) {
+        Telemetry::Busy busy(telemetry, 0);
         // construct form factor matrix (F_ij)
         for (size_t j = i; j < num_triangles; ++j) {
             if (i == j) {
@@ -117,17 +124,20 @@ std::vector<Color> compute_radiosity(KDTree& tree) {
             }
         }
 
-        const auto& triangle = tree[i];
+        const auto& material = tree.material(i);
 
         // construct material diagonal matrix (ρ_i)
-        rho_r(i) = triangle.diffuse.r;
-        rho_g(i) = triangle.diffuse.g;
-        rho_b(i) = triangle.diffuse.b;
+        rho_r(i) = material.diffuse.r;
+        rho_g(i) = material.diffuse.g;
+        rho_b(i) = material.diffuse.b;
 
         // construct vector of emitters
-        E_r(i) = triangle.emissive.r;
-        E_g(i) = triangle.emissive.g;
-        E_b(i) = triangle.emissive.b;
+        E_r(i) = material.emissive.r;
+        E_g(i) = material.emissive.g;
+        E_b(i) = material.emissive.b;
+        if (telemetry) {
+            telemetry->set_completed(i + 1);
+        }
     }
 
     // solve radiosity equation with Gauß-Seidel Iteration
@@ -149,136 +159,96 @@ std::vector<Color> compute_radiosity(KDTree& tree) {
         }
     }
 
-    // We intialize B with emitter values.
-    auto B_r = gauss_seidel(K_r, E_r, E_r, 10);
-    auto B_g = gauss_seidel(K_g, E_g, E_g, 10);
-    auto B_b = gauss_seidel(K_b, E_b, E_g, 10);
+    Stats::instance().memory.matrix = F.memory_bytes() + K_r.memory_bytes() +
+                                      K_g.memory_bytes() + K_b.memory_bytes();
 
-    // combine results in a vector
-    std::vector<Color> B;
-    for (size_t i = 0; i != num_triangles; ++i) {
-        B.emplace_back(B_r(i) > 0 ? B_r(i) : 0, B_g(i) > 0 ? B_g(i) : 0,
-                       B_b(i) > 0 ? B_b(i) : 0, 1.f);
+    if (telemetry) {
+        telemetry->start_phase("Solve", 1);
     }
-    return B;
-}
-
-Triangles triangles_from_scene(const aiScene* scene) {
-    Triangles triangles;
-    for (auto node : make_range(scene->mRootNode->mChildren,
-                                scene->mRootNode->mNumChildren)) {
-        if (node->mNumMeshes == 0) {
-            continue;
-        }
-
-        const auto& T = node->mTransformation;
-        const aiMatrix3x3 Tp(T); // trafo without translation
-
-        for (auto mesh_index : make_range(node->mMeshes, node->mNumMeshes)) {
-            const auto& mesh = *scene->mMeshes[mesh_index];
-            const auto& material = scene->mMaterials[mesh.mMaterialIndex];
-
-            aiColor4D ambient, diffuse, reflective, emissive;
-            material->Get(AI_MATKEY_COLOR_AMBIENT, ambient);
-            material->Get(AI_MATKEY_COLOR_DIFFUSE, diffuse);
-            material->Get(AI_MATKEY_COLOR_REFLECTIVE, reflective);
-            material->Get(AI_MATKEY_COLOR_EMISSIVE, emissive);
-
-            float reflectivity = 0.f;
-            material->Get(AI_MATKEY_REFLECTIVITY, reflectivity);
-
-            for (aiFace face : make_range(mesh.mFaces, mesh.mNumFaces)) {
-                assert(face.mNumIndices == 3);
-
-                // convert to our internal Vec = Vector3f type
-                aiVector3D aiv0 = T * mesh.mVertices[face.mIndices[0]];
-                aiVector3D aiv1 = T * mesh.mVertices[face.mIndices[1]];
-                aiVector3D aiv2 = T * mesh.mVertices[face.mIndices[2]];
-
-                aiVector3D ain0 = Tp * mesh.mNormals[face.mIndices[0]];
-                aiVector3D ain1 = Tp * mesh.mNormals[face.mIndices[1]];
-                aiVector3D ain2 = Tp * mesh.mNormals[face.mIndices[2]];
-
-                Point3f v0(aiv0.x, aiv0.y, aiv0.z);
-                Point3f v1(aiv1.x, aiv1.y, aiv1.z);
-                Point3f v2(aiv2.x, aiv2.y, aiv2.z);
-
-                Normal3f n0(ain0.x, ain0.y, ain0.z);
-                Normal3f n1(ain1.x, ain1.y, ain1.z);
-                Normal3f n2(ain2.x, ain2.y, ain2.z);
-
-                triangles.push_back(Triangle{// vertices
-                                             {v0, v1, v2},
-                                             // normals
-                                             {n0, n1, n2},
-                                             ambient,
-                                             diffuse,
-                                             emissive,
-                                             reflective,
-                                             reflectivity});
-            }
+    std::vector<Color> B;
+    {
+        Telemetry::Busy busy(telemetry, 0);
+
+        // We intialize B with emitter values.
+        auto B_r = gauss_seidel(K_r, E_r, E_r, 10);
+        auto B_g = gauss_seidel(K_g, E_g, E_g, 10);
+        auto B_b = gauss_seidel(K_b, E_b, E_g, 10);
+
+        // combine results in a vector
+        for (size_t i = 0; i != num_triangles; ++i) {
+            B.emplace_back(B_r(i) > 0 ? B_r(i) : 0, B_g(i) > 0 ? B_g(i) : 0,
+                           B_b(i) > 0 ? B_b(i) : 0, 1.f);
         }
     }
-    return triangles;
+    if (telemetry) {
+        telemetry->set_completed(1);
+    }
+    return B;
 }
 
 Image raycast(const KDTree& tree, const RadiosityConfig& conf,
               const Camera& cam, const std::vector<Color>& radiosity,
-              Image&& image) {
+              Image&& image, Telemetry* telemetry) {
     Runtime rt(Stats::instance().runtime_ms);
 
     std::cerr << "Rendering          ";
 
-    ThreadPool pool(conf.num_threads);
-    std::vector<std::future<void>> tasks;
+    TileScheduler scheduler(
+        make_tiles(image.width(), image.height(), conf.tile_size),
+        conf.num_threads);
+    auto contexts =
+        make_render_contexts<KDTreeIntersection>(tree, conf.num_threads);
 
     Point3f cam_pos(cam.mPosition.x, cam.mPosition.y, cam.mPosition.z);
 
-    for (size_t y = 0; y < image.height(); ++y) {
-        tasks.emplace_back(pool.enqueue(
-            [&image, &cam, &tree, &radiosity, y, &conf, &cam_pos]() {
-                // TODO: we need only one tree intersection per thread, not task
-                KDTreeIntersection tree_intersection(tree);
+    auto progress_bar =
+        ProgressBar(std::cerr, "Rendering", scheduler.num_tiles());
+    if (telemetry) {
+        telemetry->start_phase("Raycast", scheduler.num_tiles());
+    }
+    scheduler.run(
+        [&](const Tile& tile, size_t worker) {
+            Telemetry::Busy busy(telemetry, worker);
+            auto& ctx = *contexts[worker];
 
-                for (size_t x = 0; x < image.width(); ++x) {
+            for (size_t y = tile.y0; y < tile.y1; ++y) {
+                for (size_t x = tile.x0; x < tile.x1; ++x) {
                     auto cam_dir = cam.raster2cam(
                         {static_cast<float>(x), static_cast<float>(y)},
                         image.width(), image.height());
 
-                    Stats::instance().num_prim_rays += 1;
-                    image(x, y) += trace({cam_pos, cam_dir}, tree_intersection,
-                                         radiosity, conf);
-
-                    image(x, y) = exposure(image(x, y), conf.exposure);
-
-                    // gamma correction
-                    if (conf.gamma_correction_enabled) {
-                        image(x, y) = gamma(image(x, y), conf.inverse_gamma);
-                    }
+                    image(x, y) += trace({cam_pos, cam_dir},
+                                         ctx.tree_intersection, radiosity,
+                                         conf);
                 }
-            }));
-    }
-
-    long completed = 0;
-    auto progress_bar = ProgressBar(std::cerr, "Rendering", tasks.size());
-    for (auto& task : tasks) {
-        task.get();
-        completed += 1;
-        progress_bar.update(completed);
-    }
+            }
+        },
+        [&](size_t completed) {
+            progress_bar.update(completed);
+            if (telemetry) {
+                telemetry->set_completed(completed);
+            }
+        });
     std::cerr << std::endl;
 
+    post_process(image, conf.exposure, conf.gamma_correction_enabled,
+                 conf.inverse_gamma);
+
     return image;
 }
 
 Image raycast(const KDTree& tree, const RadiosityConfig& conf,
-              const Camera& cam, const RadiosityMesh& mesh, Image&& image) {
+              const Camera& cam, const RadiosityMesh& mesh, Image&& image,
+              Telemetry* telemetry) {
     Runtime rt(Stats::instance().runtime_ms);
 
     std::cerr << "Rendering          ";
 
-    ThreadPool pool(conf.num_threads);
-    std::vector<std::future<void>> tasks;
+    TileScheduler scheduler(
+        make_tiles(image.width(), image.height(), conf.tile_size),
+        conf.num_threads);
+    auto contexts =
+        make_render_contexts<KDTreeIntersection>(tree, conf.num_threads);
 
     FaceRadiosityHandle frad;
     bool exists = false;
@@ -291,59 +261,57 @@ Image raycast(const KDTree& tree, const RadiosityConfig& conf,
 
     Point3f cam_pos(cam.mPosition.x, cam.mPosition.y, cam.mPosition.z);
 
-    for (size_t y = 0; y < image.height(); ++y) {
-        tasks.emplace_back(pool.enqueue([&image, &cam, &tree, &mesh, &frad,
-                                         &vrad, y, &conf, &cam_pos]() {
-            // TODO: we need only one tree intersection per thread, not task
-            KDTreeIntersection tree_intersection(tree);
-
-            for (size_t x = 0; x < image.width(); ++x) {
-                auto cam_dir = cam.raster2cam(
-                    {static_cast<float>(x), static_cast<float>(y)},
-                    image.width(), image.height());
-
-                Stats::instance().num_prim_rays += 1;
-
-                if (!conf.gouraud_enabled) {
-                    image(x, y) += trace({cam_pos, cam_dir}, tree_intersection,
-                                         mesh, frad, conf);
-                } else {
-                    image(x, y) +=
-                        trace_gouraud({cam_pos, cam_dir}, tree_intersection,
-                                      mesh, vrad, conf);
-                }
+    if (telemetry) {
+        telemetry->start_phase("Raycast", scheduler.num_tiles());
+    }
+    scheduler.run(
+        [&](const Tile& tile, size_t worker) {
+            Telemetry::Busy busy(telemetry, worker);
+            auto& ctx = *contexts[worker];
 
-                image(x, y) = exposure(image(x, y), conf.exposure);
+            for (size_t y = tile.y0; y < tile.y1; ++y) {
+                for (size_t x = tile.x0; x < tile.x1; ++x) {
+                    auto cam_dir = cam.raster2cam(
+                        {static_cast<float>(x), static_cast<float>(y)},
+                        image.width(), image.height());
 
-                // gamma correction
-                if (conf.gamma_correction_enabled) {
-                    image(x, y) = gamma(image(x, y), conf.inverse_gamma);
+                    if (!conf.gouraud_enabled) {
+                        image(x, y) +=
+                            trace({cam_pos, cam_dir}, ctx.tree_intersection,
+                                  mesh, frad, conf);
+                    } else {
+                        image(x, y) += trace_gouraud({cam_pos, cam_dir},
+                                                     ctx.tree_intersection,
+                                                     mesh, vrad, conf);
+                    }
                 }
             }
-        }));
-    }
-
-    long completed = 0;
-
-    for (auto& task : tasks) {
-        task.get();
-        completed += 1;
-        float progress = static_cast<float>(completed) / tasks.size();
-        int bar_width = progress * 20;
-        std::cerr << "\rRendering          "
-                  << "[" << std::string(bar_width, '-')
-                  << std::string(20 - bar_width, ' ') << "] "
-                  << std::setfill(' ') << std::setw(6) << std::fixed
-                  << std::setprecision(2) << (progress * 100.0) << '%';
-        std::cerr.flush();
-    }
+        },
+        [&](size_t completed) {
+            float progress =
+                static_cast<float>(completed) / scheduler.num_tiles();
+            int bar_width = progress * 20;
+            std::cerr << "\rRendering          "
+                      << "[" << std::string(bar_width, '-')
+                      << std::string(20 - bar_width, ' ') << "] "
+                      << std::setfill(' ') << std::setw(6) << std::fixed
+                      << std::setprecision(2) << (progress * 100.0) << '%';
+            std::cerr.flush();
+            if (telemetry) {
+                telemetry->set_completed(completed);
+            }
+        });
     std::cerr << std::endl;
 
+    post_process(image, conf.exposure, conf.gamma_correction_enabled,
+                 conf.inverse_gamma);
+
     return image;
 }
 
 Image render_feature_lines(const KDTree& tree, const RadiosityConfig& conf,
-                           const Camera& cam, Image&& image) {
+                           const Camera& cam, Image&& image,
+                           Telemetry* telemetry) {
     // Render feature lines after
     // "Ray Tracing NPR-Style Feature Lines" by Choudhury and Parker.
     std::cerr << "Drawing mesh lines ";
@@ -355,60 +323,68 @@ Image render_feature_lines(const KDTree& tree, const RadiosityConfig& conf,
         Point2f{0.f, offset / 2},    Point2f{offset / 2, offset},
         Point2f{offset, offset / 2}, Point2f{offset / 2, 0.f}};
 
-    ThreadPool pool(conf.num_threads);
-    std::vector<std::future<void>> mesh_tasks;
+    TileScheduler scheduler(
+        make_tiles(image.width(), image.height(), conf.tile_size),
+        conf.num_threads);
+    auto contexts =
+        make_render_contexts<KDTreeIntersection>(tree, conf.num_threads);
 
     Point3f cam_pos(cam.mPosition.x, cam.mPosition.y, cam.mPosition.z);
 
-    for (size_t y = 0; y < image.height(); ++y) {
-        mesh_tasks.emplace_back(pool.enqueue([&image, offsets, &cam, &tree, y,
-                                              &conf, &cam_pos]() {
-            // TODO: we need only one tree intersection per thread, not task
-            KDTreeIntersection tree_intersection(tree);
-
-            for (size_t x = 0; x < image.width(); ++x) {
-                float dist_to_triangle, s, t;
-                std::unordered_set<KDTreeIntersection::OptionalId> triangle_ids;
-
-                // Shoot center ray.
-                auto cam_dir = cam.raster2cam({x + 0.5f, y + 0.5f},
-                                              image.width(), image.height());
-                auto center_id = tree_intersection.intersect(
-                    {cam_pos, cam_dir}, dist_to_triangle, s, t);
-                triangle_ids.insert(center_id);
-
-                // Sample disc rays around center.
-                // TODO: Sample disc with Poisson or similar.
-                for (auto offset : offsets) {
-                    cam_dir = cam.raster2cam({x + offset.x, y + offset.y},
-                                             image.width(), image.height());
-                    auto id = tree_intersection.intersect(
+    if (telemetry) {
+        telemetry->start_phase("Feature lines", scheduler.num_tiles());
+    }
+    scheduler.run(
+        [&](const Tile& tile, size_t worker) {
+            Telemetry::Busy busy(telemetry, worker);
+            auto& tree_intersection = contexts[worker]->tree_intersection;
+
+            for (size_t y = tile.y0; y < tile.y1; ++y) {
+                for (size_t x = tile.x0; x < tile.x1; ++x) {
+                    float dist_to_triangle, s, t;
+                    std::unordered_set<KDTreeIntersection::OptionalId>
+                        triangle_ids;
+
+                    // Shoot center ray.
+                    auto cam_dir = cam.raster2cam(
+                        {x + 0.5f, y + 0.5f}, image.width(), image.height());
+                    auto center_id = tree_intersection.intersect(
                         {cam_pos, cam_dir}, dist_to_triangle, s, t);
-                    triangle_ids.insert(id);
-                }
+                    triangle_ids.insert(center_id);
+
+                    // Sample disc rays around center.
+                    // TODO: Sample disc with Poisson or similar.
+                    for (auto offset : offsets) {
+                        cam_dir = cam.raster2cam({x + offset.x, y + offset.y},
+                                                 image.width(),
+                                                 image.height());
+                        auto id = tree_intersection.intersect(
+                            {cam_pos, cam_dir}, dist_to_triangle, s, t);
+                        triangle_ids.insert(id);
+                    }
 
-                constexpr float M_2 = 0.5f * offsets.size();
-                // All hit primitives except the one hit by center.
-                const float m = triangle_ids.size() - 1.f;
-                float e = std::pow(std::abs(m - M_2) / M_2, 10);
-                image(x, y) = image(x, y) * e;
+                    constexpr float M_2 = 0.5f * offsets.size();
+                    // All hit primitives except the one hit by center.
+                    const float m = triangle_ids.size() - 1.f;
+                    float e = std::pow(std::abs(m - M_2) / M_2, 10);
+                    image(x, y) = image(x, y) * e;
+                }
             }
-        }));
-    }
-
-    size_t completed = 0;
-    for (auto& task : mesh_tasks) {
-        task.get();
-        completed += 1;
-        float progress = static_cast<float>(completed) / mesh_tasks.size();
-        int bar_width = progress * 20;
-        std::cerr << "\rDrawing mesh lines "
-                  << "[" << std::string(bar_width, '-')
-                  << std::string(20 - bar_width, ' ') << "] "
-                  << std::setfill(' ') << std::setw(6) << std::fixed
-                  << std::setprecision(2) << (progress * 100.0) << '%';
-        std::cerr.flush();
-    }
+        },
+        [&](size_t completed) {
+            float progress =
+                static_cast<float>(completed) / scheduler.num_tiles();
+            int bar_width = progress * 20;
+            std::cerr << "\rDrawing mesh lines "
+                      << "[" << std::string(bar_width, '-')
+                      << std::string(20 - bar_width, ' ') << "] "
+                      << std::setfill(' ') << std::setw(6) << std::fixed
+                      << std::setprecision(2) << (progress * 100.0) << '%';
+            std::cerr.flush();
+            if (telemetry) {
+                telemetry->set_completed(completed);
+            }
+        });
     std::cerr << std::endl;
 
     return image;
@@ -487,35 +463,28 @@ Image render_radiosity_mesh(const RadiosityMesh& mesh, const Camera& cam,
 int main(int argc, char const* argv[]) {
     RadiosityConfig conf = RadiosityConfig::from_docopt(
         docopt::docopt(USAGE, {argv + 1, argv + argc}, true, "radiosity"));
+    sampling::sampler_type() = conf.sampler;
     // import scene
-    Assimp::Importer importer;
-    const aiScene* scene =
-        importer.ReadFile(conf.filename.c_str(),
-                          aiProcess_CalcTangentSpace | aiProcess_Triangulate |
-                              aiProcess_JoinIdenticalVertices |
-                              aiProcess_GenNormals | aiProcess_SortByPType);
-
-    if (!scene) {
-        std::cout << importer.GetErrorString() << std::endl;
+    SceneLoadTimes load_times;
+    Scene scene;
+    std::string error;
+    if (!load_scene(conf.filename, scene, error, conf.num_threads,
+                    &load_times)) {
+        std::cout << error << std::endl;
         return 1;
     }
-
-    // setup camera
-    assert(scene->mNumCameras == 1); // we can deal only with a single camera
-    auto& sceneCam = *scene->mCameras[0];
-    if (sceneCam.mAspect == 0) {
-        sceneCam.mAspect = conf.aspect;
-    } else {
-        conf.aspect = sceneCam.mAspect;
+    if (!scene.chunks.empty()) {
+        std::cout << "Out-of-core scenes are only supported by the tracers"
+                  << std::endl;
+        return 1;
     }
-    auto* camNode = scene->mRootNode->FindNode(sceneCam.mName);
-    assert(camNode != nullptr);
-    const Camera cam(camNode->mTransformation, sceneCam);
+
+    const Camera cam = scene.make_camera(conf.aspect);
 
     // Scene triangles
-    auto triangles = triangles_from_scene(scene);
-    Stats::instance().num_triangles = triangles.size();
-    KDTree tree(std::move(triangles));
+    KDTree tree(std::move(scene.mesh));
+    Stats::instance().num_triangles = tree.num_triangles();
+    std::cerr << load_times << std::endl;
 
     // Image
     int width = conf.width;
@@ -523,6 +492,16 @@ int main(int argc, char const* argv[]) {
     int height = width / cam.mAspect;
     Image image(width, height);
 
+    Stats::instance().memory.triangles = tree.mesh().memory_bytes();
+    Stats::instance().memory.kdtree = tree.memory_bytes();
+    Stats::instance().memory.framebuffer = image.memory_bytes();
+    Stats::instance().end_phase("load");
+
+    std::ofstream telemetry_file;
+    const auto telemetry =
+        open_telemetry(conf.telemetry, conf.telemetry_interval,
+                       conf.num_threads, telemetry_file);
+
     // Compute radiosity
     std::vector<Color> radiosity;
 
@@ -533,15 +512,19 @@ int main(int argc, char const* argv[]) {
             std::cerr << conf << std::endl;
         }
 
-        radiosity = compute_radiosity(tree);
-        image = raycast(tree, conf, cam, radiosity, std::move(image));
+        radiosity = compute_radiosity(tree, telemetry.get());
+        Stats::instance().end_phase("radiosity");
+        image = raycast(tree, conf, cam, radiosity, std::move(image),
+                        telemetry.get());
         if (conf.mesh == RadiosityConfig::SIMPLE_MESH) {
             image = render_mesh(tree.triangles(), cam, std::move(image));
         } else if (conf.mesh == RadiosityConfig::FEATURE_MESH) {
-            image = render_feature_lines(tree, conf, cam, std::move(image));
+            image = render_feature_lines(tree, conf, cam, std::move(image),
+                                         telemetry.get());
         }
     } else if (conf.mode == RadiosityConfig::HIERARCHICAL) {
-        conf.min_area = ::min(tree.triangles().begin(), tree.triangles().end(),
+        const auto triangles = tree.triangles();
+        conf.min_area = ::min(triangles.begin(), triangles.end(),
                               [](const Triangle& tri) { return tri.area(); });
         conf.min_area /= pow(4, conf.max_subdivisions);
         if (conf.verbose) {
@@ -557,7 +540,8 @@ int main(int argc, char const* argv[]) {
         }
 
         HierarchicalRadiosity model(tree, conf.F_eps, conf.min_area,
-                                    conf.BF_eps, conf.max_iterations);
+                                    conf.BF_eps, conf.max_iterations,
+                                    telemetry.get());
         try {
             model.compute();
         } catch (std::runtime_error e) {
@@ -571,19 +555,29 @@ int main(int argc, char const* argv[]) {
         Stats::instance().num_triangles = refined_tree.num_triangles();
         Stats::instance().kdtree_height = refined_tree.height();
 
+        // the refined tree lives next to the one of the scene
+        auto& memory = Stats::instance().memory;
+        memory.triangles += refined_tree.mesh().memory_bytes();
+        memory.kdtree += refined_tree.memory_bytes();
+        memory.radiosity_mesh = memory_bytes(model.mesh());
+        memory.hierarchy = model.hierarchy_bytes();
+        memory.links = model.links_bytes();
+        Stats::instance().end_phase("radiosity");
+
         if (conf.exact_hierarchical_enabled) {
-            radiosity = compute_radiosity(refined_tree);
-            image =
-                raycast(refined_tree, conf, cam, radiosity, std::move(image));
+            radiosity = compute_radiosity(refined_tree, telemetry.get());
+            image = raycast(refined_tree, conf, cam, radiosity,
+                            std::move(image), telemetry.get());
         } else {
             image = raycast(refined_tree, conf, cam, model.mesh(),
-                            std::move(image));
+                            std::move(image), telemetry.get());
         }
 
         if (conf.mesh == RadiosityConfig::SIMPLE_MESH) {
             image = render_mesh(tree.triangles(), cam, std::move(image));
         } else if (conf.mesh == RadiosityConfig::FEATURE_MESH) {
-            image = render_feature_lines(tree, conf, cam, std::move(image));
+            image = render_feature_lines(tree, conf, cam, std::move(image),
+                                         telemetry.get());
         }
 
         if (conf.links_enabled) {
@@ -591,8 +585,15 @@ int main(int argc, char const* argv[]) {
         }
     }
 
+    Stats::instance().end_phase("render");
+
     // output stats
     std::cerr << Stats::instance() << std::endl;
+    if (!conf.stats_json.empty()) {
+        std::ofstream json(conf.stats_json);
+        write_json(json, Stats::instance());
+        json << std::endl;
+    }
 
     // output image
     std::cout << image << std::endl;
@@ -11,11 +11,22 @@ Options:
                                 used. Otherwise default value is 1.
   --background=<3x float>       Background color [default: 0 0 0].
   -t --threads=<int>            Number of threads [default: 1].
+  --tile-size=<px>              Edge length of the image tiles rendered by
+                                a thread [default: 16].
+  --sampler=<name>              Sampler of the form factors: random,
+                                stratified, halton or sobol [default: sobol].
   --inverse-gamma=<float>       Inverse of gamma for gamma correction
                                 [default: 0.454545].
   --no-gamma-correction         Disables gamma correction.
   -e --exposure=<float>         Exposure of the image [default: 1.0].
   -v --verbose                  Verbose output.
+  --stats-json=<file>           Write the stats (incl. memory) as JSON to
+                                <file>.
+  --telemetry=<file>            Write progress, rays per second, ETA,
+                                memory and busy time per thread as JSON
+                                lines to <file>, e.g. /dev/fd/3.
+  --telemetry-interval=<sec>    Seconds between telemetry lines
+                                [default: 1].
 
 Hierarchical radiosity options:
   --form-factor-eps=<float>     Link when form factor estimate is below
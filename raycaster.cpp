@@ -4,21 +4,27 @@
 #include "lib/triangle.h"
 #include "trace.h"
 
-Color trace(const Ray& ray, KDTreeIntersection& tree_intersection,
+template <typename TreeIntersection>
+Color trace(const Ray& ray, TreeIntersection& tree_intersection,
             const std::vector<Light>& /* lights */, int /* depth */,
             const TracerConfig& conf) {
     // intersection
     float dist_to_triangle, s, t;
     auto triangle_id = tree_intersection.intersect(ray, dist_to_triangle, s, t);
+    Stats::local().count_ray(RayType::PRIMARY, 0, triangle_id);
     if (!triangle_id) {
         return conf.bg_color;
     }
 
-    Stats::instance().num_rays += 1;
-    auto res = tree_intersection[triangle_id].diffuse;
+    auto res = tree_intersection.material(triangle_id).diffuse;
 
     // The light is at camera position. The farther away an object the darker it
     // is. It's not visible beyond max visibility.
     res.a = clamp(1.f - (dist_to_triangle / conf.max_visibility), 0.f, 1.f);
     return res;
 }
+
+template Color trace(const Ray&, KDTreeIntersection&,
+                     const std::vector<Light>&, int, const TracerConfig&);
+template Color trace(const Ray&, ChunkedKDTreeIntersection&,
+                     const std::vector<Light>&, int, const TracerConfig&);
@@ -3,11 +3,10 @@
 #include "lib/stats.h"
 #include "trace.h"
 
-Color trace(const Ray& ray, KDTreeIntersection& tree_intersection,
+template <typename TreeIntersection>
+Color trace(const Ray& ray, TreeIntersection& tree_intersection,
             const std::vector<Light>& lights, int depth,
             const TracerConfig& conf) {
-    Stats::instance().num_rays += 1;
-
     if (depth > conf.max_recursion_depth) {
         return {};
     }
@@ -17,6 +16,8 @@ Color trace(const Ray& ray, KDTreeIntersection& tree_intersection,
     // intersection
     float dist_to_triangle, s, t;
     auto triangle_id = tree_intersection.intersect(ray, dist_to_triangle, s, t);
+    Stats::local().count_ray(depth ? RayType::INDIRECT : RayType::PRIMARY,
+                             depth, triangle_id);
     if (!triangle_id) {
         return conf.bg_color;
     }
@@ -29,10 +30,11 @@ Color trace(const Ray& ray, KDTreeIntersection& tree_intersection,
     // interpolate normal
     const auto& triangle = tree_intersection[triangle_id];
     auto normal = triangle.interpolate_normal(1.f - s - t, s, t);
+    const auto& material = tree_intersection.material(triangle_id);
 
     // direct light
     auto direct_lightning =
-        lambertian(light_dir, normal, triangle.diffuse, light.color);
+        lambertian(light_dir, normal, material.diffuse, light.color);
 
     // move slightly in direction of normal
     Point3f p2 = p + Vector3f(normal * 0.0001f);
@@ -40,15 +42,15 @@ Color trace(const Ray& ray, KDTreeIntersection& tree_intersection,
     auto color = direct_lightning;
 
     // reflection
-    if (triangle.reflectivity > 0) {
+    if (material.reflectivity > 0) {
         // compute reflected ray from incident ray
         auto reflected_ray_dir =
             ray.d - Vector3f(2.f * dot(normal, ray.d) * normal);
         auto reflected_color = trace({p2, reflected_ray_dir}, tree_intersection,
                                      lights, depth + 1, conf);
 
-        color = (1.f - triangle.reflectivity) * direct_lightning +
-                triangle.reflectivity * triangle.reflective * reflected_color;
+        color = (1.f - material.reflectivity) * direct_lightning +
+                material.reflectivity * material.reflective * reflected_color;
     }
 
     // shadow
@@ -59,9 +61,16 @@ Color trace(const Ray& ray, KDTreeIntersection& tree_intersection,
     auto has_shadow = tree_intersection.intersect({p2, light_dir},
                                                   dist_to_next_triangle, s, t);
 
-    if (has_shadow && dist_to_next_triangle < dist_to_light) {
+    const bool occluded = has_shadow && dist_to_next_triangle < dist_to_light;
+    Stats::local().count_ray(RayType::SHADOW, depth, occluded);
+    if (occluded) {
         color -= color * conf.shadow_intensity;
     }
 
     return color;
 }
+
+template Color trace(const Ray&, KDTreeIntersection&,
+                     const std::vector<Light>&, int, const TracerConfig&);
+template Color trace(const Ray&, ChunkedKDTreeIntersection&,
+                     const std::vector<Light>&, int, const TracerConfig&);
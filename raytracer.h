@@ -3,6 +3,7 @@
 extern const char* USAGE;
 const char* USAGE =
     R"(Usage: raytracer <filename> [options]
+       raytracer --serve=<socket> [options]
 
 Options:
   -w --width=<px>           Width of the image [default: 640].
@@ -11,11 +12,51 @@ Options:
                             [default: 1].
   --background=<3x float>   Background color [default: 0 0 0].
   -t --threads=<int>        Number of threads [default: 1].
+  --tile-size=<px>          Edge length of the image tiles rendered by
+                            a thread [default: 16].
+  --sampler=<name>          Sampler of the pixels: random, stratified,
+                            halton or sobol [default: sobol].
   --inverse-gamma=<float>   Inverse of gamma for gamma correction
                             [default: 0.454545].
   --no-gamma-correction     Disables gamma correction.
   --exposure=<float>        Exposure [default: 1].
   -v --verbose              Verbose output.
+  --stats-json=<file>       Write the stats (incl. memory) as JSON to
+                            <file>.
+  --heatmap=<prefix>        Write kd-tree traversal cost per pixel to
+                            <prefix>.ppm (false color) and <prefix>.pfm.
+  --cache-dir=<dir>         Directory of the kd-tree cache
+                            [default: kdtree-cache].
+  --no-cache                Neither read nor write the kd-tree cache.
+  --memory-limit=<MB>       Memory for the chunks of an out-of-core scene
+                            (cf. turner-convert) [default: 1024].
+  --checkpoint=<file>       Write the accumulated samples to <file>
+                            periodically.
+  --checkpoint-interval=<sec>
+                            Seconds between checkpoints [default: 600].
+  --resume                  Continue from the checkpoint, if it exists.
+  --time-limit=<sec>        Render passes over the whole image until <sec>
+                            seconds after the start; 0 renders a single pass
+                            [default: 0].
+  --region=<x0,y0,x1,y1>    Render only the pixels in [x0, x1) x [y0, y1).
+  --seed=<int>              Seed of the random numbers, e.g. to render a
+                            region in several processes [default: 0].
+  --partial=<file>          Write the samples of the region to <file> for
+                            turner-merge.
+  --cameras=<file>          Render one image per camera in <file> (cf.
+                            README) against the same scene and kd-tree.
+  --output=<prefix>         Write the image of the i-th camera to
+                            <prefix>NNNN.ppm [default: frame].
+  --serve=<socket>          Keep scenes loaded and render the jobs sent to
+                            the Unix socket <socket> (cf. turner-client).
+  --max-scenes=<int>        Scenes kept loaded by --serve [default: 4].
+  --preview=<file>          Write coarse previews and then the image
+                            to <file> while rendering.
+  --telemetry=<file>        Write progress, rays per second, ETA,
+                            memory and busy time per thread as JSON
+                            lines to <file>, e.g. /dev/fd/3.
+  --telemetry-interval=<sec>
+                            Seconds between telemetry lines [default: 1].
 
 Raytracer options:
   -d --max-depth=<int>      Maximum recursion depth for raytracing [default: 3].
@@ -8,6 +8,11 @@
 #include <cmath>
 #include <string>
 
+#if defined(TURNER_SIMD) && defined(__SSE2__)
+#define TURNER_SIMD_SSE 1
+#include <emmintrin.h>
+#endif
+
 namespace turner {
 
 /**
@@ -162,22 +167,54 @@ constexpr std::array<Axis3, 3> AXES3 = {{Axis3::X, Axis3::Y, Axis3::Z}};
 // Forward declaration for conversion operators and constructors
 template <typename T> class Normal3;
 
-template <typename T> class Vector3 {
+namespace simd {
+
+/**
+ * Components of 3-dimensional vectors, points and normals.
+ *
+ * With TURNER_SIMD, only the float types are stored as aligned float4 (the
+ * fourth component is always 0), s.t. they are loaded into a single SSE
+ * register. Cf. the float specializations following Normal3.
+ */
+template <typename T> struct Components3 {
+    T x = 0;
+    T y = 0;
+    T z = 0;
+};
+
+#ifdef TURNER_SIMD_SSE
+template <> struct alignas(16) Components3<float> {
+    float x = 0;
+    float y = 0;
+    float z = 0;
+    // Fourth SIMD lane; not part of the value.
+    float pad_ = 0;
+};
+#endif
+
+} // namespace simd
+
+template <typename T> class Vector3 : public simd::Components3<T> {
+    using Components = simd::Components3<T>;
+
 public:
+    using Components::x;
+    using Components::y;
+    using Components::z;
+
     Vector3() = default;
-    Vector3(T x, T y, T z) : x{x}, y{y}, z{z} { assert(!contains_nan()); }
+    Vector3(T x, T y, T z) : Components{x, y, z} { assert(!contains_nan()); }
 
     template <typename U>
     explicit Vector3(const Vector3<U>& v)
-        : x{static_cast<T>(v.x)}
-        , y{static_cast<T>(v.y)}
-        , z{static_cast<T>(v.z)} {
+        : Components{static_cast<T>(v.x), static_cast<T>(v.y),
+                     static_cast<T>(v.z)} {
         assert(!contains_nan());
     }
 
     template <typename U> Vector3<U> as() const { return Vector3<U>(*this); }
 
-    explicit Vector3(const Normal3<T>& n) : x(n.x), y(n.y), z(n.z) {
+    explicit Vector3(const Normal3<T>& n) : Components{n.x, n.y, n.z} {
         assert(!contains_nan());
     }
 
@@ -260,10 +297,6 @@ public:
                std::to_string(z) + "]";
     }
 
-public:
-    T x = 0;
-    T y = 0;
-    T z = 0;
 };
 
 using Vector3f = Vector3<float>;
@@ -482,16 +515,21 @@ template <typename T> Point2<T> abs(const Point2<T>& p) {
 /**
  * Point in 3-dimensional space.
  */
-template <typename T> class Point3 {
+template <typename T> class Point3 : public simd::Components3<T> {
+    using Components = simd::Components3<T>;
+
 public:
+    using Components::x;
+    using Components::y;
+    using Components::z;
+
     Point3() = default;
-    Point3(T x, T y, T z) : x{x}, y{y}, z{z} { assert(!contains_nan()); }
+    Point3(T x, T y, T z) : Components{x, y, z} { assert(!contains_nan()); }
 
     template <typename U>
     explicit Point3(const Point3<U>& p)
-        : x{static_cast<T>(p.x)}
-        , y{static_cast<T>(p.y)}
-        , z{static_cast<T>(p.z)} {
+        : Components{static_cast<T>(p.x), static_cast<T>(p.y),
+                     static_cast<T>(p.z)} {
         assert(!contains_nan());
     }
 
@@ -499,9 +537,8 @@ public:
 
     template <typename U>
     explicit Point3(const Vector3<U>& v)
-        : x{static_cast<T>(v.x)}
-        , y{static_cast<T>(v.y)}
-        , z{static_cast<T>(v.z)} {
+        : Components{static_cast<T>(v.x), static_cast<T>(v.y),
+                     static_cast<T>(v.z)} {
         assert(!contains_nan());
     }
 
@@ -598,10 +635,6 @@ public:
                std::to_string(z) + ")";
     }
 
-public:
-    T x = 0;
-    T y = 0;
-    T z = 0;
 };
 
 using Point3f = Point3<float>;
@@ -656,28 +689,32 @@ Point3<T> permute(const Point3<T>& p, int x, int y, int z) {
 /**
  * Normal in 3-dimensional space.
  */
-template <typename T> class Normal3 {
+template <typename T> class Normal3 : public simd::Components3<T> {
+    using Components = simd::Components3<T>;
+
 public:
+    using Components::x;
+    using Components::y;
+    using Components::z;
+
     Normal3() = default;
-    Normal3(T x, T y, T z) : x{x}, y{y}, z{z} { assert(!contains_nan()); }
+    Normal3(T x, T y, T z) : Components{x, y, z} { assert(!contains_nan()); }
 
-    explicit Normal3(const Vector3<T>& v) : x(v.x), y(v.y), z(v.z) {
+    explicit Normal3(const Vector3<T>& v) : Components{v.x, v.y, v.z} {
         assert(!contains_nan());
     }
 
     template <typename U>
     explicit Normal3(const Vector3<U>& v)
-        : x(static_cast<T>(v.x))
-        , y(static_cast<T>(v.y))
-        , z(static_cast<T>(v.z)) {
+        : Components{static_cast<T>(v.x), static_cast<T>(v.y),
+                     static_cast<T>(v.z)} {
         assert(!contains_nan());
     }
 
     template <typename U>
     explicit Normal3(const Point3<U>& p)
-        : x(static_cast<T>(p.x))
-        , y(static_cast<T>(p.y))
-        , z(static_cast<T>(p.z)) {
+        : Components{static_cast<T>(p.x), static_cast<T>(p.y),
+                     static_cast<T>(p.z)} {
         assert(!contains_nan());
     }
 
@@ -767,10 +804,6 @@ public:
                std::to_string(z) + "]";
     }
 
-public:
-    T x = 0;
-    T y = 0;
-    T z = 0;
 };
 
 using Normal3f = Normal3<float>;
@@ -803,6 +836,220 @@ template <typename T> Normal3<T> normalize(const Normal3<T>& n) {
     return n / n.length();
 }
 
+#ifdef TURNER_SIMD_SSE
+//
+// SSE specializations of the float types
+//
+// The results are bitwise identical to the generic implementation. In
+// particular, dot products are summed up in the same order and min/max return
+// the same operand as std::min/std::max.
+//
+
+namespace simd {
+
+template <typename V> inline __m128 load(const V& v) {
+    return _mm_load_ps(&v.x);
+}
+
+template <typename V> inline V store(__m128 m) {
+    V v;
+    _mm_store_ps(&v.x, m);
+    assert(!v.contains_nan());
+    return v;
+}
+
+inline float hsum3(__m128 m) {
+    __m128 y = _mm_shuffle_ps(m, m, _MM_SHUFFLE(1, 1, 1, 1));
+    __m128 z = _mm_movehl_ps(m, m);
+    return _mm_cvtss_f32(_mm_add_ss(_mm_add_ss(m, y), z));
+}
+
+inline __m128 abs(__m128 m) {
+    return _mm_andnot_ps(_mm_set1_ps(-0.f), m);
+}
+
+} // namespace simd
+
+template <>
+inline Vector3<float> Vector3<float>::operator+(const Vector3<float>& v) const {
+    return simd::store<Vector3<float>>(
+        _mm_add_ps(simd::load(*this), simd::load(v)));
+}
+
+template <>
+inline Vector3<float>& Vector3<float>::operator+=(const Vector3<float>& v) {
+    _mm_store_ps(&x, _mm_add_ps(simd::load(*this), simd::load(v)));
+    return *this;
+}
+
+template <>
+inline Vector3<float> Vector3<float>::operator-(const Vector3<float>& v) const {
+    return simd::store<Vector3<float>>(
+        _mm_sub_ps(simd::load(*this), simd::load(v)));
+}
+
+template <>
+inline Vector3<float>& Vector3<float>::operator-=(const Vector3<float>& v) {
+    _mm_store_ps(&x, _mm_sub_ps(simd::load(*this), simd::load(v)));
+    return *this;
+}
+
+template <> inline Vector3<float> Vector3<float>::operator*(float s) const {
+    return simd::store<Vector3<float>>(
+        _mm_mul_ps(_mm_set1_ps(s), simd::load(*this)));
+}
+
+template <> inline Vector3<float>& Vector3<float>::operator*=(float s) {
+    _mm_store_ps(&x, _mm_mul_ps(simd::load(*this), _mm_set1_ps(s)));
+    return *this;
+}
+
+template <> inline Vector3<float> Vector3<float>::operator-() const {
+    return simd::store<Vector3<float>>(
+        _mm_xor_ps(_mm_set_ps(0.f, -0.f, -0.f, -0.f), simd::load(*this)));
+}
+
+inline Vector3<float> operator*(float s, const Vector3<float>& v) {
+    return simd::store<Vector3<float>>(
+        _mm_mul_ps(_mm_set1_ps(s), simd::load(v)));
+}
+
+inline Vector3<float> abs(const Vector3<float>& v) {
+    return simd::store<Vector3<float>>(simd::abs(simd::load(v)));
+}
+
+inline float dot(const Vector3<float>& v1, const Vector3<float>& v2) {
+    return simd::hsum3(_mm_mul_ps(simd::load(v1), simd::load(v2)));
+}
+
+inline Vector3<float> min(const Vector3<float>& p1, const Vector3<float>& p2) {
+    return simd::store<Vector3<float>>(
+        _mm_min_ps(simd::load(p2), simd::load(p1)));
+}
+
+inline Vector3<float> max(const Vector3<float>& p1, const Vector3<float>& p2) {
+    return simd::store<Vector3<float>>(
+        _mm_max_ps(simd::load(p2), simd::load(p1)));
+}
+
+template <>
+inline Point3<float> Point3<float>::operator+(const Vector3<float>& v) const {
+    return simd::store<Point3<float>>(
+        _mm_add_ps(simd::load(*this), simd::load(v)));
+}
+
+template <>
+inline Point3<float>& Point3<float>::operator+=(const Vector3<float>& v) {
+    _mm_store_ps(&x, _mm_add_ps(simd::load(*this), simd::load(v)));
+    return *this;
+}
+
+template <>
+inline Point3<float> Point3<float>::operator+(const Point3<float>& p) const {
+    return simd::store<Point3<float>>(
+        _mm_add_ps(simd::load(*this), simd::load(p)));
+}
+
+template <>
+inline Point3<float>& Point3<float>::operator+=(const Point3<float>& p) {
+    _mm_store_ps(&x, _mm_add_ps(simd::load(*this), simd::load(p)));
+    return *this;
+}
+
+template <>
+inline Vector3<float> Point3<float>::operator-(const Point3<float>& p) const {
+    return simd::store<Vector3<float>>(
+        _mm_sub_ps(simd::load(*this), simd::load(p)));
+}
+
+template <>
+inline Point3<float> Point3<float>::operator-(const Vector3<float>& v) const {
+    return simd::store<Point3<float>>(
+        _mm_sub_ps(simd::load(*this), simd::load(v)));
+}
+
+template <>
+inline Point3<float>& Point3<float>::operator-=(const Vector3<float>& v) {
+    _mm_store_ps(&x, _mm_sub_ps(simd::load(*this), simd::load(v)));
+    return *this;
+}
+
+template <> inline Point3<float> Point3<float>::operator*(float s) const {
+    return simd::store<Point3<float>>(
+        _mm_mul_ps(_mm_set1_ps(s), simd::load(*this)));
+}
+
+template <> inline Point3<float>& Point3<float>::operator*=(float s) {
+    _mm_store_ps(&x, _mm_mul_ps(simd::load(*this), _mm_set1_ps(s)));
+    return *this;
+}
+
+inline Point3<float> operator*(float s, const Point3<float>& p) {
+    return simd::store<Point3<float>>(
+        _mm_mul_ps(_mm_set1_ps(s), simd::load(p)));
+}
+
+inline Point3<float> min(const Point3<float>& p1, const Point3<float>& p2) {
+    return simd::store<Point3<float>>(
+        _mm_min_ps(simd::load(p2), simd::load(p1)));
+}
+
+inline Point3<float> max(const Point3<float>& p1, const Point3<float>& p2) {
+    return simd::store<Point3<float>>(
+        _mm_max_ps(simd::load(p2), simd::load(p1)));
+}
+
+inline Point3<float> abs(const Point3<float>& p) {
+    return simd::store<Point3<float>>(simd::abs(simd::load(p)));
+}
+
+template <>
+inline Normal3<float> Normal3<float>::operator+(const Normal3<float>& v) const {
+    return simd::store<Normal3<float>>(
+        _mm_add_ps(simd::load(*this), simd::load(v)));
+}
+
+template <>
+inline Normal3<float>& Normal3<float>::operator+=(const Normal3<float>& v) {
+    _mm_store_ps(&x, _mm_add_ps(simd::load(*this), simd::load(v)));
+    return *this;
+}
+
+template <>
+inline Normal3<float> Normal3<float>::operator-(const Normal3<float>& v) const {
+    return simd::store<Normal3<float>>(
+        _mm_sub_ps(simd::load(*this), simd::load(v)));
+}
+
+template <>
+inline Normal3<float>& Normal3<float>::operator-=(const Normal3<float>& v) {
+    _mm_store_ps(&x, _mm_sub_ps(simd::load(*this), simd::load(v)));
+    return *this;
+}
+
+template <> inline Normal3<float> Normal3<float>::operator*(float s) const {
+    return simd::store<Normal3<float>>(
+        _mm_mul_ps(_mm_set1_ps(s), simd::load(*this)));
+}
+
+template <> inline Normal3<float>& Normal3<float>::operator*=(float s) {
+    _mm_store_ps(&x, _mm_mul_ps(simd::load(*this), _mm_set1_ps(s)));
+    return *this;
+}
+
+inline float dot(const Normal3<float>& n1, const Normal3<float>& n2) {
+    return simd::hsum3(_mm_mul_ps(simd::load(n1), simd::load(n2)));
+}
+
+inline float dot(const Vector3<float>& v, const Normal3<float>& n) {
+    return simd::hsum3(_mm_mul_ps(simd::load(v), simd::load(n)));
+}
+
+inline float dot(const Normal3<float>& n, const Vector3<float>& v) {
+    return simd::hsum3(_mm_mul_ps(simd::load(n), simd::load(v)));
+}
+#endif // TURNER_SIMD_SSE
+
 /**
  * Infinite ray in 3d space.
  */
@@ -9,11 +9,10 @@ Triangle test_triangle(Point3f a, Point3f b, Point3f c) {
     return Triangle({a, b, c});
 }
 
-// Construct a triangle with trivial colors.
+// Construct a triangle with the default material.
 Triangle test_triangle(Point3f a, Point3f b, Point3f c, Normal3f na,
                        Normal3f nb, Normal3f nc) {
-    return Triangle({a, b, c}, {na, nb, nc}, Color(), Color(), Color(), Color(),
-                    0);
+    return Triangle({a, b, c}, {na, nb, nc}, 0);
 }
 
 Vector3f random_vec() {
@@ -0,0 +1,144 @@
+#include "../lib/accumulator.h"
+
+#include <catch.hpp>
+
+#include <sstream>
+#include <vector>
+
+TEST_CASE("Accumulate samples", "[accumulator]") {
+    Accumulator acc(3, 2);
+    REQUIRE(acc.memory_bytes() == 6 * sizeof(Accumulator::Pixel));
+    REQUIRE(acc.num_samples(1, 1) == 0);
+    REQUIRE(acc.mean(1, 1) == Color());
+    REQUIRE(std::isinf(acc.variance_of_mean(1, 1)));
+
+    acc.add(1, 1, {1, 1, 1, 1});
+    REQUIRE(std::isinf(acc.relative_error(1, 1)));
+
+    acc.add(1, 1, {0, 0, 0, 1});
+    REQUIRE(acc.num_samples(1, 1) == 2);
+    REQUIRE(acc.mean(1, 1) == Color(0.5f, 0.5f, 0.5f, 1));
+    // luminances 1 and 0: sample variance 0.5, variance of the mean 0.25
+    REQUIRE(acc.variance_of_mean(1, 1) == Approx(0.25f));
+    REQUIRE(acc.relative_error(1, 1) == Approx(1));
+
+    // the other pixels are untouched
+    REQUIRE(acc.num_samples(0, 1) == 0);
+}
+
+TEST_CASE("Error of converging pixel", "[accumulator]") {
+    Accumulator acc(1, 1);
+    for (int i = 0; i < 100; ++i) {
+        acc.add(0, 0, {0.5f, 0.5f, 0.5f, 1});
+    }
+    REQUIRE(acc.variance_of_mean(0, 0) == Approx(0).margin(1e-6));
+    REQUIRE(acc.relative_error(0, 0) < 0.01f);
+
+    // error decreases with the square root of the number of samples
+    Accumulator noisy(2, 1);
+    for (int i = 0; i < 100; ++i) {
+        noisy.add(0, 0, i % 2 ? Color(1, 1, 1, 1) : Color(0, 0, 0, 1));
+    }
+    for (int i = 0; i < 400; ++i) {
+        noisy.add(1, 0, i % 2 ? Color(1, 1, 1, 1) : Color(0, 0, 0, 1));
+    }
+    REQUIRE(noisy.relative_error(1, 0) ==
+            Approx(noisy.relative_error(0, 0) / 2).epsilon(0.01));
+}
+
+TEST_CASE("Sample count AOV", "[accumulator]") {
+    Accumulator acc(2, 1);
+    for (int i = 0; i < 4; ++i) {
+        acc.add(0, 0, {1, 0, 0, 1});
+    }
+    acc.add(1, 0, {0, 1, 0, 1});
+
+    const auto mean = mean_image(acc);
+    REQUIRE(mean(0, 0) == Color(1, 0, 0, 1));
+    REQUIRE(mean(1, 0) == Color(0, 1, 0, 1));
+
+    const auto samples = samples_image(acc);
+    REQUIRE(samples(0, 0) == Color(1, 1, 1, 1));
+    REQUIRE(samples(1, 0) == Color(0.25f, 0.25f, 0.25f, 1));
+
+    std::ostringstream pfm;
+    write_samples_pfm(pfm, acc);
+    const auto data = pfm.str();
+    REQUIRE(data.compare(0, 7, "Pf\n2 1\n") == 0);
+    const auto header_size = data.size() - 2 * sizeof(float);
+    float counts[2];
+    std::memcpy(counts, data.data() + header_size, sizeof(counts));
+    REQUIRE(counts[0] == 4);
+    REQUIRE(counts[1] == 1);
+}
+
+namespace {
+
+// Samples per pixel of a 8x8 image after passes, with or without a sample
+// at every other pixel beforehand as by a preview. The i-th sample of a
+// pixel only depends on the pixel and i, as with the counter-based sampling
+// of the renderers.
+std::vector<size_t> render_samples(const SampleBudget& budget,
+                                   size_t num_passes, bool preview) {
+    Accumulator acc(8, 8);
+    auto sample = [&](size_t x, size_t y) {
+        const size_t i = acc.num_samples(x, y);
+        const float value = ((x * 7 + y * 13 + i * 5) % 11) / 10.f;
+        acc.add(x, y, {value, value, value, 1});
+    };
+    for (size_t y = 0; y < 8; ++y) {
+        for (size_t x = 0; x < 8; ++x) {
+            if (preview && x % 2 == 0 && y % 2 == 0) {
+                sample(x, y);
+            }
+        }
+    }
+    for (size_t pass = 0; pass < num_passes; ++pass) {
+        for (size_t y = 0; y < 8; ++y) {
+            for (size_t x = 0; x < 8; ++x) {
+                sample_pixel(acc, x, y, budget, pass,
+                             [&]() { sample(x, y); });
+            }
+        }
+    }
+
+    std::vector<size_t> samples;
+    for (const auto& pixel : acc) {
+        samples.push_back(pixel.num_samples);
+    }
+    return samples;
+}
+
+} // namespace
+
+TEST_CASE("Samples of a preview count towards the batches", "[accumulator]") {
+    for (const size_t batch_size : {1, 3}) {
+        SampleBudget single;
+        single.batch_size = batch_size;
+        single.max_samples = batch_size;
+
+        SampleBudget adaptive = single;
+        adaptive.adaptive_threshold = 0.2f;
+        adaptive.max_samples = 8 * batch_size;
+
+        SampleBudget progressive = single;
+        progressive.progressive = true;
+
+        SampleBudget progressive_adaptive = adaptive;
+        progressive_adaptive.progressive = true;
+
+        for (const auto& budget :
+             {single, adaptive, progressive, progressive_adaptive}) {
+            const size_t num_passes = budget.progressive ? 4 : 1;
+            INFO("batch size " << batch_size << ", adaptive "
+                               << budget.adaptive_threshold << ", progressive "
+                               << budget.progressive);
+            const auto samples = render_samples(budget, num_passes, false);
+            REQUIRE(samples == render_samples(budget, num_passes, true));
+            if (budget.adaptive_threshold == 0) {
+                REQUIRE(samples == std::vector<size_t>(
+                                       64, num_passes * batch_size));
+            }
+        }
+    }
+}
@@ -0,0 +1,81 @@
+#include "../lib/cameras.h"
+
+#include <catch.hpp>
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+// Trivial camera of a scene, placed by trafo.
+Camera make_test_camera(const aiMatrix4x4& trafo) {
+    aiCamera cam;
+    cam.mPosition = aiVector3D(0, 0, 0);
+    cam.mUp = aiVector3D(0, 1, 0);
+    cam.mLookAt = aiVector3D(0, 0, -1);
+    cam.mHorizontalFOV = 0.5f;
+    cam.mAspect = 1;
+    return Camera(trafo, cam);
+}
+
+} // namespace
+
+TEST_CASE("Look-at camera", "[cameras]") {
+    const Camera cam =
+        make_test_camera(look_at({1, 2, 3}, {1, 2, -7}, {0, 1, 0}));
+    REQUIRE(cam.mPosition == aiVector3D(1, 2, 3));
+    // the center of the image is the target
+    const Vector3f center = cam.raster2cam({50, 50}, 100, 100);
+    REQUIRE(center.x == Approx(0));
+    REQUIRE(center.y == Approx(0));
+    REQUIRE(center.z < 0);
+
+    // looking along +x: left of the image is -z
+    const Camera side =
+        make_test_camera(look_at({0, 0, 0}, {5, 0, 0}, {0, 1, 0}));
+    const Vector3f dir = normalize(side.raster2cam({50, 50}, 100, 100));
+    REQUIRE(dir.x == Approx(1));
+    REQUIRE(dir.y == Approx(0).margin(1e-6));
+    REQUIRE(dir.z == Approx(0).margin(1e-6));
+    REQUIRE(side.raster2cam({0, 50}, 100, 100).z < 0);
+    REQUIRE(side.raster2cam({50, 0}, 100, 100).y > 0);
+}
+
+TEST_CASE("Read cameras", "[cameras]") {
+    std::stringstream ss("# turntable\n"
+                         "0 0 5  0 0 0  0 1 0\n"
+                         "\n"
+                         "1 0 0 1  0 1 0 2  0 0 1 3  0 0 0 1\n");
+    std::vector<aiMatrix4x4> trafos;
+    std::string error;
+    REQUIRE(read_cameras(ss, trafos, error));
+    REQUIRE(trafos.size() == 2);
+    REQUIRE(trafos[0] == look_at({0, 0, 5}, {0, 0, 0}, {0, 1, 0}));
+    REQUIRE(make_test_camera(trafos[1]).mPosition == aiVector3D(1, 2, 3));
+}
+
+TEST_CASE("Reject invalid cameras", "[cameras]") {
+    std::vector<aiMatrix4x4> trafos;
+    std::string error;
+
+    std::stringstream too_few("0 0 5  0 0 0  0 1 0\n0 0 5 0 0 0\n");
+    REQUIRE_FALSE(read_cameras(too_few, trafos, error));
+    REQUIRE(error.find("Line 2") != std::string::npos);
+
+    std::stringstream garbage("0 0 5  0 0 0  0 1 x\n");
+    REQUIRE_FALSE(read_cameras(garbage, trafos, error));
+    REQUIRE(error.find("Line 1") != std::string::npos);
+
+    std::stringstream along_up("0 0 0  0 5 0  0 1 0\n");
+    REQUIRE_FALSE(read_cameras(along_up, trafos, error));
+    REQUIRE(error.find("up vector") != std::string::npos);
+
+    std::stringstream empty("# nothing\n");
+    REQUIRE_FALSE(read_cameras(empty, trafos, error));
+}
+
+TEST_CASE("Frame path", "[cameras]") {
+    REQUIRE(frame_path("frame", 7, ".ppm") == "frame0007.ppm");
+    REQUIRE(frame_path("out/turn", 12345, ".pfm") == "out/turn12345.pfm");
+}
@@ -0,0 +1,128 @@
+#include "../lib/checkpoint.h"
+
+#include <catch.hpp>
+
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <string>
+
+#include <unistd.h>
+
+namespace {
+
+// Temporary checkpoint file, which is removed on destruction.
+struct TempFile {
+    TempFile() {
+        char name[] = "test_checkpoint_XXXXXX";
+        const int fd = mkstemp(name);
+        close(fd);
+        path = name;
+    }
+    ~TempFile() { std::remove(path.c_str()); }
+
+    std::string path;
+};
+
+} // namespace
+
+TEST_CASE("Tile completion", "[checkpoint]") {
+    TileCompletion completion(40, 20, 16);
+    REQUIRE(completion.num_tiles() == 6);
+    REQUIRE(completion.num_done() == 0);
+    REQUIRE(completion.index(17, 0) == 1);
+    REQUIRE(completion.index(39, 19) == 5);
+
+    const auto tiles = make_tiles(40, 20, 16);
+    completion.set_done(tiles[0]);
+    completion.set_done(tiles[3]);
+    REQUIRE(completion.num_done() == 2);
+    REQUIRE(completion.done(tiles[0]));
+    REQUIRE_FALSE(completion.done(tiles[1]));
+
+    const auto remaining = completion.remaining(tiles);
+    REQUIRE(remaining.size() == 4);
+    for (const auto& tile : remaining) {
+        REQUIRE_FALSE(completion.done(tile));
+    }
+}
+
+TEST_CASE("Write and read checkpoint", "[checkpoint]") {
+    TempFile file;
+    const uint64_t key = 0x1234;
+    const auto tiles = make_tiles(5, 3, 2);
+
+    Accumulator acc(5, 3);
+    TileCompletion completion(5, 3, 2);
+    for (size_t y = 0; y < 3; ++y) {
+        for (size_t x = 0; x < 5; ++x) {
+            acc.add(x, y, {1.f * x, 1.f * y, 0, 1});
+        }
+    }
+    completion.set_done(tiles[0]);
+    completion.set_done(tiles.back());
+
+    std::string error;
+    REQUIRE(write_checkpoint(file.path, key, acc, completion, error));
+
+    Accumulator loaded(5, 3);
+    TileCompletion loaded_completion(5, 3, 2);
+    REQUIRE(read_checkpoint(file.path, key, loaded, loaded_completion, error));
+    REQUIRE(loaded_completion.num_done() == 2);
+    for (size_t y = 0; y < 3; ++y) {
+        for (size_t x = 0; x < 5; ++x) {
+            if (completion.done(completion.index(x, y))) {
+                REQUIRE(loaded_completion.done(loaded_completion.index(x, y)));
+                REQUIRE(loaded.num_samples(x, y) == 1);
+                REQUIRE(loaded.mean(x, y) == acc.mean(x, y));
+            } else {
+                // samples of incomplete tiles are dropped
+                REQUIRE(loaded.num_samples(x, y) == 0);
+            }
+        }
+    }
+}
+
+TEST_CASE("Reject checkpoint of another render", "[checkpoint]") {
+    TempFile file;
+    Accumulator acc(4, 4);
+    TileCompletion completion(4, 4, 2);
+    completion.set_done(0);
+    std::string error;
+    REQUIRE(write_checkpoint(file.path, 1, acc, completion, error));
+
+    Accumulator loaded(4, 4);
+    TileCompletion loaded_completion(4, 4, 2);
+    REQUIRE_FALSE(read_checkpoint(file.path, 2, loaded, loaded_completion,
+                                  error));
+    REQUIRE(error.find("another render") != std::string::npos);
+    REQUIRE(loaded_completion.num_done() == 0);
+
+    Accumulator other_size(4, 2);
+    TileCompletion other_size_completion(4, 2, 2);
+    REQUIRE_FALSE(read_checkpoint(file.path, 1, other_size,
+                                  other_size_completion, error));
+
+    TileCompletion other_tiles(4, 4, 4);
+    REQUIRE_FALSE(read_checkpoint(file.path, 1, loaded, other_tiles, error));
+
+    // truncated
+    {
+        std::ifstream in(file.path, std::ios::binary);
+        std::string content((std::istreambuf_iterator<char>(in)),
+                            std::istreambuf_iterator<char>());
+        std::ofstream out(file.path, std::ios::binary | std::ios::trunc);
+        out.write(content.data(), content.size() - 1);
+    }
+    REQUIRE_FALSE(
+        read_checkpoint(file.path, 1, loaded, loaded_completion, error));
+    REQUIRE(error.find("Truncated") != std::string::npos);
+
+    {
+        std::ofstream out(file.path, std::ios::binary | std::ios::trunc);
+        out << "P3\n";
+    }
+    REQUIRE_FALSE(
+        read_checkpoint(file.path, 1, loaded, loaded_completion, error));
+    REQUIRE(error.find("Not a checkpoint") != std::string::npos);
+}
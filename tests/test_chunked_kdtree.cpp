@@ -0,0 +1,205 @@
+#include "../lib/chunked_kdtree.h"
+#include "helper.h"
+
+#include <catch.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <functional>
+#include <limits>
+#include <set>
+#include <thread>
+
+#include <unistd.h>
+
+namespace {
+
+// Small random triangles with two materials.
+TriangleMesh random_mesh(size_t num_triangles) {
+    Triangles triangles;
+    for (size_t i = 0; i < num_triangles; ++i) {
+        const Point3f p = random_point();
+        triangles.push_back(Triangle(
+            {p, p + Vector3f(1, 0, 0), p + Vector3f(0, 1, 0.5f)},
+            {Normal3f(0, 0, 1), Normal3f(0, 0, 1), Normal3f(0, 0, 1)},
+            i % 2));
+    }
+    Materials materials(2);
+    materials[1].diffuse = {1, 0, 0, 1};
+    return TriangleMesh(triangles, materials);
+}
+
+// Temporary chunk directory, which is removed with the chunks on
+// destruction.
+struct TempDir {
+    TempDir() {
+        char name[] = "test_chunked_kdtree_XXXXXX";
+        path = mkdtemp(name);
+    }
+    ~TempDir() {
+        for (const auto& chunk : chunks) {
+            std::remove(kdtree_cache_path(path, chunk.key).c_str());
+        }
+        rmdir(path.c_str());
+    }
+
+    std::string path;
+    std::vector<SceneChunk> chunks;
+};
+
+} // namespace
+
+TEST_CASE("Split mesh into chunks", "[chunked_kdtree]") {
+    const auto mesh = random_mesh(100);
+    const auto groups = split_mesh(mesh, 16);
+    REQUIRE(groups.size() == 8);
+
+    std::set<uint32_t> ids;
+    for (const auto& group : groups) {
+        REQUIRE(!group.empty());
+        REQUIRE(group.size() <= 16);
+        ids.insert(group.begin(), group.end());
+    }
+    REQUIRE(ids.size() == mesh.size());
+
+    const auto chunk = extract_mesh(mesh, groups[0]);
+    REQUIRE(chunk.size() == groups[0].size());
+    REQUIRE(chunk.materials().size() == mesh.materials().size());
+    for (size_t i = 0; i < chunk.size(); ++i) {
+        REQUIRE(chunk[i].vertices == mesh[groups[0][i]].vertices);
+        REQUIRE(chunk.material_ids()[i] == mesh.material_ids()[groups[0][i]]);
+    }
+}
+
+TEST_CASE("Intersect chunked kd-tree", "[chunked_kdtree]") {
+    const auto mesh = random_mesh(200);
+    TempDir dir;
+    std::string error;
+    REQUIRE(build_chunks(mesh, 16, dir.path, dir.chunks, error, 2));
+    REQUIRE(error.empty());
+    REQUIRE(dir.chunks.size() == 16);
+
+    // a limit of one byte keeps a single chunk resident
+    const ChunkedKDTree tree(dir.path, dir.chunks, mesh.materials(), 1);
+    REQUIRE(tree.num_triangles() == mesh.size());
+
+    const KDTree reference(mesh);
+    KDTreeIntersection reference_intersection(reference);
+    ChunkedKDTreeIntersection intersection(tree);
+
+    std::vector<Ray> rays;
+    for (int i = 0; i < 200; ++i) {
+        rays.emplace_back(random_point(), normalize(random_vec()));
+    }
+
+    SECTION("Single rays") {
+        size_t num_hits = 0;
+        for (const auto& ray : rays) {
+            float r, s, t, ref_r, ref_s, ref_t;
+            const auto id = intersection.intersect(ray, r, s, t);
+            const auto ref_id =
+                reference_intersection.intersect(ray, ref_r, ref_s, ref_t);
+            REQUIRE(static_cast<bool>(id) == static_cast<bool>(ref_id));
+            if (id) {
+                num_hits += 1;
+                REQUIRE(r == ref_r);
+                REQUIRE(intersection[id].vertices ==
+                        reference[ref_id].vertices);
+                REQUIRE(intersection.material(id).diffuse ==
+                        reference.material(ref_id).diffuse);
+            }
+        }
+        REQUIRE(num_hits > 0);
+
+        const auto stats = tree.cache_stats();
+        REQUIRE(stats.loads > 0);
+        REQUIRE(stats.evictions > 0);
+    }
+
+    SECTION("Queue rays by chunk") {
+        const auto order = intersection.queue(rays);
+        std::vector<uint32_t> sorted = order;
+        std::sort(sorted.begin(), sorted.end());
+        for (size_t i = 0; i < sorted.size(); ++i) {
+            REQUIRE(sorted[i] == i);
+        }
+
+        // the queues are contiguous, longest first, and misses come last
+        auto first_chunk = [&](uint32_t i) -> int64_t {
+            const auto& ray = rays[i];
+            int64_t chunk = -1;
+            float t_enter = std::numeric_limits<float>::max();
+            for (size_t c = 0; c < dir.chunks.size(); ++c) {
+                float t0, t1;
+                const Ray fixed(ray.o, detail::fix_direction(ray));
+                if (intersect_ray_box(fixed, dir.chunks[c].box, t0, t1) &&
+                    t1 >= 0 && std::max(t0, 0.f) < t_enter) {
+                    t_enter = std::max(t0, 0.f);
+                    chunk = c;
+                }
+            }
+            return chunk;
+        };
+        std::vector<size_t> sizes;
+        std::set<int64_t> seen;
+        for (size_t i = 0; i < order.size(); ++i) {
+            const int64_t chunk = first_chunk(order[i]);
+            if (i > 0 && chunk == first_chunk(order[i - 1])) {
+                sizes.back() += 1;
+                continue;
+            }
+            REQUIRE(seen.insert(chunk).second);
+            REQUIRE((seen.count(-1) == 0 || chunk == -1));
+            sizes.push_back(1);
+        }
+        const size_t num_queues = sizes.size() - (seen.count(-1) ? 1 : 0);
+        REQUIRE(std::is_sorted(sizes.begin(), sizes.begin() + num_queues,
+                               std::greater<size_t>()));
+    }
+
+    SECTION("Shading a hit does not lock the cache") {
+        for (const auto& ray : rays) {
+            const auto id = intersection.intersect(ray);
+            const auto ref_id = reference_intersection.intersect(ray);
+            if (id) {
+                // the chunk of the hit is pinned by the intersection
+                const size_t hits = tree.cache_stats().hits;
+                REQUIRE(intersection[id].vertices ==
+                        reference[ref_id].vertices);
+                REQUIRE(intersection.material(id).diffuse ==
+                        reference.material(ref_id).diffuse);
+                REQUIRE(tree.cache_stats().hits == hits);
+            }
+        }
+    }
+
+    SECTION("Concurrent requests load a chunk once") {
+        const ChunkedKDTree shared(dir.path, dir.chunks, mesh.materials(),
+                                   size_t(1) << 30);
+        // Catch assertions are not thread-safe
+        std::atomic<size_t> num_trees{0};
+        std::vector<std::thread> threads;
+        for (int i = 0; i < 4; ++i) {
+            threads.emplace_back([&shared, &num_trees]() {
+                for (size_t chunk = 0; chunk < shared.num_chunks(); ++chunk) {
+                    if (shared.tree(chunk)->num_triangles() > 0) {
+                        num_trees += 1;
+                    }
+                }
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        REQUIRE(num_trees == 4 * shared.num_chunks());
+        const auto stats = shared.cache_stats();
+        REQUIRE(stats.loads == shared.num_chunks());
+        REQUIRE(stats.hits == 3 * shared.num_chunks());
+    }
+
+    SECTION("Missing chunk") {
+        std::remove(kdtree_cache_path(dir.path, dir.chunks[0].key).c_str());
+        REQUIRE_THROWS_AS(tree.tree(0), std::runtime_error);
+    }
+}
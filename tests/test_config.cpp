@@ -4,6 +4,9 @@
 #include <docopt/docopt.h>
 
 #include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
 
 namespace raycaster {
 #include "../raycaster.h"
@@ -90,6 +93,269 @@ TEST_CASE("Create config from pathtracer USAGE", "[config]") {
     REQUIRE(os.str().size() > 0);
 }
 
+TEST_CASE("Kd-tree cache options of the tracers", "[config]") {
+    for (const char* usage :
+         {raycaster::USAGE, raytracer::USAGE, pathtracer::USAGE}) {
+        const char* argv[] = {"./exec", "file", "--cache-dir", "/tmp/cache",
+                              "--no-cache"};
+
+        auto conf = TracerConfig::from_docopt(
+            docopt::docopt(usage, {argv + 1, argv + 2}));
+        REQUIRE(conf.cache_dir == "kdtree-cache");
+
+        conf = TracerConfig::from_docopt(
+            docopt::docopt(usage, {argv + 1, argv + 4}));
+        REQUIRE(conf.cache_dir == "/tmp/cache");
+
+        conf = TracerConfig::from_docopt(
+            docopt::docopt(usage, {argv + 1, argv + 5}));
+        REQUIRE(conf.cache_dir.empty());
+    }
+}
+
+TEST_CASE("Memory limit option of the tracers", "[config]") {
+    for (const char* usage :
+         {raycaster::USAGE, raytracer::USAGE, pathtracer::USAGE}) {
+        const char* argv[] = {"./exec", "file", "--memory-limit", "256"};
+
+        auto conf = TracerConfig::from_docopt(
+            docopt::docopt(usage, {argv + 1, argv + 2}));
+        REQUIRE(conf.memory_limit_mb == 1024);
+
+        conf = TracerConfig::from_docopt(
+            docopt::docopt(usage, {argv + 1, argv + 4}));
+        REQUIRE(conf.memory_limit_mb == 256);
+    }
+}
+
+TEST_CASE("Adaptive sampling options of the pathtracer", "[config]") {
+    const char* argv[] = {"./exec", "file", "-p", "4",
+                          "--adaptive-threshold", "0.05",
+                          "--max-pixel-samples", "256",
+                          "--samples-aov", "samples"};
+
+    auto conf = TracerConfig::from_docopt(
+        docopt::docopt(pathtracer::USAGE, {argv + 1, argv + 2}));
+    REQUIRE(conf.adaptive_threshold == 0);
+    REQUIRE(conf.max_pixel_samples == 64);
+    REQUIRE(conf.samples_aov.empty());
+
+    conf = TracerConfig::from_docopt(
+        docopt::docopt(pathtracer::USAGE, {argv + 1, argv + 10}));
+    REQUIRE(conf.num_pixel_samples == 4);
+    REQUIRE(conf.adaptive_threshold == 0.05f);
+    REQUIRE(conf.max_pixel_samples == 256);
+    REQUIRE(conf.samples_aov == "samples");
+}
+
+TEST_CASE("Checkpoint options of the tracers", "[config]") {
+    for (const char* usage :
+         {raycaster::USAGE, raytracer::USAGE, pathtracer::USAGE}) {
+        const char* argv[] = {"./exec", "file", "--checkpoint", "render.cp",
+                              "--checkpoint-interval", "60", "--resume"};
+
+        auto conf = TracerConfig::from_docopt(
+            docopt::docopt(usage, {argv + 1, argv + 2}));
+        REQUIRE(conf.checkpoint.empty());
+        REQUIRE(conf.checkpoint_interval == 600);
+        REQUIRE_FALSE(conf.resume);
+
+        conf = TracerConfig::from_docopt(
+            docopt::docopt(usage, {argv + 1, argv + 7}));
+        REQUIRE(conf.checkpoint == "render.cp");
+        REQUIRE(conf.checkpoint_interval == 60);
+        REQUIRE(conf.resume);
+    }
+}
+
+TEST_CASE("Time limit option of the tracers", "[config]") {
+    for (const char* usage :
+         {raycaster::USAGE, raytracer::USAGE, pathtracer::USAGE}) {
+        const char* argv[] = {"./exec", "file", "--time-limit", "600"};
+
+        auto conf = TracerConfig::from_docopt(
+            docopt::docopt(usage, {argv + 1, argv + 2}));
+        REQUIRE(conf.time_limit == 0);
+
+        conf = TracerConfig::from_docopt(
+            docopt::docopt(usage, {argv + 1, argv + 4}));
+        REQUIRE(conf.time_limit == 600);
+    }
+}
+
+TEST_CASE("Region options of the tracers", "[config]") {
+    for (const char* usage :
+         {raycaster::USAGE, raytracer::USAGE, pathtracer::USAGE}) {
+        const char* argv[] = {"./exec",     "file",       "--region",
+                              "0,32,64,48", "--seed",     "7",
+                              "--partial",  "top.partial"};
+
+        auto conf = TracerConfig::from_docopt(
+            docopt::docopt(usage, {argv + 1, argv + 2}));
+        REQUIRE(conf.region.size() == 0);
+        REQUIRE(conf.seed == 0);
+        REQUIRE(conf.partial.empty());
+
+        conf = TracerConfig::from_docopt(
+            docopt::docopt(usage, {argv + 1, argv + 8}));
+        REQUIRE(conf.region.x0 == 0);
+        REQUIRE(conf.region.y0 == 32);
+        REQUIRE(conf.region.x1 == 64);
+        REQUIRE(conf.region.y1 == 48);
+        REQUIRE(conf.seed == 7);
+        REQUIRE(conf.partial == "top.partial");
+    }
+}
+
+TEST_CASE("Batch options of the tracers", "[config]") {
+    for (const char* usage :
+         {raycaster::USAGE, raytracer::USAGE, pathtracer::USAGE}) {
+        const char* argv[] = {"./exec", "file", "--cameras", "turntable.txt",
+                              "--output", "turn"};
+
+        auto conf = TracerConfig::from_docopt(
+            docopt::docopt(usage, {argv + 1, argv + 2}));
+        REQUIRE(conf.cameras.empty());
+        REQUIRE(conf.output == "frame");
+
+        conf = TracerConfig::from_docopt(
+            docopt::docopt(usage, {argv + 1, argv + 6}));
+        REQUIRE(conf.cameras == "turntable.txt");
+        REQUIRE(conf.output == "turn");
+    }
+}
+
+TEST_CASE("Serve options of the tracers", "[config]") {
+    for (const char* usage :
+         {raycaster::USAGE, raytracer::USAGE, pathtracer::USAGE}) {
+        const char* argv[] = {"./exec", "--serve", "/tmp/turner.sock",
+                              "--max-scenes", "2"};
+
+        const auto conf = TracerConfig::from_docopt(
+            docopt::docopt(usage, {argv + 1, argv + 5}));
+        REQUIRE(conf.filename.empty());
+        REQUIRE(conf.serve == "/tmp/turner.sock");
+        REQUIRE(conf.max_scenes == 2);
+    }
+}
+
+TEST_CASE("Preview option of the tracers", "[config]") {
+    for (const char* usage :
+         {raycaster::USAGE, raytracer::USAGE, pathtracer::USAGE}) {
+        const char* argv[] = {"./exec", "file", "--preview", "preview.ppm"};
+
+        auto conf = TracerConfig::from_docopt(
+            docopt::docopt(usage, {argv + 1, argv + 2}));
+        REQUIRE(conf.preview.empty());
+
+        conf = TracerConfig::from_docopt(
+            docopt::docopt(usage, {argv + 1, argv + 4}));
+        REQUIRE(conf.preview == "preview.ppm");
+    }
+}
+
+TEST_CASE("Telemetry options of the tracers", "[config]") {
+    for (const char* usage :
+         {raycaster::USAGE, raytracer::USAGE, pathtracer::USAGE}) {
+        const char* argv[] = {"./exec", "file", "--telemetry", "/dev/fd/3",
+                              "--telemetry-interval", "0.5"};
+
+        auto conf = TracerConfig::from_docopt(
+            docopt::docopt(usage, {argv + 1, argv + 2}));
+        REQUIRE(conf.telemetry.empty());
+        REQUIRE(conf.telemetry_interval == 1);
+
+        conf = TracerConfig::from_docopt(
+            docopt::docopt(usage, {argv + 1, argv + 6}));
+        REQUIRE(conf.telemetry == "/dev/fd/3");
+        REQUIRE(conf.telemetry_interval == 0.5);
+    }
+}
+
+TEST_CASE("Telemetry options of radiosity", "[config]") {
+    const char* argv[] = {"./exec", "exact", "file", "--telemetry",
+                          "/dev/fd/3", "--telemetry-interval", "0.5"};
+
+    auto conf = RadiosityConfig::from_docopt(
+        docopt::docopt(radiosity::USAGE, {argv + 1, argv + 3}));
+    REQUIRE(conf.telemetry.empty());
+    REQUIRE(conf.telemetry_interval == 1);
+
+    conf = RadiosityConfig::from_docopt(
+        docopt::docopt(radiosity::USAGE, {argv + 1, argv + 7}));
+    REQUIRE(conf.telemetry == "/dev/fd/3");
+    REQUIRE(conf.telemetry_interval == 0.5);
+}
+
+TEST_CASE("Invalid tracer options are errors, not asserts", "[config]") {
+    const std::vector<std::vector<std::string>> invalid = {
+        {"file", "--pixel-samples", "0"},
+        {"file", "--tile-size", "0"},
+        {"file", "--threads=-1"},
+        {"file", "--region", "1,2"},
+        {"file", "--region", "0,0,641,10"},
+        {"file", "--sampler", "foo"},
+        {"file", "--background", "1 2"},
+        {"file", "--resume"},
+    };
+    for (const auto& argv : invalid) {
+        TracerConfig conf{Config()};
+        std::string error;
+        bool valid = false;
+        try {
+            valid = TracerConfig::parse(
+                docopt::docopt(pathtracer::USAGE, argv), conf, error);
+        } catch (const std::invalid_argument&) {
+            error = "malformed";
+        }
+        REQUIRE_FALSE(valid);
+        REQUIRE_FALSE(error.empty());
+    }
+
+    TracerConfig conf{Config()};
+    std::string error;
+    REQUIRE(TracerConfig::parse(
+        docopt::docopt(pathtracer::USAGE, {"file", "-p", "4"}), conf,
+        error));
+    REQUIRE(conf.num_pixel_samples == 4);
+}
+
+TEST_CASE("Tile size option", "[config]") {
+    for (const char* usage : {raycaster::USAGE, raytracer::USAGE,
+                              pathtracer::USAGE, radiosity::USAGE}) {
+        const char* argv[] = {"./exec", "exact", "file", "--tile-size",
+                              "32"};
+        // only radiosity takes a mode
+        const size_t first = usage == radiosity::USAGE ? 1 : 2;
+
+        auto conf = Config::from_docopt(
+            docopt::docopt(usage, {argv + first, argv + 3}));
+        REQUIRE(conf.tile_size == 16);
+
+        conf = Config::from_docopt(
+            docopt::docopt(usage, {argv + first, argv + 5}));
+        REQUIRE(conf.tile_size == 32);
+    }
+}
+
+TEST_CASE("Sampler option", "[config]") {
+    for (const char* usage : {raycaster::USAGE, raytracer::USAGE,
+                              pathtracer::USAGE, radiosity::USAGE}) {
+        const char* argv[] = {"./exec", "exact", "file", "--sampler",
+                              "halton"};
+        // only radiosity takes a mode
+        const size_t first = usage == radiosity::USAGE ? 1 : 2;
+
+        auto conf = Config::from_docopt(
+            docopt::docopt(usage, {argv + first, argv + 3}));
+        REQUIRE(conf.sampler == SamplerType::SOBOL);
+
+        conf = Config::from_docopt(
+            docopt::docopt(usage, {argv + first, argv + 5}));
+        REQUIRE(conf.sampler == SamplerType::HALTON);
+    }
+}
+
 TEST_CASE("Create common config from radiosity USAGE", "[config]") {
     const char* argv[] = {"./exec",
                           "exact",
@@ -0,0 +1,61 @@
+#include "../lib/counter_rng.h"
+#include "../lib/sampling.h"
+
+#include <catch.hpp>
+
+#include <set>
+
+TEST_CASE("Counter-based numbers", "[counter_rng]") {
+    CounterRng rng(0, 5, 3);
+    REQUIRE(rng.dimension() == 0);
+    const float first = rng();
+    const float second = rng();
+    REQUIRE(rng.dimension() == 2);
+    REQUIRE(first == rng.at(0));
+    REQUIRE(second == rng.at(1));
+    REQUIRE(first != second);
+
+    // the numbers depend on every coordinate
+    REQUIRE(CounterRng(0, 5, 3).at(0) == first);
+    REQUIRE(CounterRng(1, 5, 3).at(0) != first);
+    REQUIRE(CounterRng(0, 6, 3).at(0) != first);
+    REQUIRE(CounterRng(0, 5, 4).at(0) != first);
+}
+
+TEST_CASE("Counter-based numbers are uniform", "[counter_rng]") {
+    const int num_buckets = 16;
+    const int num_samples = 64000;
+    int buckets[num_buckets] = {};
+    std::set<float> distinct;
+    for (int pixel = 0; pixel < num_samples / 4; ++pixel) {
+        CounterRng rng(0, pixel, 0);
+        for (int dimension = 0; dimension < 4; ++dimension) {
+            const float u = rng();
+            REQUIRE(0 <= u);
+            REQUIRE(u < 1);
+            buckets[static_cast<int>(u * num_buckets)] += 1;
+            distinct.insert(u);
+        }
+    }
+    for (int count : buckets) {
+        REQUIRE(count == Approx(num_samples / num_buckets).epsilon(0.05));
+    }
+    REQUIRE(distinct.size() > num_samples * 0.99);
+}
+
+TEST_CASE("Samples do not depend on the thread", "[counter_rng]") {
+    sampling::start_sample(7, 42, 2, 1);
+    const float u = sampling::uniform();
+    const auto dir = sampling::hemisphere();
+
+    // other samples in between, as another tile on the thread would draw
+    sampling::start_sample(7, 1, 0, 1);
+    sampling::uniform();
+
+    sampling::start_sample(7, 42, 2, 1);
+    REQUIRE(sampling::uniform() == u);
+    const auto same_dir = sampling::hemisphere();
+    REQUIRE(same_dir.first.x == dir.first.x);
+    REQUIRE(same_dir.first.y == dir.first.y);
+    REQUIRE(same_dir.first.z == dir.first.z);
+}
@@ -0,0 +1,75 @@
+#include "../lib/cpu.h"
+#include "../lib/effects.h"
+#include "helper.h"
+
+#include <catch.hpp>
+#include <algorithm>
+
+namespace {
+
+struct Square {
+    float operator()(float x) const { return x * x; }
+};
+
+struct Increment {
+    void operator()(int& x) const { x += 1; }
+};
+
+} // namespace
+
+TEST_CASE("Selected ISA is supported by the cpu", "[cpu]") {
+    REQUIRE(cpu::isa() <= cpu::detect());
+    REQUIRE(std::string(cpu::to_string(cpu::Isa::AVX2)) == "avx2");
+}
+
+TEST_CASE("Dispatch calls the kernel", "[cpu]") {
+    REQUIRE(cpu::dispatch<Square>(3.f) == 9.f);
+
+    int x = 1;
+    cpu::dispatch<Increment>(x);
+    REQUIRE(x == 2);
+}
+
+TEST_CASE("All ISA variants give the same results", "[cpu]") {
+    using Kernel = detail::PostProcess;
+
+    Image expected(16, 16);
+    for (auto& c : expected) {
+        auto p = random_point();
+        c = Color(std::abs(p.x), std::abs(p.y), std::abs(p.z), 1.f);
+    }
+    Image image = expected;
+    cpu::detail::run_baseline<Kernel, Image&, float, bool, float>(
+        expected, 1.5f, true, 0.4545f);
+
+    if (cpu::detect() >= cpu::Isa::SSE42) {
+        Image actual = image;
+        cpu::detail::run_sse42<Kernel, Image&, float, bool, float>(
+            actual, 1.5f, true, 0.4545f);
+        REQUIRE(std::equal(actual.begin(), actual.end(), expected.begin()));
+    }
+    if (cpu::detect() >= cpu::Isa::AVX2) {
+        Image actual = image;
+        cpu::detail::run_avx2<Kernel, Image&, float, bool, float>(
+            actual, 1.5f, true, 0.4545f);
+        REQUIRE(std::equal(actual.begin(), actual.end(), expected.begin()));
+    }
+    if (cpu::detect() >= cpu::Isa::AVX512) {
+        Image actual = image;
+        cpu::detail::run_avx512<Kernel, Image&, float, bool, float>(
+            actual, 1.5f, true, 0.4545f);
+        REQUIRE(std::equal(actual.begin(), actual.end(), expected.begin()));
+    }
+}
+
+TEST_CASE("Post-processing applies exposure and gamma", "[cpu]") {
+    Image image(2, 1);
+    image(0, 0) = Color(0.5f, 0.25f, 0.f, 1.f);
+    image(1, 0) = Color(1.f, 1.f, 1.f, 1.f);
+
+    post_process(image, 2.f, true, 0.5f);
+    REQUIRE(image(0, 0).r == gamma(exposure(0.5f, 2.f), 0.5f));
+    REQUIRE(image(0, 0).g == gamma(exposure(0.25f, 2.f), 0.5f));
+    REQUIRE(image(0, 0).b == 0.f);
+    REQUIRE(image(1, 0).r == gamma(exposure(1.f, 2.f), 0.5f));
+}
@@ -0,0 +1,165 @@
+#include "../lib/daemon.h"
+
+#include <catch.hpp>
+
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace {
+
+// Pair of connected sockets.
+struct ConnectionPair {
+    ConnectionPair() {
+        int fds[2];
+        REQUIRE(::socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+        a = std::make_shared<Connection>(fds[0]);
+        b = std::make_shared<Connection>(fds[1]);
+    }
+
+    std::shared_ptr<Connection> a, b;
+};
+
+} // namespace
+
+TEST_CASE("Parse requests", "[daemon]") {
+    Request request;
+    std::string error;
+    REQUIRE(parse_request(
+        R"({"id": "a", "scene": "s.turner", "args": ["-p", "16"],
+            "camera": "0 0 5 0 0 0 0 1 0", "renderer": "pathtracer"})",
+        request, error));
+    REQUIRE_FALSE(request.cancel);
+    REQUIRE(request.job.id == "a");
+    REQUIRE(request.job.scene == "s.turner");
+    REQUIRE(request.job.args == std::vector<std::string>{"-p", "16"});
+    REQUIRE(request.job.camera == "0 0 5 0 0 0 0 1 0");
+    REQUIRE(request.job.renderer == "pathtracer");
+
+    REQUIRE(parse_request(R"({"cancel": "a"})", request, error));
+    REQUIRE(request.cancel);
+    REQUIRE(request.job.id == "a");
+
+    for (const char* line :
+         {"[]", "{\"id\": \"a\"}", "{\"id\": 1, \"scene\": \"s\"}",
+          "{\"id\": \"a\", \"scene\": \"s\", \"args\": \"-p 16\"}",
+          "{\"id\": \"a\", \"scene\": \"s\", \"args\": [16]}",
+          "{\"id\": \"a\", \"scene\": \"s\", \"camera\": [0]}",
+          "{\"cancel\": 1}", "{"}) {
+        INFO(line);
+        REQUIRE_FALSE(parse_request(line, request, error));
+    }
+}
+
+TEST_CASE("Events are JSON", "[daemon]") {
+    Json json;
+    std::string error;
+    REQUIRE(parse_json(progress_event("a\"", 2, 3, 4), json, error));
+    REQUIRE(json.find("id")->string == "a\"");
+    REQUIRE(json.find("event")->string == "progress");
+    REQUIRE(json.find("pass")->number == 2);
+    REQUIRE(json.find("tiles")->number == 3);
+    REQUIRE(json.find("total")->number == 4);
+
+    REQUIRE(parse_json(image_event("a", 640, 480, 123), json, error));
+    REQUIRE(json.find("bytes")->number == 123);
+    REQUIRE(parse_json(done_event("a", 10, true), json, error));
+    REQUIRE(json.find("cached")->boolean);
+    REQUIRE(parse_json(cancelled_event("a"), json, error));
+    REQUIRE(json.find("event")->string == "cancelled");
+    REQUIRE(parse_json(error_event("a", "no\nscene"), json, error));
+    REQUIRE(json.find("message")->string == "no\nscene");
+}
+
+TEST_CASE("Connection", "[daemon]") {
+    ConnectionPair pair;
+    REQUIRE(pair.a->send_line("first"));
+    REQUIRE(pair.a->send("second\nP3 "));
+    REQUIRE(pair.a->send(std::string(10000, 'x') + "\n"));
+
+    std::string line;
+    REQUIRE(pair.b->read_line(line));
+    REQUIRE(line == "first");
+    REQUIRE(pair.b->read_line(line));
+    REQUIRE(line == "second");
+    std::string data;
+    REQUIRE(pair.b->read_bytes(data, 3));
+    REQUIRE(data == "P3 ");
+    REQUIRE(pair.b->read_line(line));
+    REQUIRE(line == std::string(10000, 'x'));
+
+    pair.a.reset();
+    REQUIRE_FALSE(pair.b->read_line(line));
+}
+
+TEST_CASE("Listen and connect", "[daemon]") {
+    char dir[] = "test_daemon_XXXXXX";
+    REQUIRE(mkdtemp(dir));
+    const std::string path = std::string(dir) + "/socket";
+
+    std::string error;
+    REQUIRE(connect_unix(path, error) < 0);
+    REQUIRE(error.find("Cannot connect") != std::string::npos);
+
+    // a stale socket file is replaced
+    for (int i = 0; i < 2; ++i) {
+        const int listener = listen_unix(path, error);
+        REQUIRE(listener >= 0);
+
+        std::thread client([&]() {
+            Connection connection(connect_unix(path, error));
+            connection.send_line("hello");
+        });
+        Connection connection(::accept(listener, nullptr, nullptr));
+        std::string line;
+        REQUIRE(connection.read_line(line));
+        REQUIRE(line == "hello");
+        client.join();
+        ::close(listener);
+    }
+
+    ::unlink(path.c_str());
+    ::rmdir(dir);
+}
+
+TEST_CASE("Job queue", "[daemon]") {
+    ConnectionPair first, second;
+    JobQueue queue;
+    queue.push(first.a, {"1", "", "s", "", {}});
+    queue.push(second.a, {"1", "", "s", "", {}});
+    queue.push(first.a, {"2", "", "s", "", {}});
+    REQUIRE(queue.size() == 3);
+
+    JobQueue::Entry entry;
+    REQUIRE(queue.pop(entry));
+    REQUIRE(entry.connection == first.a);
+    REQUIRE(entry.job.id == "1");
+    REQUIRE_FALSE(queue.cancelled());
+
+    // the ids are per connection
+    REQUIRE(queue.cancel(second.a, "2") == JobQueue::Cancelled::UNKNOWN);
+    REQUIRE(queue.cancel(first.a, "2") == JobQueue::Cancelled::QUEUED);
+    REQUIRE(queue.size() == 1);
+    REQUIRE(queue.cancel(first.a, "1") == JobQueue::Cancelled::RUNNING);
+    REQUIRE(queue.cancelled());
+    queue.finish();
+
+    REQUIRE(queue.pop(entry));
+    REQUIRE(entry.connection == second.a);
+    REQUIRE_FALSE(queue.cancelled());
+
+    // a closed connection cancels its running and queued jobs
+    queue.push(second.a, {"2", "", "s", "", {}});
+    queue.drop(second.a);
+    REQUIRE(queue.cancelled());
+    REQUIRE(queue.size() == 0);
+    queue.finish();
+
+    std::thread stopper([&]() { queue.stop(); });
+    REQUIRE_FALSE(queue.pop(entry));
+    stopper.join();
+}
@@ -157,3 +157,41 @@ TEST_CASE("Split box at plane", "[bbox3]") {
     REQUIRE(l == (Bbox3i{{0, 0, 0}, {2, 2, 1}}));
     REQUIRE(r == (Bbox3i{{0, 0, 1}, {2, 2, 2}}));
 }
+
+TEST_CASE("Vector3f arithmetic is component-wise", "[vector3]") {
+    Vector3f v(-1.5f, 0.1f, 3.f);
+    Vector3f w(0.3f, -2.f, 3.f);
+
+    Vector3f sum = v + w;
+    REQUIRE(sum.x == -1.5f + 0.3f);
+    REQUIRE(sum.y == 0.1f + -2.f);
+    REQUIRE(sum.z == 3.f + 3.f);
+
+    Vector3f scaled = 0.7f * v;
+    REQUIRE(scaled.x == 0.7f * -1.5f);
+    REQUIRE(scaled.y == 0.7f * 0.1f);
+    REQUIRE(scaled.z == 0.7f * 3.f);
+
+    REQUIRE(dot(v, w) == -1.5f * 0.3f + 0.1f * -2.f + 3.f * 3.f);
+    REQUIRE(min(v, w) == Vector3f(-1.5f, -2.f, 3.f));
+    REQUIRE(max(v, w) == Vector3f(0.3f, 0.1f, 3.f));
+    REQUIRE(abs(v) == Vector3f(1.5f, 0.1f, 3.f));
+
+#ifdef TURNER_SIMD_SSE
+    REQUIRE(sizeof(Vector3f) == 16);
+    REQUIRE(alignof(Point3f) == 16);
+    REQUIRE(alignof(Normal3f) == 16);
+#endif
+    // only the float types get the fourth lane
+    REQUIRE(sizeof(Point3i) == 3 * sizeof(int));
+    REQUIRE(sizeof(Vector3<double>) == 3 * sizeof(double));
+    REQUIRE(alignof(Vector3i) == alignof(int));
+}
+
+TEST_CASE("Bbox3f union of points", "[bbox3]") {
+    Bbox3f b(Point3f(0, 0, 0));
+    b = bbox_union(b, Point3f(-1, 2, 0.5f));
+    b = bbox_union(b, Point3f(1, -2, -0.5f));
+    REQUIRE(b.p_min == Point3f(-1, -2, -0.5f));
+    REQUIRE(b.p_max == Point3f(1, 2, 0.5f));
+}
@@ -0,0 +1,56 @@
+#include "../lib/heatmap.h"
+#include <catch.hpp>
+
+#include <cstring>
+#include <sstream>
+
+TEST_CASE("False color scale", "[heatmap]") {
+    REQUIRE(false_color(0) == Color(0, 0, 1, 1));
+    REQUIRE(false_color(0.5f) == Color(0, 1, 0, 1));
+    REQUIRE(false_color(1) == Color(1, 0, 0, 1));
+}
+
+TEST_CASE("False color image is normalized by the most expensive pixel",
+          "[heatmap]") {
+    Heatmap heatmap(2, 1);
+    heatmap(1, 0).nodes = 10;
+    heatmap(1, 0).leaves = 2;
+    heatmap(1, 0).triangle_tests = 4;
+
+    auto image = false_color_image(heatmap);
+    REQUIRE(image.width() == 2);
+    REQUIRE(image.height() == 1);
+    REQUIRE(image(0, 0) == false_color(0));
+    REQUIRE(image(1, 0) == false_color(1));
+
+    // empty heatmap
+    image = false_color_image(Heatmap(1, 1));
+    REQUIRE(image(0, 0) == false_color(0));
+}
+
+TEST_CASE("Write heatmap as PFM", "[heatmap]") {
+    Heatmap heatmap(2, 2);
+    heatmap(0, 0).nodes = 1;
+    heatmap(1, 0).leaves = 2;
+    heatmap(0, 1).triangle_tests = 3;
+
+    std::ostringstream os;
+    write_pfm(os, heatmap);
+    std::istringstream is(os.str());
+
+    std::string magic, scale;
+    size_t width, height;
+    is >> magic >> width >> height >> scale;
+    is.get();
+    REQUIRE(magic == "PF");
+    REQUIRE(width == 2);
+    REQUIRE(height == 2);
+
+    float data[12];
+    is.read(reinterpret_cast<char*>(data), sizeof(data));
+    REQUIRE(is.gcount() == sizeof(data));
+
+    // bottom row first
+    float expected[12] = {0, 0, 3, 0, 0, 0, 1, 0, 0, 0, 2, 0};
+    REQUIRE(std::memcmp(data, expected, sizeof(data)) == 0);
+}
@@ -1,7 +1,9 @@
 #include "../lib/intersection.h"
 #include "helper.h"
 #include "catch.hpp"
+#include <algorithm>
 #include <iostream>
+#include <random>
 
 
 TEST_CASE("Segment plane intersection", "[intersection]") {
@@ -66,3 +68,55 @@ TEST_CASE("Random triangle aabb intersection", "[intersection]") {
         REQUIRE(intersect_triangle_box(random_triangle(), box));
     }
 }
+
+template <typename Intersector> void check_intersector() {
+    static std::default_random_engine gen(0);
+    static std::uniform_real_distribution<float> rnd(-0.5f, 1.5f);
+
+    for (int i = 0; i < 1000; ++i) {
+        auto tri = random_triangle();
+        auto data = Intersector::precompute(tri);
+
+        // Shoot a ray at a point in the plane of the triangle given by
+        // barycentric coordinates. Skip points close to the edges, where the
+        // kernels may disagree due to rounding.
+        float s0 = rnd(gen);
+        float t0 = rnd(gen);
+        if (std::min({std::abs(s0), std::abs(t0), std::abs(1 - s0 - t0)}) <
+            0.01f) {
+            continue;
+        }
+        Point3f target = tri.vertices[0] + s0 * tri.u + t0 * tri.v;
+        Point3f origin = random_point();
+        Ray ray(origin, target - origin);
+
+        float r = 0, s = 0, t = 0;
+        bool expected = intersect_ray_triangle(ray, tri, r, s, t);
+
+        float r_i = 0, s_i = 0, t_i = 0;
+        bool actual = Intersector::intersect(
+            ray, data, std::numeric_limits<float>::max(), r_i, s_i, t_i);
+        REQUIRE(actual == expected);
+        if (!expected) {
+            continue;
+        }
+        REQUIRE(r_i == Approx(r).epsilon(0.001));
+        REQUIRE(std::abs(s_i - s) < 0.001f);
+        REQUIRE(std::abs(t_i - t) < 0.001f);
+
+        // Intersections behind t_max are rejected.
+        REQUIRE(!Intersector::intersect(ray, data, r / 2, r_i, s_i, t_i));
+    }
+}
+
+TEST_CASE("Moeller-Trumbore ray triangle intersection", "[intersection]") {
+    check_intersector<intersector::MoellerTrumbore>();
+}
+
+TEST_CASE("Wald projection ray triangle intersection", "[intersection]") {
+    check_intersector<intersector::WaldProjection>();
+}
+
+TEST_CASE("Baldwin-Weber ray triangle intersection", "[intersection]") {
+    check_intersector<intersector::BaldwinWeber>();
+}
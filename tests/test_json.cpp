@@ -0,0 +1,58 @@
+#include "../lib/json.h"
+
+#include <catch.hpp>
+
+#include <string>
+
+TEST_CASE("Parse JSON", "[json]") {
+    Json json;
+    std::string error;
+    REQUIRE(parse_json(R"( {"a": [1, -2.5e1, true, false, null],
+                            "b": {"c": "d\"e\\\n\u00e9"}, "e": []} )",
+                       json, error));
+    REQUIRE(json.is_object());
+    REQUIRE(json.object.size() == 3);
+
+    const Json* a = json.find("a");
+    REQUIRE(a);
+    REQUIRE(a->is_array());
+    REQUIRE(a->array.size() == 5);
+    REQUIRE(a->array[0].number == 1);
+    REQUIRE(a->array[1].number == -25);
+    REQUIRE(a->array[2].type == Json::BOOL);
+    REQUIRE(a->array[2].boolean);
+    REQUIRE_FALSE(a->array[3].boolean);
+    REQUIRE(a->array[4].type == Json::NUL);
+
+    const Json* c = json.find("b")->find("c");
+    REQUIRE(c);
+    REQUIRE(c->is_string());
+    REQUIRE(c->string == "d\"e\\\n\xc3\xa9");
+    REQUIRE(json.find("e")->array.empty());
+    REQUIRE(json.find("f") == nullptr);
+}
+
+TEST_CASE("Reject invalid JSON", "[json]") {
+    Json json;
+    std::string error;
+    for (const char* text :
+         {"", "{", "{\"a\" 1}", "{\"a\": 1,}", "[1 2]", "\"abc", "tru",
+          "{} x", "{a: 1}", "\"\\x\"", "[-]"}) {
+        INFO(text);
+        REQUIRE_FALSE(parse_json(text, json, error));
+        REQUIRE_FALSE(error.empty());
+    }
+    REQUIRE_FALSE(parse_json(std::string(100, '[') + std::string(100, ']'),
+                             json, error));
+}
+
+TEST_CASE("JSON string", "[json]") {
+    REQUIRE(json_string("abc") == "\"abc\"");
+    REQUIRE(json_string("a\"b\\c\nd\x01") == "\"a\\\"b\\\\c\\nd\\u0001\"");
+
+    Json json;
+    std::string error;
+    const std::string s = "quote \" backslash \\ tab \t";
+    REQUIRE(parse_json(json_string(s), json, error));
+    REQUIRE(json.string == s);
+}
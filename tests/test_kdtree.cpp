@@ -62,6 +62,41 @@ TEST_CASE("Four separated triangles test", "[kdtree]") {
     REQUIRE(t == 0.5f);
 }
 
+TEST_CASE("Count traversal cost", "[kdtree]") {
+    auto a = test_triangle({0, 0, 1}, {0, 1, 1}, {1, 0, 1});
+    auto b = test_triangle({2, 0, 1}, {3, 0, 1}, {3, 1, 1});
+    auto c = test_triangle({0, 2, 1}, {0, 3, 1}, {1, 3, 1});
+    auto d = test_triangle({3, 2, 1}, {3, 3, 1}, {2, 3, 1});
+    KDTree tree(Triangles{a, b, c, d});
+    KDTreeIntersection tree_intersection(tree);
+
+    TraversalCost cost;
+    tree_intersection.count_cost(&cost);
+
+    // missing the bounding box costs nothing
+    REQUIRE(!tree_intersection.intersect({{0, 0, 0}, {-1, -1, 1}}));
+    REQUIRE(cost.nodes == 0);
+    REQUIRE(cost.leaves == 0);
+    REQUIRE(cost.triangle_tests == 0);
+
+    REQUIRE(tree_intersection.intersect({{0, 0, 0}, {0.5f, 0.5f, 1}}));
+    REQUIRE(cost.nodes >= 1);
+    REQUIRE(cost.leaves >= 1);
+    REQUIRE(cost.triangle_tests >= 1);
+    REQUIRE(cost.triangle_tests < 4);
+
+    // costs are summed up
+    TraversalCost first = cost;
+    REQUIRE(tree_intersection.intersect({{0, 0, 0}, {0.5f, 0.5f, 1}}));
+    REQUIRE(cost.nodes == 2 * first.nodes);
+    REQUIRE(cost.leaves == 2 * first.leaves);
+    REQUIRE(cost.triangle_tests == 2 * first.triangle_tests);
+
+    tree_intersection.count_cost(nullptr);
+    REQUIRE(tree_intersection.intersect({{0, 0, 0}, {2.5f, 2.5f, 1}}));
+    REQUIRE(cost.triangle_tests == 2 * first.triangle_tests);
+}
+
 TEST_CASE("Serialize and deserialize", "[kdtree]") {
     auto a = test_triangle({0, 0, 1}, {0, 1, 1}, {1, 0, 1});
     auto b = test_triangle({2, 0, 1}, {3, 0, 1}, {3, 1, 1});
@@ -159,6 +194,45 @@ TEST_CASE("KDTree stress test", "[kdtree]") {
     std::cerr << std::endl;
 }
 
+TEST_CASE("KDTree gives the same hits for all intersection kernels",
+          "[kdtree]") {
+    static constexpr size_t TRIANGLES_COUNT = 100;
+    static constexpr size_t RAYS_COUNT = 1000;
+
+    Triangles triangles;
+    for (size_t i = 0; i < TRIANGLES_COUNT; ++i) {
+        triangles.push_back(random_triangle());
+    }
+
+    BasicKDTree<intersector::MoellerTrumbore> mt_tree(triangles);
+    BasicKDTree<intersector::WaldProjection> wald_tree(mt_tree);
+    BasicKDTree<intersector::BaldwinWeber> bw_tree(mt_tree);
+    REQUIRE(wald_tree.num_nodes() == mt_tree.num_nodes());
+    REQUIRE(bw_tree.num_nodes() == mt_tree.num_nodes());
+
+    BasicKDTreeIntersection<intersector::MoellerTrumbore> mt(mt_tree);
+    BasicKDTreeIntersection<intersector::WaldProjection> wald(wald_tree);
+    BasicKDTreeIntersection<intersector::BaldwinWeber> bw(bw_tree);
+
+    size_t num_hits = 0;
+    for (size_t i = 0; i < RAYS_COUNT; ++i) {
+        Ray ray(random_point(), random_vec());
+        float r_mt = 0, r_wald = 0, r_bw = 0, s, t;
+        auto id_mt = mt.intersect(ray, r_mt, s, t);
+        auto id_wald = wald.intersect(ray, r_wald, s, t);
+        auto id_bw = bw.intersect(ray, r_bw, s, t);
+
+        REQUIRE(id_mt == id_wald);
+        REQUIRE(id_mt == id_bw);
+        if (id_mt) {
+            num_hits += 1;
+            REQUIRE(std::abs(r_wald - r_mt) < 0.001f * std::max(1.f, r_mt));
+            REQUIRE(std::abs(r_bw - r_mt) < 0.001f * std::max(1.f, r_mt));
+        }
+    }
+    REQUIRE(num_hits > 0);
+}
+
 TEST_CASE("Test cube in kdtree", "[kdtree]") {
     // cube made of triangles
     // front
@@ -228,7 +302,7 @@ TEST_CASE("Intersect coplanar triangles", "[KDTree]") {
         triangle_id = tree_intersection.intersect(ray, r, s, t);
         REQUIRE(static_cast<bool>(triangle_id));
         REQUIRE(static_cast<size_t>(triangle_id) == 0L);
-        REQUIRE(static_cast<int>(r) == 100);
+        REQUIRE(r == Approx(100));
         REQUIRE(is_eps_zero(s - 1.f / 3));
         REQUIRE(is_eps_zero(t - 1.f / 3));
 
@@ -238,7 +312,7 @@ TEST_CASE("Intersect coplanar triangles", "[KDTree]") {
         triangle_id = tree_intersection.intersect(ray, r, s, t);
         REQUIRE(static_cast<bool>(triangle_id));
         REQUIRE(static_cast<size_t>(triangle_id) == 9L);
-        REQUIRE(static_cast<int>(r) == 91);
+        REQUIRE(r == Approx(91));
         REQUIRE(is_eps_zero(s - 1.f / 3));
         REQUIRE(is_eps_zero(t - 1.f / 3));
     }
@@ -0,0 +1,154 @@
+#include "../lib/kdtree_cache.h"
+#include "helper.h"
+
+#include <catch.hpp>
+
+#include <cstdio>
+#include <fstream>
+
+#include <unistd.h>
+
+namespace {
+
+TriangleMesh test_mesh(float z) {
+    return TriangleMesh(
+        Triangles{test_triangle({0, 0, z}, {1, 0, z}, {0, 1, z}),
+                  test_triangle({0, 0, z + 1}, {1, 0, z + 1}, {0, 1, z + 1})});
+}
+
+// Temporary cache directory, which is removed with its content on
+// destruction.
+struct TempDir {
+    TempDir() {
+        char name[] = "test_kdtree_cache_XXXXXX";
+        path = mkdtemp(name);
+    }
+    ~TempDir() {
+        for (const auto& file : files) {
+            std::remove(file.c_str());
+        }
+        rmdir(path.c_str());
+    }
+
+    std::string path;
+    std::vector<std::string> files;
+};
+
+} // namespace
+
+TEST_CASE("Kd-tree cache key", "[kdtree_cache]") {
+    REQUIRE(kdtree_cache_key(test_mesh(0)) == kdtree_cache_key(test_mesh(0)));
+    REQUIRE(kdtree_cache_key(test_mesh(0)) != kdtree_cache_key(test_mesh(1)));
+
+    // the material table is part of the key
+    auto mesh = test_mesh(0);
+    Material material;
+    material.diffuse = {1, 0, 0, 1};
+    mesh.add_material(material);
+    REQUIRE(kdtree_cache_key(mesh) != kdtree_cache_key(test_mesh(0)));
+}
+
+TEST_CASE("Store and load kd-tree from cache", "[kdtree_cache]") {
+    TempDir dir;
+    const KDTree tree(test_mesh(0));
+    const uint64_t key = kdtree_cache_key(tree.mesh());
+    const std::string path = kdtree_cache_path(dir.path, key);
+    dir.files.push_back(path);
+
+    KDTree loaded;
+    std::string error;
+    REQUIRE_FALSE(load_cached_kdtree(dir.path, key, loaded, error));
+    REQUIRE(error.empty());
+
+    REQUIRE(store_cached_kdtree(dir.path, key, tree));
+
+    SECTION("Valid cache file") {
+        REQUIRE(load_cached_kdtree(dir.path, key, loaded, error));
+        REQUIRE(loaded.num_nodes() == tree.num_nodes());
+        REQUIRE(loaded.mesh().vertices() == tree.mesh().vertices());
+        REQUIRE(loaded.mesh().faces() == tree.mesh().faces());
+        REQUIRE(kdtree_cache_key(loaded.mesh()) == key);
+
+        // the loaded tree refers to the mapped file
+        REQUIRE(loaded.nodes().is_view());
+        REQUIRE(loaded.intersector_data().is_view());
+        REQUIRE(loaded.mesh().vertices().is_view());
+
+        KDTreeIntersection intersection(tree);
+        KDTreeIntersection loaded_intersection(loaded);
+        const Ray ray({0.25f, 0.25f, -1}, {0, 0, 1});
+        float r, s, t;
+        REQUIRE(loaded_intersection.intersect(ray, r, s, t) ==
+                intersection.intersect(ray, r, s, t));
+        REQUIRE(loaded_intersection.intersect(ray, r, s, t));
+    }
+
+    SECTION("Other intersection kernel") {
+        using Other = std::conditional_t<
+            std::is_same<TriangleIntersector, intersector::BaldwinWeber>::value,
+            intersector::MoellerTrumbore, intersector::BaldwinWeber>;
+        BasicKDTree<Other> other;
+        REQUIRE(load_cached_kdtree(dir.path, key, other, error));
+        REQUIRE(other.nodes().is_view());
+        REQUIRE_FALSE(other.intersector_data().is_view());
+        REQUIRE(other.intersector_data().size() == tree.num_triangles());
+    }
+
+    SECTION("Other key") {
+        REQUIRE_FALSE(load_cached_kdtree(
+            dir.path, kdtree_cache_key(test_mesh(1)), loaded, error));
+        REQUIRE(error.empty());
+    }
+
+    SECTION("Other layout") {
+        std::fstream file(path,
+                          std::ios::in | std::ios::out | std::ios::binary);
+        file.seekp(offsetof(KDTreeCacheHeader, node_size));
+        file.put(4);
+        file.close();
+
+        REQUIRE_FALSE(load_cached_kdtree(dir.path, key, loaded, error));
+        REQUIRE_FALSE(error.empty());
+    }
+
+    SECTION("Corrupt face") {
+        KDTreeCacheHeader header;
+        std::ifstream(path, std::ios::binary)
+            .read(reinterpret_cast<char*>(&header), sizeof(header));
+        const uint32_t vertex = header.num_vertices;
+        std::fstream file(path,
+                          std::ios::in | std::ios::out | std::ios::binary);
+        file.seekp(header.faces_offset + sizeof(uint32_t));
+        file.write(reinterpret_cast<const char*>(&vertex), sizeof(vertex));
+        file.close();
+
+        REQUIRE_FALSE(load_cached_kdtree(dir.path, key, loaded, error));
+        REQUIRE(error.find("Corrupt") != std::string::npos);
+    }
+
+    SECTION("Corrupt node") {
+        KDTreeCacheHeader header;
+        std::ifstream(path, std::ios::binary)
+            .read(reinterpret_cast<char*>(&header), sizeof(header));
+        // a leaf referring to a triangle behind the mesh
+        const detail::FlatNode node(header.num_faces);
+        std::fstream file(path,
+                          std::ios::in | std::ios::out | std::ios::binary);
+        file.seekp(header.nodes_offset);
+        file.write(reinterpret_cast<const char*>(&node), sizeof(node));
+        file.close();
+
+        REQUIRE_FALSE(load_cached_kdtree(dir.path, key, loaded, error));
+        REQUIRE(error.find("Corrupt") != std::string::npos);
+    }
+
+    SECTION("Truncated cache file") {
+        REQUIRE(truncate(path.c_str(), 20) == 0);
+        REQUIRE_FALSE(load_cached_kdtree(dir.path, key, loaded, error));
+        REQUIRE_FALSE(error.empty());
+
+        REQUIRE(truncate(path.c_str(), sizeof(KDTreeCacheHeader) + 1) == 0);
+        REQUIRE_FALSE(load_cached_kdtree(dir.path, key, loaded, error));
+        REQUIRE_FALSE(error.empty());
+    }
+}
@@ -0,0 +1,48 @@
+#include "../lib/lru_cache.h"
+
+#include <catch.hpp>
+
+#include <iterator>
+#include <memory>
+#include <string>
+#include <vector>
+
+TEST_CASE("LRU cache", "[lru_cache]") {
+    LruCache<std::string, int> cache(2);
+    REQUIRE(cache.get("a") == nullptr);
+
+    cache.put("a", 1);
+    cache.put("b", 2);
+    REQUIRE(cache.size() == 2);
+    REQUIRE(*cache.get("a") == 1);
+
+    // b is the least recently used entry
+    cache.put("c", 3);
+    REQUIRE(cache.size() == 2);
+    REQUIRE(cache.get("b") == nullptr);
+    REQUIRE(*cache.get("a") == 1);
+    REQUIRE(*cache.get("c") == 3);
+
+    std::vector<std::string> keys;
+    cache.keys(std::back_inserter(keys));
+    REQUIRE(keys == std::vector<std::string>{"c", "a"});
+
+    // replacing a value makes it the most recently used
+    cache.put("a", 4);
+    cache.put("d", 5);
+    REQUIRE(cache.get("c") == nullptr);
+    REQUIRE(*cache.get("a") == 4);
+
+    cache.erase("a");
+    REQUIRE(cache.get("a") == nullptr);
+    REQUIRE(cache.size() == 1);
+}
+
+TEST_CASE("LRU cache of move-only values", "[lru_cache]") {
+    LruCache<int, std::unique_ptr<int>> cache(1);
+    int* value = cache.put(1, std::unique_ptr<int>(new int(7))).get();
+    REQUIRE(cache.get(1)->get() == value);
+    cache.put(2, std::unique_ptr<int>(new int(8)));
+    REQUIRE(cache.get(1) == nullptr);
+    REQUIRE(**cache.get(2) == 8);
+}
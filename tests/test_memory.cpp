@@ -0,0 +1,64 @@
+#include "../lib/kdtree.h"
+#include "../lib/memory.h"
+#include "../lib/output.h"
+#include "../lib/raster.h"
+#include "../lib/stats.h"
+#include "helper.h"
+
+#include <catch.hpp>
+
+#include <sstream>
+
+TEST_CASE("Memory of containers", "[memory]") {
+    std::vector<float> v;
+    v.reserve(10);
+    REQUIRE(memory_bytes(v) == 10 * sizeof(float));
+
+    const Image image(4, 2);
+    REQUIRE(image.memory_bytes() == 8 * sizeof(Color));
+
+    const TriangleMesh mesh(
+        Triangles{test_triangle({0, 0, 0}, {1, 0, 0}, {0, 1, 0}),
+                  test_triangle({0, 0, 1}, {1, 0, 1}, {0, 1, 1})});
+    const size_t vertex_size = sizeof(Point3f) + sizeof(Normal3f);
+    const size_t face_size = sizeof(TriangleMesh::Face) + sizeof(MaterialId);
+    REQUIRE(mesh.memory_bytes() >= mesh.vertices().size() * vertex_size +
+                                       mesh.size() * face_size);
+
+    const KDTree tree(mesh);
+    REQUIRE(tree.memory_bytes() >=
+            tree.num_nodes() * KDTree::node_size() +
+                tree.num_triangles() * sizeof(KDTree::IntersectorData));
+
+    // a view refers to memory it does not own
+    const Buffer<float> view(v.data(), 3, std::make_shared<int>(0));
+    REQUIRE(view.memory_bytes() == 3 * sizeof(float));
+}
+
+TEST_CASE("Resident set size", "[memory]") {
+    const size_t rss = current_rss_bytes();
+    REQUIRE(rss > 0);
+    REQUIRE(peak_rss_bytes() >= rss);
+}
+
+TEST_CASE("Memory stats", "[memory]") {
+    auto& stats = Stats::instance();
+    stats.memory.triangles = 1024;
+    stats.memory.matrix = 2048;
+    stats.end_phase("load");
+    REQUIRE(stats.peak_rss.back().first == "load");
+    REQUIRE(stats.peak_rss.back().second > 0);
+
+    std::ostringstream text;
+    text << stats;
+    REQUIRE(text.str().find("Peak RSS") != std::string::npos);
+
+    std::ostringstream json;
+    write_json(json, stats);
+    REQUIRE(json.str().front() == '{');
+    REQUIRE(json.str().back() == '}');
+    REQUIRE(json.str().find("\"triangles\": 1024") != std::string::npos);
+    REQUIRE(json.str().find("\"matrix\": 2048") != std::string::npos);
+    REQUIRE(json.str().find("{\"phase\": \"load\", \"bytes\": ") !=
+            std::string::npos);
+}
@@ -0,0 +1,171 @@
+#include "../lib/partial.h"
+
+#include <catch.hpp>
+
+#include <cstdio>
+#include <fstream>
+#include <string>
+
+#include <unistd.h>
+
+namespace {
+
+// Temporary partial file, which is removed on destruction.
+struct TempFile {
+    TempFile() {
+        char name[] = "test_partial_XXXXXX";
+        const int fd = mkstemp(name);
+        close(fd);
+        path = name;
+    }
+    ~TempFile() { std::remove(path.c_str()); }
+
+    std::string path;
+};
+
+} // namespace
+
+TEST_CASE("Write and read partial", "[partial]") {
+    TempFile file;
+    Accumulator acc(6, 4);
+    for (size_t y = 0; y < 4; ++y) {
+        for (size_t x = 0; x < 6; ++x) {
+            acc.add(x, y, {1.f * x, 1.f * y, 0, 1});
+        }
+    }
+
+    std::string error;
+    REQUIRE(write_partial(file.path, acc, {1, 2, 4, 4}, 42, 7, error));
+
+    Partial partial;
+    REQUIRE(read_partial(file.path, partial, error));
+    REQUIRE(partial.width == 6);
+    REQUIRE(partial.height == 4);
+    REQUIRE(partial.region.x0 == 1);
+    REQUIRE(partial.region.y0 == 2);
+    REQUIRE(partial.region.x1 == 4);
+    REQUIRE(partial.region.y1 == 4);
+    REQUIRE(partial.key == 42);
+    REQUIRE(partial.seed == 7);
+    REQUIRE(partial.pixels.size() == 6);
+
+    // only the region is merged
+    Accumulator merged(6, 4);
+    MergedPartials merged_partials;
+    std::string warning;
+    REQUIRE(merge_partial(partial, merged, merged_partials, error, warning));
+    REQUIRE(warning.empty());
+    REQUIRE(merged_partials.key == 42);
+    for (size_t y = 0; y < 4; ++y) {
+        for (size_t x = 0; x < 6; ++x) {
+            const bool inside = 1 <= x && x < 4 && 2 <= y;
+            REQUIRE(merged.num_samples(x, y) == (inside ? 1 : 0));
+            if (inside) {
+                REQUIRE(merged.mean(x, y) == acc.mean(x, y));
+            }
+        }
+    }
+}
+
+TEST_CASE("Merge partials weighted by samples", "[partial]") {
+    TempFile a_file, b_file;
+    Accumulator a(2, 1), b(2, 1);
+    a.add(0, 0, {1, 1, 1, 1});
+    for (int i = 0; i < 3; ++i) {
+        b.add(0, 0, {0, 0, 0, 1});
+    }
+    b.add(1, 0, {0.5f, 0.5f, 0.5f, 1});
+
+    std::string error;
+    REQUIRE(write_partial(a_file.path, a, {0, 0, 1, 1}, 42, 0, error));
+    REQUIRE(write_partial(b_file.path, b, {0, 0, 2, 1}, 42, 1, error));
+
+    Accumulator merged(2, 1);
+    MergedPartials merged_partials;
+    for (const auto& path : {a_file.path, b_file.path}) {
+        Partial partial;
+        std::string warning;
+        REQUIRE(read_partial(path, partial, error));
+        REQUIRE(
+            merge_partial(partial, merged, merged_partials, error, warning));
+        REQUIRE(warning.empty());
+    }
+    REQUIRE(merged.num_samples(0, 0) == 4);
+    REQUIRE(merged.mean(0, 0).r == Approx(0.25f));
+    REQUIRE(merged.num_samples(1, 0) == 1);
+    REQUIRE(merged.mean(1, 0).r == Approx(0.5f));
+    // the error estimate covers the samples of both partials: luminances
+    // 1, 0, 0, 0 have sample variance 0.25
+    REQUIRE(merged.variance_of_mean(0, 0) == Approx(0.25f / 4));
+}
+
+TEST_CASE("Reject invalid partials", "[partial]") {
+    TempFile file;
+    Accumulator acc(4, 4);
+    std::string error;
+    REQUIRE(write_partial(file.path, acc, {0, 0, 4, 4}, 42, 0, error));
+
+    Partial partial;
+    REQUIRE(read_partial(file.path, partial, error));
+    Accumulator other_size(4, 2);
+    MergedPartials merged_partials;
+    std::string warning;
+    REQUIRE_FALSE(
+        merge_partial(partial, other_size, merged_partials, error, warning));
+
+    {
+        std::ofstream out(file.path, std::ios::binary | std::ios::trunc);
+        out << "P3\n";
+    }
+    REQUIRE_FALSE(read_partial(file.path, partial, error));
+    REQUIRE(error.find("Not a partial") != std::string::npos);
+}
+
+TEST_CASE("Reject partials of other renders", "[partial]") {
+    Accumulator acc(4, 4);
+    MergedPartials merged_partials;
+    std::string error, warning;
+
+    Partial partial;
+    partial.width = 4;
+    partial.height = 4;
+    partial.region = {0, 0, 4, 2};
+    partial.key = 42;
+    partial.pixels.resize(partial.region.size());
+    REQUIRE(merge_partial(partial, acc, merged_partials, error, warning));
+
+    partial.region = {0, 2, 4, 4};
+    partial.key = 43;
+    REQUIRE_FALSE(
+        merge_partial(partial, acc, merged_partials, error, warning));
+    REQUIRE(error.find("another scene") != std::string::npos);
+}
+
+TEST_CASE("Warn about overlapping partials with the same seed", "[partial]") {
+    Accumulator acc(4, 4);
+    MergedPartials merged_partials;
+    std::string error, warning;
+
+    Partial partial;
+    partial.width = 4;
+    partial.height = 4;
+    partial.region = {0, 0, 4, 2};
+    partial.pixels.resize(partial.region.size());
+    REQUIRE(merge_partial(partial, acc, merged_partials, error, warning));
+
+    // disjoint regions may share their seed
+    partial.region = {0, 2, 4, 4};
+    REQUIRE(merge_partial(partial, acc, merged_partials, error, warning));
+    REQUIRE(warning.empty());
+
+    // as may overlapping regions with different seeds
+    partial.region = {0, 1, 4, 3};
+    partial.seed = 1;
+    partial.pixels.resize(partial.region.size());
+    REQUIRE(merge_partial(partial, acc, merged_partials, error, warning));
+    REQUIRE(warning.empty());
+
+    partial.seed = 0;
+    REQUIRE(merge_partial(partial, acc, merged_partials, error, warning));
+    REQUIRE(warning.find("seed 0") != std::string::npos);
+}
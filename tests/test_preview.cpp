@@ -0,0 +1,40 @@
+#include "../lib/preview.h"
+
+#include <catch.hpp>
+
+TEST_CASE("Preview levels render every block corner once", "[preview]") {
+    for (size_t y = 0; y < 32; ++y) {
+        for (size_t x = 0; x < 32; ++x) {
+            size_t levels = 0;
+            for (const size_t block : PREVIEW_BLOCKS) {
+                levels += preview_pixel(x, y, block);
+            }
+            INFO("pixel " << x << ", " << y);
+            // odd pixels are left to the full render
+            REQUIRE(levels == (x % 2 == 0 && y % 2 == 0 ? 1u : 0u));
+        }
+    }
+    REQUIRE(preview_pixel(0, 0, 8));
+    REQUIRE_FALSE(preview_pixel(0, 0, 4));
+    REQUIRE(preview_pixel(4, 0, 4));
+    REQUIRE(preview_pixel(2, 6, 2));
+    REQUIRE_FALSE(preview_pixel(4, 4, 2));
+}
+
+TEST_CASE("Preview image", "[preview]") {
+    Accumulator acc(10, 5);
+    acc.add(0, 0, {1, 0, 0, 1});
+    acc.add(8, 0, {0, 1, 0, 1});
+    acc.add(0, 4, {0, 0, 1, 1});
+    acc.add(0, 4, {0, 0, 0, 1});
+
+    const Image coarse = preview_image(acc, 8);
+    REQUIRE(coarse(7, 4) == Color(1, 0, 0, 1));
+    REQUIRE(coarse(9, 2) == Color(0, 1, 0, 1));
+
+    const Image fine = preview_image(acc, 4);
+    REQUIRE(fine(3, 3) == Color(1, 0, 0, 1));
+    REQUIRE(fine(2, 4) == Color(0, 0, 0.5f, 1));
+    // blocks without samples are black
+    REQUIRE(fine(5, 1) == Color());
+}
@@ -0,0 +1,19 @@
+#include "../lib/kdtree.h"
+#include "../lib/render_context.h"
+#include "helper.h"
+
+#include <catch.hpp>
+
+TEST_CASE("Render contexts", "[render_context]") {
+    const KDTree tree(TriangleMesh(
+        Triangles{test_triangle({0, 0, 0}, {1, 0, 0}, {0, 1, 0})}));
+
+    auto contexts = make_render_contexts<KDTreeIntersection>(tree, 3);
+    REQUIRE(contexts.size() == 3);
+
+    float r, s, t;
+    const auto id = contexts[1]->tree_intersection.intersect(
+        {{0.2f, 0.2f, 1}, {0, 0, -1}}, r, s, t);
+    REQUIRE(id);
+    REQUIRE(r == Approx(1));
+}
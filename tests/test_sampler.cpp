@@ -0,0 +1,109 @@
+#include "../lib/sampler.h"
+
+#include <catch.hpp>
+
+#include <cmath>
+#include <vector>
+
+namespace {
+
+const SamplerType ALL_TYPES[] = {SamplerType::RANDOM, SamplerType::STRATIFIED,
+                                 SamplerType::HALTON, SamplerType::SOBOL};
+
+// Number of values of a dimension of the first n samples of a pixel in each
+// of the n strata of [0, 1).
+std::vector<int> strata(SamplerType type, uint32_t dimension, uint32_t n) {
+    std::vector<int> counts(n, 0);
+    for (uint32_t i = 0; i < n; ++i) {
+        const float u = Sampler(type, 0, 17, i, n).at(dimension);
+        counts[static_cast<size_t>(u * n)] += 1;
+    }
+    return counts;
+}
+
+// Mean absolute error of the integral of x * y over [0, 1)^2 with n samples
+// per pixel, over many pixels.
+double integration_error(SamplerType type, uint32_t n) {
+    const int num_pixels = 200;
+    double error = 0;
+    for (int pixel = 0; pixel < num_pixels; ++pixel) {
+        double sum = 0;
+        for (uint32_t i = 0; i < n; ++i) {
+            Sampler sampler(type, 0, pixel, i, n);
+            const float x = sampler();
+            const float y = sampler();
+            sum += x * y;
+        }
+        error += std::abs(sum / n - 0.25);
+    }
+    return error / num_pixels;
+}
+
+} // namespace
+
+TEST_CASE("Sampler names", "[sampler]") {
+    for (const auto type : ALL_TYPES) {
+        SamplerType parsed = SamplerType::RANDOM;
+        REQUIRE(parse_sampler_type(to_string(type), parsed));
+        REQUIRE(parsed == type);
+    }
+    SamplerType parsed;
+    REQUIRE_FALSE(parse_sampler_type("poisson", parsed));
+}
+
+TEST_CASE("Samplers are deterministic and in [0, 1)", "[sampler]") {
+    for (const auto type : ALL_TYPES) {
+        for (uint32_t i = 0; i < 64; ++i) {
+            Sampler sampler(type, 3, 1234, i, 16);
+            REQUIRE(sampler.type() == type);
+            for (uint32_t dimension = 0; dimension < 40; ++dimension) {
+                const float u = sampler();
+                REQUIRE(0 <= u);
+                REQUIRE(u < 1);
+                REQUIRE(Sampler(type, 3, 1234, i, 16).at(dimension) == u);
+            }
+            REQUIRE(sampler.dimension() == 40);
+        }
+    }
+}
+
+TEST_CASE("Stratified samples", "[sampler]") {
+    for (uint32_t dimension = 0; dimension < 8; ++dimension) {
+        for (int count : strata(SamplerType::STRATIFIED, dimension, 10)) {
+            REQUIRE(count == 1);
+        }
+    }
+}
+
+TEST_CASE("Halton and Sobol samples are stratified", "[sampler]") {
+    for (const auto type : {SamplerType::HALTON, SamplerType::SOBOL}) {
+        for (int count : strata(type, 0, 16)) {
+            REQUIRE(count == 1);
+        }
+    }
+    for (uint32_t dimension = 0; dimension < 8; ++dimension) {
+        for (int count : strata(SamplerType::SOBOL, dimension, 32)) {
+            REQUIRE(count == 1);
+        }
+    }
+
+    // the pairs of dimensions of Sobol are (0, 2)-nets: every 4x4 cell has
+    // one of 16 points
+    std::vector<int> cells(16, 0);
+    for (uint32_t i = 0; i < 16; ++i) {
+        Sampler sampler(SamplerType::SOBOL, 0, 5, i, 16);
+        const int x = sampler.at(2) * 4;
+        const int y = sampler.at(3) * 4;
+        cells[y * 4 + x] += 1;
+    }
+    for (int count : cells) {
+        REQUIRE(count == 1);
+    }
+}
+
+TEST_CASE("Low-discrepancy samples converge faster", "[sampler]") {
+    const double random = integration_error(SamplerType::RANDOM, 64);
+    REQUIRE(integration_error(SamplerType::STRATIFIED, 64) < random);
+    REQUIRE(integration_error(SamplerType::HALTON, 64) < random / 2);
+    REQUIRE(integration_error(SamplerType::SOBOL, 64) < random / 2);
+}
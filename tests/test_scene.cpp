@@ -0,0 +1,91 @@
+#include "../lib/scene.h"
+#include <catch.hpp>
+
+namespace {
+
+// Mesh containing a single triangle in the xy-plane.
+aiMesh* triangle_mesh(unsigned int material_index) {
+    auto* mesh = new aiMesh();
+    mesh->mNumVertices = 3;
+    mesh->mVertices = new aiVector3D[3]{{0, 0, 0}, {1, 0, 0}, {0, 1, 0}};
+    mesh->mNormals = new aiVector3D[3]{{0, 0, 1}, {0, 0, 1}, {0, 0, 1}};
+    mesh->mNumFaces = 1;
+    mesh->mFaces = new aiFace[1];
+    mesh->mFaces[0].mNumIndices = 3;
+    mesh->mFaces[0].mIndices = new unsigned int[3]{0, 1, 2};
+    mesh->mMaterialIndex = material_index;
+    return mesh;
+}
+
+aiMaterial* material(const aiColor4D& diffuse, const aiColor4D& emissive) {
+    auto* material = new aiMaterial();
+    material->AddProperty(&diffuse, 1, AI_MATKEY_COLOR_DIFFUSE);
+    material->AddProperty(&emissive, 1, AI_MATKEY_COLOR_EMISSIVE);
+    return material;
+}
+
+// Scene with two triangle meshes attached to a node translated by (1, 2, 3).
+void setup_scene(aiScene& scene) {
+    scene.mNumMeshes = 2;
+    scene.mMeshes = new aiMesh* [2] { triangle_mesh(1), triangle_mesh(0) };
+
+    scene.mNumMaterials = 2;
+    scene.mMaterials = new aiMaterial* [2] {
+        material({1, 0, 0, 1}, {0, 0, 0, 1}),
+            material({0, 1, 0, 1}, {0, 0, 1, 1})
+    };
+
+    auto* node = new aiNode();
+    node->mTransformation.a4 = 1;
+    node->mTransformation.b4 = 2;
+    node->mTransformation.c4 = 3;
+    node->mNumMeshes = 2;
+    node->mMeshes = new unsigned int[2]{0, 1};
+
+    scene.mRootNode = new aiNode();
+    scene.mRootNode->mNumChildren = 1;
+    scene.mRootNode->mChildren = new aiNode* [1] { node };
+    node->mParent = scene.mRootNode;
+}
+
+} // namespace
+
+TEST_CASE("Materials from scene", "[scene]") {
+    aiScene scene;
+    setup_scene(scene);
+
+    auto materials = materials_from_scene(&scene);
+    REQUIRE(materials.size() == 2);
+    REQUIRE(materials[0].diffuse == Color(1, 0, 0, 1));
+    REQUIRE(materials[0].emissive == Color(0, 0, 0, 1));
+    REQUIRE(materials[1].diffuse == Color(0, 1, 0, 1));
+    REQUIRE(materials[1].emissive == Color(0, 0, 1, 1));
+}
+
+TEST_CASE("Mesh from scene", "[scene]") {
+    aiScene scene;
+    setup_scene(scene);
+
+    for (size_t num_threads : {1, 4}) {
+        SceneLoadTimes times;
+        auto mesh = mesh_from_scene(&scene, num_threads, &times);
+
+        REQUIRE(mesh.size() == 2);
+        REQUIRE(mesh.vertices().size() == 6);
+        REQUIRE(mesh.materials().size() == 2);
+
+        // faces refer to the vertices of their own aiMesh
+        REQUIRE(mesh.faces()[0] == TriangleMesh::Face{0, 1, 2});
+        REQUIRE(mesh.faces()[1] == TriangleMesh::Face{3, 4, 5});
+        REQUIRE(mesh.material_ids()[0] == 1);
+        REQUIRE(mesh.material_ids()[1] == 0);
+
+        // vertices are in world coordinates
+        auto tri = mesh[1];
+        REQUIRE(tri.vertices[0] == Point3f(1, 2, 3));
+        REQUIRE(tri.vertices[1] == Point3f(2, 2, 3));
+        REQUIRE(tri.vertices[2] == Point3f(1, 3, 3));
+        REQUIRE(tri.normals[0] == Normal3f(0, 0, 1));
+        REQUIRE(mesh.material(0).diffuse == Color(0, 1, 0, 1));
+    }
+}
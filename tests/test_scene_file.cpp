@@ -0,0 +1,173 @@
+#include "../lib/scene_file.h"
+
+#include <catch.hpp>
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+namespace {
+
+Scene test_scene() {
+    Materials materials(2);
+    materials[1].diffuse = {0, 1, 0, 1};
+    materials[1].emissive = {0, 0, 1, 1};
+    materials[1].reflectivity = 0.5f;
+
+    const Normal3f n(0, 0, 1);
+    Triangles triangles{
+        Triangle({{{0, 0, 0}, {1, 0, 0}, {0, 1, 0}}}, {n, n, n}, 0),
+        Triangle({{{0, 0, 1}, {1, 0, 1}, {0, 1, 1}}}, {n, n, n}, 1)};
+
+    Scene scene;
+    scene.mesh = TriangleMesh(triangles, materials);
+    scene.camera_trafo.a4 = 1;
+    scene.camera_trafo.b4 = 2;
+    scene.camera_trafo.c4 = 3;
+    scene.camera.mHorizontalFOV = 0.5f;
+    scene.camera.mAspect = 2;
+    scene.lights.push_back({{1, 2, 3}, {1, 1, 0.5f, 1}});
+    return scene;
+}
+
+// Write the content into a temporary file, which is removed on destruction.
+struct TempFile {
+    explicit TempFile(const std::string& content)
+        : filename("test_scene_file.turner") {
+        std::ofstream file(filename, std::ios::binary);
+        file << content;
+    }
+    ~TempFile() { std::remove(filename.c_str()); }
+
+    std::string filename;
+};
+
+std::string serialized(const Scene& scene) {
+    std::ostringstream os;
+    write_scene_file(os, scene);
+    return os.str();
+}
+
+} // namespace
+
+TEST_CASE("Write and read scene file", "[scene_file]") {
+    const Scene scene = test_scene();
+    TempFile file(serialized(scene));
+
+    REQUIRE(is_scene_file(file.filename));
+
+    Scene loaded;
+    std::string error;
+    REQUIRE(read_scene_file(file.filename, loaded, error));
+    REQUIRE(error.empty());
+
+    const auto& mesh = loaded.mesh;
+    REQUIRE(mesh.vertices() == scene.mesh.vertices());
+    REQUIRE(mesh.normals() == scene.mesh.normals());
+    REQUIRE(mesh.faces() == scene.mesh.faces());
+    REQUIRE(mesh.material_ids() == scene.mesh.material_ids());
+    REQUIRE(mesh.materials().size() == 2);
+    REQUIRE(mesh.material(1).diffuse == Color(0, 1, 0, 1));
+    REQUIRE(mesh.material(1).emissive == Color(0, 0, 1, 1));
+    REQUIRE(mesh.material(1).reflectivity == 0.5f);
+
+    REQUIRE(loaded.camera_trafo == scene.camera_trafo);
+    REQUIRE(loaded.camera.mHorizontalFOV == 0.5f);
+    REQUIRE(loaded.camera.mAspect == 2);
+
+    REQUIRE(loaded.lights.size() == 1);
+    REQUIRE(loaded.lights[0].position == Point3f(1, 2, 3));
+    REQUIRE(loaded.lights[0].color == Color(1, 1, 0.5f, 1));
+
+    // the camera is the same as the one of the original scene
+    float aspect = 1;
+    const Camera cam = loaded.make_camera(aspect);
+    REQUIRE(aspect == 2);
+    REQUIRE(cam.mPosition == aiVector3D(1, 2, 3));
+}
+
+TEST_CASE("Scene file camera is trivial", "[scene_file]") {
+    TempFile file(serialized(test_scene()));
+
+    // as set by Assimp, whose default camera looks along +z
+    Scene loaded;
+    loaded.camera.mPosition = aiVector3D(1, 1, 1);
+    loaded.camera.mUp = aiVector3D(1, 0, 0);
+    loaded.camera.mLookAt = aiVector3D(0, 0, 1);
+
+    std::string error;
+    REQUIRE(read_scene_file(file.filename, loaded, error));
+    REQUIRE(loaded.camera.mPosition == aiVector3D(0, 0, 0));
+    REQUIRE(loaded.camera.mUp == aiVector3D(0, 1, 0));
+    REQUIRE(loaded.camera.mLookAt == aiVector3D(0, 0, -1));
+}
+
+TEST_CASE("Write and read out-of-core scene file", "[scene_file]") {
+    Scene scene = test_scene();
+    scene.mesh = TriangleMesh(Triangles{}, scene.mesh.materials());
+    scene.chunks.push_back({42, Bbox3f({0, 0, 0}, {1, 1, 1}), 0, 3});
+    scene.chunks.push_back({43, Bbox3f({1, 0, 0}, {2, 1, 1}), 3, 2});
+    TempFile file(serialized(scene));
+    REQUIRE(scene_chunk_dir(file.filename) == file.filename + ".chunks");
+
+    Scene loaded;
+    std::string error;
+    REQUIRE(read_scene_file(file.filename, loaded, error));
+    REQUIRE(loaded.mesh.size() == 0);
+    REQUIRE(loaded.mesh.materials().size() == 2);
+    REQUIRE(loaded.chunks.size() == 2);
+    REQUIRE(loaded.chunks[1].key == 43);
+    REQUIRE(loaded.chunks[1].box == Bbox3f({1, 0, 0}, {2, 1, 1}));
+    REQUIRE(loaded.chunks[1].first_triangle == 3);
+    REQUIRE(loaded.chunks[1].num_triangles == 2);
+
+    SECTION("Chunks have to number the triangles consecutively") {
+        scene.chunks[1].first_triangle = 4;
+        TempFile gap(serialized(scene));
+        REQUIRE_FALSE(read_scene_file(gap.filename, loaded, error));
+        REQUIRE_FALSE(error.empty());
+    }
+}
+
+TEST_CASE("Reject invalid scene files", "[scene_file]") {
+    const std::string content = serialized(test_scene());
+    Scene loaded;
+    std::string error;
+
+    SECTION("Not a scene file") {
+        TempFile file("solid cube\nendsolid cube\n");
+        REQUIRE_FALSE(is_scene_file(file.filename));
+        REQUIRE_FALSE(read_scene_file(file.filename, loaded, error));
+    }
+
+    SECTION("Missing file") {
+        REQUIRE_FALSE(is_scene_file("does_not_exist.turner"));
+        REQUIRE_FALSE(
+            read_scene_file("does_not_exist.turner", loaded, error));
+    }
+
+    SECTION("Truncated file") {
+        TempFile file(content.substr(0, content.size() - 1));
+        REQUIRE(is_scene_file(file.filename));
+        REQUIRE_FALSE(read_scene_file(file.filename, loaded, error));
+    }
+
+    SECTION("Wrong version") {
+        std::string modified = content;
+        modified[offsetof(SceneFileHeader, version)] += 1;
+        TempFile file(modified);
+        REQUIRE_FALSE(read_scene_file(file.filename, loaded, error));
+    }
+
+    SECTION("Vertex index out of range") {
+        SceneFileHeader header;
+        std::memcpy(&header, content.data(), sizeof(header));
+        std::string modified = content;
+        const uint32_t index = 42;
+        std::memcpy(&modified[header.faces_offset], &index, sizeof(index));
+        TempFile file(modified);
+        REQUIRE_FALSE(read_scene_file(file.filename, loaded, error));
+    }
+
+    REQUIRE_FALSE(error.empty());
+}
@@ -0,0 +1,81 @@
+#include "../lib/output.h"
+#include "../lib/stats.h"
+
+#include <catch.hpp>
+
+#include <sstream>
+#include <thread>
+
+TEST_CASE("Count rays in thread-local shards", "[stats]") {
+    const auto before = Stats::instance().rays();
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 4; ++i) {
+        threads.emplace_back([]() {
+            for (int j = 0; j < 1000; ++j) {
+                Stats::local().count_ray(RayType::PRIMARY, 0, j % 4 != 0);
+                Stats::local().count_ray(RayType::SHADOW, 0, j % 2 == 0);
+                Stats::local().count_ray(RayType::INDIRECT, 1 + j % 20, true);
+            }
+            Stats::local().count_rays(RayType::FORM_FACTOR, 128, 32);
+        });
+    }
+    // counted in a live shard
+    Stats::local().count_ray(RayType::PRIMARY, 0, false);
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    // the shards of the exited threads are kept
+    const auto after = Stats::instance().rays();
+    auto diff = [&](RayType type) {
+        return after.num_rays(type) - before.num_rays(type);
+    };
+    auto diff_hits = [&](RayType type) {
+        return after.num_hits(type) - before.num_hits(type);
+    };
+    REQUIRE(diff(RayType::PRIMARY) == 4001);
+    REQUIRE(diff_hits(RayType::PRIMARY) == 3000);
+    REQUIRE(diff(RayType::SHADOW) == 4000);
+    REQUIRE(diff_hits(RayType::SHADOW) == 2000);
+    REQUIRE(diff(RayType::INDIRECT) == 4000);
+    REQUIRE(diff(RayType::FORM_FACTOR) == 512);
+    REQUIRE(diff_hits(RayType::FORM_FACTOR) == 128);
+    REQUIRE(after.num_rays() - before.num_rays() == 4001 + 4000 + 4000 + 512);
+
+    // form factor rays have no depth
+    REQUIRE(after.by_depth[0] - before.by_depth[0] == 4001 + 4000);
+    REQUIRE(after.by_depth[1] - before.by_depth[1] == 4 * 50);
+    // depths from 15 on share the last bucket
+    REQUIRE(after.by_depth[RayStats::MAX_DEPTH - 1] -
+                before.by_depth[RayStats::MAX_DEPTH - 1] ==
+            4 * 6 * 50);
+}
+
+TEST_CASE("Hit rate", "[stats]") {
+    RayStats rays;
+    REQUIRE(rays.hit_rate(RayType::SHADOW) == 0);
+    rays.rays[static_cast<size_t>(RayType::SHADOW)] = 4;
+    rays.hits[static_cast<size_t>(RayType::SHADOW)] = 1;
+    REQUIRE(rays.hit_rate(RayType::SHADOW) == 0.25);
+
+    RayStats sum;
+    sum += rays;
+    sum += rays;
+    REQUIRE(sum.num_rays() == 8);
+    REQUIRE(sum.num_hits(RayType::SHADOW) == 2);
+}
+
+TEST_CASE("Write ray stats", "[stats]") {
+    Stats::local().count_ray(RayType::SHADOW, 2, true);
+
+    std::ostringstream text;
+    text << Stats::instance();
+    REQUIRE(text.str().find("Rays (shadow)  : ") != std::string::npos);
+    REQUIRE(text.str().find("Rays by depth  : ") != std::string::npos);
+
+    std::ostringstream json;
+    write_json(json, Stats::instance());
+    REQUIRE(json.str().find("\"shadow\": {\"rays\": ") != std::string::npos);
+    REQUIRE(json.str().find("\"rays_by_depth\": [") != std::string::npos);
+}
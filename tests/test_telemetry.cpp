@@ -0,0 +1,97 @@
+#include "../lib/telemetry.h"
+
+#include <catch.hpp>
+
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+std::vector<Json> parse_lines(const std::string& text) {
+    std::vector<Json> lines;
+    std::stringstream ss(text);
+    std::string line;
+    while (std::getline(ss, line)) {
+        Json json;
+        std::string error;
+        REQUIRE(parse_json(line, json, error));
+        lines.push_back(json);
+    }
+    return lines;
+}
+
+} // namespace
+
+TEST_CASE("Telemetry writes progress and done lines", "[telemetry]") {
+    std::stringstream out;
+    {
+        Telemetry telemetry(out, 2, std::chrono::milliseconds(10));
+        telemetry.set_label("frame0001");
+        telemetry.start_phase("Pass 1", 4);
+        {
+            Telemetry::Busy busy(&telemetry, 0);
+            Stats::local().count_ray(RayType::PRIMARY, 0, true);
+            std::this_thread::sleep_for(std::chrono::milliseconds(30));
+        }
+        telemetry.set_completed(1);
+        std::this_thread::sleep_for(std::chrono::milliseconds(30));
+    }
+
+    const auto lines = parse_lines(out.str());
+    REQUIRE(lines.size() >= 2);
+    for (size_t i = 0; i < lines.size(); ++i) {
+        const Json& line = lines[i];
+        REQUIRE(line.is_object());
+        REQUIRE(line.find("event")->string ==
+                (i + 1 < lines.size() ? "progress" : "done"));
+        REQUIRE(line.find("label")->string == "frame0001");
+        REQUIRE(line.find("phase")->string == "Pass 1");
+        REQUIRE(line.find("total")->number == 4);
+        REQUIRE(line.find("rays_per_s")->is_object());
+        REQUIRE(line.find("rays_per_s")->find("primary"));
+        REQUIRE(line.find("rays_per_s")->find("form_factor"));
+        REQUIRE(line.find("rss_bytes")->number > 0);
+        REQUIRE(line.find("threads")->array.size() == 2);
+    }
+
+    const Json& done = lines.back();
+    REQUIRE(done.find("tiles")->number == 1);
+    // 3 of 4 tiles remain after about 30 ms
+    REQUIRE(done.find("eta_s")->number >= 0.06);
+
+    const auto& threads = done.find("threads")->array;
+    REQUIRE(threads[0].find("tiles")->number == 1);
+    REQUIRE(threads[0].find("busy_s")->number >= 0.03);
+    REQUIRE(threads[0].find("idle_s")->number >= 0.02);
+    REQUIRE(threads[1].find("tiles")->number == 0);
+    REQUIRE(threads[1].find("busy_s")->number == 0);
+    REQUIRE(threads[1].find("idle_s")->number >= 0.05);
+}
+
+TEST_CASE("Telemetry has no ETA before the first tile", "[telemetry]") {
+    std::stringstream out;
+    {
+        Telemetry telemetry(out, 1, std::chrono::milliseconds(1000));
+        telemetry.start_phase("Rendering", 10);
+    }
+    const auto lines = parse_lines(out.str());
+    REQUIRE(lines.size() == 1);
+    REQUIRE(lines[0].find("event")->string == "done");
+    REQUIRE(lines[0].find("eta_s")->type == Json::NUL);
+}
+
+TEST_CASE("Telemetry ETA of a progressive render", "[telemetry]") {
+    std::stringstream out;
+    {
+        Telemetry telemetry(out, 1, std::chrono::milliseconds(1000));
+        telemetry.start_phase("Pass 2", 10,
+                              Telemetry::Clock::now() +
+                                  std::chrono::seconds(60));
+    }
+    const auto lines = parse_lines(out.str());
+    REQUIRE(lines.size() == 1);
+    REQUIRE(lines[0].find("eta_s")->number > 59);
+    REQUIRE(lines[0].find("eta_s")->number <= 60);
+}
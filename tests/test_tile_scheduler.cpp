@@ -0,0 +1,134 @@
+#include "../lib/tile_scheduler.h"
+
+#include <catch.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+
+TEST_CASE("Morton code", "[tile_scheduler]") {
+    REQUIRE(morton_code(0, 0) == 0);
+    REQUIRE(morton_code(1, 0) == 1);
+    REQUIRE(morton_code(0, 1) == 2);
+    REQUIRE(morton_code(1, 1) == 3);
+    REQUIRE(morton_code(2, 0) == 4);
+    REQUIRE(morton_code(3, 5) == 0x27);
+}
+
+TEST_CASE("Tiles cover the image", "[tile_scheduler]") {
+    const size_t width = 70, height = 45, tile_size = 16;
+    const auto tiles = make_tiles(width, height, tile_size);
+    REQUIRE(tiles.size() == 5 * 3);
+
+    std::vector<int> covered(width * height, 0);
+    for (const auto& tile : tiles) {
+        REQUIRE(0 < tile.width());
+        REQUIRE(tile.width() <= tile_size);
+        REQUIRE(0 < tile.height());
+        REQUIRE(tile.height() <= tile_size);
+        for (size_t y = tile.y0; y < tile.y1; ++y) {
+            for (size_t x = tile.x0; x < tile.x1; ++x) {
+                covered[y * width + x] += 1;
+            }
+        }
+    }
+    for (int count : covered) {
+        REQUIRE(count == 1);
+    }
+
+    // Z-order: the first four tiles form the top left 2x2 block
+    REQUIRE(tiles[0].x0 == 0);
+    REQUIRE(tiles[0].y0 == 0);
+    REQUIRE(tiles[1].x0 == 16);
+    REQUIRE(tiles[1].y0 == 0);
+    REQUIRE(tiles[2].x0 == 0);
+    REQUIRE(tiles[2].y0 == 16);
+    REQUIRE(tiles[3].x0 == 16);
+    REQUIRE(tiles[3].y0 == 16);
+}
+
+TEST_CASE("Intersect tiles", "[tile_scheduler]") {
+    const Tile a = {0, 0, 16, 16};
+    const Tile b = {8, 4, 40, 10};
+    const Tile both = intersect(a, b);
+    REQUIRE(both.x0 == 8);
+    REQUIRE(both.y0 == 4);
+    REQUIRE(both.x1 == 16);
+    REQUIRE(both.y1 == 10);
+
+    REQUIRE(intersect(a, {16, 0, 32, 16}).size() == 0);
+    REQUIRE(intersect(a, {20, 20, 32, 32}).size() == 0);
+}
+
+TEST_CASE("Schedule tiles", "[tile_scheduler]") {
+    const size_t width = 100, height = 60;
+    const size_t num_workers = 4;
+    TileScheduler scheduler(make_tiles(width, height, 8), num_workers);
+    REQUIRE(scheduler.num_tiles() == 13 * 8);
+    REQUIRE(scheduler.num_workers() == num_workers);
+
+    // a pixel is written by exactly one thread, so no locking is needed;
+    // Catch is not thread-safe, hence, nothing is checked in render_tile
+    std::vector<int> rendered(width * height, 0);
+    std::vector<size_t> tiles_per_worker(num_workers + 1, 0);
+    size_t last_progress = 0;
+    bool monotonic = true;
+    scheduler.run(
+        [&](const Tile& tile, size_t worker) {
+            tiles_per_worker[std::min(worker, num_workers)] += 1;
+            for (size_t y = tile.y0; y < tile.y1; ++y) {
+                for (size_t x = tile.x0; x < tile.x1; ++x) {
+                    rendered[y * width + x] += 1;
+                }
+            }
+        },
+        [&](size_t completed) {
+            monotonic = monotonic && last_progress < completed;
+            last_progress = completed;
+        });
+
+    REQUIRE(monotonic);
+    REQUIRE(last_progress == scheduler.num_tiles());
+    for (int count : rendered) {
+        REQUIRE(count == 1);
+    }
+    REQUIRE(tiles_per_worker[num_workers] == 0); // invalid worker indices
+    size_t num_tiles = 0;
+    for (size_t count : tiles_per_worker) {
+        num_tiles += count;
+    }
+    REQUIRE(num_tiles == scheduler.num_tiles());
+}
+
+TEST_CASE("Steal tiles from a busy worker", "[tile_scheduler]") {
+    TileScheduler scheduler(make_tiles(64, 64, 8), 2);
+    std::atomic<size_t> by_second{0};
+    scheduler.run(
+        [&](const Tile&, size_t worker) {
+            if (worker == 0) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            } else {
+                by_second += 1;
+            }
+        },
+        [](size_t) {});
+    // the second worker is done long before the first and takes over
+    REQUIRE(scheduler.num_steals() > 0);
+    REQUIRE(by_second > scheduler.num_tiles() / 2);
+}
+
+TEST_CASE("Rethrow exception of a tile", "[tile_scheduler]") {
+    TileScheduler scheduler(make_tiles(64, 64, 8), 3);
+    std::atomic<size_t> num_rendered{0};
+    REQUIRE_THROWS_AS(scheduler.run(
+                          [&](const Tile& tile, size_t) {
+                              if (tile.x0 == 8 && tile.y0 == 8) {
+                                  throw std::runtime_error("tile failed");
+                              }
+                              num_rendered += 1;
+                          },
+                          [](size_t) {}),
+                      std::runtime_error);
+    REQUIRE(num_rendered < scheduler.num_tiles());
+}
@@ -79,3 +79,49 @@ TEST_CASE("Test interpolate triangle normal with trivial case", "[triangle]") {
         REQUIRE(interpolated_normal.z == Approx(normal.z));
     }
 }
+
+TEST_CASE("Triangle mesh shares vertices", "[triangle]") {
+    TriangleMesh mesh;
+    Normal3f n(0, 0, 1);
+    auto a = mesh.add_vertex({0, 0, 0}, n);
+    auto b = mesh.add_vertex({1, 0, 0}, n);
+    auto c = mesh.add_vertex({1, 1, 0}, n);
+    auto d = mesh.add_vertex({0, 1, 0}, n);
+    Material material;
+    material.diffuse = Color(0.5f, 0.5f, 0.5f, 1);
+    mesh.add_material(Material{});
+    auto material_id = mesh.add_material(material);
+    mesh.add_face({a, b, c}, 0);
+    mesh.add_face({a, c, d}, material_id);
+
+    REQUIRE(mesh.size() == 2);
+    REQUIRE(mesh.vertices().size() == 4);
+
+    Triangle tri = mesh[1];
+    REQUIRE(tri.vertices[0] == Point3f(0, 0, 0));
+    REQUIRE(tri.vertices[1] == Point3f(1, 1, 0));
+    REQUIRE(tri.vertices[2] == Point3f(0, 1, 0));
+    REQUIRE(tri.normals[0] == n);
+    REQUIRE(tri.material_id == material_id);
+    REQUIRE(mesh.material(1).diffuse == material.diffuse);
+    REQUIRE(mesh.material(0).diffuse == Color());
+    REQUIRE(mesh.bbox(1) == tri.bbox());
+    REQUIRE_THROWS(mesh.at(2));
+}
+
+TEST_CASE("Triangle mesh from triangles", "[triangle]") {
+    static constexpr int NUM_SAMPLES = 100;
+
+    Triangles triangles;
+    for (int j = 0; j < NUM_SAMPLES; ++j) {
+        triangles.push_back(random_triangle());
+    }
+    TriangleMesh mesh(triangles);
+    REQUIRE(mesh.size() == triangles.size());
+
+    for (size_t i = 0; i < mesh.size(); ++i) {
+        REQUIRE(mesh[i].vertices == triangles[i].vertices);
+        REQUIRE(mesh[i].normal == triangles[i].normal);
+        REQUIRE(mesh.bbox(i) == triangles[i].bbox());
+    }
+}
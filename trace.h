@@ -1,6 +1,7 @@
 #pragma once
 
 #include "config.h"
+#include "lib/chunked_kdtree.h"
 #include "lib/kdtree.h"
 #include "lib/types.h"
 
@@ -11,6 +12,9 @@
  *
  * TODO: Could be a performance bottleneck since not inlined. Profile!
  *
+ * Instantiated for KDTreeIntersection and, for out-of-core scenes, for
+ * ChunkedKDTreeIntersection.
+ *
  * @param  origin            origin of the ray
  * @param  dir               direction of the ray
  * @param  tree_intersection wrapped kd-tree containing triangles for
@@ -20,6 +24,8 @@
  * @param  conf              configuration
  * @return                   Color hit by the ray
  */
-Color trace(const Ray& ray, KDTreeIntersection& tree_intersection,
+template <typename TreeIntersection>
+Color trace(const Ray& ray, TreeIntersection& tree_intersection,
             const std::vector<Light>& lights, int depth,
             const TracerConfig& conf);
+